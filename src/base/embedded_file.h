@@ -58,8 +58,9 @@
 namespace mozc {
 
 // Stores a byte data of file and its file size.  To create this structure, use
-// embed_file.py.  The first address of embedded file data is aligned at 64 bit
-// boundary, so we can embed data that requires normal alignment (8, 16, etc.).
+// embed_file.py.  The first address of embedded file data is aligned at 64 byte
+// boundary, so we can embed data that requires normal alignment (8, 16, etc.)
+// as well as data aligned at cache lines.
 struct EmbeddedFile {
   const uint64 *const data;
   const size_t size;
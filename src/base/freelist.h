@@ -89,6 +89,9 @@ class FreeList {
 
   void set_size(size_t size) { size_ = size; }
 
+  // Returns the number of chunks currently kept by this instance.
+  size_t chunk_count() const { return pool_.size(); }
+
  private:
   std::vector<T*> pool_;
   size_t current_index_;
@@ -57,7 +57,7 @@ namespace mozc {
 
 Mmap::Mmap() : text_(nullptr), size_(0) {}
 
-bool Mmap::Open(const char *filename, const char *mode) {
+bool Mmap::Open(const char *filename, const char *mode, bool populate) {
   Close();
   uint32 mode1, mode2, mode3, mode4;
   if (strcmp(mode, "r") == 0) {
@@ -135,7 +135,7 @@ class ScopedCloser {
 };
 }  // namespace
 
-bool Mmap::Open(const char *filename, const char *mode) {
+bool Mmap::Open(const char *filename, const char *mode, bool populate) {
   Close();
 
   int flag;
@@ -166,7 +166,14 @@ bool Mmap::Open(const char *filename, const char *mode) {
     prot |= PROT_WRITE;
   }
 
-  void *ptr = mmap(nullptr, st.st_size, prot, MAP_SHARED, fd, 0);
+  int map_flags = MAP_SHARED;
+#ifdef MAP_POPULATE
+  if (populate) {
+    map_flags |= MAP_POPULATE;
+  }
+#endif  // MAP_POPULATE
+
+  void *ptr = mmap(nullptr, st.st_size, prot, map_flags, fd, 0);
   if (ptr == MAP_FAILED) {
     LOG(WARNING) << "mmap() failed: " << filename;
     return false;
@@ -224,4 +231,40 @@ int Mmap::MaybeMUnlock(const void *addr, size_t len) { return -1; }
 
 #undef MOZC_HAVE_MLOCK
 
+#if defined(OS_WIN) || defined(OS_NACL)
+int Mmap::MaybeAdviseWillNeed(const void *addr, size_t len) { return -1; }
+
+int Mmap::MaybeAdviseHugePages(const void *addr, size_t len) { return -1; }
+
+#else  // OS_WIN || OS_NACL
+
+namespace {
+
+// Calls madvise() for the pages enclosing [addr, addr + len).
+int AdvisePages(const void *addr, size_t len, int advice) {
+  if (len == 0) {
+    return 0;
+  }
+  const uintptr_t page_size = static_cast<uintptr_t>(::getpagesize());
+  const uintptr_t begin =
+      reinterpret_cast<uintptr_t>(addr) & ~(page_size - 1);
+  const uintptr_t end = reinterpret_cast<uintptr_t>(addr) + len;
+  return ::madvise(reinterpret_cast<void *>(begin), end - begin, advice);
+}
+
+}  // namespace
+
+int Mmap::MaybeAdviseWillNeed(const void *addr, size_t len) {
+  return AdvisePages(addr, len, MADV_WILLNEED);
+}
+
+int Mmap::MaybeAdviseHugePages(const void *addr, size_t len) {
+#ifdef MADV_HUGEPAGE
+  return AdvisePages(addr, len, MADV_HUGEPAGE);
+#else   // MADV_HUGEPAGE
+  return -1;
+#endif  // MADV_HUGEPAGE
+}
+#endif  // OS_WIN || OS_NACL
+
 }  // namespace mozc
@@ -43,7 +43,11 @@ class Mmap : public MmapSyncInterface {
   Mmap();
   ~Mmap() override { Close(); }
 
-  bool Open(const char *filename, const char *mode = "r");
+  // Maps |filename|.  If |populate| is true, the whole file is prefaulted at
+  // mapping time (MAP_POPULATE) where supported, which moves the page faults
+  // of the first accesses to this call.
+  bool Open(const char *filename, const char *mode = "r",
+            bool populate = false);
   void Close();
 
   // Following mlock/munlock related functions work based on target environment.
@@ -61,6 +65,18 @@ class Mmap : public MmapSyncInterface {
   static int MaybeMLock(const void *addr, size_t len);
   static int MaybeMUnlock(const void *addr, size_t len);
 
+  // Memory advice for a mapped range.  |addr| and |len| don't need to be page
+  // aligned; the range is extended to the enclosing pages.  These functions
+  // return the result of madvise(), or -1 on platforms where the advice is not
+  // available.
+  // MaybeAdviseWillNeed() starts asynchronous read-ahead of the range.
+  // MaybeAdviseHugePages() asks the kernel to back the range with transparent
+  // huge pages.  For file mappings this only takes effect if the kernel
+  // supports huge pages for the page cache, so callers should treat failures
+  // as benign.
+  static int MaybeAdviseWillNeed(const void *addr, size_t len);
+  static int MaybeAdviseHugePages(const void *addr, size_t len);
+
   char &operator[](size_t n) { return *(text_ + n); }
   char operator[](size_t n) const { return *(text_ + n); }
   char *begin() { return text_; }
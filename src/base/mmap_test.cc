@@ -109,5 +109,36 @@ TEST(MmapTest, MaybeMLockTest) {
   }
 }
 
+TEST(MmapTest, PopulateAndAdviseTest) {
+  const std::string filename =
+      FileUtil::JoinPath(FLAGS_test_tmpdir, "populate.db");
+  const size_t kFileSize = 3 * 4096 + 17;
+  std::unique_ptr<char[]> buf(new char[kFileSize]);
+  Util::GetRandomSequence(buf.get(), kFileSize);
+  {
+    OutputFileStream ofs(filename.c_str(), std::ios::out | std::ios::binary);
+    EXPECT_TRUE(ofs.good());
+    ofs.write(buf.get(), kFileSize);
+  }
+
+  {
+    Mmap mmap;
+    ASSERT_TRUE(mmap.Open(filename.c_str(), "r", true));
+    ASSERT_EQ(kFileSize, mmap.size());
+    EXPECT_EQ(0, memcmp(buf.get(), mmap.begin(), kFileSize));
+
+    // The advice accepts unaligned ranges.  Huge pages may not be available
+    // for file mappings, so only check that the call doesn't break the data.
+#if defined(OS_WIN) || defined(OS_NACL)
+    EXPECT_EQ(-1, Mmap::MaybeAdviseWillNeed(mmap.begin() + 5, 4096));
+#else   // OS_WIN || OS_NACL
+    EXPECT_EQ(0, Mmap::MaybeAdviseWillNeed(mmap.begin() + 5, 4096));
+#endif  // OS_WIN || OS_NACL
+    Mmap::MaybeAdviseHugePages(mmap.begin(), mmap.size());
+    EXPECT_EQ(0, memcmp(buf.get(), mmap.begin(), kFileSize));
+  }
+  FileUtil::Unlink(filename);
+}
+
 }  // namespace
 }  // namespace mozc
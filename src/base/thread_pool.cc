@@ -0,0 +1,184 @@
+// Copyright 2010-2020, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#include "base/thread_pool.h"
+
+#include <algorithm>
+#include <utility>
+
+#include "base/logging.h"
+#include "base/thread.h"
+#include "absl/memory/memory.h"
+
+namespace mozc {
+namespace {
+
+// The workers are started on demand, so unused capacity costs nothing.
+constexpr size_t kMaxSharedWorkers = 8;
+
+}  // namespace
+
+class ThreadPool::Worker : public Thread {
+ public:
+  explicit Worker(ThreadPool *pool) : pool_(pool) {}
+  ~Worker() override = default;
+
+  void Run() override {
+    Task task;
+    while (pool_->TakeTask(this, &task)) {
+      task.func();
+      pool_->FinishTask(task.group);
+    }
+  }
+
+  void Wake() { wake_.Notify(); }
+  void Sleep() { wake_.Wait(-1); }
+
+ private:
+  ThreadPool *pool_;
+  UnnamedEvent wake_;
+
+  DISALLOW_COPY_AND_ASSIGN(Worker);
+};
+
+ThreadPool::ThreadPool(size_t max_workers)
+    : max_workers_(max_workers), shutdown_(false) {}
+
+ThreadPool::~ThreadPool() {
+  {
+    scoped_lock l(&mutex_);
+    shutdown_ = true;
+    for (Worker *worker : idle_workers_) {
+      worker->Wake();
+    }
+    idle_workers_.clear();
+  }
+  for (auto &worker : workers_) {
+    worker->Join();
+  }
+}
+
+// static
+ThreadPool *ThreadPool::GetSharedPool() {
+  static ThreadPool *pool = new ThreadPool(kMaxSharedWorkers);
+  return pool;
+}
+
+void ThreadPool::RunInParallel(size_t num_threads,
+                               const std::function<void()> &func) {
+  TaskGroup group(this);
+  for (size_t i = 1; i < num_threads; ++i) {
+    group.Schedule(func);
+  }
+  func();
+  group.Wait();
+}
+
+void ThreadPool::Schedule(Task task) {
+  scoped_lock l(&mutex_);
+  DCHECK(!shutdown_);
+  queue_.push_back(std::move(task));
+  if (!idle_workers_.empty()) {
+    idle_workers_.back()->Wake();
+    idle_workers_.pop_back();
+  } else if (workers_.size() < max_workers_) {
+    workers_.push_back(absl::make_unique<Worker>(this));
+    workers_.back()->SetJoinable(true);
+    workers_.back()->Start("ThreadPool");
+  }
+}
+
+bool ThreadPool::TakeTask(Worker *worker, Task *task) {
+  while (true) {
+    {
+      scoped_lock l(&mutex_);
+      if (!queue_.empty()) {
+        *task = std::move(queue_.front());
+        queue_.pop_front();
+        ++task->group->num_running_;
+        return true;
+      }
+      if (shutdown_) {
+        return false;
+      }
+      idle_workers_.push_back(worker);
+    }
+    worker->Sleep();
+  }
+}
+
+void ThreadPool::FinishTask(TaskGroup *group) {
+  scoped_lock l(&mutex_);
+  // |group| may be destroyed as soon as the lock is released after the
+  // notification.
+  if (--group->num_running_ == 0 && group->waiting_) {
+    group->waiting_ = false;
+    group->done_.Notify();
+  }
+}
+
+ThreadPool::TaskGroup::TaskGroup(ThreadPool *pool)
+    : pool_(pool), num_running_(0), waiting_(false) {
+  DCHECK(pool_);
+}
+
+ThreadPool::TaskGroup::~TaskGroup() { Wait(); }
+
+void ThreadPool::TaskGroup::Schedule(std::function<void()> func) {
+  pool_->Schedule({std::move(func), this});
+}
+
+void ThreadPool::TaskGroup::Wait() {
+  while (true) {
+    std::function<void()> func;
+    {
+      scoped_lock l(&pool_->mutex_);
+      auto it = std::find_if(pool_->queue_.begin(), pool_->queue_.end(),
+                             [this](const Task &task) {
+                               return task.group == this;
+                             });
+      if (it != pool_->queue_.end()) {
+        func = std::move(it->func);
+        pool_->queue_.erase(it);
+      } else if (num_running_ == 0) {
+        return;
+      } else {
+        waiting_ = true;
+      }
+    }
+    if (func) {
+      func();
+    } else {
+      done_.Wait(-1);
+    }
+  }
+}
+
+}  // namespace mozc
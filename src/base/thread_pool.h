@@ -0,0 +1,126 @@
+// Copyright 2010-2020, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#ifndef MOZC_BASE_THREAD_POOL_H_
+#define MOZC_BASE_THREAD_POOL_H_
+
+#include <deque>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "base/mutex.h"
+#include "base/port.h"
+#include "base/unnamed_event.h"
+
+namespace mozc {
+
+// A pool of worker threads which run tasks scheduled through TaskGroup.  The
+// workers are started on demand up to the given number and are reused until
+// the pool is destroyed, so that per-request parallelism, e.g., in conversion
+// and prediction, doesn't pay for creating threads.
+//
+// Usage:
+//   ThreadPool::TaskGroup group(ThreadPool::GetSharedPool());
+//   group.Schedule([&]() { ... });
+//   ...  // Does other work on the calling thread.
+//   group.Wait();
+class ThreadPool {
+ public:
+  class TaskGroup;
+
+  explicit ThreadPool(size_t max_workers);
+  // Runs the remaining tasks and joins the workers.
+  ~ThreadPool();
+
+  // Returns the pool shared in the process.  It's never destroyed.
+  static ThreadPool *GetSharedPool();
+
+  // Calls |func| on the calling thread and concurrently on up to
+  // |num_threads| - 1 workers, and returns when all the calls return.  Suited
+  // for |func| that takes work items from a shared queue until it's empty.
+  void RunInParallel(size_t num_threads, const std::function<void()> &func);
+
+  size_t max_workers() const { return max_workers_; }
+
+ private:
+  class Worker;
+  struct Task {
+    std::function<void()> func;
+    TaskGroup *group;
+  };
+
+  void Schedule(Task task);
+  // Blocks until a task is available and returns true with it, or returns
+  // false when the pool is being destroyed.
+  bool TakeTask(Worker *worker, Task *task);
+  void FinishTask(TaskGroup *group);
+
+  const size_t max_workers_;
+  Mutex mutex_;
+  std::deque<Task> queue_;
+  std::vector<std::unique_ptr<Worker>> workers_;
+  std::vector<Worker *> idle_workers_;
+  bool shutdown_;
+
+  DISALLOW_COPY_AND_ASSIGN(ThreadPool);
+};
+
+// A set of tasks scheduled on a ThreadPool that can be waited for together.
+class ThreadPool::TaskGroup {
+ public:
+  explicit TaskGroup(ThreadPool *pool);
+  // Waits for the tasks.
+  ~TaskGroup();
+
+  void Schedule(std::function<void()> func);
+
+  // Returns when all the scheduled tasks are done.  The tasks that no worker
+  // has started yet are run on the calling thread, so waiting never depends
+  // on a free worker; hence a task may wait for its own group of tasks on the
+  // same pool.
+  void Wait();
+
+ private:
+  friend class ThreadPool;
+
+  ThreadPool *pool_;
+  // The number of the tasks running on workers, guarded by |pool_->mutex_|.
+  size_t num_running_;
+  // True while Wait() waits for |done_|, guarded by |pool_->mutex_|.
+  bool waiting_;
+  UnnamedEvent done_;
+
+  DISALLOW_COPY_AND_ASSIGN(TaskGroup);
+};
+
+}  // namespace mozc
+
+#endif  // MOZC_BASE_THREAD_POOL_H_
@@ -0,0 +1,110 @@
+// Copyright 2010-2020, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#include "base/thread_pool.h"
+
+#include <atomic>
+#include <vector>
+
+#include "testing/base/public/gunit.h"
+
+namespace mozc {
+namespace {
+
+TEST(ThreadPoolTest, RunInParallel) {
+  ThreadPool pool(3);
+  for (size_t num_threads : {0, 1, 2, 4, 8}) {
+    std::vector<std::atomic<int>> counts(1000);
+    std::atomic<size_t> next_index(0);
+    pool.RunInParallel(num_threads, [&]() {
+      for (size_t i = next_index++; i < counts.size(); i = next_index++) {
+        ++counts[i];
+      }
+    });
+    for (const std::atomic<int> &count : counts) {
+      EXPECT_EQ(1, count.load());
+    }
+  }
+}
+
+TEST(ThreadPoolTest, TaskGroup) {
+  ThreadPool pool(2);
+  std::atomic<int> count(0);
+  {
+    ThreadPool::TaskGroup group(&pool);
+    for (int i = 0; i < 100; ++i) {
+      group.Schedule([&count]() { ++count; });
+    }
+    group.Wait();
+    EXPECT_EQ(100, count.load());
+
+    // The group can be reused after Wait().
+    group.Schedule([&count]() { ++count; });
+  }
+  // The destructor of the group waits for the task.
+  EXPECT_EQ(101, count.load());
+}
+
+TEST(ThreadPoolTest, NoWorker) {
+  // The tasks are run by Wait().
+  ThreadPool pool(0);
+  int count = 0;
+  ThreadPool::TaskGroup group(&pool);
+  group.Schedule([&count]() { ++count; });
+  group.Schedule([&count]() { ++count; });
+  EXPECT_EQ(0, count);
+  group.Wait();
+  EXPECT_EQ(2, count);
+}
+
+TEST(ThreadPoolTest, NestedTaskGroups) {
+  // The tasks wait for their own tasks on the same pool, which needs more
+  // threads than the pool has.
+  ThreadPool pool(1);
+  std::atomic<int> count(0);
+  ThreadPool::TaskGroup group(&pool);
+  for (int i = 0; i < 4; ++i) {
+    group.Schedule([&pool, &count]() {
+      pool.RunInParallel(4, [&count]() { ++count; });
+    });
+  }
+  group.Wait();
+  EXPECT_EQ(16, count.load());
+}
+
+TEST(ThreadPoolTest, SharedPool) {
+  ThreadPool *pool = ThreadPool::GetSharedPool();
+  ASSERT_NE(nullptr, pool);
+  EXPECT_EQ(pool, ThreadPool::GetSharedPool());
+  EXPECT_LT(0, pool->max_workers());
+}
+
+}  // namespace
+}  // namespace mozc
@@ -1199,7 +1199,7 @@ bool Util::IsKanaSymbolContained(const std::string &input) {
   return false;
 }
 
-bool Util::IsEnglishTransliteration(const std::string &value) {
+bool Util::IsEnglishTransliteration(absl::string_view value) {
   for (size_t i = 0; i < value.size(); ++i) {
     if (value[i] == 0x20 || value[i] == 0x21 || value[i] == 0x27 ||
         value[i] == 0x2D ||
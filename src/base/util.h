@@ -343,7 +343,7 @@ class Util {
   static bool IsKanaSymbolContained(const std::string &input);
 
   // Returns true if |input| looks like a pure English word.
-  static bool IsEnglishTransliteration(const std::string &value);
+  static bool IsEnglishTransliteration(absl::string_view value);
 
   static void NormalizeVoicedSoundMark(absl::string_view input,
                                        std::string *output);
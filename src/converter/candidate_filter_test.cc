@@ -44,6 +44,7 @@
 #include "dictionary/suppression_dictionary.h"
 #include "prediction/suggestion_filter.h"
 #include "testing/base/public/gunit.h"
+#include "absl/strings/str_cat.h"
 
 namespace mozc {
 namespace converter {
@@ -641,10 +642,10 @@ TEST_F(CandidateFilterTest, CapabilityOfSuggestionFilter_Conversion) {
     nodes.push_back(n);
 
     Segment::Candidate *c = NewCandidate();
-    c->key = n->key;
-    c->value = n->value;
-    c->content_key = n->key;
-    c->content_value = n->value;
+    c->key = std::string(n->key);
+    c->value = std::string(n->value);
+    c->content_key = std::string(n->key);
+    c->content_value = std::string(n->value);
     c->cost = 1000;
     c->structure_cost = 2000;
 
@@ -667,10 +668,10 @@ TEST_F(CandidateFilterTest, CapabilityOfSuggestionFilter_Suggestion) {
     nodes.push_back(n);
 
     Segment::Candidate *c = NewCandidate();
-    c->key = n->key;
-    c->value = n->value;
-    c->content_key = n->key;
-    c->content_value = n->value;
+    c->key = std::string(n->key);
+    c->value = std::string(n->value);
+    c->content_key = std::string(n->key);
+    c->content_value = std::string(n->value);
     c->cost = 1000;
     c->structure_cost = 2000;
 
@@ -681,7 +682,7 @@ TEST_F(CandidateFilterTest, CapabilityOfSuggestionFilter_Suggestion) {
     filter->Reset();
     // Test case where "フィルター" is suggested from key "ふぃるたー".
     EXPECT_EQ(CandidateFilter::BAD_CANDIDATE,
-              filter->FilterCandidate(n->key, c, nodes, Segments::SUGGESTION));
+              filter->FilterCandidate(c->key, c, nodes, Segments::SUGGESTION));
   }
   // Next test bigram case.
   {
@@ -700,8 +701,8 @@ TEST_F(CandidateFilterTest, CapabilityOfSuggestionFilter_Suggestion) {
     nodes.push_back(n2);
 
     Segment::Candidate *c = NewCandidate();
-    c->key.assign(n1->key).append(n2->key);
-    c->value.assign(n1->value).append(n2->value);
+    c->key = absl::StrCat(n1->key, n2->key);
+    c->value = absl::StrCat(n1->value, n2->value);
     c->content_key = c->key;
     c->content_value = c->value;
     c->cost = 1000;
@@ -740,9 +741,8 @@ TEST_F(CandidateFilterTest, CapabilityOfSuggestionFilter_Suggestion) {
     nodes.push_back(n3);
 
     Segment::Candidate *c = NewCandidate();
-    c->key.assign(n1->key).append(n2->key).append(n3->key);
-    ;
-    c->value.assign(n1->value).append(n2->value).append(n3->value);
+    c->key = absl::StrCat(n1->key, n2->key, n3->key);
+    c->value = absl::StrCat(n1->value, n2->value, n3->value);
     c->content_key = c->key;
     c->content_value = c->value;
     c->cost = 1000;
@@ -774,10 +774,10 @@ TEST_F(CandidateFilterTest, CapabilityOfSuggestionFilter_Suggestion_Mobile) {
     nodes.push_back(n);
 
     Segment::Candidate *c = NewCandidate();
-    c->key = n->key;
-    c->value = n->value;
-    c->content_key = n->key;
-    c->content_value = n->value;
+    c->key = std::string(n->key);
+    c->value = std::string(n->value);
+    c->content_key = std::string(n->key);
+    c->content_value = std::string(n->value);
     c->cost = 1000;
     c->structure_cost = 2000;
 
@@ -788,7 +788,7 @@ TEST_F(CandidateFilterTest, CapabilityOfSuggestionFilter_Suggestion_Mobile) {
     filter->Reset();
     // Test case where "フィルター" is suggested from key "ふぃるたー".
     EXPECT_EQ(CandidateFilter::GOOD_CANDIDATE,
-              filter->FilterCandidate(n->key, c, nodes, Segments::SUGGESTION));
+              filter->FilterCandidate(c->key, c, nodes, Segments::SUGGESTION));
   }
 }
 
@@ -807,10 +807,10 @@ TEST_F(CandidateFilterTest, CapabilityOfSuggestionFilter_Prediction) {
     nodes.push_back(n);
 
     Segment::Candidate *c = NewCandidate();
-    c->key = n->key;
-    c->value = n->value;
-    c->content_key = n->key;
-    c->content_value = n->value;
+    c->key = std::string(n->key);
+    c->value = std::string(n->value);
+    c->content_key = std::string(n->key);
+    c->content_value = std::string(n->value);
     c->cost = 1000;
     c->structure_cost = 2000;
 
@@ -823,7 +823,7 @@ TEST_F(CandidateFilterTest, CapabilityOfSuggestionFilter_Prediction) {
     // are good if its key is equal to the original key.
     filter->Reset();
     EXPECT_EQ(CandidateFilter::GOOD_CANDIDATE,
-              filter->FilterCandidate(n->key, c, nodes, Segments::PREDICTION));
+              filter->FilterCandidate(c->key, c, nodes, Segments::PREDICTION));
   }
   // Next test bigram case.
   {
@@ -842,8 +842,8 @@ TEST_F(CandidateFilterTest, CapabilityOfSuggestionFilter_Prediction) {
     nodes.push_back(n2);
 
     Segment::Candidate *c = NewCandidate();
-    c->key.assign(n1->key).append(n2->key);
-    c->value.assign(n1->value).append(n2->value);
+    c->key = absl::StrCat(n1->key, n2->key);
+    c->value = absl::StrCat(n1->value, n2->value);
     c->content_key = c->key;
     c->content_value = c->value;
     c->cost = 1000;
@@ -883,9 +883,8 @@ TEST_F(CandidateFilterTest, CapabilityOfSuggestionFilter_Prediction) {
     nodes.push_back(n3);
 
     Segment::Candidate *c = NewCandidate();
-    c->key.assign(n1->key).append(n2->key).append(n3->key);
-    ;
-    c->value.assign(n1->value).append(n2->value).append(n3->value);
+    c->key = absl::StrCat(n1->key, n2->key, n3->key);
+    c->value = absl::StrCat(n1->value, n2->value, n3->value);
     c->content_key = c->key;
     c->content_value = c->value;
     c->cost = 1000;
@@ -922,8 +921,8 @@ TEST_F(CandidateFilterTest, ReverseConversion) {
 
   {
     Segment::Candidate *c = NewCandidate();
-    c->key.assign(n1->key);
-    c->value.assign(n1->value);
+    c->key = std::string(n1->key);
+    c->value = std::string(n1->value);
     c->content_key = c->key;
     c->content_value = c->value;
     c->cost = 1000;
@@ -939,8 +938,8 @@ TEST_F(CandidateFilterTest, ReverseConversion) {
   {
     // White space should be valid candidate.
     Segment::Candidate *c = NewCandidate();
-    c->key.assign(n2->key);
-    c->value.assign(n2->value);
+    c->key = std::string(n2->key);
+    c->value = std::string(n2->value);
     c->content_key = c->key;
     c->content_value = c->value;
     c->cost = 1000;
@@ -34,6 +34,7 @@
 #include <limits>
 #include <memory>
 
+#include "base/flags.h"
 #include "base/logging.h"
 #include "base/port.h"
 #include "base/status.h"
@@ -44,6 +45,10 @@
 #include "absl/memory/memory.h"
 #include "absl/strings/str_cat.h"
 
+DEFINE_bool(use_dense_connection_matrix, false,
+            "Expands the connection matrix into a dense table on load. "
+            "Faster lookup at the cost of memory.");
+
 namespace mozc {
 namespace {
 
@@ -66,6 +71,18 @@ inline uint32 EncodeKey(uint16 rid, uint16 lid) {
   return (static_cast<uint32>(rid) << 16) | lid;
 }
 
+inline uint64 EncodeCacheEntry(uint32 key, int value) {
+  return (static_cast<uint64>(key) << 32) | static_cast<uint32>(value);
+}
+
+inline uint32 DecodeCacheKey(uint64 entry) {
+  return static_cast<uint32>(entry >> 32);
+}
+
+inline int DecodeCacheValue(uint64 entry) {
+  return static_cast<int32>(static_cast<uint32>(entry));
+}
+
 mozc::Status IsMemoryAligned32(const void *ptr) {
   const auto addr = reinterpret_cast<std::uintptr_t>(ptr);
   const auto alignment = addr % 4;
@@ -137,9 +154,7 @@ mozc::StatusOr<Metadata> ParseMetadata(const char *connection_data,
 
 class Connector::Row {
  public:
-  Row()
-      : chunk_bits_index_(sizeof(uint32)),
-        compact_bits_index_(sizeof(uint32)) {}
+  Row() = default;
 
   Row(const Row &) = delete;
   Row &operator=(const Row &) = delete;
@@ -197,6 +212,9 @@ mozc::StatusOr<std::unique_ptr<Connector>> Connector::CreateFromDataManager(
   const char *connection_data = nullptr;
   size_t connection_data_size = 0;
   data_manager.GetConnectorData(&connection_data, &connection_data_size);
+  if (FLAGS_use_dense_connection_matrix) {
+    return CreateDense(connection_data, connection_data_size);
+  }
   return Create(connection_data, connection_data_size, kCacheSize);
 }
 
@@ -210,7 +228,81 @@ mozc::StatusOr<std::unique_ptr<Connector>> Connector::Create(
   return connector;
 }
 
-Connector::Connector() = default;
+mozc::StatusOr<std::unique_ptr<Connector>> Connector::CreateDense(
+    const char *connection_data, size_t connection_size) {
+  // The cache is not used in the dense mode, so the minimum size is enough.
+  auto connector = absl::make_unique<Connector>();
+  auto status = connector->Init(connection_data, connection_size, 1);
+  if (!status.ok()) {
+    return status;
+  }
+  status = connector->ExpandToDenseTable();
+  if (!status.ok()) {
+    return status;
+  }
+  return connector;
+}
+
+// Hit/miss counts shared by a Connector and the threads looking it up.
+struct Connector::CacheStats {
+  std::atomic<uint64> hit_count{0};
+  std::atomic<uint64> miss_count{0};
+};
+
+// Accumulates the cache hits and misses of the current thread and adds them to
+// the shared counters in bulk, which keeps the atomic read-modify-write
+// operations out of GetTransitionCost().  The counts are flushed every
+// kFlushInterval lookups, when the thread switches to another connector, when
+// the thread exits, and before the stats are read or reset on the thread.
+class Connector::PendingCacheStats {
+ public:
+  PendingCacheStats() = default;
+  ~PendingCacheStats() { Flush(); }
+
+  PendingCacheStats(const PendingCacheStats &) = delete;
+  PendingCacheStats &operator=(const PendingCacheStats &) = delete;
+
+  static PendingCacheStats *Get() {
+    thread_local PendingCacheStats pending;
+    return &pending;
+  }
+
+  void Add(const std::shared_ptr<CacheStats> &stats, bool hit) {
+    // Compares the control blocks instead of the raw pointers, so that
+    // another instance allocated at the address of a destroyed one is not
+    // mistaken for it.
+    if (stats_.owner_before(stats) || stats.owner_before(stats_)) {
+      Flush();
+      stats_ = stats;
+    }
+    hit_count_ += hit;
+    if (++count_ >= kFlushInterval) {
+      Flush();
+    }
+  }
+
+  void Flush() {
+    if (count_ == 0) {
+      return;
+    }
+    if (const std::shared_ptr<CacheStats> stats = stats_.lock()) {
+      stats->hit_count.fetch_add(hit_count_, std::memory_order_relaxed);
+      stats->miss_count.fetch_add(count_ - hit_count_,
+                                  std::memory_order_relaxed);
+    }
+    hit_count_ = 0;
+    count_ = 0;
+  }
+
+ private:
+  static constexpr uint32 kFlushInterval = 1024;
+
+  std::weak_ptr<CacheStats> stats_;
+  uint32 hit_count_ = 0;
+  uint32 count_ = 0;
+};
+
+Connector::Connector() : cache_stats_(std::make_shared<CacheStats>()) {}
 Connector::~Connector() = default;
 
 mozc::Status Connector::Init(const char *connection_data,
@@ -222,8 +314,7 @@ mozc::Status Connector::Init(const char *connection_data,
   }
   cache_size_ = cache_size;
   cache_hash_mask_ = cache_size - 1;
-  cache_key_ = absl::make_unique<uint32[]>(cache_size);
-  cache_value_ = absl::make_unique<int[]>(cache_size);
+  cache_ = absl::make_unique<std::atomic<uint64>[]>(cache_size);
 
   mozc::StatusOr<Metadata> metadata =
       ParseMetadata(connection_data, connection_size);
@@ -329,22 +420,96 @@ mozc::Status Connector::Init(const char *connection_data,
 }
 
 
+mozc::Status Connector::ExpandToDenseTable() {
+  const size_t rsize = rows_.size();
+  lsize_ = rsize;  // The matrix is square.
+  auto table = absl::make_unique<int16[]>(rsize * lsize_);
+  for (size_t rid = 0; rid < rsize; ++rid) {
+    int16 *row = table.get() + rid * lsize_;
+    for (size_t lid = 0; lid < lsize_; ++lid) {
+      const int cost = LookupCost(rid, lid);
+      if (cost < std::numeric_limits<int16>::min() ||
+          cost > std::numeric_limits<int16>::max()) {
+        return mozc::OutOfRangeError(absl::StrCat(
+            "connector.cc: Cost doesn't fit in int16: rid=", rid,
+            ", lid=", lid, ", cost=", cost));
+      }
+      row[lid] = static_cast<int16>(cost);
+    }
+  }
+  dense_table_ = std::move(table);
+  return mozc::Status();
+}
+
 int Connector::GetTransitionCost(uint16 rid, uint16 lid) const {
-  const uint32 index = EncodeKey(rid, lid);
-  const uint32 bucket = GetHashValue(rid, lid, cache_hash_mask_);
-  if (cache_key_[bucket] == index) {
-    return cache_value_[bucket];
+  if (dense_table_ != nullptr) {
+    return dense_table_[rid * lsize_ + lid];
   }
-  const int value = LookupCost(rid, lid);
-  cache_key_[bucket] = index;
-  cache_value_[bucket] = value;
+  bool hit = false;
+  const int value = LookupCostWithCache(rid, lid, &hit);
+  PendingCacheStats::Get()->Add(cache_stats_, hit);
   return value;
 }
 
+void Connector::GetTransitionCosts(const uint16 *rids, size_t size, uint16 lid,
+                                   int32 *costs) const {
+  if (dense_table_ != nullptr) {
+    const int16 *column = dense_table_.get() + lid;
+    for (size_t i = 0; i < size; ++i) {
+      costs[i] = column[rids[i] * lsize_];
+    }
+    return;
+  }
+  // Updates the shared counters once per batch to keep the atomic operations
+  // out of the loop.
+  uint64 hit_count = 0;
+  for (size_t i = 0; i < size; ++i) {
+    bool hit = false;
+    costs[i] = LookupCostWithCache(rids[i], lid, &hit);
+    hit_count += hit;
+  }
+  cache_stats_->hit_count.fetch_add(hit_count, std::memory_order_relaxed);
+  cache_stats_->miss_count.fetch_add(size - hit_count,
+                                     std::memory_order_relaxed);
+}
+
 int Connector::GetResolution() const { return resolution_; }
 
 void Connector::ClearCache() {
-  std::fill(cache_key_.get(), cache_key_.get() + cache_size_, kInvalidCacheKey);
+  const uint64 invalid_entry = EncodeCacheEntry(kInvalidCacheKey, 0);
+  for (int i = 0; i < cache_size_; ++i) {
+    cache_[i].store(invalid_entry, std::memory_order_relaxed);
+  }
+}
+
+uint64 Connector::GetCacheHitCount() const {
+  PendingCacheStats::Get()->Flush();
+  return cache_stats_->hit_count.load(std::memory_order_relaxed);
+}
+
+uint64 Connector::GetCacheMissCount() const {
+  PendingCacheStats::Get()->Flush();
+  return cache_stats_->miss_count.load(std::memory_order_relaxed);
+}
+
+void Connector::ResetCacheStats() {
+  PendingCacheStats::Get()->Flush();
+  cache_stats_->hit_count.store(0, std::memory_order_relaxed);
+  cache_stats_->miss_count.store(0, std::memory_order_relaxed);
+}
+
+int Connector::LookupCostWithCache(uint16 rid, uint16 lid, bool *hit) const {
+  const uint32 key = EncodeKey(rid, lid);
+  std::atomic<uint64> &slot = cache_[GetHashValue(rid, lid, cache_hash_mask_)];
+  const uint64 entry = slot.load(std::memory_order_relaxed);
+  if (DecodeCacheKey(entry) == key) {
+    *hit = true;
+    return DecodeCacheValue(entry);
+  }
+  *hit = false;
+  const int value = LookupCost(rid, lid);
+  slot.store(EncodeCacheEntry(key, value), std::memory_order_relaxed);
+  return value;
 }
 
 int Connector::LookupCost(uint16 rid, uint16 lid) const {
@@ -30,6 +30,7 @@
 #ifndef MOZC_CONVERTER_CONNECTOR_H_
 #define MOZC_CONVERTER_CONNECTOR_H_
 
+#include <atomic>
 #include <memory>
 #include <vector>
 
@@ -51,6 +52,13 @@ class Connector final {
   static mozc::StatusOr<std::unique_ptr<Connector>> Create(
       const char *connection_data, size_t connection_size, int cache_size);
 
+  // Creates a connector which expands the whole connection matrix into a dense
+  // int16 table on creation.  GetTransitionCost() then becomes a single load
+  // without hashing, at the cost of 2 * rsize * lsize bytes of memory (about
+  // 14MB for the OSS data set).  Fails if a cost doesn't fit in int16.
+  static mozc::StatusOr<std::unique_ptr<Connector>> CreateDense(
+      const char *connection_data, size_t connection_size);
+
   Connector();
   ~Connector();
 
@@ -58,25 +66,60 @@ class Connector final {
   Connector &operator=(const Connector &) = delete;
 
   int GetTransitionCost(uint16 rid, uint16 lid) const;
+
+  // Batch version of GetTransitionCost(): stores the transition cost from
+  // rids[i] to |lid| to costs[i] for each i in [0, size).
+  void GetTransitionCosts(const uint16 *rids, size_t size, uint16 lid,
+                          int32 *costs) const;
   int GetResolution() const;
 
+  // Returns true if the connection matrix is expanded to a dense table.
+  bool IsDense() const { return dense_table_ != nullptr; }
+
   void ClearCache();
 
+  // Returns the number of lookups which hit/missed the cache since creation or
+  // the last ResetCacheStats().  Always 0 in the dense mode, which has no
+  // cache.  Lookups by GetTransitionCost() are counted per thread and added
+  // in bulk, so those of other threads may not be reflected until they exit.
+  uint64 GetCacheHitCount() const;
+  uint64 GetCacheMissCount() const;
+  void ResetCacheStats();
+
  private:
   class Row;
+  struct CacheStats;
+  class PendingCacheStats;
 
   mozc::Status Init(const char *connection_data, size_t connection_size,
                     int cache_size);
 
+  mozc::Status ExpandToDenseTable();
+
   int LookupCost(uint16 rid, uint16 lid) const;
 
+  // Returns the cost using the cache. |hit| is set to true on cache hit.
+  int LookupCostWithCache(uint16 rid, uint16 lid, bool *hit) const;
+
   std::vector<std::unique_ptr<Row>> rows_;
   const uint16 *default_cost_ = nullptr;
   int resolution_ = 0;
   int cache_size_ = 0;
   uint32 cache_hash_mask_ = 0;
-  mutable std::unique_ptr<uint32[]> cache_key_;
-  mutable std::unique_ptr<int[]> cache_value_;
+  // Each slot packs the key (rid, lid) into the upper 32 bits and the cost
+  // into the lower 32 bits, so that a slot is read and written atomically.
+  // Concurrent lookups may overwrite each other's slots, which only costs a
+  // cache miss; a key is never paired with another key's cost.  Hence one
+  // instance can be shared by conversions running in parallel.
+  mutable std::unique_ptr<std::atomic<uint64>[]> cache_;
+  // Shared with the threads holding uncommitted counts of this instance, so
+  // that the counts can be flushed safely after this instance is destroyed.
+  std::shared_ptr<CacheStats> cache_stats_;
+
+  // Costs of all the (rid, lid) pairs stored at rid * lsize_ + lid.  Null
+  // unless created by CreateDense().
+  std::unique_ptr<int16[]> dense_table_;
+  size_t lsize_ = 0;
 };
 
 }  // namespace mozc
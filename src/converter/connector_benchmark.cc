@@ -0,0 +1,138 @@
+// Copyright 2010-2020, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// Compares the lookup speed of the compressed (cached) connection matrix with
+// the dense one.
+
+#include <memory>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include "base/logging.h"
+#include "base/port.h"
+#include "converter/connector.h"
+#include "data_manager/testing/mock_data_manager.h"
+#include "benchmark/benchmark.h"
+
+namespace mozc {
+namespace {
+
+enum Mode {
+  COMPRESSED = 0,
+  DENSE = 1,
+};
+
+std::unique_ptr<Connector> CreateConnector(Mode mode) {
+  const testing::MockDataManager data_manager;
+  const char *data = nullptr;
+  size_t size = 0;
+  data_manager.GetConnectorData(&data, &size);
+  auto status_or_connector = (mode == DENSE)
+                                 ? Connector::CreateDense(data, size)
+                                 : Connector::Create(data, size, 1024);
+  CHECK(status_or_connector.ok()) << status_or_connector.status();
+  return std::move(status_or_connector).value();
+}
+
+// Returns the number of ids, i.e., the matrix is |num_ids| x |num_ids|.
+int GetNumIds() {
+  const testing::MockDataManager data_manager;
+  const char *data = nullptr;
+  size_t size = 0;
+  data_manager.GetConnectorData(&data, &size);
+  // The third uint16 of the metadata is the number of rows.
+  return reinterpret_cast<const uint16 *>(data)[2];
+}
+
+// Scans the whole rid/lid space in row-major order.
+void BM_SequentialLookup(benchmark::State &state) {
+  const std::unique_ptr<Connector> connector =
+      CreateConnector(static_cast<Mode>(state.range(0)));
+  const int num_ids = GetNumIds();
+  for (auto _ : state) {
+    for (int rid = 0; rid < num_ids; ++rid) {
+      for (int lid = 0; lid < num_ids; ++lid) {
+        benchmark::DoNotOptimize(connector->GetTransitionCost(rid, lid));
+      }
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * num_ids * num_ids);
+}
+BENCHMARK(BM_SequentialLookup)->Arg(COMPRESSED)->Arg(DENSE);
+
+// Looks up random pairs from the rid/lid space, which mostly misses the cache
+// in the compressed mode.
+void BM_RandomLookup(benchmark::State &state) {
+  const std::unique_ptr<Connector> connector =
+      CreateConnector(static_cast<Mode>(state.range(0)));
+  const int num_ids = GetNumIds();
+  std::mt19937 urbg(0);
+  std::uniform_int_distribution<int> dist(0, num_ids - 1);
+  std::vector<std::pair<uint16, uint16>> pairs(1 << 16);
+  for (auto &pair : pairs) {
+    pair.first = dist(urbg);
+    pair.second = dist(urbg);
+  }
+  for (auto _ : state) {
+    for (const auto &pair : pairs) {
+      benchmark::DoNotOptimize(
+          connector->GetTransitionCost(pair.first, pair.second));
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * pairs.size());
+}
+BENCHMARK(BM_RandomLookup)->Arg(COMPRESSED)->Arg(DENSE);
+
+// Simulates Viterbi: gathers the costs from a column of a few dozen rids to
+// each lid, where the same rids repeat across lids.
+void BM_ColumnGather(benchmark::State &state) {
+  const std::unique_ptr<Connector> connector =
+      CreateConnector(static_cast<Mode>(state.range(0)));
+  const int num_ids = GetNumIds();
+  std::mt19937 urbg(0);
+  std::uniform_int_distribution<int> dist(0, num_ids - 1);
+  std::vector<uint16> rids(32);
+  for (uint16 &rid : rids) {
+    rid = dist(urbg);
+  }
+  std::vector<int32> costs(rids.size());
+  for (auto _ : state) {
+    for (int lid = 0; lid < num_ids; ++lid) {
+      connector->GetTransitionCosts(rids.data(), rids.size(), lid,
+                                    costs.data());
+      benchmark::DoNotOptimize(costs.data());
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * num_ids * rids.size());
+}
+BENCHMARK(BM_ColumnGather)->Arg(COMPRESSED)->Arg(DENSE);
+
+}  // namespace
+}  // namespace mozc
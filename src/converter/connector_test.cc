@@ -37,6 +37,7 @@
 
 #include "base/logging.h"
 #include "base/mmap.h"
+#include "base/thread.h"
 #include "data_manager/connection_file_reader.h"
 #include "testing/base/public/gunit.h"
 #include "testing/base/public/mozctest.h"
@@ -61,6 +62,7 @@ TEST(ConnectorTest, CompareWithRawData) {
   ASSERT_TRUE(status_or_connector.ok()) << status_or_connector.status();
   auto connector = std::move(status_or_connector).value();
   ASSERT_EQ(1, connector->GetResolution());
+  EXPECT_FALSE(connector->IsDense());
 
   const std::string connection_text_path = testing::GetSourceFileOrDie(
       {"data_manager", "testing", "connection_single_column.txt"});
@@ -90,6 +92,220 @@ TEST(ConnectorTest, CompareWithRawData) {
   }
 }
 
+TEST(ConnectorTest, DenseModeCompareWithRawData) {
+  const std::string path = testing::GetSourceFileOrDie(
+      {"data_manager", "testing", "connection.data"});
+  Mmap cmmap;
+  ASSERT_TRUE(cmmap.Open(path.c_str())) << "Failed to open image: " << path;
+  auto status_or_connector =
+      Connector::CreateDense(cmmap.begin(), cmmap.size());
+  ASSERT_TRUE(status_or_connector.ok()) << status_or_connector.status();
+  auto connector = std::move(status_or_connector).value();
+  ASSERT_TRUE(connector->IsDense());
+  ASSERT_EQ(1, connector->GetResolution());
+
+  const std::string connection_text_path = testing::GetSourceFileOrDie(
+      {"data_manager", "testing", "connection_single_column.txt"});
+  for (ConnectionFileReader reader(connection_text_path); !reader.done();
+       reader.Next()) {
+    const uint16 rid = reader.rid_of_left_node();
+    const uint16 lid = reader.lid_of_right_node();
+    EXPECT_EQ(reader.cost(), connector->GetTransitionCost(rid, lid));
+    int32 cost = 0;
+    connector->GetTransitionCosts(&rid, 1, lid, &cost);
+    EXPECT_EQ(reader.cost(), cost);
+  }
+}
+
+TEST(ConnectorTest, GetTransitionCosts) {
+  const std::string path = testing::GetSourceFileOrDie(
+      {"data_manager", "testing", "connection.data"});
+  Mmap cmmap;
+  ASSERT_TRUE(cmmap.Open(path.c_str())) << "Failed to open image: " << path;
+  auto status_or_connector =
+      Connector::Create(cmmap.begin(), cmmap.size(), 256);
+  ASSERT_TRUE(status_or_connector.ok()) << status_or_connector.status();
+  auto connector = std::move(status_or_connector).value();
+
+  const std::string connection_text_path = testing::GetSourceFileOrDie(
+      {"data_manager", "testing", "connection_single_column.txt"});
+  std::vector<ConnectionDataEntry> data;
+  for (ConnectionFileReader reader(connection_text_path); !reader.done();
+       reader.Next()) {
+    ConnectionDataEntry entry;
+    entry.rid = reader.rid_of_left_node();
+    entry.lid = reader.lid_of_right_node();
+    entry.cost = reader.cost();
+    data.push_back(entry);
+  }
+
+  // Gather the costs of a few rids for every lid at once.
+  constexpr size_t kNumRids = 10;
+  std::random_device rd;
+  std::mt19937 urbg(rd());
+  std::shuffle(data.begin(), data.end(), urbg);
+  for (size_t i = 0; i + kNumRids <= data.size(); i += kNumRids) {
+    std::vector<uint16> rids(kNumRids);
+    for (size_t j = 0; j < kNumRids; ++j) {
+      rids[j] = data[i + j].rid;
+    }
+    const uint16 lid = data[i].lid;
+    std::vector<int32> costs(kNumRids);
+    connector->GetTransitionCosts(rids.data(), rids.size(), lid, costs.data());
+    for (size_t j = 0; j < kNumRids; ++j) {
+      EXPECT_EQ(connector->GetTransitionCost(rids[j], lid), costs[j]);
+    }
+  }
+}
+
+TEST(ConnectorTest, CacheStats) {
+  const std::string path = testing::GetSourceFileOrDie(
+      {"data_manager", "testing", "connection.data"});
+  Mmap cmmap;
+  ASSERT_TRUE(cmmap.Open(path.c_str())) << "Failed to open image: " << path;
+  auto status_or_connector =
+      Connector::Create(cmmap.begin(), cmmap.size(), 256);
+  ASSERT_TRUE(status_or_connector.ok()) << status_or_connector.status();
+  auto connector = std::move(status_or_connector).value();
+  EXPECT_EQ(0, connector->GetCacheHitCount());
+  EXPECT_EQ(0, connector->GetCacheMissCount());
+
+  const int cost = connector->GetTransitionCost(1, 2);
+  EXPECT_EQ(0, connector->GetCacheHitCount());
+  EXPECT_EQ(1, connector->GetCacheMissCount());
+
+  EXPECT_EQ(cost, connector->GetTransitionCost(1, 2));
+  EXPECT_EQ(1, connector->GetCacheHitCount());
+  EXPECT_EQ(1, connector->GetCacheMissCount());
+
+  // (1, 2) is cached but (3, 2) is not.
+  const uint16 rids[] = {1, 3};
+  int32 costs[2];
+  connector->GetTransitionCosts(rids, 2, 2, costs);
+  EXPECT_EQ(cost, costs[0]);
+  EXPECT_EQ(2, connector->GetCacheHitCount());
+  EXPECT_EQ(2, connector->GetCacheMissCount());
+
+  connector->ClearCache();
+  EXPECT_EQ(cost, connector->GetTransitionCost(1, 2));
+  EXPECT_EQ(2, connector->GetCacheHitCount());
+  EXPECT_EQ(3, connector->GetCacheMissCount());
+
+  connector->ResetCacheStats();
+  EXPECT_EQ(0, connector->GetCacheHitCount());
+  EXPECT_EQ(0, connector->GetCacheMissCount());
+}
+
+TEST(ConnectorTest, CacheStatsOfMultipleConnectors) {
+  const std::string path = testing::GetSourceFileOrDie(
+      {"data_manager", "testing", "connection.data"});
+  Mmap cmmap;
+  ASSERT_TRUE(cmmap.Open(path.c_str())) << "Failed to open image: " << path;
+  auto status_or_connector1 =
+      Connector::Create(cmmap.begin(), cmmap.size(), 256);
+  ASSERT_TRUE(status_or_connector1.ok()) << status_or_connector1.status();
+  auto connector1 = std::move(status_or_connector1).value();
+
+  // Lookups of a connector destroyed with uncommitted counts must not be
+  // added to the other one.
+  {
+    auto status_or_connector2 =
+        Connector::Create(cmmap.begin(), cmmap.size(), 256);
+    ASSERT_TRUE(status_or_connector2.ok()) << status_or_connector2.status();
+    auto connector2 = std::move(status_or_connector2).value();
+    connector2->GetTransitionCost(1, 2);
+  }
+  for (int i = 0; i < 3000; ++i) {
+    connector1->GetTransitionCost(1, 2);
+  }
+  EXPECT_EQ(2999, connector1->GetCacheHitCount());
+  EXPECT_EQ(1, connector1->GetCacheMissCount());
+
+  // Interleaves the lookups of two connectors.
+  auto status_or_connector3 =
+      Connector::Create(cmmap.begin(), cmmap.size(), 256);
+  ASSERT_TRUE(status_or_connector3.ok()) << status_or_connector3.status();
+  auto connector3 = std::move(status_or_connector3).value();
+  for (int i = 0; i < 1000; ++i) {
+    connector1->GetTransitionCost(1, 2);
+    connector3->GetTransitionCost(3, 2);
+  }
+  EXPECT_EQ(3999, connector1->GetCacheHitCount());
+  EXPECT_EQ(1, connector1->GetCacheMissCount());
+  EXPECT_EQ(999, connector3->GetCacheHitCount());
+  EXPECT_EQ(1, connector3->GetCacheMissCount());
+}
+
+class LookupThread : public Thread {
+ public:
+  LookupThread(const Connector *connector,
+               const std::vector<ConnectionDataEntry> *data, int seed)
+      : connector_(connector), data_(data), seed_(seed), num_errors_(0) {}
+
+  void Run() override {
+    std::mt19937 urbg(seed_);
+    std::uniform_int_distribution<size_t> dist(0, data_->size() - 1);
+    for (int i = 0; i < 100000; ++i) {
+      const ConnectionDataEntry &entry = (*data_)[dist(urbg)];
+      if (connector_->GetTransitionCost(entry.rid, entry.lid) != entry.cost) {
+        ++num_errors_;
+      }
+    }
+  }
+
+  int num_errors() const { return num_errors_; }
+
+ private:
+  const Connector *connector_;
+  const std::vector<ConnectionDataEntry> *data_;
+  const int seed_;
+  int num_errors_;
+};
+
+TEST(ConnectorTest, ConcurrentLookup) {
+  const std::string path = testing::GetSourceFileOrDie(
+      {"data_manager", "testing", "connection.data"});
+  Mmap cmmap;
+  ASSERT_TRUE(cmmap.Open(path.c_str())) << "Failed to open image: " << path;
+  // A small cache makes the threads race on the same slots.
+  auto status_or_connector = Connector::Create(cmmap.begin(), cmmap.size(), 16);
+  ASSERT_TRUE(status_or_connector.ok()) << status_or_connector.status();
+  auto connector = std::move(status_or_connector).value();
+
+  const std::string connection_text_path = testing::GetSourceFileOrDie(
+      {"data_manager", "testing", "connection_single_column.txt"});
+  std::vector<ConnectionDataEntry> data;
+  for (ConnectionFileReader reader(connection_text_path); !reader.done();
+       reader.Next()) {
+    // Use a part of the matrix so that the lookups hit the cache sometimes.
+    if (reader.rid_of_left_node() >= 4 || reader.lid_of_right_node() >= 4) {
+      continue;
+    }
+    ConnectionDataEntry entry;
+    entry.rid = reader.rid_of_left_node();
+    entry.lid = reader.lid_of_right_node();
+    entry.cost = reader.cost();
+    data.push_back(entry);
+  }
+  ASSERT_FALSE(data.empty());
+
+  constexpr int kNumThreads = 4;
+  std::vector<std::unique_ptr<LookupThread>> threads;
+  for (int i = 0; i < kNumThreads; ++i) {
+    threads.push_back(
+        absl::make_unique<LookupThread>(connector.get(), &data, i));
+    threads.back()->SetJoinable(true);
+    threads.back()->Start("ConnectorTest");
+  }
+  for (auto &thread : threads) {
+    thread->Join();
+    EXPECT_EQ(0, thread->num_errors());
+  }
+  EXPECT_EQ(kNumThreads * 100000,
+            connector->GetCacheHitCount() + connector->GetCacheMissCount());
+  EXPECT_LT(0, connector->GetCacheHitCount());
+}
+
 TEST(ConnectorTest, BrokenData) {
   const std::string path = testing::GetSourceFileOrDie(
       {"data_manager", "testing", "connection.data"});
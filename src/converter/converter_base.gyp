@@ -60,6 +60,16 @@
         '../storage/louds/louds.gyp:simple_succinct_bit_vector_index',
       ],
     },
+    {
+      'target_name': 'viterbi_kernel',
+      'type': 'static_library',
+      'sources': [
+        'viterbi_kernel.cc',
+      ],
+      'dependencies': [
+        '../base/base.gyp:base',
+      ],
+    },
     {
       'target_name': 'lattice',
       'type': 'static_library',
@@ -130,6 +140,7 @@
         'immutable_converter_interface',
         'segmenter',
         'segments',
+        'viterbi_kernel',
       ],
     },
     {
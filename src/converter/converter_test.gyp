@@ -44,7 +44,9 @@
         'key_corrector_test.cc',
         'lattice_test.cc',
         'nbest_generator_test.cc',
+        'node_allocator_test.cc',
         'segments_test.cc',
+        'viterbi_kernel_test.cc',
       ],
       'dependencies': [
         '../base/absl.gyp:absl_strings',
@@ -72,6 +74,7 @@
         'converter_base.gyp:converter_mock',
         'converter_base.gyp:segmenter',
         'converter_base.gyp:segments',
+        'converter_base.gyp:viterbi_kernel',
       ],
       'variables': {
         'test_size': 'small',
@@ -30,16 +30,20 @@
 #include "converter/immutable_converter.h"
 
 #include <algorithm>
+#include <atomic>
 #include <cctype>
 #include <climits>
+#include <functional>
 #include <memory>
 #include <string>
 #include <utility>
 #include <vector>
 
+#include "base/flags.h"
 #include "base/logging.h"
 #include "base/port.h"
 #include "base/stl_util.h"
+#include "base/thread_pool.h"
 #include "base/util.h"
 #include "config/config_handler.h"
 #include "converter/connector.h"
@@ -51,6 +55,7 @@
 #include "converter/node_list_builder.h"
 #include "converter/segmenter.h"
 #include "converter/segments.h"
+#include "converter/viterbi_kernel.h"
 #include "dictionary/dictionary_interface.h"
 #include "dictionary/pos_group.h"
 #include "dictionary/pos_matcher.h"
@@ -59,8 +64,19 @@
 #include "protocol/commands.pb.h"
 #include "protocol/config.pb.h"
 #include "request/conversion_request.h"
+#include "absl/memory/memory.h"
 #include "absl/strings/string_view.h"
 
+DEFINE_int32(nbest_expansion_threads, 1,
+             "The number of threads to enumerate the candidates of the "
+             "segments in parallel on conversion of multiple segments.");
+DEFINE_int32(nbest_expansions_per_candidate, 0,
+             "If positive, bounds the search steps of the N-best expansion "
+             "of each segment by this value times the number of candidates "
+             "to generate (but at least 2000).  By default, the search is "
+             "bounded only for each candidate.  Small values reduce the "
+             "latency of long candidate lists at the cost of recall.");
+
 using mozc::dictionary::DictionaryInterface;
 using mozc::dictionary::PosGroup;
 using mozc::dictionary::POSMatcher;
@@ -94,15 +110,22 @@ class KeyCorrectedNodeListBuilder : public BaseNodeListBuilder {
         key_corrector_(key_corrector),
         tail_(nullptr) {}
 
+  // The original offset depends only on the key, so tokens without one are
+  // skipped before their values are decoded.
+  bool OnTokenWithoutValue(absl::string_view key, absl::string_view actual_key,
+                           const Token &token) override {
+    return GetOriginalOffset(token) != 0;
+  }
+
   ResultType OnToken(absl::string_view key, absl::string_view actual_key,
                      const Token &token) override {
-    const size_t offset =
-        key_corrector_->GetOriginalOffset(pos_, token.key.size());
-    if (!KeyCorrector::IsValidPosition(offset) || offset == 0) {
+    const size_t offset = GetOriginalOffset(token);
+    if (offset == 0) {
       return TRAVERSE_NEXT_KEY;
     }
     Node *node = NewNodeFromToken(token);
-    node->key.assign(original_lookup_key_.data() + pos_, offset);
+    node->key = allocator_->NewString(
+        absl::string_view(original_lookup_key_.data() + pos_, offset));
     node->wcost += KeyCorrector::GetCorrectedCostPenalty(node->key);
 
     // Push back |node| to the end.
@@ -119,6 +142,14 @@ class KeyCorrectedNodeListBuilder : public BaseNodeListBuilder {
   Node *tail() const { return tail_; }
 
  private:
+  // Returns the length of the original key corresponding to the corrected
+  // |token.key|, or 0 if there's no such length.
+  size_t GetOriginalOffset(const Token &token) const {
+    const size_t offset =
+        key_corrector_->GetOriginalOffset(pos_, token.key.size());
+    return KeyCorrector::IsValidPosition(offset) ? offset : 0;
+  }
+
   const size_t pos_;
   const absl::string_view original_lookup_key_;
   const KeyCorrector *key_corrector_;
@@ -165,8 +196,9 @@ bool ContainsWhiteSpacesOnly(const absl::string_view s) {
   return true;
 }
 
-void DecomposeNumberAndSuffix(const std::string &input, std::string *number,
-                              std::string *suffix) {
+void DecomposeNumberAndSuffix(absl::string_view input,
+                              absl::string_view *number,
+                              absl::string_view *suffix) {
   const char *begin = input.data();
   const char *end = input.data() + input.size();
   size_t pos = 0;
@@ -178,12 +210,13 @@ void DecomposeNumberAndSuffix(const std::string &input, std::string *number,
     }
     break;
   }
-  number->assign(input, 0, pos);
-  suffix->assign(input, pos, input.size() - pos);
+  *number = input.substr(0, pos);
+  *suffix = input.substr(pos);
 }
 
-void DecomposePrefixAndNumber(const std::string &input, std::string *prefix,
-                              std::string *number) {
+void DecomposePrefixAndNumber(absl::string_view input,
+                              absl::string_view *prefix,
+                              absl::string_view *number) {
   const char *begin = input.data();
   const char *end = input.data() + input.size() - 1;
   size_t pos = input.size();
@@ -195,8 +228,8 @@ void DecomposePrefixAndNumber(const std::string &input, std::string *prefix,
     }
     break;
   }
-  prefix->assign(input, 0, pos);
-  number->assign(input, pos, input.size() - pos);
+  *prefix = input.substr(0, pos);
+  *number = input.substr(pos);
 }
 
 void NormalizeHistorySegments(Segments *segments) {
@@ -458,8 +491,9 @@ bool ImmutableConverterImpl::ResegmentArabicNumberAndSuffix(
         pos_matcher_->IsNumber(compound_node->lid) &&
         !pos_matcher_->IsNumber(compound_node->rid) &&
         IsNumber(compound_node->value[0]) && IsNumber(compound_node->key[0])) {
-      std::string number_value, number_key;
-      std::string suffix_value, suffix_key;
+      // The parts refer to the strings of |compound_node|.
+      absl::string_view number_value, number_key;
+      absl::string_view suffix_value, suffix_key;
       DecomposeNumberAndSuffix(compound_node->value, &number_value,
                                &suffix_value);
       DecomposeNumberAndSuffix(compound_node->key, &number_key, &suffix_key);
@@ -534,8 +568,9 @@ bool ImmutableConverterImpl::ResegmentPrefixAndArabicNumber(
         !IsNumber(compound_node->key[0]) &&
         IsNumber(compound_node->value[compound_node->value.size() - 1]) &&
         IsNumber(compound_node->key[compound_node->key.size() - 1])) {
-      std::string number_value, number_key;
-      std::string prefix_value, prefix_key;
+      // The parts refer to the strings of |compound_node|.
+      absl::string_view number_value, number_key;
+      absl::string_view prefix_value, prefix_key;
       DecomposePrefixAndNumber(compound_node->value, &prefix_value,
                                &number_value);
       DecomposePrefixAndNumber(compound_node->key, &prefix_key, &number_key);
@@ -645,7 +680,8 @@ bool ImmutableConverterImpl::ResegmentPersonalName(size_t pos,
              rnode != nullptr; rnode = rnode->bnext) {
           if ((lnode->value.size() + rnode->value.size()) ==
                   compound_node->value.size() &&
-              (lnode->value + rnode->value) == compound_node->value &&
+              compound_node->value.substr(lnode->value.size()) ==
+                  rnode->value &&
               segmenter_->IsBoundary(*lnode, *rnode, false)) {  // Constraint 3.
             const int32 cost = lnode->wcost + GetCost(lnode, rnode);
             if (cost < best_cost) {  // choose the smallest ones
@@ -757,8 +793,8 @@ Node *ImmutableConverterImpl::Lookup(const int begin_pos, const int end_pos,
   const char *end = lattice->key().data() + end_pos;
   const size_t len = end_pos - begin_pos;
 
-  lattice->node_allocator()->set_max_nodes_size(8192);
   Node *result_node = nullptr;
+  bool add_single_char_node = true;
   if (is_reverse) {
     BaseNodeListBuilder builder(lattice->node_allocator(),
                                 lattice->node_allocator()->max_nodes_size());
@@ -767,12 +803,19 @@ Node *ImmutableConverterImpl::Lookup(const int begin_pos, const int end_pos,
     result_node = builder.result();
   } else {
     if (is_prediction) {
-      NodeListBuilderWithCacheEnabled builder(
-          lattice->node_allocator(), lattice->cache_info(begin_pos) + 1);
-      dictionary_->LookupPrefix(absl::string_view(begin, len), request,
-                                &builder);
-      result_node = builder.result();
-      lattice->SetCacheInfo(begin_pos, len);
+      // Only the keys longer than the ones looked up for the previous key are
+      // looked up, as the shorter ones are kept in the lattice.
+      const size_t cached_len = lattice->cache_info(begin_pos);
+      if (cached_len < len) {
+        NodeListBuilderWithCacheEnabled builder(lattice->node_allocator(),
+                                                cached_len + 1);
+        dictionary_->LookupPrefix(absl::string_view(begin, len), request,
+                                  &builder);
+        result_node = builder.result();
+        lattice->SetCacheInfo(begin_pos, len);
+      }
+      // The single character node has been cached by the first lookup.
+      add_single_char_node = (cached_len == 0);
     } else {
       // When cache feature is not used, look up normally
       BaseNodeListBuilder builder(lattice->node_allocator(),
@@ -782,13 +825,67 @@ Node *ImmutableConverterImpl::Lookup(const int begin_pos, const int end_pos,
       result_node = builder.result();
     }
   }
-  return AddCharacterTypeBasedNodes(begin, end, lattice, result_node);
+  return AddCharacterTypeBasedNodes(begin, end, add_single_char_node, lattice,
+                                    result_node);
 }
 
-Node *ImmutableConverterImpl::AddCharacterTypeBasedNodes(const char *begin,
-                                                         const char *end,
-                                                         Lattice *lattice,
-                                                         Node *nodes) const {
+void ImmutableConverterImpl::LookupForAllPositions(
+    size_t begin_pos, const ConversionRequest &request, bool is_prediction,
+    Lattice *lattice, std::vector<Node *> *nodes) const {
+  const std::string &key = lattice->key();
+  nodes->assign(key.size(), nullptr);
+
+  // Prepare the builders in the same way as Lookup().
+  std::vector<size_t> positions;
+  std::vector<absl::string_view> keys;
+  std::vector<std::unique_ptr<BaseNodeListBuilder>> builders;
+  std::vector<DictionaryInterface::Callback *> callbacks;
+  for (size_t pos = begin_pos; pos < key.size();
+       pos += Util::OneCharLen(key.data() + pos)) {
+    positions.push_back(pos);
+    const size_t len = key.size() - pos;
+    if (is_prediction) {
+      const size_t cached_len = lattice->cache_info(pos);
+      if (cached_len >= len) {
+        builders.push_back(nullptr);
+        continue;
+      }
+      builders.push_back(absl::make_unique<NodeListBuilderWithCacheEnabled>(
+          lattice->node_allocator(), cached_len + 1));
+    } else {
+      builders.push_back(absl::make_unique<BaseNodeListBuilder>(
+          lattice->node_allocator(),
+          lattice->node_allocator()->max_nodes_size()));
+    }
+    keys.push_back(absl::string_view(key.data() + pos, len));
+    callbacks.push_back(builders.back().get());
+  }
+
+  dictionary_->LookupPrefixBatch(keys, request, callbacks);
+
+  for (size_t i = 0; i < positions.size(); ++i) {
+    const size_t pos = positions[i];
+    Node *result_node = nullptr;
+    bool add_single_char_node = true;
+    if (is_prediction) {
+      const size_t cached_len = lattice->cache_info(pos);
+      if (builders[i] != nullptr) {
+        result_node = builders[i]->result();
+        lattice->SetCacheInfo(pos, key.size() - pos);
+      }
+      add_single_char_node = (cached_len == 0);
+    } else {
+      result_node = builders[i]->result();
+    }
+    (*nodes)[pos] =
+        AddCharacterTypeBasedNodes(key.data() + pos, key.data() + key.size(),
+                                   add_single_char_node, lattice, result_node);
+  }
+}
+
+Node *ImmutableConverterImpl::AddCharacterTypeBasedNodes(
+    const char *begin, const char *end, bool add_single_char_node,
+    Lattice *lattice, Node *nodes) const {
   size_t mblen = 0;
   const char32 ucs4 = Util::UTF8ToUCS4(begin, end, &mblen);
 
@@ -796,27 +893,32 @@ Node *ImmutableConverterImpl::AddCharacterTypeBasedNodes(const char *begin,
   const Util::FormType first_form_type = Util::GetFormType(ucs4);
 
   // Add 1 character node. It can be either UnknownId or NumberId.
-  {
+  // The node doesn't depend on the following characters, so it is kept in the
+  // lattice cache like the nodes from the dictionary.
+  if (add_single_char_node) {
     Node *new_node = lattice->NewNode();
     CHECK(new_node);
     if (first_script_type == Util::NUMBER) {
       new_node->lid = number_id_;
       new_node->rid = number_id_;
+      new_node->wcost = kDefaultNumberCost;
     } else {
       new_node->lid = unknown_id_;
       new_node->rid = unknown_id_;
+      new_node->wcost = kMaxCost;
     }
 
-    new_node->wcost = kMaxCost;
-    new_node->value.assign(begin, mblen);
-    new_node->key.assign(begin, mblen);
+    new_node->raw_wcost = new_node->wcost;
+    new_node->attributes |= Node::ENABLE_CACHE;
+    new_node->key =
+        lattice->node_allocator()->NewString(absl::string_view(begin, mblen));
+    new_node->value = new_node->key;
     new_node->node_type = Node::NOR_NODE;
     new_node->bnext = nodes;
     nodes = new_node;
   }  // scope out |new_node|
 
   if (first_script_type == Util::NUMBER) {
-    nodes->wcost = kDefaultNumberCost;
     return nodes;
   }
 
@@ -850,8 +952,9 @@ Node *ImmutableConverterImpl::AddCharacterTypeBasedNodes(const char *begin,
       new_node->rid = unknown_id_;
     }
     new_node->wcost = kMaxCost / 2;
-    new_node->value.assign(begin, mblen);
-    new_node->key.assign(begin, mblen);
+    new_node->key =
+        lattice->node_allocator()->NewString(absl::string_view(begin, mblen));
+    new_node->value = new_node->key;
     new_node->node_type = Node::NOR_NODE;
     new_node->bnext = nodes;
     nodes = new_node;
@@ -866,14 +969,54 @@ namespace {
 // calculated based on kVeryBigCost.
 const int kVeryBigCost = (INT_MAX >> 2);
 
+// Returns the index of the node in |lcolumn| which connects to a node with
+// |rnode_lid| with the minimum cost, or -1 if no node connects with a cost
+// less than kVeryBigCost. The cost is stored to |best_cost|.
+// |transition_costs| is a buffer to hold the gathered connection costs.
+inline int FindBestLeftNode(const Connector &connector,
+                            const LatticeColumn &lcolumn, uint16 rnode_lid,
+                            std::vector<int32> *transition_costs,
+                            int *best_cost) {
+  *best_cost = kVeryBigCost;
+  const size_t size = lcolumn.size();
+  if (size == 0) {
+    return -1;
+  }
+  transition_costs->resize(size);
+  connector.GetTransitionCosts(lcolumn.rids.data(), size, rnode_lid,
+                               transition_costs->data());
+  int32 min_cost = 0;
+  const int best_index = ViterbiKernel::FindMinCostIndex(
+      lcolumn.costs.data(), transition_costs->data(), size, &min_cost);
+  if (best_index < 0 || min_cost >= kVeryBigCost) {
+    return -1;
+  }
+  *best_cost = min_cost;
+  return best_index;
+}
+
 // Runs viterbi algorithm at position |pos|. The left_boundary/right_boundary
 // are the next boundary looked from pos. (If pos is on the boundary,
 // left_boundary should be the previous one, and right_boundary should be
 // the next).
+// |lcolumn| and |transition_costs| are buffers reused across positions to
+// hold the valid nodes ending at |pos| and their connection costs.
+// If |beam_width| is positive, only that number of the best nodes ending at
+// |pos| are considered as the left nodes.
 inline void ViterbiInternal(const Connector &connector, size_t pos,
-                            size_t right_boundary, Lattice *lattice) {
-  for (Node *rnode = lattice->begin_nodes(pos); rnode != nullptr;
-       rnode = rnode->bnext) {
+                            size_t right_boundary, size_t beam_width,
+                            Lattice *lattice, LatticeColumn *lcolumn,
+                            std::vector<int32> *transition_costs) {
+  Node *rnode_begin = lattice->begin_nodes(pos);
+  if (rnode_begin == nullptr) {
+    return;
+  }
+  lattice->GetConnectedEndNodes(pos, lcolumn);
+  if (beam_width > 0) {
+    lcolumn->KeepBest(beam_width);
+  }
+
+  for (Node *rnode = rnode_begin; rnode != nullptr; rnode = rnode->bnext) {
     if (rnode->end_pos > right_boundary) {
       // Invalid rnode.
       rnode->prev = nullptr;
@@ -894,23 +1037,9 @@ inline void ViterbiInternal(const Connector &connector, size_t pos,
 
     // Find a valid node which connects to the rnode with minimum cost.
     int best_cost = kVeryBigCost;
-    Node *best_node = nullptr;
-    for (Node *lnode = lattice->end_nodes(pos); lnode != nullptr;
-         lnode = lnode->enext) {
-      if (lnode->prev == nullptr) {
-        // Invalid lnode.
-        continue;
-      }
-
-      int cost =
-          lnode->cost + connector.GetTransitionCost(lnode->rid, rnode->lid);
-      if (cost < best_cost) {
-        best_cost = cost;
-        best_node = lnode;
-      }
-    }
-
-    rnode->prev = best_node;
+    const int best_index = FindBestLeftNode(connector, *lcolumn, rnode->lid,
+                                            transition_costs, &best_cost);
+    rnode->prev = (best_index < 0) ? nullptr : lcolumn->nodes[best_index];
     rnode->cost = best_cost + rnode->wcost;
   }
 }
@@ -918,6 +1047,12 @@ inline void ViterbiInternal(const Connector &connector, size_t pos,
 
 bool ImmutableConverterImpl::Viterbi(const Segments &segments,
                                      Lattice *lattice) const {
+  return Viterbi(segments, 0, lattice);
+}
+
+bool ImmutableConverterImpl::Viterbi(const Segments &segments,
+                                     size_t beam_width,
+                                     Lattice *lattice) const {
   const std::string &key = lattice->key();
 
   // Process BOS.
@@ -945,6 +1080,11 @@ bool ImmutableConverterImpl::Viterbi(const Segments &segments,
     }
   }
 
+  // Nodes ending at the current position and their connection costs, reused
+  // across positions.
+  LatticeColumn lcolumn;
+  std::vector<int32> transition_costs;
+
   size_t left_boundary = 0;
   const size_t segments_size = segments.segments_size();
 
@@ -955,7 +1095,8 @@ bool ImmutableConverterImpl::Viterbi(const Segments &segments,
     const size_t right_boundary =
         left_boundary + segments.segment(0).key().size();
     for (size_t pos = left_boundary + 1; pos < right_boundary; ++pos) {
-      ViterbiInternal(*connector_, pos, right_boundary, lattice);
+      ViterbiInternal(*connector_, pos, right_boundary, beam_width, lattice,
+                      &lcolumn, &transition_costs);
     }
     left_boundary = right_boundary;
   }
@@ -966,7 +1107,8 @@ bool ImmutableConverterImpl::Viterbi(const Segments &segments,
     const size_t right_boundary =
         left_boundary + segments.segment(i).key().size();
     for (size_t pos = left_boundary; pos < right_boundary; ++pos) {
-      ViterbiInternal(*connector_, pos, right_boundary, lattice);
+      ViterbiInternal(*connector_, pos, right_boundary, beam_width, lattice,
+                      &lcolumn, &transition_costs);
     }
     left_boundary = right_boundary;
   }
@@ -985,24 +1127,11 @@ bool ImmutableConverterImpl::Viterbi(const Segments &segments,
     left_boundary =
         key.size() - segments.segment(segments_size - 1).key().size();
     // Find a valid node which connects to the rnode with minimum cost.
+    lattice->GetConnectedEndNodes(key.size(), &lcolumn);
     int best_cost = kVeryBigCost;
-    Node *best_node = nullptr;
-    for (Node *lnode = lattice->end_nodes(key.size()); lnode != nullptr;
-         lnode = lnode->enext) {
-      if (lnode->prev == nullptr) {
-        // Invalid lnode.
-        continue;
-      }
-
-      int cost = lnode->cost +
-                 connector_->GetTransitionCost(lnode->rid, eos_node->lid);
-      if (cost < best_cost) {
-        best_cost = cost;
-        best_node = lnode;
-      }
-    }
-
-    eos_node->prev = best_node;
+    const int best_index = FindBestLeftNode(
+        *connector_, lcolumn, eos_node->lid, &transition_costs, &best_cost);
+    eos_node->prev = (best_index < 0) ? nullptr : lcolumn.nodes[best_index];
     eos_node->cost = best_cost + eos_node->wcost;
   }
 
@@ -1042,6 +1171,13 @@ bool ImmutableConverterImpl::Viterbi(const Segments &segments,
 // We cannot apply this function in suggestion because in suggestion there are
 // WEAK_CONNECTED nodes and this function is not designed for them.
 //
+// The lattice for prediction is kept across keystrokes, so the costs computed
+// by the last call are reused. At a position where no node ending there has
+// been added, removed or changed its cost, only the nodes starting there whose
+// cost has not been computed yet (e.g., the nodes for the new suffix of the
+// key) are updated. Hence, the other positions cost one connection cost lookup
+// per node instead of the full search.
+//
 // TODO(toshiyuki): We may be able to use faster viterbi for
 // conversion/suggestion if we use richer info as contraction group.
 
@@ -1053,8 +1189,11 @@ bool ImmutableConverterImpl::PredictionViterbi(const Segments &segments,
   for (size_t i = 0; i < history_segments_size; ++i) {
     history_length += segments.segment(i).key().size();
   }
-  PredictionViterbiInternal(0, history_length, lattice);
-  PredictionViterbiInternal(history_length, key_length, lattice);
+  std::vector<bool> changed_columns(key_length + 1, false);
+  PredictionViterbiInternal(0, history_length, &changed_columns, lattice);
+  PredictionViterbiInternal(history_length, key_length, &changed_columns,
+                            lattice);
+  lattice->MarkCostsValid();
 
   Node *node = lattice->eos_nodes();
   CHECK(node->bnext == nullptr);
@@ -1073,9 +1212,22 @@ bool ImmutableConverterImpl::PredictionViterbi(const Segments &segments,
   return true;
 }
 
-void ImmutableConverterImpl::PredictionViterbiInternal(int calc_begin_pos,
-                                                       int calc_end_pos,
-                                                       Lattice *lattice) const {
+namespace {
+
+// Returns true if the cost of |rnode| is the one computed from its prev node,
+// i.e., neither the node nor its wcost has changed since the last Viterbi.
+inline bool HasComputedCost(const Connector &connector, const Node *rnode) {
+  return rnode->prev != nullptr &&
+         rnode->cost ==
+             rnode->prev->cost + rnode->wcost +
+                 connector.GetTransitionCost(rnode->prev->rid, rnode->lid);
+}
+
+}  // namespace
+
+void ImmutableConverterImpl::PredictionViterbiInternal(
+    int calc_begin_pos, int calc_end_pos, std::vector<bool> *changed_columns,
+    Lattice *lattice) const {
   CHECK_LE(calc_begin_pos, calc_end_pos);
 
   // Mapping from lnode's rid to (cost, Node) of best way/cost, and vice versa.
@@ -1088,10 +1240,39 @@ void ImmutableConverterImpl::PredictionViterbiInternal(int calc_begin_pos,
   lbest.reserve(128);
   rbest.reserve(128);
 
+  // The contracted lnodes and their connection costs to an rnode lid, laid out
+  // contiguously for ViterbiKernel.
+  LatticeColumn lcolumn;
+  std::vector<int32> transition_costs;
+
   const std::pair<int, Node *> kInvalidValue(INT_MAX,
                                              static_cast<Node *>(nullptr));
 
   for (size_t pos = calc_begin_pos; pos <= calc_end_pos; ++pos) {
+    // If the nodes ending at |pos| are the same as the last Viterbi, the nodes
+    // starting at |pos| with the computed costs are up to date.
+    const bool is_valid_column =
+        pos < lattice->valid_cost_end_pos() && !(*changed_columns)[pos];
+
+    rbest.clear();
+    Node *rnode_begin = lattice->begin_nodes(pos);
+    for (Node *rnode = rnode_begin; rnode != nullptr; rnode = rnode->bnext) {
+      if (rnode->end_pos > calc_end_pos ||
+          (is_valid_column && HasComputedCost(*connector_, rnode))) {
+        continue;
+      }
+      BestMap::value_type key(rnode->lid, kInvalidValue);
+      BestMap::iterator iter =
+          std::lower_bound(rbest.begin(), rbest.end(), key, OrderByFirst());
+      if (iter == rbest.end() || iter->first != rnode->lid) {
+        rbest.insert(iter, key);
+      }
+    }
+
+    if (rbest.empty()) {
+      continue;
+    }
+
     lbest.clear();
     for (Node *lnode = lattice->end_nodes(pos); lnode != nullptr;
          lnode = lnode->enext) {
@@ -1112,34 +1293,26 @@ void ImmutableConverterImpl::PredictionViterbiInternal(int calc_begin_pos,
       continue;
     }
 
-    rbest.clear();
-    Node *rnode_begin = lattice->begin_nodes(pos);
-    for (Node *rnode = rnode_begin; rnode != nullptr; rnode = rnode->bnext) {
-      if (rnode->end_pos > calc_end_pos) {
-        continue;
-      }
-      BestMap::value_type key(rnode->lid, kInvalidValue);
-      BestMap::iterator iter =
-          std::lower_bound(rbest.begin(), rbest.end(), key, OrderByFirst());
-      if (iter == rbest.end() || iter->first != rnode->lid) {
-        rbest.insert(iter, key);
-      }
-    }
-
-    if (rbest.empty()) {
-      continue;
-    }
-
+    // Lay out the best lnode of each rid in ascending order of rid. As the
+    // kernel returns the first minimum, ties are resolved by the smallest rid.
+    lcolumn.clear();
     for (BestMap::iterator liter = lbest.begin(); liter != lbest.end();
          ++liter) {
-      for (BestMap::iterator riter = rbest.begin(); riter != rbest.end();
-           ++riter) {
-        const int cost = liter->second.first + connector_->GetTransitionCost(
-                                                   liter->first, riter->first);
-        if (cost < riter->second.first) {
-          riter->second.first = cost;
-          riter->second.second = liter->second.second;
-        }
+      lcolumn.push_back(liter->second.second);
+    }
+    transition_costs.resize(lcolumn.size());
+
+    for (BestMap::iterator riter = rbest.begin(); riter != rbest.end();
+         ++riter) {
+      connector_->GetTransitionCosts(lcolumn.rids.data(), lcolumn.size(),
+                                     riter->first, transition_costs.data());
+      int32 min_cost = 0;
+      const int best_index = ViterbiKernel::FindMinCostIndex(
+          lcolumn.costs.data(), transition_costs.data(), lcolumn.size(),
+          &min_cost);
+      if (best_index >= 0 && min_cost < riter->second.first) {
+        riter->second.first = min_cost;
+        riter->second.second = lcolumn.nodes[best_index];
       }
     }
 
@@ -1155,7 +1328,11 @@ void ImmutableConverterImpl::PredictionViterbiInternal(int calc_begin_pos,
         continue;
       }
 
-      rnode->cost = iter->second.first + rnode->wcost;
+      const int new_cost = iter->second.first + rnode->wcost;
+      if (rnode->prev == nullptr || rnode->cost != new_cost) {
+        (*changed_columns)[rnode->end_pos] = true;
+      }
+      rnode->cost = new_cost;
       rnode->prev = iter->second.second;
     }
   }
@@ -1508,8 +1685,8 @@ bool ImmutableConverterImpl::MakeLatticeNodesForHistorySegments(
     rnode->lid = candidate.lid;
     rnode->rid = candidate.rid;
     rnode->wcost = 0;
-    rnode->value = candidate.value;
-    rnode->key = segment.key();
+    rnode->value = lattice->node_allocator()->NewString(candidate.value);
+    rnode->key = lattice->node_allocator()->NewString(segment.key());
     rnode->node_type = Node::HIS_NODE;
     rnode->bnext = nullptr;
     lattice->Insert(segments_pos, rnode);
@@ -1532,8 +1709,8 @@ bool ImmutableConverterImpl::MakeLatticeNodesForHistorySegments(
       // TODO(team): Figure out a better way to set the cost using
       // boundary.def-like approach.
       rnode2->wcost = 0;
-      rnode2->value = candidate.value;
-      rnode2->key = segment.key();
+      rnode2->value = rnode->value;
+      rnode2->key = rnode->key;
       rnode2->node_type = Node::HIS_NODE;
       rnode2->bnext = nullptr;
       lattice->Insert(segments_pos, rnode2);
@@ -1575,11 +1752,8 @@ bool ImmutableConverterImpl::MakeLatticeNodesForHistorySegments(
         CHECK(new_node);
 
         // get the suffix part ("たくや/卓也")
-        new_node->key.assign(compound_node->key, rnode->key.size(),
-                             compound_node->key.size() - rnode->key.size());
-        new_node->value.assign(
-            compound_node->value, rnode->value.size(),
-            compound_node->value.size() - rnode->value.size());
+        new_node->key = compound_node->key.substr(rnode->key.size());
+        new_node->value = compound_node->value.substr(rnode->value.size());
 
         // rid/lid are derived from the compound.
         // lid is just an approximation
@@ -1645,10 +1819,19 @@ void ImmutableConverterImpl::MakeLatticeNodesForConversionSegments(
       (segments.request_type() == Segments::REVERSE_CONVERSION);
   const bool is_prediction = (segments.request_type() == Segments::SUGGESTION ||
                               segments.request_type() == Segments::PREDICTION);
+
+  // Every character position gets reachable by the single character nodes, so
+  // the dictionary can be looked up for all the positions beforehand.
+  std::vector<Node *> nodes;
+  if (!is_reverse) {
+    LookupForAllPositions(history_key.size(), request, is_prediction, lattice,
+                          &nodes);
+  }
   for (size_t pos = history_key.size(); pos < key.size(); ++pos) {
     if (lattice->end_nodes(pos) != nullptr) {
-      Node *rnode =
-          Lookup(pos, key.size(), request, is_reverse, is_prediction, lattice);
+      Node *rnode = is_reverse ? Lookup(pos, key.size(), request, is_reverse,
+                                        is_prediction, lattice)
+                               : nodes[pos];
       // If history key is NOT empty and user input seems to starts with
       // a particle ("はにで..."), mark the node as STARTS_WITH_PARTICLE.
       // We change the segment boundary if STARTS_WITH_PARTICLE attribute
@@ -1661,8 +1844,11 @@ void ImmutableConverterImpl::MakeLatticeNodesForConversionSegments(
           }
         }
       }
-      CHECK(rnode != nullptr);
-      lattice->Insert(pos, rnode);
+      // |rnode| can be nullptr in prediction if all the nodes at |pos| have
+      // been cached in the lattice.
+      if (rnode != nullptr) {
+        lattice->Insert(pos, rnode);
+      }
       InsertCorrectedNodes(pos, key, request, key_corrector.get(), dictionary_,
                            lattice);
     }
@@ -1710,8 +1896,8 @@ void ImmutableConverterImpl::Resegment(const Segments &segments,
       rnode->lid = candidate.lid;
       rnode->rid = candidate.rid;
       rnode->wcost = kMinCost;
-      rnode->value = candidate.value;
-      rnode->key = segment.key();
+      rnode->value = lattice->node_allocator()->NewString(candidate.value);
+      rnode->key = lattice->node_allocator()->NewString(segment.key());
       rnode->node_type = Node::CON_NODE;
       rnode->bnext = nullptr;
       lattice->Insert(segments_pos, rnode);
@@ -1880,15 +2066,16 @@ void ImmutableConverterImpl::InsertCandidates(Segments *segments,
                std::min(static_cast<size_t>(512), max_candidates_size));
 
   const bool is_single_segment = (type == SINGLE_SEGMENT);
-  NBestGenerator nbest_generator(suppression_dictionary_, segmenter_,
-                                 connector_, pos_matcher_, &lattice,
-                                 suggestion_filter_, (filter_type == DESKTOP));
 
   std::string original_key;
   for (size_t i = 0; i < segments->conversion_segments_size(); ++i) {
     original_key.append(segments->conversion_segment(i).key());
   }
 
+  // Splits the lattice into segments first, and then expands the candidates
+  // of each segment.
+  std::vector<SegmentExpansion> expansions;
+  std::vector<const Node *> segment_end_nodes;
   size_t begin_pos = std::string::npos;
   for (Node *node = prev->next; node->next != nullptr; node = node->next) {
     if (begin_pos == std::string::npos) {
@@ -1911,25 +2098,77 @@ void ImmutableConverterImpl::InsertCandidates(Segments *segments,
       // Boundary is specified. Skip boundary check in nbest generator.
       mode = NBestGenerator::ONLY_MID;
     }
-    nbest_generator.Reset(prev, node->next, mode);
+    expansions.push_back({prev, node->next, mode, segment});
+    segment_end_nodes.push_back(node);
+
+    if (type == ONLY_FIRST_SEGMENT) {
+      break;
+    }
+    begin_pos = std::string::npos;
+    prev = node;
+  }
 
-    ExpandCandidates(original_key, &nbest_generator, segment,
-                     segments->request_type(), expand_size);
+  ExpandSegments(lattice, original_key, segments->request_type(), expand_size,
+                 filter_type, expansions);
 
+  for (size_t i = 0; i < expansions.size(); ++i) {
+    Segment *segment = expansions[i].segment;
     if (type == MULTI_SEGMENTS || type == SINGLE_SEGMENT) {
       InsertDummyCandidates(segment, expand_size);
     }
 
-    if (node->node_type == Node::CON_NODE) {
+    if (segment_end_nodes[i]->node_type == Node::CON_NODE) {
       segment->set_segment_type(Segment::FIXED_VALUE);
     }
+  }
+}
 
-    if (type == ONLY_FIRST_SEGMENT) {
-      break;
+void ImmutableConverterImpl::ExpandSegments(
+    const Lattice &lattice, const std::string &original_key,
+    Segments::RequestType request_type, size_t expand_size,
+    FilterType filter_type,
+    const std::vector<SegmentExpansion> &expansions) const {
+  // Optionally bounds the search steps for each segment by the number of
+  // candidates to generate, so that a long candidate list doesn't spike the
+  // latency.  Otherwise NBestGenerator only bounds the steps for each
+  // candidate.
+  const int kMinExpansions = 2000;
+  const int expansions_per_candidate = FLAGS_nbest_expansions_per_candidate;
+  const int max_expansions =
+      expansions_per_candidate > 0
+          ? std::max(kMinExpansions,
+                     static_cast<int>(expand_size) * expansions_per_candidate)
+          : 0;
+
+  // Each thread takes the next segment until all the segments are expanded.
+  // A segment is written only by the thread which took it, and the nodes,
+  // the connector and the filters are only read.
+  std::atomic<size_t> next_index(0);
+  auto expand = [&]() {
+    NBestGenerator nbest_generator(suppression_dictionary_, segmenter_,
+                                   connector_, pos_matcher_, &lattice,
+                                   suggestion_filter_,
+                                   (filter_type == DESKTOP));
+    if (max_expansions > 0) {
+      nbest_generator.set_max_expansions(max_expansions);
+    }
+    for (size_t i = next_index++; i < expansions.size(); i = next_index++) {
+      const SegmentExpansion &expansion = expansions[i];
+      nbest_generator.Reset(expansion.begin_node, expansion.end_node,
+                            expansion.mode);
+      ExpandCandidates(original_key, &nbest_generator, expansion.segment,
+                       request_type, expand_size);
     }
-    begin_pos = std::string::npos;
-    prev = node;
+  };
+
+  const size_t num_threads =
+      std::min(expansions.size(),
+               static_cast<size_t>(std::max(FLAGS_nbest_expansion_threads, 1)));
+  if (num_threads <= 1) {
+    expand();
+    return;
   }
+  ThreadPool::GetSharedPool()->RunInParallel(num_threads, expand);
 }
 
 bool ImmutableConverterImpl::MakeSegments(const ConversionRequest &request,
@@ -2099,7 +2338,7 @@ bool ImmutableConverterImpl::ConvertForRequest(const ConversionRequest &request,
       return false;
     }
   } else {
-    if (!Viterbi(*segments, lattice)) {
+    if (!Viterbi(*segments, request.viterbi_beam_width(), lattice)) {
       LOG(WARNING) << "viterbi failed";
       return false;
     }
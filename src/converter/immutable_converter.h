@@ -36,6 +36,7 @@
 #include "base/port.h"
 #include "converter/connector.h"
 #include "converter/immutable_converter_interface.h"
+#include "converter/nbest_generator.h"
 #include "converter/node.h"
 #include "converter/segments.h"
 #include "dictionary/dictionary_interface.h"
@@ -50,7 +51,6 @@ namespace mozc {
 struct Node;
 class ImmutableConverterInterface;
 class Lattice;
-class NBestGenerator;
 class Segmenter;
 class SuggestionFilter;
 
@@ -73,8 +73,12 @@ class ImmutableConverterImpl : public ImmutableConverterInterface {
   FRIEND_TEST(ImmutableConverterTest, AddPredictiveNodes);
   FRIEND_TEST(ImmutableConverterTest, DummyCandidatesCost);
   FRIEND_TEST(ImmutableConverterTest, DummyCandidatesInnerSegmentBoundary);
+  FRIEND_TEST(ImmutableConverterTest, IncrementalPredictionLattice);
+  FRIEND_TEST(ImmutableConverterTest, KeyCorrectedNodesSkipTokensWithoutValues);
   FRIEND_TEST(ImmutableConverterTest, NotConnectedTest);
   FRIEND_TEST(ImmutableConverterTest, PredictiveNodesOnlyForConversionKey);
+  FRIEND_TEST(ImmutableConverterTest, ViterbiBeamWidth);
+  FRIEND_TEST(NBestGeneratorTest, ExpansionBudget);
   FRIEND_TEST(NBestGeneratorTest, InnerSegmentBoundary);
   FRIEND_TEST(NBestGeneratorTest, MultiSegmentConnectionTest);
   FRIEND_TEST(NBestGeneratorTest, SingleSegmentConnectionTest);
@@ -102,8 +106,21 @@ class ImmutableConverterImpl : public ImmutableConverterInterface {
   Node *Lookup(const int begin_pos, const int end_pos,
                const ConversionRequest &request, bool is_reverse,
                bool is_prediction, Lattice *lattice) const;
+  // Performs the same as Lookup(pos, lattice->key().size(), ...) without
+  // reverse lookup for each character position |pos| from |begin_pos|, and
+  // stores the result to (*nodes)[pos].  The dictionary is looked up for all
+  // the positions by one batched call, which overlaps the memory stalls of
+  // the trie traversals.
+  void LookupForAllPositions(size_t begin_pos,
+                             const ConversionRequest &request,
+                             bool is_prediction, Lattice *lattice,
+                             std::vector<Node *> *nodes) const;
+  // Adds the nodes for unknown words based on the character types of the key
+  // starting at |begin| to |nodes|.  The node for the first character is added
+  // only if |add_single_char_node| is true.
   Node *AddCharacterTypeBasedNodes(const char *begin, const char *end,
-                                   Lattice *lattice, Node *nodes) const;
+                                   bool add_single_char_node, Lattice *lattice,
+                                   Node *nodes) const;
 
   void Resegment(const Segments &segments, const std::string &history_key,
                  const std::string &conversion_key, Lattice *lattice) const;
@@ -134,9 +151,16 @@ class ImmutableConverterImpl : public ImmutableConverterInterface {
                                 Lattice *lattice) const;
 
   bool Viterbi(const Segments &segments, Lattice *lattice) const;
+  // Same as above, but considers only |beam_width| best left nodes at each
+  // position if |beam_width| is positive.
+  bool Viterbi(const Segments &segments, size_t beam_width,
+               Lattice *lattice) const;
 
   bool PredictionViterbi(const Segments &segments, Lattice *lattice) const;
+  // |changed_columns|[pos] is set to true when the cost of a node ending at
+  // |pos| is changed.
   void PredictionViterbiInternal(int calc_begin_pos, int calc_end_pos,
+                                 std::vector<bool> *changed_columns,
                                  Lattice *lattice) const;
 
   // TODO(toshiyuki): Change parameter order for mutable |segments|.
@@ -168,6 +192,24 @@ class ImmutableConverterImpl : public ImmutableConverterInterface {
                                   InsertCandidatesType type, size_t begin_pos,
                                   const Node *node, Segments *segments) const;
 
+  // The part of the lattice to enumerate the candidates of |segment| from.
+  struct SegmentExpansion {
+    const Node *begin_node;
+    const Node *end_node;
+    NBestGenerator::BoundaryCheckMode mode;
+    Segment *segment;
+  };
+
+  // Helper function for InsertCandidates().
+  // Expands the candidates of the segments of |expansions|.  As the lattice
+  // is read-only here, the segments are expanded on multiple threads if
+  // --nbest_expansion_threads is greater than 1.  The result is the same as
+  // the sequential expansion.
+  void ExpandSegments(const Lattice &lattice, const std::string &original_key,
+                      Segments::RequestType request_type, size_t expand_size,
+                      FilterType filter_type,
+                      const std::vector<SegmentExpansion> &expansions) const;
+
   bool MakeSegments(const ConversionRequest &request, const Lattice &lattice,
                     const std::vector<uint16> &group, Segments *segments) const;
 
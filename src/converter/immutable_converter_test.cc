@@ -34,6 +34,7 @@
 #include <utility>
 #include <vector>
 
+#include "base/flags.h"
 #include "base/logging.h"
 #include "base/port.h"
 #include "base/system_util.h"
@@ -61,6 +62,9 @@
 #include "absl/memory/memory.h"
 #include "absl/strings/string_view.h"
 
+DECLARE_int32(nbest_expansion_threads);
+DECLARE_int32(nbest_expansions_per_candidate);
+
 namespace mozc {
 namespace {
 
@@ -71,6 +75,7 @@ using dictionary::POSMatcher;
 using dictionary::SuffixDictionary;
 using dictionary::SuppressionDictionary;
 using dictionary::SystemDictionary;
+using dictionary::Token;
 using dictionary::UserDictionaryStub;
 using dictionary::ValueDictionary;
 
@@ -411,6 +416,90 @@ TEST(ImmutableConverterTest, NoInnerSegmenBoundaryForConversion) {
   }
 }
 
+TEST(ImmutableConverterTest, ParallelSegmentExpansion) {
+  std::unique_ptr<MockDataAndImmutableConverter> data_and_converter(
+      new MockDataAndImmutableConverter);
+  const std::string kRequestKey = "わたしのなまえはなかのです";
+  const int32 original_threads = FLAGS_nbest_expansion_threads;
+
+  Segments expected;
+  expected.set_request_type(Segments::CONVERSION);
+  expected.add_segment()->set_key(kRequestKey);
+  FLAGS_nbest_expansion_threads = 1;
+  ASSERT_TRUE(data_and_converter->GetConverter()->Convert(&expected));
+  ASSERT_LT(1, expected.segments_size());
+
+  Segments actual;
+  actual.set_request_type(Segments::CONVERSION);
+  actual.add_segment()->set_key(kRequestKey);
+  FLAGS_nbest_expansion_threads = 4;
+  ASSERT_TRUE(data_and_converter->GetConverter()->Convert(&actual));
+  FLAGS_nbest_expansion_threads = original_threads;
+
+  // The result doesn't depend on the number of threads.
+  ASSERT_EQ(expected.segments_size(), actual.segments_size());
+  for (size_t i = 0; i < expected.segments_size(); ++i) {
+    const Segment &expected_segment = expected.segment(i);
+    const Segment &actual_segment = actual.segment(i);
+    EXPECT_EQ(expected_segment.key(), actual_segment.key());
+    EXPECT_EQ(expected_segment.segment_type(), actual_segment.segment_type());
+    ASSERT_EQ(expected_segment.candidates_size(),
+              actual_segment.candidates_size());
+    for (size_t j = 0; j < expected_segment.candidates_size(); ++j) {
+      EXPECT_EQ(expected_segment.candidate(j).value,
+                actual_segment.candidate(j).value);
+      EXPECT_EQ(expected_segment.candidate(j).cost,
+                actual_segment.candidate(j).cost);
+    }
+  }
+}
+
+TEST(ImmutableConverterTest, ExpansionBudgetPerCandidate) {
+  std::unique_ptr<MockDataAndImmutableConverter> data_and_converter(
+      new MockDataAndImmutableConverter);
+  const std::string kRequestKey = "わたしのなまえはなかのです";
+  const int32 original_expansions = FLAGS_nbest_expansions_per_candidate;
+  auto convert = [&data_and_converter, &kRequestKey](int32 expansions,
+                                                     Segments *segments) {
+    segments->set_request_type(Segments::CONVERSION);
+    segments->add_segment()->set_key(kRequestKey);
+    FLAGS_nbest_expansions_per_candidate = expansions;
+    return data_and_converter->GetConverter()->Convert(segments);
+  };
+
+  // The default bound of NBestGenerator.
+  Segments expected;
+  ASSERT_TRUE(convert(0, &expected));
+
+  // A bound larger than the default one doesn't change the result.
+  Segments loose;
+  ASSERT_TRUE(convert(100000, &loose));
+  ASSERT_EQ(expected.segments_size(), loose.segments_size());
+  for (size_t i = 0; i < expected.segments_size(); ++i) {
+    const Segment &expected_segment = expected.segment(i);
+    const Segment &loose_segment = loose.segment(i);
+    ASSERT_EQ(expected_segment.candidates_size(),
+              loose_segment.candidates_size());
+    for (size_t j = 0; j < expected_segment.candidates_size(); ++j) {
+      EXPECT_EQ(expected_segment.candidate(j).value,
+                loose_segment.candidate(j).value);
+      EXPECT_EQ(expected_segment.candidate(j).cost,
+                loose_segment.candidate(j).cost);
+    }
+  }
+
+  // The tightest bound of the flag still finds the best candidates.
+  Segments tight;
+  ASSERT_TRUE(convert(1, &tight));
+  FLAGS_nbest_expansions_per_candidate = original_expansions;
+  ASSERT_EQ(expected.segments_size(), tight.segments_size());
+  for (size_t i = 0; i < expected.segments_size(); ++i) {
+    ASSERT_LT(0, tight.segment(i).candidates_size());
+    EXPECT_EQ(expected.segment(i).candidate(0).value,
+              tight.segment(i).candidate(0).value);
+  }
+}
+
 TEST(ImmutableConverterTest, NotConnectedTest) {
   std::unique_ptr<MockDataAndImmutableConverter> data_and_converter(
       new MockDataAndImmutableConverter);
@@ -451,6 +540,143 @@ TEST(ImmutableConverterTest, NotConnectedTest) {
   EXPECT_TRUE(tested);
 }
 
+namespace {
+// Calls back the tokens whose keys are prefixes of the looked-up key in the
+// same way as SystemDictionary, i.e., OnTokenWithoutValue() is checked before
+// OnToken().  Records the keys of the tokens rejected by the former.
+class PrefixTokenDictionary : public DictionaryInterface {
+ public:
+  void AddToken(const std::string &key, const std::string &value) {
+    Token token;
+    token.key = key;
+    token.value = value;
+    token.lid = token.rid = 1;
+    token.cost = 1000;
+    tokens_.push_back(token);
+  }
+
+  bool HasKey(absl::string_view key) const override { return false; }
+  bool HasValue(absl::string_view value) const override { return false; }
+
+  void LookupPredictive(absl::string_view key, const ConversionRequest &convreq,
+                        Callback *callback) const override {}
+
+  void LookupPrefix(absl::string_view key, const ConversionRequest &convreq,
+                    Callback *callback) const override {
+    for (const Token &token : tokens_) {
+      if (!Util::StartsWith(key, token.key)) {
+        continue;
+      }
+      const Callback::ResultType result = callback->OnKey(token.key);
+      if (result == Callback::TRAVERSE_DONE) {
+        return;
+      }
+      if (result != Callback::TRAVERSE_CONTINUE) {
+        continue;
+      }
+      callback->OnActualKey(token.key, token.key, false);
+      if (!callback->OnTokenWithoutValue(token.key, token.key, token)) {
+        rejected_keys_.push_back(token.key);
+        continue;
+      }
+      if (callback->OnToken(token.key, token.key, token) ==
+          Callback::TRAVERSE_DONE) {
+        return;
+      }
+    }
+  }
+
+  void LookupExact(absl::string_view key, const ConversionRequest &convreq,
+                   Callback *callback) const override {}
+
+  void LookupReverse(absl::string_view str, const ConversionRequest &convreq,
+                     Callback *callback) const override {}
+
+  const std::vector<std::string> &rejected_keys() const {
+    return rejected_keys_;
+  }
+
+ private:
+  std::vector<Token> tokens_;
+  mutable std::vector<std::string> rejected_keys_;
+};
+}  // namespace
+
+TEST(ImmutableConverterTest, KeyCorrectedNodesSkipTokensWithoutValues) {
+  PrefixTokenDictionary *dictionary = new PrefixTokenDictionary;
+  dictionary->AddToken("こ", "子");
+  dictionary->AddToken("こんにちは", "今日は");
+  std::unique_ptr<MockDataAndImmutableConverter> data_and_converter(
+      new MockDataAndImmutableConverter(dictionary));
+  ImmutableConverterImpl *converter = data_and_converter->GetConverter();
+
+  // "こんんにちは" is corrected to "こんにちは", where "こ" has no
+  // corresponding part of the original key.
+  const std::string kKey = "こんんにちは";
+  Segments segments;
+  segments.set_request_type(Segments::CONVERSION);
+  segments.add_segment()->set_key(kKey);
+  Lattice lattice;
+  lattice.SetKey(kKey);
+  const ConversionRequest request;
+  ASSERT_TRUE(converter->MakeLattice(request, &segments, &lattice));
+
+  // The token for "こ" is rejected before its value is used, only in the
+  // lookup for the corrected key.
+  EXPECT_EQ(std::vector<std::string>({"こ"}), dictionary->rejected_keys());
+  bool found = false;
+  for (Node *node = lattice.begin_nodes(0); node != nullptr;
+       node = node->bnext) {
+    if (node->value == "今日は") {
+      EXPECT_EQ(kKey, node->key);
+      found = true;
+    }
+  }
+  EXPECT_TRUE(found);
+}
+
+TEST(ImmutableConverterTest, IncrementalPredictionLattice) {
+  std::unique_ptr<MockDataAndImmutableConverter> data_and_converter(
+      new MockDataAndImmutableConverter);
+  ImmutableConverterImpl *converter = data_and_converter->GetConverter();
+  const ConversionRequest request;
+
+  std::vector<std::string> chars;
+  Util::SplitStringToUtf8Chars("わたしのなまえはなかのです", &chars);
+
+  // The lattice reused across keystrokes should give the same costs as the one
+  // built from scratch, while typing and while deleting the characters.
+  std::vector<std::string> keys;
+  std::string key;
+  for (const std::string &c : chars) {
+    key += c;
+    keys.push_back(key);
+  }
+  for (int i = static_cast<int>(chars.size()) - 2; i >= 0; --i) {
+    keys.push_back(keys[i]);
+  }
+
+  Lattice incremental_lattice;
+  for (const std::string &key : keys) {
+    SCOPED_TRACE(key);
+    Segments segments;
+    segments.set_request_type(Segments::PREDICTION);
+    segments.add_segment()->set_key(key);
+
+    ASSERT_TRUE(
+        converter->MakeLattice(request, &segments, &incremental_lattice));
+    ASSERT_TRUE(converter->PredictionViterbi(segments, &incremental_lattice));
+    EXPECT_EQ(incremental_lattice.key().size() + 1,
+              incremental_lattice.valid_cost_end_pos());
+
+    Lattice lattice;
+    ASSERT_TRUE(converter->MakeLattice(request, &segments, &lattice));
+    ASSERT_TRUE(converter->PredictionViterbi(segments, &lattice));
+
+    EXPECT_EQ(lattice.eos_nodes()->cost, incremental_lattice.eos_nodes()->cost);
+  }
+}
+
 TEST(ImmutableConverterTest, HistoryKeyLengthIsVeryLong) {
   // "あ..." (100 times)
   const std::string kA100 =
@@ -488,6 +714,33 @@ TEST(ImmutableConverterTest, HistoryKeyLengthIsVeryLong) {
   EXPECT_EQ(kRequestKey, segments.segment(0).key());
 }
 
+TEST(ImmutableConverterTest, ViterbiBeamWidth) {
+  std::unique_ptr<MockDataAndImmutableConverter> data_and_converter(
+      new MockDataAndImmutableConverter);
+  ImmutableConverterImpl *converter = data_and_converter->GetConverter();
+
+  Segments segments;
+  segments.set_request_type(Segments::CONVERSION);
+  const std::string kKey = "わたしのなまえはなかのです";
+  segments.add_segment()->set_key(kKey);
+
+  Lattice lattice;
+  lattice.SetKey(kKey);
+  const ConversionRequest request;
+  ASSERT_TRUE(converter->MakeLattice(request, &segments, &lattice));
+
+  ASSERT_TRUE(converter->Viterbi(segments, &lattice));
+  const int exhaustive_cost = lattice.eos_nodes()->cost;
+
+  // A beam wider than any column is the same as the exhaustive search.
+  ASSERT_TRUE(converter->Viterbi(segments, 100000, &lattice));
+  EXPECT_EQ(exhaustive_cost, lattice.eos_nodes()->cost);
+
+  // A narrow beam can miss the best path, but never finds a better one.
+  ASSERT_TRUE(converter->Viterbi(segments, 1, &lattice));
+  EXPECT_LE(exhaustive_cost, lattice.eos_nodes()->cost);
+}
+
 namespace {
 bool AutoPartialSuggestionTestHelper(const ConversionRequest &request) {
   std::unique_ptr<MockDataAndImmutableConverter> data_and_converter(
@@ -554,10 +554,10 @@ bool KeyCorrector::IsInvalidPosition(size_t pos) {
 size_t KeyCorrector::InvalidPosition() { return kInvalidPos; }
 
 // static
-int KeyCorrector::GetCorrectedCostPenalty(const std::string &key) {
+int KeyCorrector::GetCorrectedCostPenalty(absl::string_view key) {
   // "んん" and "っっ" must be mis-spelling.
-  if (key.find("んん") != std::string::npos ||
-      key.find("っっ") != std::string::npos) {
+  if (key.find("んん") != absl::string_view::npos ||
+      key.find("っっ") != absl::string_view::npos) {
     return 0;
   }
   // add 3000 to the original word cost
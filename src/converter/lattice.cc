@@ -50,7 +50,7 @@ Node *InitBOSNode(Lattice *lattice, uint16 length) {
   DCHECK(bos_node);
   bos_node->rid = 0;  // 0 is reserved for EOS/BOS
   bos_node->lid = 0;
-  bos_node->key.clear();
+  bos_node->key = absl::string_view();
   bos_node->value = "BOS";
   bos_node->node_type = Node::BOS_NODE;
   bos_node->wcost = 0;
@@ -66,7 +66,7 @@ Node *InitEOSNode(Lattice *lattice, uint16 length) {
   DCHECK(eos_node);
   eos_node->rid = 0;  // 0 is reserved for EOS/BOS
   eos_node->lid = 0;
-  eos_node->key.clear();
+  eos_node->key = absl::string_view();
   eos_node->value = "EOS";
   eos_node->node_type = Node::EOS_NODE;
   eos_node->wcost = 0;
@@ -143,7 +143,10 @@ struct LatticeDisplayNodeInfo {
   std::string display_node_str_;
 };
 
-Lattice::Lattice() : history_end_pos_(0), node_allocator_(new NodeAllocator) {}
+Lattice::Lattice()
+    : history_end_pos_(0),
+      node_allocator_(new NodeAllocator),
+      valid_cost_end_pos_(0) {}
 
 Lattice::~Lattice() {}
 
@@ -155,6 +158,61 @@ Node *Lattice::begin_nodes(size_t pos) const { return begin_nodes_[pos]; }
 
 Node *Lattice::end_nodes(size_t pos) const { return end_nodes_[pos]; }
 
+void LatticeColumn::KeepBest(size_t width) {
+  const size_t column_size = size();
+  if (column_size <= width) {
+    return;
+  }
+  if (width == 0) {
+    clear();
+    return;
+  }
+
+  // Finds the cost of the |width|-th best node.
+  sorted_costs.assign(costs.begin(), costs.end());
+  std::nth_element(sorted_costs.begin(), sorted_costs.begin() + width - 1,
+                   sorted_costs.end());
+  const int32 threshold = sorted_costs[width - 1];
+  size_t num_ties = width;
+  for (size_t i = 0; i < width; ++i) {
+    if (sorted_costs[i] < threshold) {
+      --num_ties;
+    }
+  }
+
+  size_t kept = 0;
+  for (size_t i = 0; i < column_size; ++i) {
+    if (costs[i] > threshold) {
+      continue;
+    }
+    if (costs[i] == threshold) {
+      if (num_ties == 0) {
+        continue;
+      }
+      --num_ties;
+    }
+    rids[kept] = rids[i];
+    costs[kept] = costs[i];
+    nodes[kept] = nodes[i];
+    ++kept;
+  }
+  DCHECK_EQ(width, kept);
+  rids.resize(kept);
+  costs.resize(kept);
+  nodes.resize(kept);
+}
+
+void Lattice::GetConnectedEndNodes(size_t pos, LatticeColumn *column) const {
+  DCHECK(column);
+  column->clear();
+  for (Node *node = end_nodes_[pos]; node != nullptr; node = node->enext) {
+    if (node->prev == nullptr) {
+      continue;
+    }
+    column->push_back(node);
+  }
+}
+
 void Lattice::SetKey(absl::string_view key) {
   Clear();
   key_.assign(key.data(), key.size());
@@ -187,6 +245,7 @@ void Lattice::Insert(size_t pos, Node *node) {
     rnode->cost = 0;
     rnode->enext = end_nodes_[end_pos];
     end_nodes_[end_pos] = rnode;
+    valid_cost_end_pos_ = std::min(valid_cost_end_pos_, end_pos);
   }
 
   if (begin_nodes_[pos] == nullptr) {
@@ -210,9 +269,10 @@ void Lattice::Clear() {
   key_.clear();
   begin_nodes_.clear();
   end_nodes_.clear();
-  node_allocator_->Free();
+  node_allocator_->Reset();
   cache_info_.clear();
   history_end_pos_ = 0;
+  valid_cost_end_pos_ = 0;
 }
 
 void Lattice::SetDebugDisplayNode(size_t begin_pos, size_t end_pos,
@@ -271,7 +331,10 @@ void Lattice::AddSuffix(const std::string &suffix_key) {
   std::fill(end_nodes_.begin() + old_size + 1, end_nodes_.end(),
             static_cast<Node *>(nullptr));
 
-  end_nodes_[0] = InitBOSNode(this, static_cast<uint16>(0));
+  // Keep the BOS node as the nodes at position 0 may point to it.
+  if (end_nodes_[0] == nullptr) {
+    end_nodes_[0] = InitBOSNode(this, static_cast<uint16>(0));
+  }
   begin_nodes_[new_size] = InitEOSNode(this, static_cast<uint16>(new_size));
 
   // update cache_info
@@ -325,6 +388,8 @@ void Lattice::ShrinkKey(const size_t new_len) {
   }
   std::fill(cache_info_.begin() + new_len, cache_info_.end(), 0);
 
+  valid_cost_end_pos_ = std::min(valid_cost_end_pos_, new_len + 1);
+
   // update key
   key_.erase(new_len);
 }
@@ -341,64 +406,40 @@ void Lattice::SetCacheInfo(const size_t pos, const size_t len) {
 
 void Lattice::ResetNodeCost() {
   for (size_t i = 0; i <= key_.size(); ++i) {
-    if (begin_nodes_[i] != nullptr) {
-      Node *prev = nullptr;
-      for (Node *node = begin_nodes_[i]; node != nullptr; node = node->bnext) {
-        // do not process BOS / EOS nodes
-        if (node->node_type == Node::BOS_NODE ||
-            node->node_type == Node::EOS_NODE) {
-          continue;
-        }
-        // if the node has ENABLE_CACHE attribute, then revert its wcost.
-        // Otherwise, erase the node from the lattice.
-        if (node->attributes & Node::ENABLE_CACHE) {
-          node->wcost = node->raw_wcost;
-        } else {
-          if (node == begin_nodes_[i]) {
-            if (node->bnext == nullptr) {
-              begin_nodes_[i] = nullptr;
-            } else {
-              begin_nodes_[i] = node->bnext;
-            }
-          } else {
-            CHECK(prev);
-            CHECK_EQ(prev->bnext, node);
-            prev->next = node->bnext;
-          }
-        }
-        // traverse a next node
-        prev = node;
+    for (Node **node = &begin_nodes_[i]; *node != nullptr;) {
+      // do not process BOS / EOS nodes
+      if ((*node)->node_type == Node::BOS_NODE ||
+          (*node)->node_type == Node::EOS_NODE) {
+        node = &(*node)->bnext;
+        continue;
+      }
+      // if the node has ENABLE_CACHE attribute, then revert its wcost.
+      // Otherwise, erase the node from the lattice.
+      if ((*node)->attributes & Node::ENABLE_CACHE) {
+        (*node)->wcost = (*node)->raw_wcost;
+        node = &(*node)->bnext;
+      } else {
+        *node = (*node)->bnext;
       }
     }
 
-    if (end_nodes_[i] != nullptr) {
-      Node *prev = nullptr;
-      for (Node *node = end_nodes_[i]; node != nullptr; node = node->enext) {
-        if (node->node_type == Node::BOS_NODE ||
-            node->node_type == Node::EOS_NODE) {
-          continue;
-        }
-        if (node->attributes & Node::ENABLE_CACHE) {
-          node->wcost = node->raw_wcost;
-        } else {
-          if (node == end_nodes_[i]) {
-            if (node->enext == nullptr) {
-              end_nodes_[i] = nullptr;
-            } else {
-              end_nodes_[i] = node->enext;
-            }
-          } else {
-            CHECK(prev);
-            CHECK_EQ(prev->enext, node);
-            prev->next = node->enext;
-          }
-        }
-        prev = node;
+    for (Node **node = &end_nodes_[i]; *node != nullptr;) {
+      if ((*node)->node_type == Node::BOS_NODE ||
+          (*node)->node_type == Node::EOS_NODE ||
+          ((*node)->attributes & Node::ENABLE_CACHE)) {
+        node = &(*node)->enext;
+      } else {
+        *node = (*node)->enext;
+        valid_cost_end_pos_ = std::min(valid_cost_end_pos_, i);
       }
     }
   }
 }
 
+size_t Lattice::valid_cost_end_pos() const { return valid_cost_end_pos_; }
+
+void Lattice::MarkCostsValid() { valid_cost_end_pos_ = key_.size() + 1; }
+
 std::string Lattice::DebugString() const {
   std::stringstream os;
   if (!has_lattice()) {
@@ -41,6 +41,41 @@
 
 namespace mozc {
 
+// Struct-of-arrays copy of the nodes ending at one position of a lattice.
+// Viterbi reads the right POS id and the accumulated cost of every left node
+// once per right node, so keeping them in contiguous arrays avoids chasing
+// Node::enext across the allocator chunks for each (lnode, rnode) pair.
+// |nodes| keeps the original Node pointers in the same order, so that the
+// result can be written back through the usual Node API.
+struct LatticeColumn {
+  std::vector<uint16> rids;
+  std::vector<int32> costs;
+  std::vector<Node *> nodes;
+
+  size_t size() const { return nodes.size(); }
+  bool empty() const { return nodes.empty(); }
+
+  void clear() {
+    rids.clear();
+    costs.clear();
+    nodes.clear();
+  }
+
+  void push_back(Node *node) {
+    rids.push_back(node->rid);
+    costs.push_back(node->cost);
+    nodes.push_back(node);
+  }
+
+  // Keeps only the |width| nodes of the lowest costs, preserving their order.
+  // Of the nodes with the same cost as the last kept one, the earlier ones are
+  // kept.
+  void KeepBest(size_t width);
+
+  // Buffer for KeepBest().
+  std::vector<int32> sorted_costs;
+};
+
 class Lattice {
  public:
   Lattice();
@@ -71,6 +106,11 @@ class Lattice {
   // To traverse all nodes, use Node::enext member.
   Node *end_nodes(size_t pos) const;
 
+  // Fills |column| with the nodes ending at |pos| that are connected to BOS,
+  // i.e., nodes whose |prev| has been set by Viterbi. The order of the nodes
+  // is the same as the one of end_nodes(pos).
+  void GetConnectedEndNodes(size_t pos, LatticeColumn *column) const;
+
   // return bos nodes.
   // alias of end_nodes(0).
   Node *bos_nodes() const;
@@ -83,6 +123,7 @@ class Lattice {
   void Insert(size_t pos, Node *node);
 
   // clear all lattice and nodes allocated with NewNode method.
+  // The memory for the nodes is kept for the next conversion.
   void Clear();
 
   // return true if this instance has a valid lattice.
@@ -106,8 +147,18 @@ class Lattice {
   // revert the wcost of nodes if it has ENABLE_CACHE attribute.
   // This function is needed for wcost may be changed during conversion
   // process for some heuristic methods.
+  // Nodes without ENABLE_CACHE attribute are removed from the lattice.
   void ResetNodeCost();
 
+  // Returns the smallest position whose end nodes have been inserted or
+  // removed since the last call of MarkCostsValid().  The nodes ending at a
+  // position before it still hold the costs computed by the last Viterbi, so
+  // that Viterbi can skip them unless their begin position is affected.
+  size_t valid_cost_end_pos() const;
+
+  // Marks the costs of all the nodes as computed.  Called after Viterbi.
+  void MarkCostsValid();
+
   // Dump the best path and the path that contains the designated string.
   std::string DebugString() const;
 
@@ -130,6 +181,9 @@ class Lattice {
   // If cache_info_[pos] equals to len, it means key.substr(pos, k)
   // (1 <= k <= len) is already looked up.
   std::vector<size_t> cache_info_;
+
+  // See valid_cost_end_pos().
+  size_t valid_cost_end_pos_;
 };
 
 }  // namespace mozc
@@ -35,6 +35,7 @@
 #include "base/port.h"
 #include "converter/node.h"
 #include "testing/base/public/gunit.h"
+#include "absl/strings/string_view.h"
 
 namespace mozc {
 
@@ -103,6 +104,52 @@ TEST(LatticeTest, InsertTest) {
   }
 }
 
+TEST(LatticeTest, GetConnectedEndNodesTest) {
+  Lattice lattice;
+  lattice.SetKey("test");
+
+  Node *node1 = lattice.NewNode();
+  node1->key = "te";
+  node1->rid = 10;
+  lattice.Insert(0, node1);
+
+  Node *node2 = lattice.NewNode();
+  node2->key = "e";
+  node2->rid = 20;
+  lattice.Insert(1, node2);
+
+  Node *node3 = lattice.NewNode();
+  node3->key = "tes";
+  node3->rid = 30;
+  lattice.Insert(0, node3);
+
+  // Only node1 and node2 are connected to BOS.
+  node1->prev = lattice.bos_nodes();
+  node1->cost = 100;
+  node2->prev = node1;
+  node2->cost = 200;
+
+  LatticeColumn column;
+  lattice.GetConnectedEndNodes(2, &column);
+  ASSERT_EQ(2, column.size());
+  // The order is the same as end_nodes(2).
+  EXPECT_EQ(node2, column.nodes[0]);
+  EXPECT_EQ(20, column.rids[0]);
+  EXPECT_EQ(200, column.costs[0]);
+  EXPECT_EQ(node1, column.nodes[1]);
+  EXPECT_EQ(10, column.rids[1]);
+  EXPECT_EQ(100, column.costs[1]);
+
+  // node3 is not connected yet.
+  lattice.GetConnectedEndNodes(3, &column);
+  EXPECT_TRUE(column.empty());
+
+  node3->prev = lattice.bos_nodes();
+  lattice.GetConnectedEndNodes(3, &column);
+  ASSERT_EQ(1, column.size());
+  EXPECT_EQ(node3, column.nodes[0]);
+}
+
 namespace {
 
 // set cache_info[i] to (key.size() - i)
@@ -118,12 +165,44 @@ void InsertNodes(Lattice *lattice) {
   const size_t key_size = lattice->key().size();
   for (size_t i = 0; i < key_size; ++i) {
     Node *node = lattice->NewNode();
-    node->key.assign(lattice->key(), i, key_size - i);
+    node->key = lattice->node_allocator()->NewString(
+        absl::string_view(lattice->key()).substr(i, key_size - i));
     lattice->Insert(i, node);
   }
 }
 }  // namespace
 
+TEST(LatticeTest, LatticeColumnKeepBestTest) {
+  Lattice lattice;
+  lattice.SetKey("test");
+  const int32 kCosts[] = {500, 100, 300, 100, 400, 300};
+  LatticeColumn column;
+  for (size_t i = 0; i < arraysize(kCosts); ++i) {
+    Node *node = lattice.NewNode();
+    node->rid = static_cast<uint16>(i);
+    node->cost = kCosts[i];
+    column.push_back(node);
+  }
+
+  column.KeepBest(10);
+  EXPECT_EQ(6, column.size());
+
+  // Of the two nodes of cost 300, the earlier one is kept.
+  column.KeepBest(3);
+  ASSERT_EQ(3, column.size());
+  EXPECT_EQ(1, column.rids[0]);
+  EXPECT_EQ(100, column.costs[0]);
+  EXPECT_EQ(2, column.rids[1]);
+  EXPECT_EQ(300, column.costs[1]);
+  EXPECT_EQ(3, column.rids[2]);
+  EXPECT_EQ(100, column.costs[2]);
+  EXPECT_EQ(column.nodes[1]->rid, column.rids[1]);
+
+  column.KeepBest(1);
+  ASSERT_EQ(1, column.size());
+  EXPECT_EQ(1, column.rids[0]);
+}
+
 TEST(LatticeTest, AddSuffixTest) {
   Lattice lattice;
 
@@ -221,4 +300,60 @@ TEST(LatticeTest, ShrinkKeyTest) {
     }
   }
 }
+
+TEST(LatticeTest, ResetNodeCostTest) {
+  Lattice lattice;
+  lattice.SetKey("test");
+
+  // "te" is cached while "es" is not.
+  Node *cached_node = lattice.NewNode();
+  cached_node->key = "te";
+  cached_node->attributes |= Node::ENABLE_CACHE;
+  cached_node->raw_wcost = 100;
+  lattice.Insert(0, cached_node);
+  Node *node = lattice.NewNode();
+  node->key = "es";
+  lattice.Insert(1, node);
+  Node *node2 = lattice.NewNode();
+  node2->key = "e";
+  lattice.Insert(1, node2);
+  lattice.MarkCostsValid();
+  EXPECT_EQ(5, lattice.valid_cost_end_pos());
+
+  cached_node->wcost = 200;
+  lattice.ResetNodeCost();
+  EXPECT_EQ(100, cached_node->wcost);
+  EXPECT_EQ(cached_node, lattice.begin_nodes(0));
+  EXPECT_EQ(nullptr, lattice.begin_nodes(1));
+  EXPECT_EQ(cached_node, lattice.end_nodes(2));
+  EXPECT_EQ(nullptr, cached_node->enext);
+  EXPECT_EQ(nullptr, lattice.end_nodes(3));
+  EXPECT_EQ(2, lattice.valid_cost_end_pos());
+}
+
+TEST(LatticeTest, ValidCostEndPosTest) {
+  Lattice lattice;
+  lattice.SetKey("test");
+  EXPECT_EQ(0, lattice.valid_cost_end_pos());
+  lattice.MarkCostsValid();
+  EXPECT_EQ(5, lattice.valid_cost_end_pos());
+
+  Node *node = lattice.NewNode();
+  node->key = "st";
+  lattice.Insert(2, node);
+  EXPECT_EQ(4, lattice.valid_cost_end_pos());
+
+  // Adding a suffix keeps the nodes and their costs.
+  lattice.MarkCostsValid();
+  lattice.AddSuffix("s");
+  EXPECT_EQ(5, lattice.valid_cost_end_pos());
+  EXPECT_EQ(node, lattice.end_nodes(4));
+
+  lattice.ShrinkKey(2);
+  EXPECT_EQ(3, lattice.valid_cost_end_pos());
+
+  lattice.Clear();
+  EXPECT_EQ(0, lattice.valid_cost_end_pos());
+}
+
 }  // namespace mozc
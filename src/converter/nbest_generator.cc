@@ -42,6 +42,7 @@
 #include "converter/segmenter.h"
 #include "converter/segments.h"
 #include "dictionary/pos_matcher.h"
+#include "absl/strings/str_cat.h"
 
 using mozc::dictionary::POSMatcher;
 using mozc::dictionary::SuppressionDictionary;
@@ -49,56 +50,35 @@ using mozc::dictionary::SuppressionDictionary;
 namespace mozc {
 namespace {
 
-const int kFreeListSize = 512;
+const int kInitialAgendaSize = 512;
 const int kCostDiff = 3453;  // log prob of 1/1000
 
 }  // namespace
 
 using converter::CandidateFilter;
 
-struct NBestGenerator::QueueElement {
-  const Node *node;
-  const QueueElement *next;
-  int32 fx;  // f(x) = h(x) + g(x): cost function for A* search
-  int32 gx;  // g(x)
-  // transition cost part of g(x).
-  // Do not take the transition costs to edge nodes.
-  int32 structure_gx;
-  int32 w_gx;
-};
-
-const NBestGenerator::QueueElement *NBestGenerator::CreateNewElement(
-    const Node *node, const QueueElement *next, int32 fx, int32 gx,
-    int32 structure_gx, int32 w_gx) {
-  QueueElement *elm = freelist_.Alloc();
-  DCHECK(elm);
-  elm->node = node;
-  elm->next = next;
-  elm->fx = fx;
-  elm->gx = gx;
-  elm->structure_gx = structure_gx;
-  elm->w_gx = w_gx;
-  return elm;
+void NBestGenerator::PushElement(const QueueElement &element) {
+  const int32 index = static_cast<int32>(elements_.size());
+  elements_.push_back(element);
+  agenda_.Push(element.fx, index);
 }
 
-struct NBestGenerator::QueueElementComparator {
-  bool operator()(const NBestGenerator::QueueElement *q1,
-                  const NBestGenerator::QueueElement *q2) const {
-    return (q1->fx > q2->fx);
+struct NBestGenerator::Agenda::EntryComparator {
+  bool operator()(const Entry &e1, const Entry &e2) const {
+    return (e1.fx > e2.fx);
   }
 };
 
-inline void NBestGenerator::Agenda::Push(
-    const NBestGenerator::QueueElement *element) {
-  priority_queue_.push_back(element);
+inline void NBestGenerator::Agenda::Push(int32 fx, int32 index) {
+  priority_queue_.push_back(Entry{fx, index});
   std::push_heap(priority_queue_.begin(), priority_queue_.end(),
-                 QueueElementComparator());
+                 EntryComparator());
 }
 
 inline void NBestGenerator::Agenda::Pop() {
   DCHECK(!priority_queue_.empty());
   std::pop_heap(priority_queue_.begin(), priority_queue_.end(),
-                QueueElementComparator());
+                EntryComparator());
   priority_queue_.pop_back();
 }
 
@@ -116,11 +96,12 @@ NBestGenerator::NBestGenerator(const SuppressionDictionary *suppression_dic,
       lattice_(lattice),
       begin_node_(nullptr),
       end_node_(nullptr),
-      freelist_(kFreeListSize),
       filter_(new CandidateFilter(suppression_dic, pos_matcher,
                                   suggestion_filter,
                                   apply_suggestion_filter_for_exact_match)),
       viterbi_result_checked_(false),
+      num_expansions_(0),
+      max_expansions_(0),
       check_mode_(STRICT),
       boundary_checker_(nullptr) {
   DCHECK(suppression_dictionary_);
@@ -131,7 +112,8 @@ NBestGenerator::NBestGenerator(const SuppressionDictionary *suppression_dic,
     return;
   }
 
-  agenda_.Reserve(kFreeListSize);
+  agenda_.Reserve(kInitialAgendaSize);
+  elements_.reserve(kInitialAgendaSize);
 }
 
 NBestGenerator::~NBestGenerator() {}
@@ -139,9 +121,10 @@ NBestGenerator::~NBestGenerator() {}
 void NBestGenerator::Reset(const Node *begin_node, const Node *end_node,
                            const BoundaryCheckMode mode) {
   agenda_.Clear();
-  freelist_.Free();
+  elements_.clear();
   filter_->Reset();
   viterbi_result_checked_ = false;
+  num_expansions_ = 0;
   check_mode_ = mode;
 
   begin_node_ = begin_node;
@@ -153,7 +136,7 @@ void NBestGenerator::Reset(const Node *begin_node, const Node *end_node,
                               node->cost - end_node_->cost <= kCostDiff &&
                               node->prev != end_node_->prev)) {
       // Push "EOS" nodes.
-      agenda_.Push(CreateNewElement(node, nullptr, node->cost, 0, 0, 0));
+      PushElement(QueueElement{node, -1, node->cost, 0, 0, 0});
     }
   }
 
@@ -189,14 +172,15 @@ void NBestGenerator::MakeCandidate(
   for (size_t i = 0; i < nodes.size(); ++i) {
     const Node *node = nodes[i];
     DCHECK(node != nullptr);
+    // The strings of the nodes are materialized here.
     if (!is_functional && !pos_matcher_->IsFunctional(node->lid)) {
-      candidate->content_value += node->value;
-      candidate->content_key += node->key;
+      absl::StrAppend(&candidate->content_value, node->value);
+      absl::StrAppend(&candidate->content_key, node->key);
     } else {
       is_functional = true;
     }
-    candidate->key += node->key;
-    candidate->value += node->value;
+    absl::StrAppend(&candidate->key, node->key);
+    absl::StrAppend(&candidate->value, node->value);
 
     if (node->constrained_prev != nullptr ||
         (node->next != nullptr && node->next->constrained_prev == node)) {
@@ -332,27 +316,33 @@ bool NBestGenerator::Next(const std::string &original_key,
   int num_trials = 0;
 
   while (!agenda_.IsEmpty()) {
-    const QueueElement *top = agenda_.Top();
-    DCHECK(top);
+    const int32 top_index = agenda_.Top().index;
     agenda_.Pop();
-    const Node *rnode = top->node;
+    // Copy the element as |elements_| can be reallocated below.
+    const QueueElement top = elements_[top_index];
+    const Node *rnode = top.node;
     CHECK(rnode);
 
     if (num_trials++ > KMaxTrial) {  // too many trials
       VLOG(2) << "too many trials: " << num_trials;
       return false;
     }
+    if (max_expansions_ > 0 && ++num_expansions_ > max_expansions_) {
+      VLOG(2) << "expansion budget is used up: " << max_expansions_;
+      agenda_.Clear();
+      return false;
+    }
 
     // reached to the goal.
     if (rnode->end_pos == begin_node_->end_pos) {
       nodes_.clear();
-      for (const QueueElement *elm = top->next; elm->next != nullptr;
-           elm = elm->next) {
-        nodes_.push_back(elm->node);
+      for (int32 i = top.next; elements_[i].next != -1;
+           i = elements_[i].next) {
+        nodes_.push_back(elements_[i].node);
       }
       CHECK(!nodes_.empty());
 
-      MakeCandidate(candidate, top->gx, top->structure_gx, top->w_gx, nodes_);
+      MakeCandidate(candidate, top.gx, top.structure_gx, top.w_gx, nodes_);
       const int filter_result = filter_->FilterCandidate(
           original_key, candidate, nodes_, request_type);
       nodes_.clear();
@@ -368,7 +358,8 @@ bool NBestGenerator::Next(const std::string &original_key,
           // do nothing
       }
     } else {
-      const QueueElement *best_left_elm = nullptr;
+      // |best_left_elm.node| is nullptr until a left edge node is found.
+      QueueElement best_left_elm = {nullptr, -1, 0, 0, 0, 0};
       const bool is_right_edge = rnode->begin_pos == end_node_->begin_pos;
       const bool is_left_edge = rnode->begin_pos == begin_node_->end_pos;
       DCHECK(!(is_right_edge && is_left_edge));
@@ -457,29 +448,29 @@ bool NBestGenerator::Next(const std::string &original_key,
           wcost_diff += kWeakConnectedPenalty / 2;
         }
 
-        const int32 gx = cost_diff + top->gx;
+        const int32 gx = cost_diff + top.gx;
         // |lnode->cost| is heuristics function of A* search, h(x).
         // After Viterbi search, we already know an exact value of h(x).
         const int32 fx = lnode->cost + gx;
-        const int32 structure_gx = structure_cost_diff + top->structure_gx;
-        const int32 w_gx = wcost_diff + top->w_gx;
+        const int32 structure_gx = structure_cost_diff + top.structure_gx;
+        const int32 w_gx = wcost_diff + top.w_gx;
+        const QueueElement element = {lnode, top_index,    fx,
+                                      gx,    structure_gx, w_gx};
         if (is_left_edge) {
           // We only need to only 1 left node here.
           // Even if expand all left nodes, all the |value| part should
           // be identical. Here, we simply use the best left edge node.
           // This hack reduces the number of redundant calls of pop().
-          if (best_left_elm == nullptr || best_left_elm->fx > fx) {
-            best_left_elm =
-                CreateNewElement(lnode, top, fx, gx, structure_gx, w_gx);
+          if (best_left_elm.node == nullptr || best_left_elm.fx > fx) {
+            best_left_elm = element;
           }
         } else {
-          agenda_.Push(
-              CreateNewElement(lnode, top, fx, gx, structure_gx, w_gx));
+          PushElement(element);
         }
       }
 
-      if (best_left_elm != nullptr) {
-        agenda_.Push(best_left_elm);
+      if (best_left_elm.node != nullptr) {
+        PushElement(best_left_elm);
       }
     }
   }
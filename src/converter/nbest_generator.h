@@ -34,7 +34,6 @@
 #include <string>
 #include <vector>
 
-#include "base/freelist.h"
 #include "base/port.h"
 #include "converter/candidate_filter.h"
 #include "converter/segments.h"
@@ -92,6 +91,15 @@ class NBestGenerator {
   void Reset(const Node *begin_node, const Node *end_node,
              const BoundaryCheckMode mode);
 
+  // Sets the maximum number of the search steps after Reset().  Next()
+  // returns false once the budget is used up, so that the latency of
+  // enumerating many candidates is bounded.  By default, or if
+  // |max_expansions| is not positive, only the number of the steps in each
+  // Next() call is bounded.
+  void set_max_expansions(int max_expansions) {
+    max_expansions_ = max_expansions;
+  }
+
   // Iterator:
   // Can obtain N-best results by calling Next() in sequence.
   bool Next(const std::string &original_key, Segment::Candidate *candidate,
@@ -108,26 +116,45 @@ class NBestGenerator {
                                                                  const Node *,
                                                                  bool) const;
 
-  struct QueueElement;
-  struct QueueElementComparator;
+  // An element of the A* search, i.e., a partial path from the end node.
+  // The elements are stored in |elements_| and refer to each other by index.
+  struct QueueElement {
+    const Node *node;
+    // Index of the next (right) element in |elements_|, or -1.
+    int32 next;
+    int32 fx;  // f(x) = h(x) + g(x): cost function for A* search
+    int32 gx;  // g(x)
+    // transition cost part of g(x).
+    // Do not take the transition costs to edge nodes.
+    int32 structure_gx;
+    int32 w_gx;
+  };
 
-  // This is just a priority_queue of const QueueElement*, but supports
-  // more operations in addition to std::priority_queue.
+  // Priority queue of the indices of |elements_| ordered by f(x).  The keys
+  // are copied next to the indices so that the heap operations don't touch
+  // the elements themselves.
   class Agenda {
    public:
+    struct Entry {
+      int32 fx;
+      int32 index;
+    };
+
     Agenda() {}
     ~Agenda() {}
 
-    const QueueElement *Top() const { return priority_queue_.front(); }
+    const Entry &Top() const { return priority_queue_.front(); }
     bool IsEmpty() const { return priority_queue_.empty(); }
     void Clear() { priority_queue_.clear(); }
     void Reserve(int size) { priority_queue_.reserve(size); }
 
-    void Push(const QueueElement *element);
+    void Push(int32 fx, int32 index);
     void Pop();
 
    private:
-    std::vector<const QueueElement *> priority_queue_;
+    struct EntryComparator;
+
+    std::vector<Entry> priority_queue_;
 
     DISALLOW_COPY_AND_ASSIGN(Agenda);
   };
@@ -150,11 +177,8 @@ class NBestGenerator {
 
   int GetTransitionCost(const Node *lnode, const Node *rnode) const;
 
-  // Create queue element from freelist
-  const QueueElement *CreateNewElement(const Node *node,
-                                       const QueueElement *next, int32 fx,
-                                       int32 gx, int32 structure_gx,
-                                       int32 w_gx);
+  // Appends |element| to |elements_| and pushes it to the agenda.
+  void PushElement(const QueueElement &element);
 
   // References to relevant modules.
   const dictionary::SuppressionDictionary *suppression_dictionary_;
@@ -167,10 +191,14 @@ class NBestGenerator {
   const Node *end_node_;
 
   Agenda agenda_;
-  FreeList<QueueElement> freelist_;
+  std::vector<QueueElement> elements_;
   std::vector<const Node *> nodes_;
   std::unique_ptr<converter::CandidateFilter> filter_;
   bool viterbi_result_checked_;
+  // The number of elements popped from the agenda since Reset(), counted only
+  // if |max_expansions_| is positive.
+  int num_expansions_;
+  int max_expansions_;
   BoundaryCheckMode check_mode_;
 
   BoundaryChecker boundary_checker_;
@@ -291,6 +291,50 @@ TEST_F(NBestGeneratorTest, SingleSegmentConnectionTest) {
   }
 }
 
+TEST_F(NBestGeneratorTest, ExpansionBudget) {
+  auto data_and_converter = absl::make_unique<MockDataAndImmutableConverter>();
+  ImmutableConverterImpl *converter = data_and_converter->GetConverter();
+
+  Segments segments;
+  segments.set_request_type(Segments::CONVERSION);
+  const std::string kText = "わたしのなまえはなかのです";
+  segments.add_segment()->set_key(kText);
+
+  Lattice lattice;
+  lattice.SetKey(kText);
+  const ConversionRequest request;
+  converter->MakeLattice(request, &segments, &lattice);
+
+  std::vector<uint16> group;
+  converter->MakeGroup(segments, &group);
+  converter->Viterbi(segments, &lattice);
+
+  std::unique_ptr<NBestGenerator> nbest_generator =
+      data_and_converter->CreateNBestGenerator(&lattice);
+
+  const bool kSingleSegment = true;
+  const Node *begin_node = lattice.bos_nodes();
+  const Node *end_node =
+      GetEndNode(*converter, segments, *begin_node, group, kSingleSegment);
+
+  // The Viterbi best result doesn't need the search.
+  nbest_generator->set_max_expansions(1);
+  nbest_generator->Reset(begin_node, end_node, NBestGenerator::ONLY_EDGE);
+  Segment result_segment;
+  GatherCandidates(10, Segments::CONVERSION, nbest_generator.get(),
+                   &result_segment);
+  ASSERT_EQ(1, result_segment.candidates_size());
+  EXPECT_EQ("私の名前は中ノです", result_segment.candidate(0).value);
+
+  // The budget is renewed by Reset().
+  nbest_generator->set_max_expansions(10000);
+  nbest_generator->Reset(begin_node, end_node, NBestGenerator::ONLY_EDGE);
+  result_segment.Clear();
+  GatherCandidates(10, Segments::CONVERSION, nbest_generator.get(),
+                   &result_segment);
+  EXPECT_LT(1, result_segment.candidates_size());
+}
+
 TEST_F(NBestGeneratorTest, InnerSegmentBoundary) {
   auto data_and_converter = absl::make_unique<MockDataAndImmutableConverter>();
   ImmutableConverterImpl *converter = data_and_converter->GetConverter();
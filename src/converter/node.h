@@ -30,10 +30,9 @@
 #ifndef MOZC_CONVERTER_NODE_H_
 #define MOZC_CONVERTER_NODE_H_
 
-#include <string>
-
 #include "base/port.h"
 #include "dictionary/dictionary_token.h"
+#include "absl/strings/string_view.h"
 
 namespace mozc {
 
@@ -176,9 +175,12 @@ struct Node {
   // actual_key: The actual search key that corresponds to the value.
   //           Can differ from key when no modifier conversion is enabled.
   // value: The surface form of the word.
-  std::string key;
-  std::string actual_key;
-  std::string value;
+  // The strings are owned by the NodeAllocator which created the node, see
+  // NodeAllocator::NewString(), or are string literals.  They are copied to
+  // std::string only when the node becomes a Segment::Candidate.
+  absl::string_view key;
+  absl::string_view actual_key;
+  absl::string_view value;
 
   Node() { Init(); }
 
@@ -197,11 +199,13 @@ struct Node {
     cost = 0;
     raw_wcost = 0;
     attributes = 0;
-    key.clear();
-    actual_key.clear();
-    value.clear();
+    key = absl::string_view();
+    actual_key = absl::string_view();
+    value = absl::string_view();
   }
 
+  // Initializes the node with |token| except for the strings, which need to
+  // be copied to the storage of the allocator by the caller.
   inline void InitFromToken(const dictionary::Token &token) {
     prev = nullptr;
     next = nullptr;
@@ -227,9 +231,9 @@ struct Node {
       attributes |= USER_DICTIONARY;
       attributes |= NO_VARIANTS_EXPANSION;
     }
-    key = token.key;
-    actual_key.clear();
-    value = token.value;
+    key = absl::string_view();
+    actual_key = absl::string_view();
+    value = absl::string_view();
   }
 };
 
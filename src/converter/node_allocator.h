@@ -30,17 +30,40 @@
 #ifndef MOZC_CONVERTER_NODE_ALLOCATOR_H_
 #define MOZC_CONVERTER_NODE_ALLOCATOR_H_
 
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <vector>
+
 #include "base/freelist.h"
 #include "base/logging.h"
 #include "base/port.h"
 #include "converter/node.h"
+#include "absl/strings/string_view.h"
 
 namespace mozc {
 
+// Arena of Node instances and of their strings.  The nodes and the strings
+// are allocated from chunks which are reused after Reset(), so that a lattice
+// built for every keystroke doesn't go to the heap once the allocator has
+// grown to the size of the largest conversion.
 class NodeAllocator {
  public:
+  // The number of nodes in a chunk.
+  static constexpr size_t kChunkSize = 1024;
+  // The number of bytes in a chunk for strings.
+  static constexpr size_t kStringChunkSize = 64 * 1024;
+  // The default limit of the number of nodes for a lookup.
+  static constexpr size_t kDefaultMaxNodesSize = 8192;
+
   NodeAllocator()
-      : node_freelist_(1024), max_nodes_size_(8192), node_count_(0) {}
+      : node_freelist_(kChunkSize),
+        string_freelist_(kStringChunkSize),
+        max_nodes_size_(kDefaultMaxNodesSize),
+        node_count_(0),
+        string_bytes_(0),
+        peak_node_count_(0),
+        peak_bytes_(0) {}
   ~NodeAllocator() {}
 
   Node *NewNode() {
@@ -51,10 +74,44 @@ class NodeAllocator {
     return node;
   }
 
-  // Frees all nodes allocateed by NewNode().
+  // Copies |str| to the storage of this allocator and returns the copy, which
+  // is valid until Reset() or Free().  Nodes refer to their strings through it.
+  absl::string_view NewString(absl::string_view str) {
+    if (str.empty()) {
+      return absl::string_view();
+    }
+    char *buf = nullptr;
+    if (str.size() < kStringChunkSize) {
+      buf = string_freelist_.Alloc(str.size());
+    } else {
+      large_strings_.emplace_back(new char[str.size()]);
+      buf = large_strings_.back().get();
+    }
+    memcpy(buf, str.data(), str.size());
+    string_bytes_ += str.size();
+    return absl::string_view(buf, str.size());
+  }
+
+  // Invalidates all nodes and strings allocated by this instance in O(1).  The
+  // chunks are kept for the next allocations.
+  void Reset() {
+    UpdatePeak();
+    node_freelist_.Reset();
+    string_freelist_.Reset();
+    large_strings_.clear();
+    node_count_ = 0;
+    string_bytes_ = 0;
+  }
+
+  // Frees all nodes and strings allocated by this instance and releases the
+  // chunks except for the first one.
   void Free() {
+    UpdatePeak();
     node_freelist_.Free();
+    string_freelist_.Free();
+    large_strings_.clear();
     node_count_ = 0;
+    string_bytes_ = 0;
   }
 
   size_t max_nodes_size() const { return max_nodes_size_; }
@@ -63,12 +120,44 @@ class NodeAllocator {
     max_nodes_size_ = max_nodes_size;
   }
 
+  // Returns the number of nodes allocated since the last Reset() or Free(),
+  // i.e., in the current conversion.
   size_t node_count() const { return node_count_; }
 
+  // Returns the bytes of the nodes and the strings allocated in the current
+  // conversion.
+  size_t allocated_bytes() const {
+    return node_count_ * sizeof(Node) + string_bytes_;
+  }
+
+  // Returns the largest node_count() / allocated_bytes() of the conversions so
+  // far, including the current one.
+  size_t peak_node_count() const {
+    return std::max(peak_node_count_, node_count_);
+  }
+  size_t peak_bytes() const { return std::max(peak_bytes_, allocated_bytes()); }
+
+  // Returns the bytes of the chunks kept by this allocator.
+  size_t capacity_bytes() const {
+    return node_freelist_.chunk_count() * kChunkSize * sizeof(Node) +
+           string_freelist_.chunk_count() * kStringChunkSize;
+  }
+
  private:
+  void UpdatePeak() {
+    peak_node_count_ = peak_node_count();
+    peak_bytes_ = peak_bytes();
+  }
+
   FreeList<Node> node_freelist_;
+  FreeList<char> string_freelist_;
+  // Strings not fitting in a chunk of |string_freelist_|.
+  std::vector<std::unique_ptr<char[]>> large_strings_;
   size_t max_nodes_size_;
   size_t node_count_;
+  size_t string_bytes_;
+  size_t peak_node_count_;
+  size_t peak_bytes_;
 
   DISALLOW_COPY_AND_ASSIGN(NodeAllocator);
 };
@@ -0,0 +1,128 @@
+// Copyright 2010-2020, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "converter/node_allocator.h"
+
+#include <string>
+
+#include "base/port.h"
+#include "converter/node.h"
+#include "testing/base/public/gunit.h"
+#include "absl/strings/string_view.h"
+
+namespace mozc {
+namespace {
+
+TEST(NodeAllocatorTest, NewNode) {
+  NodeAllocator allocator;
+  EXPECT_EQ(NodeAllocator::kDefaultMaxNodesSize, allocator.max_nodes_size());
+  EXPECT_EQ(0, allocator.node_count());
+  EXPECT_EQ(0, allocator.allocated_bytes());
+
+  Node *node = allocator.NewNode();
+  ASSERT_NE(nullptr, node);
+  EXPECT_EQ(1, allocator.node_count());
+  EXPECT_EQ(sizeof(Node), allocator.allocated_bytes());
+  EXPECT_EQ(NodeAllocator::kChunkSize * sizeof(Node),
+            allocator.capacity_bytes());
+}
+
+TEST(NodeAllocatorTest, ResetKeepsCapacity) {
+  NodeAllocator allocator;
+  for (size_t i = 0; i < 3 * NodeAllocator::kChunkSize; ++i) {
+    allocator.NewNode()->value = "value";
+  }
+  const size_t capacity = allocator.capacity_bytes();
+  EXPECT_LT(3 * NodeAllocator::kChunkSize * sizeof(Node) - 1, capacity);
+
+  allocator.Reset();
+  EXPECT_EQ(0, allocator.node_count());
+  EXPECT_EQ(capacity, allocator.capacity_bytes());
+
+  // Reused nodes are initialized.
+  Node *node = allocator.NewNode();
+  EXPECT_TRUE(node->value.empty());
+  EXPECT_EQ(nullptr, node->bnext);
+  for (size_t i = 1; i < 3 * NodeAllocator::kChunkSize; ++i) {
+    allocator.NewNode();
+  }
+  EXPECT_EQ(capacity, allocator.capacity_bytes());
+
+  allocator.Free();
+  EXPECT_EQ(0, allocator.node_count());
+  EXPECT_EQ(NodeAllocator::kChunkSize * sizeof(Node),
+            allocator.capacity_bytes());
+}
+
+TEST(NodeAllocatorTest, NewString) {
+  NodeAllocator allocator;
+  std::string str = "key";
+  const absl::string_view copy = allocator.NewString(str);
+  str = "modified";
+  EXPECT_EQ("key", copy);
+  EXPECT_EQ(3, allocator.allocated_bytes());
+  EXPECT_TRUE(allocator.NewString("").empty());
+
+  // A string longer than a chunk is allocated separately.
+  const std::string large(NodeAllocator::kStringChunkSize + 1, 'a');
+  EXPECT_EQ(large, allocator.NewString(large));
+  EXPECT_EQ(3 + large.size(), allocator.allocated_bytes());
+  EXPECT_EQ(NodeAllocator::kStringChunkSize, allocator.capacity_bytes());
+
+  allocator.Reset();
+  EXPECT_EQ(0, allocator.allocated_bytes());
+  EXPECT_EQ("value", allocator.NewString("value"));
+  EXPECT_EQ(NodeAllocator::kStringChunkSize, allocator.capacity_bytes());
+}
+
+TEST(NodeAllocatorTest, PeakStats) {
+  NodeAllocator allocator;
+  for (int i = 0; i < 10; ++i) {
+    allocator.NewNode();
+  }
+  EXPECT_EQ(10, allocator.peak_node_count());
+  EXPECT_EQ(10 * sizeof(Node), allocator.peak_bytes());
+
+  allocator.Reset();
+  for (int i = 0; i < 5; ++i) {
+    allocator.NewNode();
+  }
+  EXPECT_EQ(5, allocator.node_count());
+  EXPECT_EQ(10, allocator.peak_node_count());
+
+  allocator.Reset();
+  for (int i = 0; i < 20; ++i) {
+    allocator.NewNode();
+  }
+  EXPECT_EQ(20, allocator.peak_node_count());
+  EXPECT_EQ(20 * sizeof(Node), allocator.peak_bytes());
+}
+
+}  // namespace
+}  // namespace mozc
@@ -79,6 +79,8 @@ class BaseNodeListBuilder : public dictionary::DictionaryInterface::Callback {
   Node *NewNodeFromToken(const dictionary::Token &token) {
     Node *new_node = allocator_->NewNode();
     new_node->InitFromToken(token);
+    new_node->key = allocator_->NewString(token.key);
+    new_node->value = allocator_->NewString(token.value);
     new_node->wcost += penalty_;
     return new_node;
   }
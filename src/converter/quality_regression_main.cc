@@ -40,6 +40,10 @@
 #include "engine/engine_interface.h"
 
 DEFINE_string(test_file, "", "regression test file");
+DEFINE_int32(viterbi_beam_width, 0,
+             "If positive, each item is also converted with the beam-pruned "
+             "Viterbi search of this width, and the results are compared with "
+             "the exhaustive search.");
 
 using mozc::EngineFactory;
 using mozc::EngineInterface;
@@ -54,15 +58,41 @@ int main(int argc, char **argv) {
   std::vector<QualityRegressionUtil::TestItem> items;
   QualityRegressionUtil::ParseFile(FLAGS_test_file, &items);
 
+  size_t num_ok = 0;
+  size_t num_beam_ok = 0;
+  size_t num_beam_diff = 0;
   for (size_t i = 0; i < items.size(); ++i) {
     std::string actual_value;
+    util.SetViterbiBeamWidth(0);
     const bool result = util.ConvertAndTest(items[i], &actual_value);
     if (result) {
+      ++num_ok;
       std::cout << "OK:\t" << items[i].OutputAsTSV() << std::endl;
     } else {
       std::cout << "FAILED:\t" << items[i].OutputAsTSV() << "\t" << actual_value
                 << std::endl;
     }
+
+    if (FLAGS_viterbi_beam_width <= 0) {
+      continue;
+    }
+    std::string beam_value;
+    util.SetViterbiBeamWidth(FLAGS_viterbi_beam_width);
+    if (util.ConvertAndTest(items[i], &beam_value)) {
+      ++num_beam_ok;
+    }
+    if (beam_value != actual_value) {
+      ++num_beam_diff;
+      std::cout << "BEAM_DIFF:\t" << items[i].OutputAsTSV() << "\t"
+                << actual_value << "\t" << beam_value << std::endl;
+    }
+  }
+
+  if (FLAGS_viterbi_beam_width > 0) {
+    std::cout << "SUMMARY:\texhaustive=" << num_ok << "/" << items.size()
+              << "\tbeam(" << FLAGS_viterbi_beam_width << ")=" << num_beam_ok
+              << "/" << items.size() << "\tdiff=" << num_beam_diff
+              << std::endl;
   }
 
   return 0;
@@ -152,7 +152,8 @@ QualityRegressionUtil::QualityRegressionUtil(ConverterInterface *converter)
     : converter_(converter),
       request_(new commands::Request),
       config_(new config::Config),
-      segments_(new Segments) {}
+      segments_(new Segments),
+      viterbi_beam_width_(0) {}
 
 QualityRegressionUtil::~QualityRegressionUtil() {}
 
@@ -200,6 +201,7 @@ bool QualityRegressionUtil::ConvertAndTest(const TestItem &item,
     composer::Composer composer(&table, request_.get(), config_.get());
     composer.SetPreeditTextForTestOnly(key);
     ConversionRequest request(&composer, request_.get(), config_.get());
+    request.set_viterbi_beam_width(viterbi_beam_width_);
     converter_->StartConversionForRequest(request, segments_.get());
   } else if (command == kReverseConversionExpect ||
              command == kReverseConversionNotExpect) {
@@ -208,11 +210,13 @@ bool QualityRegressionUtil::ConvertAndTest(const TestItem &item,
     composer::Composer composer(&table, request_.get(), config_.get());
     composer.SetPreeditTextForTestOnly(key);
     ConversionRequest request(&composer, request_.get(), config_.get());
+    request.set_viterbi_beam_width(viterbi_beam_width_);
     converter_->StartPredictionForRequest(request, segments_.get());
   } else if (command == kSuggestionExpect || command == kSuggestionNotExpect) {
     composer::Composer composer(&table, request_.get(), config_.get());
     composer.SetPreeditTextForTestOnly(key);
     ConversionRequest request(&composer, request_.get(), config_.get());
+    request.set_viterbi_beam_width(viterbi_beam_width_);
     converter_->StartSuggestionForRequest(request, segments_.get());
   } else {
     LOG(FATAL) << "Unknown command: " << command;
@@ -251,6 +255,10 @@ void QualityRegressionUtil::SetConfig(const config::Config &config) {
   *config_ = config;
 }
 
+void QualityRegressionUtil::SetViterbiBeamWidth(size_t width) {
+  viterbi_beam_width_ = width;
+}
+
 std::string QualityRegressionUtil::GetPlatformString(uint32 platform_bitfiled) {
   std::vector<std::string> v;
   if (platform_bitfiled & DESKTOP) {
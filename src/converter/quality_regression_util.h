@@ -82,6 +82,8 @@ class QualityRegressionUtil {
 
   void SetRequest(const commands::Request &request);
   void SetConfig(const config::Config &config);
+  // Sets ConversionRequest::viterbi_beam_width() used for the conversions.
+  void SetViterbiBeamWidth(size_t width);
   static std::string GetPlatformString(uint32 platform_bitfiled);
 
  private:
@@ -89,6 +91,7 @@ class QualityRegressionUtil {
   std::unique_ptr<commands::Request> request_;
   std::unique_ptr<config::Config> config_;
   std::unique_ptr<Segments> segments_;
+  size_t viterbi_beam_width_;
 
   DISALLOW_COPY_AND_ASSIGN(QualityRegressionUtil);
 };
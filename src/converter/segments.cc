@@ -685,6 +685,11 @@ Segments::RevertEntry *Segments::mutable_revert_entry(size_t i) {
 
 Lattice *Segments::mutable_cached_lattice() { return cached_lattice_.get(); }
 
+void Segments::SwapCachedLattice(Segments *other) {
+  DCHECK(other);
+  cached_lattice_.swap(other->cached_lattice_);
+}
+
 std::string Segments::DebugString() const {
   std::stringstream os;
   os << "{" << std::endl;
@@ -496,6 +496,9 @@ class Segments {
 
   // setter
   Lattice *mutable_cached_lattice();
+  // Exchanges the cached lattice with |other|.  CopyFrom() doesn't copy the
+  // lattice, so this lets a copy reuse the lattice of the original.
+  void SwapCachedLattice(Segments *other);
 
   Segments();
   virtual ~Segments();
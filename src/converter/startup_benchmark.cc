@@ -0,0 +1,162 @@
+// Copyright 2010-2020, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+// Measures the startup latency of the converter on the OSS data set: the time
+// from mapping the data set to the end of the first conversion, with the page
+// cache of the data file dropped (COLD) or kept (WARM), under several
+// combinations of the --data_set_* memory hints of DataManager.
+
+#include <chrono>  // NOLINT
+#include <memory>
+#include <string>
+#include <utility>
+
+#if defined(OS_LINUX) || defined(OS_ANDROID)
+#include <fcntl.h>
+#include <unistd.h>
+#endif  // OS_LINUX || OS_ANDROID
+
+#include "base/flags.h"
+#include "base/logging.h"
+#include "converter/converter_interface.h"
+#include "converter/segments.h"
+#include "data_manager/data_manager.h"
+#include "engine/engine.h"
+#include "testing/base/public/mozctest.h"
+#include "absl/memory/memory.h"
+#include "benchmark/benchmark.h"
+
+DECLARE_bool(data_set_populate);
+DECLARE_bool(data_set_will_need);
+DECLARE_bool(data_set_huge_pages);
+DECLARE_bool(data_set_pin_hot_sections);
+
+namespace mozc {
+namespace {
+
+enum PageCache {
+  COLD = 0,
+  WARM = 1,
+};
+
+// Bit set of memory hints.
+enum MemoryHint {
+  NO_HINT = 0,
+  POPULATE = 1,
+  WILL_NEED = 2,
+  HUGE_PAGES = 4,
+  PIN_HOT_SECTIONS = 8,
+};
+
+constexpr char kFirstKey[] = "きょうはいいてんきです";
+
+std::string GetDataFilePath() {
+  return testing::GetSourcePath({"data_manager", "oss", "mozc.data"});
+}
+
+// Drops the clean pages of |path| from the page cache so that the next mapping
+// reads the file from the storage.  This is a no-op on platforms without
+// posix_fadvise(), where COLD is the same as WARM.
+void EvictFromPageCache(const std::string &path) {
+#if defined(OS_LINUX) || defined(OS_ANDROID)
+  const int fd = ::open(path.c_str(), O_RDONLY);
+  CHECK_GE(fd, 0) << "Cannot open " << path;
+  ::fdatasync(fd);
+  ::posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+  ::close(fd);
+#endif  // OS_LINUX || OS_ANDROID
+}
+
+double ElapsedMillis(std::chrono::steady_clock::time_point begin,
+                     std::chrono::steady_clock::time_point end) {
+  return std::chrono::duration<double, std::milli>(end - begin).count();
+}
+
+// Iteration time is the whole startup; the "first_conversion_ms" counter
+// reports the first StartConversion() alone, where the page faults in the
+// tries, the token array and the connection matrix show up.
+void BM_Startup(benchmark::State &state) {
+  const PageCache page_cache = static_cast<PageCache>(state.range(0));
+  const int hints = state.range(1);
+  mozc::SetFlag(&FLAGS_data_set_populate, (hints & POPULATE) != 0);
+  mozc::SetFlag(&FLAGS_data_set_will_need, (hints & WILL_NEED) != 0);
+  mozc::SetFlag(&FLAGS_data_set_huge_pages, (hints & HUGE_PAGES) != 0);
+  mozc::SetFlag(&FLAGS_data_set_pin_hot_sections,
+                (hints & PIN_HOT_SECTIONS) != 0);
+
+  const testing::ScopedTmpUserProfileDirectory scoped_profile_dir;
+  const std::string path = GetDataFilePath();
+  double first_conversion_ms = 0.0;
+  for (auto _ : state) {
+    state.PauseTiming();
+    if (page_cache == COLD) {
+      EvictFromPageCache(path);
+    }
+    state.ResumeTiming();
+
+    auto data_manager = absl::make_unique<DataManager>();
+    // The OSS data set has the default magic number of DataManager.
+    CHECK_EQ(DataManager::Status::OK, data_manager->InitFromFile(path));
+    std::unique_ptr<Engine> engine =
+        Engine::CreateDesktopEngine(std::move(data_manager)).value();
+    ConverterInterface *converter = engine->GetConverter();
+
+    Segments segments;
+    const auto begin = std::chrono::steady_clock::now();
+    CHECK(converter->StartConversion(&segments, kFirstKey));
+    first_conversion_ms +=
+        ElapsedMillis(begin, std::chrono::steady_clock::now());
+
+    // Unmapping the data set is not a part of startup.
+    state.PauseTiming();
+    engine.reset();
+    state.ResumeTiming();
+  }
+  state.counters["first_conversion_ms"] = benchmark::Counter(
+      first_conversion_ms, benchmark::Counter::kAvgIterations);
+
+  mozc::SetFlag(&FLAGS_data_set_populate, false);
+  mozc::SetFlag(&FLAGS_data_set_will_need, false);
+  mozc::SetFlag(&FLAGS_data_set_huge_pages, false);
+  mozc::SetFlag(&FLAGS_data_set_pin_hot_sections, false);
+}
+BENCHMARK(BM_Startup)
+    ->Unit(benchmark::kMillisecond)
+    ->Args({COLD, NO_HINT})
+    ->Args({WARM, NO_HINT})
+    ->Args({COLD, POPULATE})
+    ->Args({WARM, POPULATE})
+    ->Args({COLD, WILL_NEED})
+    ->Args({COLD, HUGE_PAGES})
+    ->Args({COLD, POPULATE | PIN_HOT_SECTIONS})
+    ->Args({COLD, POPULATE | HUGE_PAGES | PIN_HOT_SECTIONS});
+
+}  // namespace
+}  // namespace mozc
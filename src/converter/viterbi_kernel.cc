@@ -0,0 +1,228 @@
+// Copyright 2010-2020, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "converter/viterbi_kernel.h"
+
+#include <limits>
+
+#include "base/logging.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define MOZC_VITERBI_KERNEL_X86
+#include <immintrin.h>
+#endif  // __GNUC__ && (__x86_64__ || __i386__)
+
+namespace mozc {
+namespace {
+
+constexpr int32 kInfinity = std::numeric_limits<int32>::max();
+
+typedef int (*FindMinCostIndexFunc)(const int32 *lcosts,
+                                    const int32 *transition_costs, size_t size,
+                                    int32 *min_cost);
+
+// Scans [begin, size) sequentially, updating |best_index| and |min_cost| only
+// when a strictly smaller cost is found.
+inline void ScanScalar(const int32 *lcosts, const int32 *transition_costs,
+                       size_t begin, size_t size, int *best_index,
+                       int32 *min_cost) {
+  for (size_t i = begin; i < size; ++i) {
+    const int32 cost = lcosts[i] + transition_costs[i];
+    if (cost < *min_cost) {
+      *min_cost = cost;
+      *best_index = static_cast<int>(i);
+    }
+  }
+}
+
+int FindMinCostIndexScalar(const int32 *lcosts, const int32 *transition_costs,
+                           size_t size, int32 *min_cost) {
+  int best_index = -1;
+  *min_cost = kInfinity;
+  ScanScalar(lcosts, transition_costs, 0, size, &best_index, min_cost);
+  return best_index;
+}
+
+#ifdef MOZC_VITERBI_KERNEL_X86
+
+// Picks the lane with the minimum cost from |lane_costs|. Ties are broken by
+// the smaller index so that the result matches the sequential scan.
+inline void ReduceLanes(const int32 *lane_costs, const int32 *lane_indices,
+                        size_t num_lanes, int *best_index, int32 *min_cost) {
+  for (size_t i = 0; i < num_lanes; ++i) {
+    if (lane_indices[i] < 0) {
+      continue;
+    }
+    if (lane_costs[i] < *min_cost ||
+        (lane_costs[i] == *min_cost && lane_indices[i] < *best_index)) {
+      *min_cost = lane_costs[i];
+      *best_index = lane_indices[i];
+    }
+  }
+}
+
+// Each lane keeps the minimum cost and the index where it first appeared.
+// Since a lane is updated only on strictly smaller costs, the index is the
+// smallest one among the indices giving the minimum in that lane.
+__attribute__((target("sse4.1"))) int FindMinCostIndexSSE41(
+    const int32 *lcosts, const int32 *transition_costs, size_t size,
+    int32 *min_cost) {
+  constexpr size_t kLanes = 4;
+  int best_index = -1;
+  *min_cost = kInfinity;
+  const size_t vector_size = size - size % kLanes;
+  if (vector_size > 0) {
+    __m128i min_costs = _mm_set1_epi32(kInfinity);
+    __m128i min_indices = _mm_set1_epi32(-1);
+    __m128i indices = _mm_setr_epi32(0, 1, 2, 3);
+    const __m128i step = _mm_set1_epi32(kLanes);
+    for (size_t i = 0; i < vector_size; i += kLanes) {
+      const __m128i costs = _mm_add_epi32(
+          _mm_loadu_si128(reinterpret_cast<const __m128i *>(lcosts + i)),
+          _mm_loadu_si128(
+              reinterpret_cast<const __m128i *>(transition_costs + i)));
+      const __m128i smaller = _mm_cmplt_epi32(costs, min_costs);
+      min_costs = _mm_min_epi32(costs, min_costs);
+      // Selects with and/andnot/or rather than _mm_blendv_epi8, whose GCC
+      // implementation misbehaves with -funsigned-char.
+      min_indices = _mm_or_si128(_mm_and_si128(smaller, indices),
+                                 _mm_andnot_si128(smaller, min_indices));
+      indices = _mm_add_epi32(indices, step);
+    }
+    alignas(16) int32 lane_costs[kLanes];
+    alignas(16) int32 lane_indices[kLanes];
+    _mm_store_si128(reinterpret_cast<__m128i *>(lane_costs), min_costs);
+    _mm_store_si128(reinterpret_cast<__m128i *>(lane_indices), min_indices);
+    ReduceLanes(lane_costs, lane_indices, kLanes, &best_index, min_cost);
+  }
+  ScanScalar(lcosts, transition_costs, vector_size, size, &best_index,
+             min_cost);
+  return best_index;
+}
+
+__attribute__((target("avx2"))) int FindMinCostIndexAVX2(
+    const int32 *lcosts, const int32 *transition_costs, size_t size,
+    int32 *min_cost) {
+  constexpr size_t kLanes = 8;
+  int best_index = -1;
+  *min_cost = kInfinity;
+  const size_t vector_size = size - size % kLanes;
+  if (vector_size > 0) {
+    __m256i min_costs = _mm256_set1_epi32(kInfinity);
+    __m256i min_indices = _mm256_set1_epi32(-1);
+    __m256i indices = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    const __m256i step = _mm256_set1_epi32(kLanes);
+    for (size_t i = 0; i < vector_size; i += kLanes) {
+      const __m256i costs = _mm256_add_epi32(
+          _mm256_loadu_si256(reinterpret_cast<const __m256i *>(lcosts + i)),
+          _mm256_loadu_si256(
+              reinterpret_cast<const __m256i *>(transition_costs + i)));
+      const __m256i smaller = _mm256_cmpgt_epi32(min_costs, costs);
+      min_costs = _mm256_min_epi32(costs, min_costs);
+      min_indices = _mm256_or_si256(_mm256_and_si256(smaller, indices),
+                                    _mm256_andnot_si256(smaller, min_indices));
+      indices = _mm256_add_epi32(indices, step);
+    }
+    alignas(32) int32 lane_costs[kLanes];
+    alignas(32) int32 lane_indices[kLanes];
+    _mm256_store_si256(reinterpret_cast<__m256i *>(lane_costs), min_costs);
+    _mm256_store_si256(reinterpret_cast<__m256i *>(lane_indices),
+                       min_indices);
+    ReduceLanes(lane_costs, lane_indices, kLanes, &best_index, min_cost);
+  }
+  ScanScalar(lcosts, transition_costs, vector_size, size, &best_index,
+             min_cost);
+  return best_index;
+}
+
+#endif  // MOZC_VITERBI_KERNEL_X86
+
+FindMinCostIndexFunc GetFunction(ViterbiKernel::Implementation implementation) {
+  switch (implementation) {
+#ifdef MOZC_VITERBI_KERNEL_X86
+    case ViterbiKernel::SSE4_1:
+      return &FindMinCostIndexSSE41;
+    case ViterbiKernel::AVX2:
+      return &FindMinCostIndexAVX2;
+#endif  // MOZC_VITERBI_KERNEL_X86
+    default:
+      return &FindMinCostIndexScalar;
+  }
+}
+
+ViterbiKernel::Implementation SelectImplementation() {
+  if (ViterbiKernel::IsAvailable(ViterbiKernel::AVX2)) {
+    return ViterbiKernel::AVX2;
+  }
+  if (ViterbiKernel::IsAvailable(ViterbiKernel::SSE4_1)) {
+    return ViterbiKernel::SSE4_1;
+  }
+  return ViterbiKernel::SCALAR;
+}
+
+}  // namespace
+
+int ViterbiKernel::FindMinCostIndex(const int32 *lcosts,
+                                    const int32 *transition_costs, size_t size,
+                                    int32 *min_cost) {
+  static const FindMinCostIndexFunc kFunc = GetFunction(GetImplementation());
+  return (*kFunc)(lcosts, transition_costs, size, min_cost);
+}
+
+ViterbiKernel::Implementation ViterbiKernel::GetImplementation() {
+  static const Implementation kImplementation = SelectImplementation();
+  return kImplementation;
+}
+
+bool ViterbiKernel::IsAvailable(Implementation implementation) {
+  switch (implementation) {
+    case SCALAR:
+      return true;
+#ifdef MOZC_VITERBI_KERNEL_X86
+    case SSE4_1:
+      __builtin_cpu_init();
+      return __builtin_cpu_supports("sse4.1");
+    case AVX2:
+      __builtin_cpu_init();
+      return __builtin_cpu_supports("avx2");
+#endif  // MOZC_VITERBI_KERNEL_X86
+    default:
+      return false;
+  }
+}
+
+int ViterbiKernel::FindMinCostIndexWithImplementation(
+    Implementation implementation, const int32 *lcosts,
+    const int32 *transition_costs, size_t size, int32 *min_cost) {
+  DCHECK(IsAvailable(implementation));
+  return (*GetFunction(implementation))(lcosts, transition_costs, size,
+                                        min_cost);
+}
+
+}  // namespace mozc
@@ -0,0 +1,77 @@
+// Copyright 2010-2020, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// Vectorized kernels used in the inner loop of the Viterbi search.
+
+#ifndef MOZC_CONVERTER_VITERBI_KERNEL_H_
+#define MOZC_CONVERTER_VITERBI_KERNEL_H_
+
+#include <cstddef>
+
+#include "base/port.h"
+
+namespace mozc {
+
+class ViterbiKernel {
+ public:
+  enum Implementation {
+    SCALAR,
+    SSE4_1,
+    AVX2,
+  };
+
+  // Returns the index i which minimizes lcosts[i] + transition_costs[i], or
+  // -1 if |size| is 0. When several indices give the minimum, the smallest one
+  // is returned, i.e., the result is the same as a sequential scan using
+  // strict "<". The minimum cost is stored to |min_cost| (INT32_MAX if |size|
+  // is 0). The best implementation available on the running CPU is used.
+  static int FindMinCostIndex(const int32 *lcosts,
+                              const int32 *transition_costs, size_t size,
+                              int32 *min_cost);
+
+  // Returns the implementation used by FindMinCostIndex().
+  static Implementation GetImplementation();
+
+  // Returns true if |implementation| can run on this CPU.
+  static bool IsAvailable(Implementation implementation);
+
+  // Same as FindMinCostIndex() but uses the given |implementation|, which
+  // must be available. Exposed for unit tests and benchmarks.
+  static int FindMinCostIndexWithImplementation(Implementation implementation,
+                                                const int32 *lcosts,
+                                                const int32 *transition_costs,
+                                                size_t size, int32 *min_cost);
+
+ private:
+  DISALLOW_IMPLICIT_CONSTRUCTORS(ViterbiKernel);
+};
+
+}  // namespace mozc
+
+#endif  // MOZC_CONVERTER_VITERBI_KERNEL_H_
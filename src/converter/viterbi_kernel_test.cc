@@ -0,0 +1,152 @@
+// Copyright 2010-2020, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "converter/viterbi_kernel.h"
+
+#include <limits>
+#include <random>
+#include <vector>
+
+#include "base/port.h"
+#include "testing/base/public/gunit.h"
+
+namespace mozc {
+namespace {
+
+constexpr ViterbiKernel::Implementation kImplementations[] = {
+    ViterbiKernel::SCALAR,
+    ViterbiKernel::SSE4_1,
+    ViterbiKernel::AVX2,
+};
+
+// Reference implementation, i.e., the loop used in Viterbi before the kernel.
+int FindMinCostIndexNaive(const std::vector<int32> &lcosts,
+                          const std::vector<int32> &transition_costs,
+                          int32 *min_cost) {
+  int best_index = -1;
+  *min_cost = std::numeric_limits<int32>::max();
+  for (size_t i = 0; i < lcosts.size(); ++i) {
+    const int32 cost = lcosts[i] + transition_costs[i];
+    if (cost < *min_cost) {
+      *min_cost = cost;
+      best_index = static_cast<int>(i);
+    }
+  }
+  return best_index;
+}
+
+void ExpectSameAsNaive(const std::vector<int32> &lcosts,
+                       const std::vector<int32> &transition_costs) {
+  int32 expected_cost = 0;
+  const int expected_index =
+      FindMinCostIndexNaive(lcosts, transition_costs, &expected_cost);
+  for (const ViterbiKernel::Implementation impl : kImplementations) {
+    if (!ViterbiKernel::IsAvailable(impl)) {
+      continue;
+    }
+    int32 cost = 0;
+    const int index = ViterbiKernel::FindMinCostIndexWithImplementation(
+        impl, lcosts.data(), transition_costs.data(), lcosts.size(), &cost);
+    EXPECT_EQ(expected_index, index)
+        << "impl: " << impl << ", size: " << lcosts.size();
+    EXPECT_EQ(expected_cost, cost)
+        << "impl: " << impl << ", size: " << lcosts.size();
+  }
+  int32 cost = 0;
+  EXPECT_EQ(expected_index,
+            ViterbiKernel::FindMinCostIndex(lcosts.data(),
+                                            transition_costs.data(),
+                                            lcosts.size(), &cost));
+  EXPECT_EQ(expected_cost, cost);
+}
+
+TEST(ViterbiKernelTest, ScalarIsAlwaysAvailable) {
+  EXPECT_TRUE(ViterbiKernel::IsAvailable(ViterbiKernel::SCALAR));
+  EXPECT_TRUE(ViterbiKernel::IsAvailable(ViterbiKernel::GetImplementation()));
+}
+
+TEST(ViterbiKernelTest, Empty) {
+  for (const ViterbiKernel::Implementation impl : kImplementations) {
+    if (!ViterbiKernel::IsAvailable(impl)) {
+      continue;
+    }
+    int32 cost = 0;
+    EXPECT_EQ(-1, ViterbiKernel::FindMinCostIndexWithImplementation(
+                      impl, nullptr, nullptr, 0, &cost));
+    EXPECT_EQ(std::numeric_limits<int32>::max(), cost);
+  }
+}
+
+TEST(ViterbiKernelTest, FirstMinimumIsReturned) {
+  // The minimum 10 appears at 5, 13 and 30, which are in different lanes and
+  // different vector blocks.
+  std::vector<int32> lcosts(40, 100);
+  std::vector<int32> transition_costs(40, 5);
+  lcosts[30] = 5;
+  lcosts[13] = 5;
+  lcosts[5] = 5;
+  ExpectSameAsNaive(lcosts, transition_costs);
+
+  // All the costs are the same.
+  lcosts.assign(40, 7);
+  transition_costs.assign(40, 3);
+  ExpectSameAsNaive(lcosts, transition_costs);
+
+  // The minimum only appears in the scalar tail.
+  lcosts.assign(39, 100);
+  transition_costs.assign(39, 0);
+  lcosts[38] = 1;
+  ExpectSameAsNaive(lcosts, transition_costs);
+}
+
+TEST(ViterbiKernelTest, NoCostLessThanInfinity) {
+  const int32 kMax = std::numeric_limits<int32>::max();
+  const std::vector<int32> lcosts(20, kMax);
+  const std::vector<int32> transition_costs(20, 0);
+  ExpectSameAsNaive(lcosts, transition_costs);
+}
+
+TEST(ViterbiKernelTest, RandomCosts) {
+  std::mt19937 urbg(0);
+  // Narrow ranges produce many ties.
+  for (const int32 range : {3, 1000, 100000}) {
+    std::uniform_int_distribution<int32> dist(-range, range);
+    for (size_t size = 0; size <= 100; ++size) {
+      std::vector<int32> lcosts(size), transition_costs(size);
+      for (size_t i = 0; i < size; ++i) {
+        lcosts[i] = dist(urbg);
+        transition_costs[i] = dist(urbg);
+      }
+      ExpectSameAsNaive(lcosts, transition_costs);
+    }
+  }
+}
+
+}  // namespace
+}  // namespace mozc
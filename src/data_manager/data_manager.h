@@ -72,7 +72,8 @@ class DataManager : public DataManagerInterface {
   Status InitFromArray(absl::string_view array, absl::string_view magic);
 
   // The same as above InitFromArray() but the data is loaded using mmap, which
-  // is owned in this instance.
+  // is owned in this instance.  The --data_set_* flags control how the mapping
+  // is prefaulted and which sections are pinned in memory.
   Status InitFromFile(const std::string &path);
   Status InitFromFile(const std::string &path, absl::string_view magic);
 
@@ -146,6 +147,9 @@ class DataManager : public DataManagerInterface {
  private:
   Status InitFromReader(const DataSetReader &reader);
 
+  // Locks the sections of |mmap_| that are used by every conversion.
+  void PinHotSections(const DataSetReader &reader);
+
   Mmap mmap_;
   absl::string_view pos_matcher_data_;
   absl::string_view user_pos_token_array_data_;
@@ -41,7 +41,11 @@
 namespace mozc {
 namespace {
 
-bool IsValidAlignment(int a) { return a == 8 || a == 16 || a == 32 || a == 64; }
+// 512 bits aligns data at the cache line boundary.
+bool IsValidAlignment(int a) {
+  return a == 8 || a == 16 || a == 32 || a == 64 || a == 128 || a == 256 ||
+         a == 512;
+}
 
 }  // namespace
 
@@ -39,8 +39,8 @@
 //
 // name:alignment:/path/to/infile
 //
-// where alignment must be one of {8, 16, 32, 64}.  Each packed file can be
-// retrieved by DataSetReader through its name.
+// where alignment must be one of {8, 16, 32, 64, 128, 256, 512}.  Each packed
+// file can be retrieved by DataSetReader through its name.
 
 #include <string>
 #include <vector>
@@ -116,5 +116,18 @@ TEST(DatasetWriterTest, Write) {
   EXPECT_EQ(expected, actual);
 }
 
+TEST(DatasetWriterTest, CacheLineAlignment) {
+  DataSetWriter w("magic");
+  w.Add("data8", 8, "data8");
+  w.Add("data512", 512, "data512");
+  w.Add("data8_2", 8, "data8");
+  w.Add("data512_2", 512, "data512");
+
+  const DataSetMetadata &metadata = w.metadata();
+  ASSERT_EQ(4, metadata.entries_size());
+  EXPECT_EQ(64, metadata.entries(1).offset());
+  EXPECT_EQ(128, metadata.entries(3).offset());
+}
+
 }  // namespace
 }  // namespace mozc
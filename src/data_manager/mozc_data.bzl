@@ -127,7 +127,7 @@ def mozc_dataset(
         "coll:32:$(location :" + name + "@collocation) " +
         "cols:32:$(location :" + name + "@collocation_suppression) " +
         "conn:32:$(location :" + name + "@connection) " +
-        "dict:32:$(location :" + name + "@dictionary) " +
+        "dict:512:$(location :" + name + "@dictionary) " +
         "sugg:32:$(location :" + name + "@suggestion_filter) " +
         "posg:32:$(location :" + name + "@pos_group) " +
         "bdry:32:$(location :" + name + "@boundary) " +
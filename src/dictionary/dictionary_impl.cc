@@ -29,8 +29,10 @@
 
 #include "dictionary/dictionary_impl.h"
 
+#include <memory>
 #include <string>
 #include <utility>
+#include <vector>
 
 #include "base/logging.h"
 #include "base/util.h"
@@ -39,6 +41,7 @@
 #include "dictionary/pos_matcher.h"
 #include "dictionary/suppression_dictionary.h"
 #include "protocol/commands.pb.h"
+#include "absl/memory/memory.h"
 #include "absl/strings/string_view.h"
 
 namespace mozc {
@@ -106,11 +109,30 @@ class CallbackWithFilter : public DictionaryInterface::Callback {
     return callback_->OnKey(key);
   }
 
+  ResultType OnApproximateKey(absl::string_view actual_key,
+                              int num_edits) override {
+    return callback_->OnApproximateKey(actual_key, num_edits);
+  }
+
   ResultType OnActualKey(absl::string_view key, absl::string_view actual_key,
                          bool is_expanded) override {
     return callback_->OnActualKey(key, actual_key, is_expanded);
   }
 
+  bool OnTokenWithoutValue(absl::string_view key, absl::string_view actual_key,
+                           const Token &token) override {
+    if (!(token.attributes & Token::USER_DICTIONARY)) {
+      if (!use_spelling_correction_ &&
+          (token.attributes & Token::SPELLING_CORRECTION)) {
+        return false;
+      }
+      if (!use_zip_code_conversion_ && pos_matcher_->IsZipcode(token.lid)) {
+        return false;
+      }
+    }
+    return callback_->OnTokenWithoutValue(key, actual_key, token);
+  }
+
   ResultType OnToken(absl::string_view key, absl::string_view actual_key,
                      const Token &token) override {
     if (!(token.attributes & Token::USER_DICTIONARY)) {
@@ -132,6 +154,8 @@ class CallbackWithFilter : public DictionaryInterface::Callback {
     return callback_->OnToken(key, actual_key, token);
   }
 
+  void OnLookupTruncated() override { callback_->OnLookupTruncated(); }
+
  private:
   const bool use_spelling_correction_;
   const bool use_zip_code_conversion_;
@@ -156,6 +180,21 @@ void DictionaryImpl::LookupPredictive(
   }
 }
 
+void DictionaryImpl::LookupPredictiveApproximate(
+    absl::string_view key, size_t exact_prefix_len, int max_edits,
+    const ConversionRequest &conversion_request, Callback *callback) const {
+  CallbackWithFilter callback_with_filter(
+      conversion_request.config().use_spelling_correction(),
+      conversion_request.config().use_zip_code_conversion(),
+      conversion_request.config().use_t13n_conversion(), pos_matcher_,
+      suppression_dictionary_, callback);
+  for (size_t i = 0; i < dics_.size(); ++i) {
+    dics_[i]->LookupPredictiveApproximate(key, exact_prefix_len, max_edits,
+                                          conversion_request,
+                                          &callback_with_filter);
+  }
+}
+
 void DictionaryImpl::LookupPrefix(absl::string_view key,
                                   const ConversionRequest &conversion_request,
                                   Callback *callback) const {
@@ -169,6 +208,28 @@ void DictionaryImpl::LookupPrefix(absl::string_view key,
   }
 }
 
+void DictionaryImpl::LookupPrefixBatch(
+    const std::vector<absl::string_view> &keys,
+    const ConversionRequest &conversion_request,
+    const std::vector<Callback *> &callbacks) const {
+  DCHECK_EQ(keys.size(), callbacks.size());
+  std::vector<std::unique_ptr<CallbackWithFilter>> callbacks_with_filter;
+  std::vector<Callback *> filtered_callbacks;
+  callbacks_with_filter.reserve(callbacks.size());
+  filtered_callbacks.reserve(callbacks.size());
+  for (Callback *callback : callbacks) {
+    callbacks_with_filter.push_back(absl::make_unique<CallbackWithFilter>(
+        conversion_request.config().use_spelling_correction(),
+        conversion_request.config().use_zip_code_conversion(),
+        conversion_request.config().use_t13n_conversion(), pos_matcher_,
+        suppression_dictionary_, callback));
+    filtered_callbacks.push_back(callbacks_with_filter.back().get());
+  }
+  for (size_t i = 0; i < dics_.size(); ++i) {
+    dics_[i]->LookupPrefixBatch(keys, conversion_request, filtered_callbacks);
+  }
+}
+
 void DictionaryImpl::LookupExact(absl::string_view key,
                                  const ConversionRequest &conversion_request,
                                  Callback *callback) const {
@@ -212,6 +273,12 @@ bool DictionaryImpl::LookupComment(absl::string_view key,
 
 bool DictionaryImpl::Reload() { return user_dictionary_->Reload(); }
 
+uint64 DictionaryImpl::GetGeneration() const {
+  // The suppression dictionary is updated only when the user dictionary is
+  // reloaded, and the system and value dictionaries are immutable.
+  return user_dictionary_->GetGeneration();
+}
+
 void DictionaryImpl::PopulateReverseLookupCache(absl::string_view str) const {
   for (size_t i = 0; i < dics_.size(); ++i) {
     dics_[i]->PopulateReverseLookupCache(str);
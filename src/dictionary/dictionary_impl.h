@@ -68,9 +68,17 @@ class DictionaryImpl : public DictionaryInterface {
   void LookupPredictive(absl::string_view key,
                         const ConversionRequest &conversion_request,
                         Callback *callback) const override;
+  void LookupPredictiveApproximate(absl::string_view key,
+                                   size_t exact_prefix_len, int max_edits,
+                                   const ConversionRequest &conversion_request,
+                                   Callback *callback) const override;
   void LookupPrefix(absl::string_view key,
                     const ConversionRequest &conversion_request,
                     Callback *callback) const override;
+  void LookupPrefixBatch(const std::vector<absl::string_view> &keys,
+                         const ConversionRequest &conversion_request,
+                         const std::vector<Callback *> &callbacks)
+      const override;
 
   void LookupExact(absl::string_view key,
                    const ConversionRequest &conversion_request,
@@ -84,6 +92,7 @@ class DictionaryImpl : public DictionaryInterface {
                      const ConversionRequest &conversion_request,
                      std::string *comment) const override;
   bool Reload() override;
+  uint64 GetGeneration() const override;
   void PopulateReverseLookupCache(absl::string_view str) const override;
   void ClearReverseLookupCache() const override;
 
@@ -33,6 +33,7 @@
 #include <string>
 #include <vector>
 
+#include "base/logging.h"
 #include "base/port.h"
 #include "dictionary/dictionary_token.h"
 #include "request/conversion_request.h"
@@ -50,7 +51,9 @@ class DictionaryInterface {
   //   OnKey(key);
   //   OnActualKey(key, actual_key, key != actual_key);
   //   for (each token in the token array for the key) {
-  //     OnToken(key, actual_key, token);
+  //     if (OnTokenWithoutValue(key, actual_key, token)) {  // Optional
+  //       OnToken(key, actual_key, token);
+  //     }
   //   }
   // }
   //
@@ -90,6 +93,14 @@ class DictionaryInterface {
       return TRAVERSE_CONTINUE;
     }
 
+    // Called back before OnKey() only by LookupPredictiveApproximate(), with
+    // the number of edits between the looked-up key and the prefix of
+    // |actual_key| that it matched.
+    virtual ResultType OnApproximateKey(absl::string_view actual_key,
+                                        int num_edits) {
+      return TRAVERSE_CONTINUE;
+    }
+
     // Called back when actual key is decoded. The third argument is guaranteed
     // to be (key != actual_key) but computed in an efficient way.
     virtual ResultType OnActualKey(absl::string_view key,
@@ -98,6 +109,18 @@ class DictionaryInterface {
       return TRAVERSE_CONTINUE;
     }
 
+    // Called back before OnToken() for dictionaries that can decode a token
+    // partially, e.g., SystemDictionary.  Key, lid, rid, cost and attributes
+    // of |token| are valid but its value is not decoded yet.  If false is
+    // returned, the token is skipped without decoding its value, i.e.,
+    // OnToken() is not called for it.  Since other dictionaries don't call
+    // this method, OnToken() should still check the same conditions.
+    virtual bool OnTokenWithoutValue(absl::string_view key,
+                                     absl::string_view actual_key,
+                                     const Token &token) {
+      return true;
+    }
+
     // Called back when a token is decoded.
     virtual ResultType OnToken(absl::string_view key,
                                absl::string_view expanded_key,
@@ -105,6 +128,12 @@ class DictionaryInterface {
       return TRAVERSE_CONTINUE;
     }
 
+    // Called back by LookupPredictive() when the dictionary doesn't visit all
+    // the keys starting with the looked-up key, e.g., because of its own
+    // lookup limit.  Callers that reuse the results for longer keys need to
+    // know it.
+    virtual void OnLookupTruncated() {}
+
    protected:
     Callback() {}
   };
@@ -121,10 +150,36 @@ class DictionaryInterface {
                                 const ConversionRequest &conversion_request,
                                 Callback *callback) const = 0;
 
+  // Same as LookupPredictive() but also finds the keys starting with a string
+  // that is |max_edits| or fewer edits (insertions, deletions or
+  // substitutions of a character) away from |key|, e.g., keys with a typo.
+  // The first |exact_prefix_len| bytes of |key|, e.g., the key of the history
+  // segment, need to match exactly and don't take any edit.
+  // OnApproximateKey() tells the number of edits for each key; the |key|
+  // passed to the other methods is |key| followed by the rest of the actual
+  // key, like the expanded keys of LookupPredictive().  Dictionaries that
+  // don't support the lookup find nothing.
+  virtual void LookupPredictiveApproximate(
+      absl::string_view key, size_t exact_prefix_len, int max_edits,
+      const ConversionRequest &conversion_request, Callback *callback) const {}
+
   virtual void LookupPrefix(absl::string_view key,
                             const ConversionRequest &conversion_request,
                             Callback *callback) const = 0;
 
+  // Runs LookupPrefix() for each pair of keys[i] and callbacks[i].  The
+  // callbacks for the same key are called in the same order as LookupPrefix(),
+  // while those for different keys may be interleaved.  Dictionaries can
+  // override this method to look up the keys together more efficiently.
+  virtual void LookupPrefixBatch(const std::vector<absl::string_view> &keys,
+                                 const ConversionRequest &conversion_request,
+                                 const std::vector<Callback *> &callbacks) const {
+    DCHECK_EQ(keys.size(), callbacks.size());
+    for (size_t i = 0; i < keys.size(); ++i) {
+      LookupPrefix(keys[i], conversion_request, callbacks[i]);
+    }
+  }
+
   virtual void LookupExact(absl::string_view key,
                            const ConversionRequest &conversion_request,
                            Callback *callback) const = 0;
@@ -156,6 +211,11 @@ class DictionaryInterface {
   // Reload dictionary data from local disk.
   virtual bool Reload() { return true; }
 
+  // Returns a number that changes whenever the results of look-ups may
+  // change, e.g., when the dictionary data is reloaded.  Callers caching the
+  // results compare it to detect stale entries.
+  virtual uint64 GetGeneration() const { return 0; }
+
  protected:
   // Do not allow instantiation
   DictionaryInterface() {}
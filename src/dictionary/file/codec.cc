@@ -44,6 +44,18 @@
 
 namespace mozc {
 namespace dictionary {
+namespace {
+
+// The name of the sections inserted only to align the following sections.
+constexpr char kPaddingSectionName[] = "_padding";
+
+// The size of the file header: the file magic and the seed.
+constexpr int kHeaderSize = 8;
+
+// The size of the section header: the data size and the fingerprint.
+constexpr int kSectionHeaderSize = 12;
+
+}  // namespace
 
 DictionaryFileCodec::DictionaryFileCodec()
     : seed_(2135654146), filemagic_(20110701) {}
@@ -55,20 +67,25 @@ void DictionaryFileCodec::WriteSections(
     std::ostream *ofs) const {
   DCHECK(ofs);
   WriteHeader(ofs);
+  int offset = kHeaderSize;
 
-  if (sections.size() == 4) {
+  if (sections.size() >= 4) {
     // In production, the number of sections equals 4.  In this case, write the
     // sections in the following deterministic order.  This order was determined
     // by random shuffle for engine version 24 but it's now made deterministic
-    // to obsolte DictionaryFileCodec.
+    // to obsolte DictionaryFileCodec.  Optional sections, e.g., the reverse
+    // lookup index, follow in given order.
     for (size_t i : {0, 2, 1, 3}) {
-      WriteSection(sections[i], ofs);
+      WriteSection(sections[i], &offset, ofs);
+    }
+    for (size_t i = 4; i < sections.size(); ++i) {
+      WriteSection(sections[i], &offset, ofs);
     }
   } else {
-    // Some tests don't have four sections.  In this case, simply write sections
-    // in given order.
+    // Some tests have fewer than four sections.  In this case, simply write
+    // sections in given order.
     for (const auto &section : sections) {
-      WriteSection(section, ofs);
+      WriteSection(section, &offset, ofs);
     }
   }
 
@@ -82,8 +99,31 @@ void DictionaryFileCodec::WriteHeader(std::ostream *ofs) const {
 }
 
 void DictionaryFileCodec::WriteSection(const DictionaryFileSection &section,
-                                       std::ostream *ofs) const {
+                                       int *offset, std::ostream *ofs) const {
+  DCHECK(offset);
   DCHECK(ofs);
+  DCHECK_EQ(0, *offset % 4);
+  if ((*offset + kSectionHeaderSize) % kSectionAlignment != 0) {
+    // The padding section itself has a header, so its data size is chosen to
+    // make the data of |section| start at the boundary.  It's not zero, which
+    // is the end marker.
+    int padding_size =
+        (kSectionAlignment -
+         (*offset + 2 * kSectionHeaderSize) % kSectionAlignment) %
+        kSectionAlignment;
+    if (padding_size == 0) {
+      padding_size = kSectionAlignment;
+    }
+    const std::string padding_name = GetSectionName(kPaddingSectionName);
+    filecodec_util::WriteInt32(padding_size, ofs);
+    ofs->write(padding_name.data(), padding_name.size());
+    for (int i = 0; i < padding_size; ++i) {
+      (*ofs) << '\0';
+    }
+    *offset += kSectionHeaderSize + padding_size;
+  }
+  DCHECK_EQ(0, (*offset + kSectionHeaderSize) % kSectionAlignment);
+
   const std::string &name = section.name;
   // name should be encoded
   // uint64 needs just 8 bytes.
@@ -97,6 +137,7 @@ void DictionaryFileCodec::WriteSection(const DictionaryFileSection &section,
   ofs->write(name.data(), name.size());
   ofs->write(section.ptr, section.len);
   filecodec_util::Pad4(section.len, ofs);
+  *offset += kSectionHeaderSize + filecodec_util::RoundUp4(section.len);
 }
 
 std::string DictionaryFileCodec::GetSectionName(const std::string &name) const {
@@ -138,6 +179,7 @@ mozc::Status DictionaryFileCodec::ReadSections(
         " Actual: ", filemagic));
   }
   seed_ = filecodec_util::ReadInt32ThenAdvance(&ptr);
+  const std::string padding_name = GetSectionName(kPaddingSectionName);
   for (int section_index = 0;; ++section_index) {
     // Each section has the following format:
     // +-----------+-------------+-----------------+---------------+
@@ -146,6 +188,9 @@ mozc::Status DictionaryFileCodec::ReadSections(
     // +-----------+-------------+-----------------+---------------+
     // ^                         <- - - - padded_data_size - - - - >
     // ptr points to here now.
+    //
+    // The data is aligned at kSectionAlignment by the padding sections, which
+    // are not returned to the caller.
     if (std::distance(ptr, image_end) < 4) {
       return mozc::OutOfRangeError(absl::StrCat(
           "codec.cc: Section ", section_index,
@@ -177,7 +222,9 @@ mozc::Status DictionaryFileCodec::ReadSections(
     // Add a section with data and fingerprint.  Note that the data size is
     // |data_size| but |ptr| is advanced by |padded_data_size| to skip padding
     // bytes at the end.
-    sections->emplace_back(ptr, data_size, fingerprint);
+    if (fingerprint != padding_name) {
+      sections->emplace_back(ptr, data_size, fingerprint);
+    }
     ptr += padded_data_size;
   }
   if (ptr != image_end) {
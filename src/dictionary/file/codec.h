@@ -59,9 +59,17 @@ class DictionaryFileCodec : public DictionaryFileCodecInterface {
       std::vector<DictionaryFileSection> *sections) const override;
   std::string GetSectionName(const std::string &name) const override;
 
+  // The data of every section starts at a multiple of this value from the
+  // beginning of the image.  Hence, if the image is aligned at this boundary,
+  // the data structures in the sections can be aligned at cache lines.
+  static constexpr int kSectionAlignment = 64;
+
  private:
   void WriteHeader(std::ostream *ofs) const;
-  void WriteSection(const DictionaryFileSection &section,
+  // Writes |section| preceded by a padding section if necessary to align the
+  // data at kSectionAlignment.  |offset| is the number of bytes written to
+  // |ofs| so far and is advanced by this method.
+  void WriteSection(const DictionaryFileSection &section, int *offset,
                     std::ostream *ofs) const;
 
   // Seed value for name string finger print
@@ -30,6 +30,9 @@
 #include "dictionary/file/codec.h"
 
 #include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
 
 #include "base/file_stream.h"
 #include "base/file_util.h"
@@ -217,6 +220,40 @@ TEST_F(CodecTest, RandomizedCodecTest) {
   EXPECT_TRUE(CheckValue(sections[index], "Value 1 test test"));
 }
 
+TEST_F(CodecTest, SectionAlignment) {
+  const DictionaryFileCodecInterface *codec =
+      DictionaryFileCodecFactory::GetCodec();
+  ASSERT_TRUE(codec != nullptr);
+  // Sections of various lengths, including ones whose data would start at
+  // the boundary without padding.
+  std::vector<std::string> values;
+  for (int len : {1, 4, 52, 64, 100, 116, 3, 40}) {
+    values.push_back(std::string(len, 'a' + values.size()));
+  }
+  std::vector<DictionaryFileSection> write_sections;
+  for (size_t i = 0; i < values.size(); ++i) {
+    AddSection(codec, Util::StringPrintf("Section %d", static_cast<int>(i)),
+               values[i].data(), values[i].size(), &write_sections);
+  }
+  std::ostringstream oss;
+  codec->WriteSections(write_sections, &oss);
+  const std::string image = oss.str();
+
+  std::vector<DictionaryFileSection> sections;
+  ASSERT_TRUE(codec->ReadSections(image.data(), image.size(), &sections).ok());
+  // The padding sections are not returned.
+  ASSERT_EQ(values.size(), sections.size());
+  for (size_t i = 0; i < values.size(); ++i) {
+    int index = -1;
+    ASSERT_TRUE(FindSection(
+        codec, sections, Util::StringPrintf("Section %d", static_cast<int>(i)),
+        &index));
+    EXPECT_TRUE(CheckValue(sections[index], values[i]));
+    EXPECT_EQ(0, (sections[index].ptr - image.data()) %
+                     DictionaryFileCodec::kSectionAlignment);
+  }
+}
+
 }  // namespace
 }  // namespace dictionary
 }  // namespace mozc
@@ -29,6 +29,8 @@
 
 #include "dictionary/system/codec.h"
 
+#include <array>
+#include <cstring>
 #include <sstream>
 
 #include "base/logging.h"
@@ -39,6 +41,11 @@
 #include "dictionary/system/words_info.h"
 #include "absl/strings/string_view.h"
 
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define MOZC_SYSTEM_DICTIONARY_CODEC_X86
+#include <immintrin.h>
+#endif  // __GNUC__ && (__x86_64__ || __i386__)
+
 namespace mozc {
 namespace dictionary {
 namespace {
@@ -75,6 +82,8 @@ const char kKeySectionName[] = "k";
 const char kValueSectionName[] = "v";
 const char kTokensSectionName[] = "t";
 const char kPosSectionName[] = "p";
+const char kReverseLookupIndexSectionName[] = "r";
+const char kPredictiveCostIndexSectionName[] = "c";
 
 //// Constants for validation ////
 // 12 bits
@@ -187,6 +196,309 @@ const uint8 kUpperFlagsMask = 0xc0;
 // Mask to get upper 6bits from flags value
 const uint8 kUpperCrammedIDMask = 0x3f;
 
+//// Tables for decoding ////
+// UTF-8 sequence of a code point decoded from one byte.  Only the first
+// |length| bytes of |bytes| are valid, but all the 3 bytes are always copied
+// so that the copy doesn't depend on the length.
+struct Utf8Char {
+  char bytes[3];
+  uint8 length;
+};
+typedef std::array<Utf8Char, 256> ByteDecodeTable;
+
+constexpr Utf8Char MakeUtf8Char(uint32 c) {
+  // Util::UCS4ToUTF8 outputs nothing for NUL.
+  if (c == 0) {
+    return {{0, 0, 0}, 0};
+  }
+  if (c < 0x80) {
+    return {{static_cast<char>(c), 0, 0}, 1};
+  }
+  if (c < 0x800) {
+    return {{static_cast<char>(0xc0 | (c >> 6)),
+             static_cast<char>(0x80 | (c & 0x3f)), 0},
+            2};
+  }
+  return {{static_cast<char>(0xe0 | (c >> 12)),
+           static_cast<char>(0x80 | ((c >> 6) & 0x3f)),
+           static_cast<char>(0x80 | (c & 0x3f))},
+          3};
+}
+
+// Maps a byte of encoded value to its UTF-8 sequence.  Valid only for bytes
+// accepted by IsValueKanaByte().
+constexpr ByteDecodeTable MakeValueDecodeTable() {
+  ByteDecodeTable table = {};
+  for (int b = kValueHiraganaOffset; b < kValueKatakanaOffset; ++b) {
+    table[b] = MakeUtf8Char(0x3041 + b - kValueHiraganaOffset);
+  }
+  for (int b = kValueKatakanaOffset; b < kValueCharMarkAscii; ++b) {
+    table[b] = MakeUtf8Char(0x30a1 + b - kValueKatakanaOffset);
+  }
+  return table;
+}
+
+// Swaps a code point as described at EncodeDecodeKeyImpl().
+constexpr uint32 EncodeDecodeKeyCode(uint32 code) {
+  int32 offset = 0;
+  if ((code >= 0x0001 && code <= 0x001f) ||
+      (code >= 0x3041 && code <= 0x305f)) {
+    offset = 0x3041 - 0x0001;
+  } else if ((code >= 0x0040 && code <= 0x0075) ||
+             (code >= 0x3060 && code <= 0x3095)) {
+    offset = 0x3060 - 0x0040;
+  } else if ((code >= 0x0076 && code <= 0x0077) ||
+             (code >= 0x30FB && code <= 0x30FC)) {
+    offset = 0x30FB - 0x0076;
+  }
+  if (code < 0x80) {
+    return code + offset;
+  }
+  return code - offset;
+}
+
+// Maps an ASCII byte of encoded key to its UTF-8 sequence.  Valid only for
+// bytes less than 0x80.
+constexpr ByteDecodeTable MakeKeyDecodeTable() {
+  ByteDecodeTable table = {};
+  for (uint32 b = 0; b < 0x80; ++b) {
+    table[b] = MakeUtf8Char(EncodeDecodeKeyCode(b));
+  }
+  return table;
+}
+
+// Returns true if |b| is decoded into one hiragana or katakana by itself.
+inline bool IsValueKanaByte(uint8 b) {
+  return b >= kValueHiraganaOffset && b < kValueCharMarkAscii;
+}
+
+inline char *AppendUtf8Char(const Utf8Char &c, char *dst) {
+  memcpy(dst, c.bytes, sizeof(c.bytes));
+  return dst + c.length;
+}
+
+// Functions returning the end of the longest prefix of [begin, end) whose
+// bytes are all decoded by a table lookup, i.e., hiragana and katakana bytes
+// for values and ASCII bytes for keys.
+typedef const uint8 *(*FindRunEndFunc)(const uint8 *begin, const uint8 *end);
+
+const uint8 *FindValueKanaRunEndScalar(const uint8 *begin, const uint8 *end) {
+  while (begin < end && IsValueKanaByte(*begin)) {
+    ++begin;
+  }
+  return begin;
+}
+
+const uint8 *FindKeyAsciiRunEndScalar(const uint8 *begin, const uint8 *end) {
+  while (begin < end && *begin < 0x80) {
+    ++begin;
+  }
+  return begin;
+}
+
+#ifdef MOZC_SYSTEM_DICTIONARY_CODEC_X86
+
+// In the vectorized versions, a byte is a hiragana or katakana byte iff
+// (b - kValueHiraganaOffset) mod 256 <= kValueKanaRange as unsigned.
+constexpr int kValueKanaRange = kValueCharMarkAscii - kValueHiraganaOffset - 1;
+
+__attribute__((target("sse2"))) const uint8 *FindValueKanaRunEndSSE2(
+    const uint8 *begin, const uint8 *end) {
+  const __m128i offset = _mm_set1_epi8(kValueHiraganaOffset);
+  const __m128i range = _mm_set1_epi8(static_cast<char>(kValueKanaRange));
+  while (end - begin >= 16) {
+    const __m128i x = _mm_sub_epi8(
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(begin)), offset);
+    const uint32 mask =
+        _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_min_epu8(x, range), x));
+    if (mask != 0xffff) {
+      return begin + __builtin_ctz(~mask);
+    }
+    begin += 16;
+  }
+  return FindValueKanaRunEndScalar(begin, end);
+}
+
+__attribute__((target("sse2"))) const uint8 *FindKeyAsciiRunEndSSE2(
+    const uint8 *begin, const uint8 *end) {
+  while (end - begin >= 16) {
+    const uint32 mask = _mm_movemask_epi8(
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(begin)));
+    if (mask != 0) {
+      return begin + __builtin_ctz(mask);
+    }
+    begin += 16;
+  }
+  return FindKeyAsciiRunEndScalar(begin, end);
+}
+
+__attribute__((target("avx2"))) const uint8 *FindValueKanaRunEndAVX2(
+    const uint8 *begin, const uint8 *end) {
+  const __m256i offset = _mm256_set1_epi8(kValueHiraganaOffset);
+  const __m256i range = _mm256_set1_epi8(static_cast<char>(kValueKanaRange));
+  while (end - begin >= 32) {
+    const __m256i x = _mm256_sub_epi8(
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(begin)), offset);
+    const uint32 mask = _mm256_movemask_epi8(
+        _mm256_cmpeq_epi8(_mm256_min_epu8(x, range), x));
+    if (mask != 0xffffffff) {
+      return begin + __builtin_ctz(~mask);
+    }
+    begin += 32;
+  }
+  return FindValueKanaRunEndSSE2(begin, end);
+}
+
+__attribute__((target("avx2"))) const uint8 *FindKeyAsciiRunEndAVX2(
+    const uint8 *begin, const uint8 *end) {
+  while (end - begin >= 32) {
+    const uint32 mask = _mm256_movemask_epi8(
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(begin)));
+    if (mask != 0) {
+      return begin + __builtin_ctz(mask);
+    }
+    begin += 32;
+  }
+  return FindKeyAsciiRunEndSSE2(begin, end);
+}
+
+#endif  // MOZC_SYSTEM_DICTIONARY_CODEC_X86
+
+// Selects the widest implementation available on the running CPU.
+FindRunEndFunc SelectFindRunEndFunc(FindRunEndFunc scalar, FindRunEndFunc sse2,
+                                    FindRunEndFunc avx2) {
+#ifdef MOZC_SYSTEM_DICTIONARY_CODEC_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) {
+    return avx2;
+  }
+  if (__builtin_cpu_supports("sse2")) {
+    return sse2;
+  }
+#endif  // MOZC_SYSTEM_DICTIONARY_CODEC_X86
+  return scalar;
+}
+
+#ifdef MOZC_SYSTEM_DICTIONARY_CODEC_X86
+#define MOZC_FIND_RUN_END_FUNCS(name) \
+  &name##Scalar, &name##SSE2, &name##AVX2
+#else  // MOZC_SYSTEM_DICTIONARY_CODEC_X86
+#define MOZC_FIND_RUN_END_FUNCS(name) &name##Scalar, nullptr, nullptr
+#endif  // MOZC_SYSTEM_DICTIONARY_CODEC_X86
+
+const uint8 *FindValueKanaRunEnd(const uint8 *begin, const uint8 *end) {
+  static const FindRunEndFunc kFunc =
+      SelectFindRunEndFunc(MOZC_FIND_RUN_END_FUNCS(FindValueKanaRunEnd));
+  return (*kFunc)(begin, end);
+}
+
+const uint8 *FindKeyAsciiRunEnd(const uint8 *begin, const uint8 *end) {
+  static const FindRunEndFunc kFunc =
+      SelectFindRunEndFunc(MOZC_FIND_RUN_END_FUNCS(FindKeyAsciiRunEnd));
+  return (*kFunc)(begin, end);
+}
+
+#undef MOZC_FIND_RUN_END_FUNCS
+
+// Decodes an encoded value string into |dst| and returns the end of the
+// output.  |dst| must have room for 3 * |src.size()| bytes plus 8 bytes, as a
+// byte is decoded into at most 3 bytes, and Util::UCS4ToUTF8 may write the
+// NUL terminator after the output.
+char *DecodeValueImpl(const absl::string_view src, char *dst) {
+  static constexpr ByteDecodeTable kTable = MakeValueDecodeTable();
+  const uint8 *p = reinterpret_cast<const uint8 *>(src.data());
+  const uint8 *const end = p + src.size();
+  while (p < end) {
+    // Hiragana and katakana, which are most of the characters in values,
+    // are decoded by a table lookup.
+    for (const uint8 *run_end = FindValueKanaRunEnd(p, end); p < run_end;
+         ++p) {
+      dst = AppendUtf8Char(kTable[*p], dst);
+    }
+    if (p == end) {
+      break;
+    }
+    const int cc = p[0];
+    int c = 0;
+    if (cc == kValueCharMarkAscii) {
+      // Ascii
+      c = p[1];
+      p += 2;
+    } else if (cc == kValueCharMarkXX00) {
+      // xx00
+      c = (p[1] << 8);
+      p += 2;
+    } else if (cc == kValueCharMarkUCS4) {
+      // UCS4
+      c = ((p[1] & kValueCharMarkUCS4LeftMask) << 16);
+      int pos = 2;
+      if (!(p[1] & kValueCharMarkUCS4Middle0)) {
+        c += (p[pos++] << 8);
+      }
+      if (!(p[1] & kValueCharMarkUCS4Right0)) {
+        c += p[pos++];
+      }
+      p += pos;
+    } else if (cc == kValueCharMarkOtherUCS2) {
+      // other
+      c = (p[1] << 8);
+      c += p[2];
+      p += 3;
+    } else if (cc < kValueHiraganaOffset) {
+      // Frequent kanji
+      c = (((p[0] - kValueKanjiOffset) << 8) + 0x4e00);
+      c += p[1];
+      p += 2;
+    } else {
+      VLOG(1) << "should never come here";
+      p += 1;
+    }
+    dst += Util::UCS4ToUTF8(c, dst);
+  }
+  return dst;
+}
+
+// Decodes an encoded key string into |dst| and returns the end of the output.
+// |dst| must have room for 3 * |src.size()| bytes plus 8 bytes.
+char *DecodeKeyImpl(const absl::string_view src, char *dst) {
+  static constexpr ByteDecodeTable kTable = MakeKeyDecodeTable();
+  const uint8 *p = reinterpret_cast<const uint8 *>(src.data());
+  const uint8 *const end = p + src.size();
+  while (p < end) {
+    // Encoded keys mostly consist of ASCII bytes, which are decoded by a
+    // table lookup.
+    for (const uint8 *run_end = FindKeyAsciiRunEnd(p, end); p < run_end;
+         ++p) {
+      dst = AppendUtf8Char(kTable[*p], dst);
+    }
+    if (p == end) {
+      break;
+    }
+    char32 c = 0;
+    absl::string_view rest;
+    if (!Util::SplitFirstChar32(
+            absl::string_view(reinterpret_cast<const char *>(p), end - p), &c,
+            &rest)) {
+      break;
+    }
+    p = reinterpret_cast<const uint8 *>(rest.data());
+    dst += Util::UCS4ToUTF8(EncodeDecodeKeyCode(c), dst);
+  }
+  return dst;
+}
+
+// Resizes |dst| to hold the output of Decode{Key,Value}Impl for |src|, calls
+// |decode| and shrinks |dst| to the actual size.
+template <typename DecodeFunc>
+void AppendDecoded(const absl::string_view src, DecodeFunc decode,
+                   std::string *dst) {
+  const size_t original_size = dst->size();
+  dst->resize(original_size + 3 * src.size() + 8);
+  char *const begin = &(*dst)[0];
+  char *const output_end = decode(src, begin + original_size);
+  dst->resize(output_end - begin);
+}
+
 //// Last token flag ////
 // This token is last token for a index word
 const uint8 kLastTokenFlag = 0x80;
@@ -212,6 +524,16 @@ const std::string SystemDictionaryCodec::GetSectionNameForPos() const {
   return kPosSectionName;
 }
 
+const std::string SystemDictionaryCodec::GetSectionNameForReverseLookupIndex()
+    const {
+  return kReverseLookupIndexSectionName;
+}
+
+const std::string SystemDictionaryCodec::GetSectionNameForPredictiveCostIndex()
+    const {
+  return kPredictiveCostIndexSectionName;
+}
+
 void SystemDictionaryCodec::EncodeKey(const absl::string_view src,
                                       std::string *dst) const {
   EncodeDecodeKeyImpl(src, dst);
@@ -219,7 +541,7 @@ void SystemDictionaryCodec::EncodeKey(const absl::string_view src,
 
 void SystemDictionaryCodec::DecodeKey(const absl::string_view src,
                                       std::string *dst) const {
-  EncodeDecodeKeyImpl(src, dst);
+  AppendDecoded(src, &DecodeKeyImpl, dst);
 }
 
 size_t SystemDictionaryCodec::GetEncodedKeyLength(
@@ -304,52 +626,28 @@ void SystemDictionaryCodec::EncodeValue(const absl::string_view src,
 void SystemDictionaryCodec::DecodeValue(const absl::string_view src,
                                         std::string *dst) const {
   DCHECK(dst);
-  const uint8 *p = reinterpret_cast<const uint8 *>(src.data());
-  const uint8 *const end = p + src.size();
-  while (p < end) {
-    int cc = p[0];
-    int c = 0;
-    if (kValueHiraganaOffset <= cc && cc < kValueKatakanaOffset) {
-      // Hiragana
-      c = 0x3041 + p[0] - kValueHiraganaOffset;
-      p += 1;
-    } else if (kValueKatakanaOffset <= cc && cc < kValueCharMarkAscii) {
-      // Katakana
-      c = 0x30a1 + p[0] - kValueKatakanaOffset;
-      p += 1;
-    } else if (cc == kValueCharMarkAscii) {
-      // Ascii
-      c = p[1];
-      p += 2;
-    } else if (cc == kValueCharMarkXX00) {
-      // xx00
-      c = (p[1] << 8);
-      p += 2;
-    } else if (cc == kValueCharMarkUCS4) {
-      // UCS4
-      c = ((p[1] & kValueCharMarkUCS4LeftMask) << 16);
-      int pos = 2;
-      if (!(p[1] & kValueCharMarkUCS4Middle0)) {
-        c += (p[pos++] << 8);
-      }
-      if (!(p[1] & kValueCharMarkUCS4Right0)) {
-        c += p[pos++];
-      }
-      p += pos;
-    } else if (cc == kValueCharMarkOtherUCS2) {
-      // other
-      c = (p[1] << 8);
-      c += p[2];
-      p += 3;
-    } else if (cc < kValueHiraganaOffset) {
-      // Frequent kanji
-      c = (((p[0] - kValueKanjiOffset) << 8) + 0x4e00);
-      c += p[1];
-      p += 2;
-    } else {
-      VLOG(1) << "should never come here";
-    }
-    Util::UCS4ToUTF8Append(c, dst);
+  AppendDecoded(src, &DecodeValueImpl, dst);
+}
+
+void SystemDictionaryCodec::DecodeKeys(
+    const std::vector<absl::string_view> &src,
+    std::vector<std::string> *dst) const {
+  DCHECK(dst);
+  dst->resize(src.size());
+  for (size_t i = 0; i < src.size(); ++i) {
+    (*dst)[i].clear();
+    AppendDecoded(src[i], &DecodeKeyImpl, &(*dst)[i]);
+  }
+}
+
+void SystemDictionaryCodec::DecodeValues(
+    const std::vector<absl::string_view> &src,
+    std::vector<std::string> *dst) const {
+  DCHECK(dst);
+  dst->resize(src.size());
+  for (size_t i = 0; i < src.size(); ++i) {
+    (*dst)[i].clear();
+    AppendDecoded(src[i], &DecodeValueImpl, &(*dst)[i]);
   }
 }
 
@@ -486,23 +784,7 @@ void EncodeDecodeKeyImpl(const absl::string_view src, std::string *dst) {
   for (ConstChar32Iterator iter(src); !iter.Done(); iter.Next()) {
     static_assert(sizeof(uint32) == sizeof(char32),
                   "char32 must be 32-bit integer size.");
-    uint32 code = iter.Get();
-    int32 offset = 0;
-    if ((code >= 0x0001 && code <= 0x001f) ||
-        (code >= 0x3041 && code <= 0x305f)) {
-      offset = 0x3041 - 0x0001;
-    } else if ((code >= 0x0040 && code <= 0x0075) ||
-               (code >= 0x3060 && code <= 0x3095)) {
-      offset = 0x3060 - 0x0040;
-    } else if ((code >= 0x0076 && code <= 0x0077) ||
-               (code >= 0x30FB && code <= 0x30FC)) {
-      offset = 0x30FB - 0x0076;
-    }
-    if (code < 0x80) {
-      code += offset;
-    } else {
-      code -= offset;
-    }
+    const uint32 code = EncodeDecodeKeyCode(iter.Get());
     DCHECK_GT(code, 0);
     Util::UCS4ToUTF8Append(code, dst);
   }
@@ -60,6 +60,12 @@ class SystemDictionaryCodec : public SystemDictionaryCodecInterface {
   // Return section name for frequent pos map
   const std::string GetSectionNameForPos() const override;
 
+  // Return section name for the optional reverse lookup index
+  const std::string GetSectionNameForReverseLookupIndex() const override;
+
+  // Return section name for the optional predictive cost index
+  const std::string GetSectionNameForPredictiveCostIndex() const override;
+
   // Compresses key string into small bytes.
   void EncodeKey(const absl::string_view src, std::string *dst) const override;
 
@@ -80,6 +86,15 @@ class SystemDictionaryCodec : public SystemDictionaryCodecInterface {
   void DecodeValue(const absl::string_view src,
                    std::string *dst) const override;
 
+  // Decompress arrays of key and value strings.  |dst| is resized to the
+  // size of |src| and the i-th element is replaced with the decoded |src[i]|.
+  // The capacity of the strings in |dst| is reused.  These are not part of
+  // the interface as no lookup decodes strings in batches.
+  void DecodeKeys(const std::vector<absl::string_view> &src,
+                  std::vector<std::string> *dst) const;
+  void DecodeValues(const std::vector<absl::string_view> &src,
+                    std::vector<std::string> *dst) const;
+
   // Compress tokens
   void EncodeTokens(const std::vector<TokenInfo> &tokens,
                     std::string *output) const override;
@@ -0,0 +1,220 @@
+// Copyright 2010-2020, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// Measures the decoding throughput of SystemDictionaryCodec.  The first
+// argument selects the decoder:
+// - TABLE: SystemDictionaryCodec, which decodes runs of kana (values) and
+//   ASCII (encoded keys) bytes by table lookups.
+// - BY_CHAR: the character-by-character decoder, which was used before the
+//   table-driven one.  For keys, EncodeKey() runs the same code as the old
+//   DecodeKey() since the key encoding is symmetric.
+// The "bytes" counter is the rate of the encoded bytes.
+
+#include <string>
+#include <vector>
+
+#include "base/port.h"
+#include "base/util.h"
+#include "dictionary/system/codec.h"
+#include "benchmark/benchmark.h"
+#include "absl/strings/string_view.h"
+
+namespace mozc {
+namespace dictionary {
+namespace {
+
+enum Decoder {
+  TABLE = 0,
+  BY_CHAR = 1,
+};
+
+// Readings and surface forms of typical dictionary entries.
+constexpr const char *kKeys[] = {
+    "わたし",     "なまえ",     "きょう",       "てんき",
+    "かいぎしつ", "うちあわせ", "しりょう",     "めーる",
+    "よろしく",   "おねがい",   "でんしゃ",     "らいしゅう",
+    "にほんご",   "とうきょう", "おおさか",     "しんかんせん",
+    "ぷろぐらむ", "せいのう",   "がっこう",     "ばすけっと",
+    "ぱそこん",   "こしょう",   "あいふぉーん", "ver1.0",
+};
+
+constexpr const char *kValues[] = {
+    "私",         "名前",       "今日",         "天気",
+    "会議室",     "打ち合わせ", "資料",         "メール",
+    "よろしく",   "お願い",     "電車",         "来週",
+    "日本語",     "東京",       "大阪",         "新幹線",
+    "プログラム", "性能",       "学校",         "バスケット",
+    "パソコン",   "故障",       "アイフォーン", "Ver1.0",
+};
+
+// Decodes a value character by character.
+void DecodeValueByChar(absl::string_view src, std::string *dst) {
+  const uint8 *p = reinterpret_cast<const uint8 *>(src.data());
+  const uint8 *const end = p + src.size();
+  while (p < end) {
+    const int cc = p[0];
+    int c = 0;
+    if (0x4b <= cc && cc < 0x9f) {
+      c = 0x3041 + cc - 0x4b;
+      p += 1;
+    } else if (0x9f <= cc && cc < 0xfc) {
+      c = 0x30a1 + cc - 0x9f;
+      p += 1;
+    } else if (cc == 0xfc) {
+      c = p[1];
+      p += 2;
+    } else if (cc == 0xfd) {
+      c = p[1] << 8;
+      p += 2;
+    } else if (cc == 0xff) {
+      c = (p[1] & 0x1f) << 16;
+      int pos = 2;
+      if (!(p[1] & 0x80)) {
+        c += p[pos++] << 8;
+      }
+      if (!(p[1] & 0x40)) {
+        c += p[pos++];
+      }
+      p += pos;
+    } else if (cc == 0xfe) {
+      c = (p[1] << 8) + p[2];
+      p += 3;
+    } else {
+      c = ((cc - 0x01) << 8) + 0x4e00 + p[1];
+      p += 2;
+    }
+    Util::UCS4ToUTF8Append(c, dst);
+  }
+}
+
+template <size_t N>
+std::vector<std::string> Encode(const char *const (&strs)[N], bool is_key) {
+  const SystemDictionaryCodec codec;
+  std::vector<std::string> encoded(N);
+  for (size_t i = 0; i < N; ++i) {
+    if (is_key) {
+      codec.EncodeKey(strs[i], &encoded[i]);
+    } else {
+      codec.EncodeValue(strs[i], &encoded[i]);
+    }
+  }
+  return encoded;
+}
+
+int64 TotalSize(const std::vector<std::string> &strs) {
+  int64 size = 0;
+  for (const std::string &str : strs) {
+    size += str.size();
+  }
+  return size;
+}
+
+void BM_DecodeKey(benchmark::State &state) {
+  const SystemDictionaryCodec codec;
+  const std::vector<std::string> encoded = Encode(kKeys, true);
+  const Decoder decoder = static_cast<Decoder>(state.range(0));
+  std::string decoded;
+  for (auto _ : state) {
+    for (const std::string &key : encoded) {
+      decoded.clear();
+      if (decoder == TABLE) {
+        codec.DecodeKey(key, &decoded);
+      } else {
+        codec.EncodeKey(key, &decoded);
+      }
+      benchmark::DoNotOptimize(decoded.data());
+    }
+  }
+  state.SetBytesProcessed(state.iterations() * TotalSize(encoded));
+}
+BENCHMARK(BM_DecodeKey)->Arg(TABLE)->Arg(BY_CHAR);
+
+void BM_DecodeValue(benchmark::State &state) {
+  const SystemDictionaryCodec codec;
+  const std::vector<std::string> encoded = Encode(kValues, false);
+  const Decoder decoder = static_cast<Decoder>(state.range(0));
+  std::string decoded;
+  for (auto _ : state) {
+    for (const std::string &value : encoded) {
+      decoded.clear();
+      if (decoder == TABLE) {
+        codec.DecodeValue(value, &decoded);
+      } else {
+        DecodeValueByChar(value, &decoded);
+      }
+      benchmark::DoNotOptimize(decoded.data());
+    }
+  }
+  state.SetBytesProcessed(state.iterations() * TotalSize(encoded));
+}
+BENCHMARK(BM_DecodeValue)->Arg(TABLE)->Arg(BY_CHAR);
+
+// Long kana-only values, where the vectorized run detection matters most.
+void BM_DecodeLongKanaValue(benchmark::State &state) {
+  const SystemDictionaryCodec codec;
+  std::string value;
+  for (const char *key : kKeys) {
+    std::string katakana;
+    Util::HiraganaToKatakana(key, &katakana);
+    value.append(katakana);
+  }
+  std::string encoded;
+  codec.EncodeValue(value, &encoded);
+  const Decoder decoder = static_cast<Decoder>(state.range(0));
+  std::string decoded;
+  for (auto _ : state) {
+    decoded.clear();
+    if (decoder == TABLE) {
+      codec.DecodeValue(encoded, &decoded);
+    } else {
+      DecodeValueByChar(encoded, &decoded);
+    }
+    benchmark::DoNotOptimize(decoded.data());
+  }
+  state.SetBytesProcessed(state.iterations() * encoded.size());
+}
+BENCHMARK(BM_DecodeLongKanaValue)->Arg(TABLE)->Arg(BY_CHAR);
+
+// Decodes all the values at once with DecodeValues().
+void BM_DecodeValues(benchmark::State &state) {
+  const SystemDictionaryCodec codec;
+  const std::vector<std::string> encoded = Encode(kValues, false);
+  const std::vector<absl::string_view> src(encoded.begin(), encoded.end());
+  std::vector<std::string> decoded;
+  for (auto _ : state) {
+    codec.DecodeValues(src, &decoded);
+    benchmark::DoNotOptimize(decoded.data());
+  }
+  state.SetBytesProcessed(state.iterations() * TotalSize(encoded));
+}
+BENCHMARK(BM_DecodeValues);
+
+}  // namespace
+}  // namespace dictionary
+}  // namespace mozc
@@ -59,6 +59,12 @@ class SystemDictionaryCodecInterface {
   // Return section name for frequent pos map
   virtual const std::string GetSectionNameForPos() const = 0;
 
+  // Return section name for the optional reverse lookup index
+  virtual const std::string GetSectionNameForReverseLookupIndex() const = 0;
+
+  // Return section name for the optional predictive cost index
+  virtual const std::string GetSectionNameForPredictiveCostIndex() const = 0;
+
   // Encode value(word) string
   virtual void EncodeValue(const absl::string_view src,
                            std::string *dst) const = 0;
@@ -316,6 +316,12 @@ class SystemDictionaryCodecMock : public SystemDictionaryCodecInterface {
   const std::string GetSectionNameForValue() const { return "Mock"; }
   const std::string GetSectionNameForTokens() const { return "Mock"; }
   const std::string GetSectionNameForPos() const { return "Mock"; }
+  const std::string GetSectionNameForReverseLookupIndex() const {
+    return "Mock";
+  }
+  const std::string GetSectionNameForPredictiveCostIndex() const {
+    return "Mock";
+  }
   void EncodeKey(const absl::string_view src, std::string *dst) const override {
   }
   void DecodeKey(const absl::string_view src, std::string *dst) const override {
@@ -427,6 +433,95 @@ TEST_F(SystemDictionaryCodecTest, ValueCodecAsciiTest) {
   EXPECT_EQ(original, decoded);
 }
 
+// Returns a random string mixing the character classes which are encoded
+// differently.  Long runs of kana are included to exercise the vectorized
+// decoding.
+std::string MakeRandomString(size_t max_length) {
+  std::string result;
+  const size_t length = Util::Random(max_length + 1);
+  for (size_t i = 0; i < length; ++i) {
+    char32 c = 0;
+    switch (Util::Random(8)) {
+      case 0:
+      case 1:
+      case 2:
+        c = 0x3041 + Util::Random(0x30fd - 0x3041);  // Kana and symbols
+        break;
+      case 3:
+        c = 0x4e00 + Util::Random(0xa000 - 0x4e00);  // Kanji
+        break;
+      case 4:
+        c = 0x01 + Util::Random(0x7f);  // ASCII
+        break;
+      case 5:
+        c = (1 + Util::Random(0xff)) << 8;  // 0x??00
+        break;
+      case 6:
+        c = 0x80 + Util::Random(0xd800 - 0x80);  // Other BMP
+        break;
+      default:
+        c = 0x10000 + Util::Random(0x100000);  // Beyond BMP
+        break;
+    }
+    Util::UCS4ToUTF8Append(c, &result);
+  }
+  return result;
+}
+
+TEST_F(SystemDictionaryCodecTest, RandomRoundTripTest) {
+  std::unique_ptr<SystemDictionaryCodec> codec(new SystemDictionaryCodec);
+  Util::SetRandomSeed(0);
+  for (size_t i = 0; i < 10000; ++i) {
+    const std::string original = MakeRandomString(80);
+
+    std::string encoded, decoded;
+    codec->EncodeKey(original, &encoded);
+    codec->DecodeKey(encoded, &decoded);
+    EXPECT_EQ(original, decoded);
+    EXPECT_EQ(decoded.size(), codec->GetDecodedKeyLength(encoded));
+
+    encoded.clear();
+    decoded.clear();
+    codec->EncodeValue(original, &encoded);
+    codec->DecodeValue(encoded, &decoded);
+    EXPECT_EQ(original, decoded);
+
+    // Decoding appends to the output.
+    const std::string prefix = "prefix";
+    decoded = prefix;
+    codec->DecodeValue(encoded, &decoded);
+    EXPECT_EQ(prefix + original, decoded);
+  }
+}
+
+TEST_F(SystemDictionaryCodecTest, DecodeKeysAndValuesTest) {
+  std::unique_ptr<SystemDictionaryCodec> codec(new SystemDictionaryCodec);
+  Util::SetRandomSeed(0);
+  std::vector<std::string> originals, encoded_keys, encoded_values;
+  for (size_t i = 0; i < 100; ++i) {
+    originals.push_back(MakeRandomString(40));
+    encoded_keys.emplace_back();
+    codec->EncodeKey(originals.back(), &encoded_keys.back());
+    encoded_values.emplace_back();
+    codec->EncodeValue(originals.back(), &encoded_values.back());
+  }
+  const std::vector<absl::string_view> keys(encoded_keys.begin(),
+                                            encoded_keys.end());
+  const std::vector<absl::string_view> values(encoded_values.begin(),
+                                              encoded_values.end());
+
+  // The previous contents of the output are discarded.
+  std::vector<std::string> decoded(3, "garbage");
+  codec->DecodeKeys(keys, &decoded);
+  EXPECT_EQ(originals, decoded);
+  decoded.assign(200, "garbage");
+  codec->DecodeValues(values, &decoded);
+  EXPECT_EQ(originals, decoded);
+
+  codec->DecodeValues(std::vector<absl::string_view>(), &decoded);
+  EXPECT_TRUE(decoded.empty());
+}
+
 TEST_F(SystemDictionaryCodecTest, TokenDefaultPosTest) {
   SystemDictionaryCodecInterface *codec =
       SystemDictionaryCodecFactory::GetCodec();
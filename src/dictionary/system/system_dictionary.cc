@@ -52,6 +52,7 @@
 #include <map>
 #include <memory>
 #include <queue>
+#include <set>
 #include <string>
 #include <utility>
 #include <vector>
@@ -482,6 +483,13 @@ SystemDictionary::SystemDictionary(
     const SystemDictionaryCodecInterface *codec,
     const DictionaryFileCodecInterface *file_codec)
     : frequent_pos_(nullptr),
+      reverse_lookup_offsets_(nullptr),
+      reverse_lookup_key_ids_(nullptr),
+      reverse_lookup_num_values_(0),
+      predictive_key_costs_(nullptr),
+      predictive_cost_bounds_(nullptr),
+      predictive_cost_bounds_size_(0),
+      predictive_cost_bounds_shift_(0),
       codec_(codec),
       dictionary_file_(new DictionaryFile(file_codec)) {}
 
@@ -522,10 +530,78 @@ bool SystemDictionary::OpenDictionaryFile(bool enable_reverse_lookup_index) {
     return false;
   }
 
-  if (enable_reverse_lookup_index) {
+  // The reverse lookup index section is optional.  When it's available, we
+  // don't need to build the index at runtime.
+  if (!OpenReverseLookupIndexSection() && enable_reverse_lookup_index) {
     InitReverseLookupIndex();
   }
 
+  // The predictive cost index section is optional too.  Without it,
+  // LookupPredictive() collects keys in BFS order.
+  OpenPredictiveCostIndexSection();
+
+  return true;
+}
+
+bool SystemDictionary::OpenPredictiveCostIndexSection() {
+  int len = 0;
+  const uint8 *image = reinterpret_cast<const uint8 *>(
+      dictionary_file_->GetSection(
+          codec_->GetSectionNameForPredictiveCostIndex(), &len));
+  if (image == nullptr) {
+    return false;
+  }
+  const uint16 *key_costs = reinterpret_cast<const uint16 *>(image);
+  const int key_costs_len = (key_trie_.GetNumKeys() + 1) * sizeof(uint16);
+  if (len < key_costs_len || key_costs[0] > 15) {
+    LOG(ERROR) << "Broken predictive cost index section";
+    return false;
+  }
+  predictive_cost_bounds_shift_ = key_costs[0];
+  predictive_key_costs_ = key_costs + 1;
+  predictive_cost_bounds_ = image + key_costs_len;
+  predictive_cost_bounds_size_ = len - key_costs_len;
+  return true;
+}
+
+bool SystemDictionary::OpenReverseLookupIndexSection() {
+  int len = 0;
+  const uint32 *image = reinterpret_cast<const uint32 *>(
+      dictionary_file_->GetSection(
+          codec_->GetSectionNameForReverseLookupIndex(), &len));
+  if (image == nullptr) {
+    return false;
+  }
+  const size_t image_size = len / sizeof(uint32);
+  if (image_size < 2 || image_size < image[0] + 2 ||
+      image_size - image[0] - 2 < image[image[0] + 1]) {
+    LOG(ERROR) << "Broken reverse lookup index section";
+    return false;
+  }
+  // Offsets must be non-decreasing and every key id must refer to a key in
+  // the key trie, as FillResultMapFromReverseLookupIndexSection() reads them
+  // without bounds checks.
+  const uint32 num_values = image[0];
+  const uint32 *offsets = image + 1;
+  for (uint32 i = 0; i < num_values; ++i) {
+    if (offsets[i] > offsets[i + 1]) {
+      LOG(ERROR) << "Broken reverse lookup index section: offsets[" << i
+                 << "] is greater than the next one";
+      return false;
+    }
+  }
+  const uint32 num_keys = key_trie_.GetNumKeys();
+  const uint32 *key_ids = image + num_values + 2;
+  for (uint32 i = 0; i < offsets[num_values]; ++i) {
+    if (key_ids[i] >= num_keys) {
+      LOG(ERROR) << "Broken reverse lookup index section: key id "
+                 << key_ids[i] << " is out of range";
+      return false;
+    }
+  }
+  reverse_lookup_num_values_ = image[0];
+  reverse_lookup_offsets_ = image + 1;
+  reverse_lookup_key_ids_ = image + reverse_lookup_num_values_ + 2;
   return true;
 }
 
@@ -585,6 +661,12 @@ bool SystemDictionary::HasValue(absl::string_view value) const {
   for (TokenDecodeIterator iter(codec_, value_trie_, frequent_pos_, key,
                                 encoded_tokens_ptr);
        !iter.Done(); iter.Next()) {
+    // Values in value trie have been checked above.
+    const TokenInfo::ValueType value_type = iter.GetWithoutValue().value_type;
+    if (value_type == TokenInfo::DEFAULT_VALUE ||
+        value_type == TokenInfo::SAME_AS_PREV_VALUE) {
+      continue;
+    }
     const Token *token = iter.Get().token;
     if (value == token->value) {
       return true;
@@ -657,6 +739,331 @@ void SystemDictionary::CollectPredictiveNodesInBfsOrder(
   } while (!queue.empty());
 }
 
+int SystemDictionary::GetPredictiveCostBound(
+    const LoudsTrie::Node &node) const {
+  const int index = node.node_id() - 1;
+  if (index >= predictive_cost_bounds_size_) {
+    return 0;
+  }
+  return predictive_cost_bounds_[index] << predictive_cost_bounds_shift_;
+}
+
+void SystemDictionary::CollectPredictiveNodesInCostOrder(
+    absl::string_view encoded_key, const KeyExpansionTable &table, size_t limit,
+    std::vector<PredictiveLookupSearchState> *result) const {
+  // Nodes for |encoded_key| and its expanded keys.
+  std::vector<PredictiveLookupSearchState> roots, next_roots;
+  roots.push_back(PredictiveLookupSearchState(LoudsTrie::Node(), 0, false));
+  for (size_t key_pos = 0; key_pos < encoded_key.size() && !roots.empty();
+       ++key_pos) {
+    const char target_char = encoded_key[key_pos];
+    const ExpandedKey &chars = table.ExpandKey(target_char);
+    next_roots.clear();
+    for (PredictiveLookupSearchState &state : roots) {
+      for (key_trie_.MoveToFirstChild(&state.node);
+           key_trie_.IsValidNode(state.node);
+           key_trie_.MoveToNextSibling(&state.node)) {
+        const char c = key_trie_.GetEdgeLabelToParentNode(state.node);
+        if (!chars.IsHit(c)) {
+          continue;
+        }
+        next_roots.push_back(PredictiveLookupSearchState(
+            state.node, key_pos + 1, state.is_expanded || c != target_char));
+      }
+    }
+    roots.swap(next_roots);
+  }
+
+  // Best-first search where a subtree is represented by the lower bound of its
+  // costs and a key by its minimum token cost.  On a tie, subtrees are
+  // expanded first so that the keys of the same cost are found in the order
+  // of key ids.  Thus the order of the keys doesn't depend on |encoded_key|.
+  struct Entry {
+    int cost;
+    bool is_key;
+    int id;
+    PredictiveLookupSearchState state;
+  };
+  const auto greater = [](const Entry &x, const Entry &y) {
+    if (x.cost != y.cost) {
+      return x.cost > y.cost;
+    }
+    if (x.is_key != y.is_key) {
+      return x.is_key;
+    }
+    return x.id > y.id;
+  };
+  std::priority_queue<Entry, std::vector<Entry>, decltype(greater)> queue(
+      greater);
+  for (const PredictiveLookupSearchState &state : roots) {
+    queue.push({GetPredictiveCostBound(state.node), false,
+                state.node.node_id(), state});
+  }
+  while (!queue.empty()) {
+    const Entry entry = queue.top();
+    queue.pop();
+    if (entry.is_key) {
+      result->push_back(entry.state);
+      if (result->size() > limit) {
+        break;
+      }
+      continue;
+    }
+
+    LoudsTrie::Node node = entry.state.node;
+    if (key_trie_.IsTerminalNode(node)) {
+      const int key_id = key_trie_.GetKeyIdOfTerminalNode(node);
+      queue.push({predictive_key_costs_[key_id], true, key_id, entry.state});
+    }
+    for (key_trie_.MoveToFirstChild(&node); key_trie_.IsValidNode(node);
+         key_trie_.MoveToNextSibling(&node)) {
+      queue.push({GetPredictiveCostBound(node), false, node.node_id(),
+                  PredictiveLookupSearchState(node, entry.state.key_pos + 1,
+                                              entry.state.is_expanded)});
+    }
+  }
+}
+
+namespace {
+
+// Finds the nodes in a subtree of a trie whose keys, after the key of the
+// subtree root, are within a bounded edit distance from a query.  The search
+// is depth-first and keeps, for each node on the current path, the row of the
+// Levenshtein distance matrix between the query and the key of the node.  A subtree is pruned as soon as every entry of the row
+// exceeds the bound, or the distance can't be lowered in the subtree any more.
+// Since an edge of the trie has a byte, the distance is updated at the nodes
+// where a UTF-8 character of the key completes.
+class ApproximatePrefixFinder {
+ public:
+  // The node where the distance between the query and the key of the node
+  // becomes lower than that of all its ancestors.  All the keys in the
+  // subtree of |node| match the query with |num_edits| edits or fewer.
+  struct Match {
+    LoudsTrie::Node node;
+    // The length of the key of |node|.
+    size_t prefix_len;
+    int num_edits;
+  };
+
+  // |root| is the node of the first |root_depth| bytes of the keys, which
+  // aren't compared with |query|.
+  ApproximatePrefixFinder(const LoudsTrie &trie, LoudsTrie::Node root,
+                          size_t root_depth, absl::string_view query,
+                          int max_edits)
+      : trie_(trie), root_(root), root_depth_(root_depth),
+        max_edits_(max_edits) {
+    for (size_t pos = 0; pos < query.size();) {
+      const size_t len = std::min<size_t>(Util::OneCharLen(query.data() + pos),
+                                          query.size() - pos);
+      query_chars_.push_back(query.substr(pos, len));
+      pos += len;
+    }
+    row_size_ = query_chars_.size() + 1;
+    rows_.resize((LoudsTrie::kMaxDepth + 1) * row_size_);
+  }
+
+  ApproximatePrefixFinder(const ApproximatePrefixFinder &) = delete;
+  ApproximatePrefixFinder &operator=(const ApproximatePrefixFinder &) = delete;
+
+  // Appends the matches in depth-first order.  A match may be in the subtree
+  // of another match, where it has fewer edits.
+  void Find(std::vector<Match> *matches) {
+    // The root would match everything.
+    if (query_chars_.size() <= static_cast<size_t>(max_edits_) ||
+        root_depth_ >= LoudsTrie::kMaxDepth) {
+      return;
+    }
+    int *row = &rows_[root_depth_ * row_size_];
+    for (size_t i = 0; i < row_size_; ++i) {
+      row[i] = i;
+    }
+    FindInChildren(root_, root_depth_, root_depth_, row, max_edits_ + 1,
+                   matches);
+  }
+
+ private:
+  // |row| is the row for the key of the first |char_begin| bytes of the path,
+  // i.e., the complete characters, and |best| is the lowest distance found on
+  // the path so far.
+  void FindInChildren(LoudsTrie::Node node, size_t depth, size_t char_begin,
+                      const int *row, int best, std::vector<Match> *matches) {
+    if (depth >= LoudsTrie::kMaxDepth) {
+      return;
+    }
+    for (trie_.MoveToFirstChild(&node); trie_.IsValidNode(node);
+         trie_.MoveToNextSibling(&node)) {
+      path_[depth] = trie_.GetEdgeLabelToParentNode(node);
+      const size_t char_len = Util::OneCharLen(path_ + char_begin);
+      if (depth + 1 - char_begin < char_len) {
+        // In the middle of a character.
+        FindInChildren(node, depth + 1, char_begin, row, best, matches);
+        continue;
+      }
+      const absl::string_view c(path_ + char_begin, depth + 1 - char_begin);
+      int *next_row = &rows_[(depth + 1) * row_size_];
+      next_row[0] = row[0] + 1;
+      int min_distance = next_row[0];
+      for (size_t i = 1; i < row_size_; ++i) {
+        const int substitution =
+            row[i - 1] + (query_chars_[i - 1] == c ? 0 : 1);
+        next_row[i] =
+            std::min(std::min(row[i], next_row[i - 1]) + 1, substitution);
+        min_distance = std::min(min_distance, next_row[i]);
+      }
+      const int distance = next_row[row_size_ - 1];
+      int next_best = best;
+      if (distance < best) {
+        matches->push_back({node, depth + 1, distance});
+        next_best = distance;
+      }
+      // The distances in the subtree are not lower than |min_distance|.
+      if (min_distance < next_best) {
+        FindInChildren(node, depth + 1, depth + 1, next_row, next_best,
+                       matches);
+      }
+    }
+  }
+
+  const LoudsTrie &trie_;
+  const LoudsTrie::Node root_;
+  const size_t root_depth_;
+  const int max_edits_;
+  std::vector<absl::string_view> query_chars_;
+  size_t row_size_;
+  // rows_[d * row_size_ ...] is the row for the node at depth d.
+  std::vector<int> rows_;
+  char path_[LoudsTrie::kMaxDepth + 1];
+};
+
+}  // namespace
+
+void SystemDictionary::LookupPredictiveApproximate(
+    absl::string_view key, size_t exact_prefix_len, int max_edits,
+    const ConversionRequest &conversion_request, Callback *callback) const {
+  if (key.empty() || max_edits < 0 || exact_prefix_len > key.size()) {
+    return;
+  }
+  // The codec encodes a key character by character, so the encoded prefix is
+  // that of the encoded key.
+  std::string encoded_prefix, encoded_query;
+  codec_->EncodeKey(key.substr(0, exact_prefix_len), &encoded_prefix);
+  codec_->EncodeKey(key.substr(exact_prefix_len), &encoded_query);
+  if (encoded_prefix.size() + encoded_query.size() > LoudsTrie::kMaxDepth) {
+    return;
+  }
+  LoudsTrie::Node root;
+  if (!key_trie_.Traverse(encoded_prefix, &root)) {
+    return;
+  }
+
+  std::vector<ApproximatePrefixFinder::Match> matches;
+  ApproximatePrefixFinder(key_trie_, root, encoded_prefix.size(),
+                          encoded_query, max_edits)
+      .Find(&matches);
+  // Visit closer matches first.  A key under nested matches is reported only
+  // for the innermost one, which has the fewest edits.
+  std::stable_sort(matches.begin(), matches.end(),
+                   [](const ApproximatePrefixFinder::Match &lhs,
+                      const ApproximatePrefixFinder::Match &rhs) {
+                     return lhs.num_edits < rhs.num_edits;
+                   });
+
+  // The same limit for each match as LookupPredictive().
+  const size_t kLookupLimit = 64;
+  std::set<int> seen_key_ids;
+  std::vector<LoudsTrie::Node> nodes;
+  char encoded_actual_key_buffer[LoudsTrie::kMaxDepth + 1];
+  std::string decoded_key, actual_key;
+  for (const ApproximatePrefixFinder::Match &match : matches) {
+    // Collect the terminal nodes in the subtree in BFS order.
+    nodes.clear();
+    std::queue<LoudsTrie::Node> queue;
+    queue.push(match.node);
+    while (!queue.empty() && nodes.size() < kLookupLimit) {
+      LoudsTrie::Node node = queue.front();
+      queue.pop();
+      if (key_trie_.IsTerminalNode(node)) {
+        nodes.push_back(node);
+      }
+      for (key_trie_.MoveToFirstChild(&node); key_trie_.IsValidNode(node);
+           key_trie_.MoveToNextSibling(&node)) {
+        queue.push(node);
+      }
+    }
+
+    for (const LoudsTrie::Node &node : nodes) {
+      const int key_id = key_trie_.GetKeyIdOfTerminalNode(node);
+      if (!seen_key_ids.insert(key_id).second) {
+        continue;
+      }
+      const absl::string_view encoded_actual_key =
+          key_trie_.RestoreKeyString(node, encoded_actual_key_buffer);
+      actual_key.clear();
+      codec_->DecodeKey(encoded_actual_key, &actual_key);
+      const Callback::ResultType result =
+          callback->OnApproximateKey(actual_key, match.num_edits);
+      if (result == Callback::TRAVERSE_DONE) {
+        return;
+      }
+      if (result == Callback::TRAVERSE_NEXT_KEY) {
+        continue;
+      }
+      if (result == Callback::TRAVERSE_CULL) {
+        // Skip the rest of the keys of this match.
+        break;
+      }
+
+      // decoded_key = key + the rest of the actual key after the prefix that
+      // matched |key|.
+      decoded_key.assign(key.data(), key.size());
+      codec_->DecodeKey(encoded_actual_key.substr(match.prefix_len),
+                        &decoded_key);
+      switch (callback->OnKey(decoded_key)) {
+        case Callback::TRAVERSE_DONE:
+          return;
+        case Callback::TRAVERSE_NEXT_KEY:
+          continue;
+        case Callback::TRAVERSE_CULL:
+          LOG(FATAL) << "Culling is not implemented.";
+          continue;
+        default:
+          break;
+      }
+      switch (callback->OnActualKey(decoded_key, actual_key,
+                                    match.num_edits > 0)) {
+        case Callback::TRAVERSE_DONE:
+          return;
+        case Callback::TRAVERSE_NEXT_KEY:
+          continue;
+        case Callback::TRAVERSE_CULL:
+          LOG(FATAL) << "Culling is not implemented.";
+          continue;
+        default:
+          break;
+      }
+
+      for (TokenDecodeIterator iter(codec_, value_trie_, frequent_pos_,
+                                    actual_key,
+                                    GetTokenArrayPtr(token_array_, key_id));
+           !iter.Done(); iter.Next()) {
+        if (!callback->OnTokenWithoutValue(decoded_key, actual_key,
+                                           *iter.GetWithoutValue().token)) {
+          continue;
+        }
+        const Callback::ResultType result =
+            callback->OnToken(decoded_key, actual_key, *iter.Get().token);
+        if (result == Callback::TRAVERSE_DONE) {
+          return;
+        }
+        if (result == Callback::TRAVERSE_NEXT_KEY) {
+          break;
+        }
+        DCHECK_NE(Callback::TRAVERSE_CULL, result) << "Not implemented";
+      }
+    }
+  }
+}
+
 void SystemDictionary::LookupPredictive(
     absl::string_view key, const ConversionRequest &conversion_request,
     Callback *callback) const {
@@ -684,7 +1091,17 @@ void SystemDictionary::LookupPredictive(
   const size_t kLookupLimit = 64;
   std::vector<PredictiveLookupSearchState> result;
   result.reserve(kLookupLimit);
-  CollectPredictiveNodesInBfsOrder(encoded_key, table, kLookupLimit, &result);
+  if (predictive_key_costs_ != nullptr) {
+    CollectPredictiveNodesInCostOrder(encoded_key, table, kLookupLimit,
+                                      &result);
+  } else {
+    CollectPredictiveNodesInBfsOrder(encoded_key, table, kLookupLimit,
+                                     &result);
+  }
+  if (result.size() > kLookupLimit) {
+    // The collection stopped at the lookup limit, so some keys may be missing.
+    callback->OnLookupTruncated();
+  }
 
   // Reused buffer and instances inside the following loop.
   char encoded_actual_key_buffer[LoudsTrie::kMaxDepth + 1];
@@ -745,6 +1162,10 @@ void SystemDictionary::LookupPredictive(
                                   actual_key,
                                   GetTokenArrayPtr(token_array_, key_id));
          !iter.Done(); iter.Next()) {
+      if (!callback->OnTokenWithoutValue(decoded_key, actual_key,
+                                         *iter.GetWithoutValue().token)) {
+        continue;
+      }
       const TokenInfo &token_info = iter.Get();
       const Callback::ResultType result =
           callback->OnToken(decoded_key, actual_key, *token_info.token);
@@ -761,21 +1182,82 @@ void SystemDictionary::LookupPredictive(
 
 namespace {
 
-// An implementation of prefix search without key expansion.  Runs |callback|
-// for prefixes of |encoded_key| in |key_trie|.
+// Runs |callback| for the prefix of |key| that reaches the terminal |node| in
+// |key_trie|.  Returns false if the traversal for |key| should stop.
 // Args:
 //   key_trie, value_trie, token_array, codec, frequent_pos:
 //     Members in SystemDictionary.
 //   key:
 //     The head address of the original key before applying codec.
-//   encoded_key:
-//     The encoded |key|.
+//   encoded_prefix:
+//     The encoded prefix of |key| reaching |node|.
+//   node:
+//     A terminal node in |key_trie|.
 //   callback:
 //     A callback function to be called.
 //   token_filter:
 //     A functor of signature bool(const TokenInfo &).  Only tokens for which
 //     this functor returns true are passed to callback function.
 template <typename Func>
+bool RunCallbackOnPrefix(const LoudsTrie &key_trie, const LoudsTrie &value_trie,
+                         const BitVectorBasedArray &token_array,
+                         const SystemDictionaryCodecInterface *codec,
+                         const uint32 *frequent_pos, const char *key,
+                         absl::string_view encoded_prefix, LoudsTrie::Node node,
+                         DictionaryInterface::Callback *callback,
+                         Func token_filter) {
+  typedef DictionaryInterface::Callback Callback;
+  const absl::string_view prefix(key,
+                                 codec->GetDecodedKeyLength(encoded_prefix));
+
+  switch (callback->OnKey(prefix)) {
+    case Callback::TRAVERSE_DONE:
+    case Callback::TRAVERSE_CULL:
+      return false;
+    case Callback::TRAVERSE_NEXT_KEY:
+      return true;
+    default:
+      break;
+  }
+
+  switch (callback->OnActualKey(prefix, prefix, false)) {
+    case Callback::TRAVERSE_DONE:
+    case Callback::TRAVERSE_CULL:
+      return false;
+    case Callback::TRAVERSE_NEXT_KEY:
+      return true;
+    default:
+      break;
+  }
+
+  const int key_id = key_trie.GetKeyIdOfTerminalNode(node);
+  for (TokenDecodeIterator iter(codec, value_trie, frequent_pos, prefix,
+                                GetTokenArrayPtr(token_array, key_id));
+       !iter.Done(); iter.Next()) {
+    if (!callback->OnTokenWithoutValue(prefix, prefix,
+                                       *iter.GetWithoutValue().token)) {
+      continue;
+    }
+    const TokenInfo &token_info = iter.Get();
+    if (!token_filter(token_info)) {
+      continue;
+    }
+    const Callback::ResultType res =
+        callback->OnToken(prefix, prefix, *token_info.token);
+    if (res == Callback::TRAVERSE_DONE || res == Callback::TRAVERSE_CULL) {
+      return false;
+    }
+    if (res == Callback::TRAVERSE_NEXT_KEY) {
+      break;
+    }
+  }
+  return true;
+}
+
+// An implementation of prefix search without key expansion.  Runs |callback|
+// for prefixes of |encoded_key| in |key_trie|.  See RunCallbackOnPrefix() for
+// the arguments.
+template <typename Func>
 void RunCallbackOnEachPrefix(const LoudsTrie &key_trie,
                              const LoudsTrie &value_trie,
                              const BitVectorBasedArray &token_array,
@@ -784,7 +1266,6 @@ void RunCallbackOnEachPrefix(const LoudsTrie &key_trie,
                              absl::string_view encoded_key,
                              DictionaryInterface::Callback *callback,
                              Func token_filter) {
-  typedef DictionaryInterface::Callback Callback;
   LoudsTrie::Node node;
   for (absl::string_view::size_type i = 0; i < encoded_key.size();) {
     if (!key_trie.MoveToChildByLabel(encoded_key[i], &node)) {
@@ -794,46 +1275,10 @@ void RunCallbackOnEachPrefix(const LoudsTrie &key_trie,
     if (!key_trie.IsTerminalNode(node)) {
       continue;
     }
-    const absl::string_view encoded_prefix = encoded_key.substr(0, i);
-    const absl::string_view prefix(key,
-                                   codec->GetDecodedKeyLength(encoded_prefix));
-
-    switch (callback->OnKey(prefix)) {
-      case Callback::TRAVERSE_DONE:
-      case Callback::TRAVERSE_CULL:
-        return;
-      case Callback::TRAVERSE_NEXT_KEY:
-        continue;
-      default:
-        break;
-    }
-
-    switch (callback->OnActualKey(prefix, prefix, false)) {
-      case Callback::TRAVERSE_DONE:
-      case Callback::TRAVERSE_CULL:
-        return;
-      case Callback::TRAVERSE_NEXT_KEY:
-        continue;
-      default:
-        break;
-    }
-
-    const int key_id = key_trie.GetKeyIdOfTerminalNode(node);
-    for (TokenDecodeIterator iter(codec, value_trie, frequent_pos, prefix,
-                                  GetTokenArrayPtr(token_array, key_id));
-         !iter.Done(); iter.Next()) {
-      const TokenInfo &token_info = iter.Get();
-      if (!token_filter(token_info)) {
-        continue;
-      }
-      const Callback::ResultType res =
-          callback->OnToken(prefix, prefix, *token_info.token);
-      if (res == Callback::TRAVERSE_DONE || res == Callback::TRAVERSE_CULL) {
-        return;
-      }
-      if (res == Callback::TRAVERSE_NEXT_KEY) {
-        break;
-      }
+    if (!RunCallbackOnPrefix(key_trie, value_trie, token_array, codec,
+                             frequent_pos, key, encoded_key.substr(0, i), node,
+                             callback, token_filter)) {
+      return;
     }
   }
 }
@@ -927,6 +1372,10 @@ SystemDictionary::LookupPrefixWithKeyExpansionImpl(
                                   *actual_prefix,
                                   GetTokenArrayPtr(token_array_, key_id));
          !iter.Done(); iter.Next()) {
+      if (!callback->OnTokenWithoutValue(prefix, *actual_prefix,
+                                         *iter.GetWithoutValue().token)) {
+        continue;
+      }
       const TokenInfo &token_info = iter.Get();
       result = callback->OnToken(prefix, *actual_prefix, *token_info.token);
       if (result == Callback::TRAVERSE_DONE ||
@@ -984,6 +1433,37 @@ void SystemDictionary::LookupPrefix(absl::string_view key,
       LoudsTrie::Node(), 0, false, actual_key_buffer, &actual_prefix);
 }
 
+void SystemDictionary::LookupPrefixBatch(
+    const std::vector<absl::string_view> &keys,
+    const ConversionRequest &conversion_request,
+    const std::vector<Callback *> &callbacks) const {
+  DCHECK_EQ(keys.size(), callbacks.size());
+  if (conversion_request.IsKanaModifierInsensitiveConversion()) {
+    // Key expansion branches the traversal, so look up the keys one by one.
+    DictionaryInterface::LookupPrefixBatch(keys, conversion_request, callbacks);
+    return;
+  }
+
+  std::vector<std::string> encoded_keys(keys.size());
+  std::vector<absl::string_view> encoded_key_views;
+  encoded_key_views.reserve(keys.size());
+  for (size_t i = 0; i < keys.size(); ++i) {
+    codec_->EncodeKey(keys[i], &encoded_keys[i]);
+    encoded_key_views.push_back(encoded_keys[i]);
+  }
+  key_trie_.PrefixSearchMulti(
+      encoded_key_views,
+      [this, &keys, &callbacks](size_t key_index, absl::string_view encoded_key,
+                                absl::string_view::size_type prefix_len,
+                                const LoudsTrie &key_trie,
+                                LoudsTrie::Node node) {
+        return RunCallbackOnPrefix(key_trie, value_trie_, token_array_, codec_,
+                                   frequent_pos_, keys[key_index].data(),
+                                   encoded_key.substr(0, prefix_len), node,
+                                   callbacks[key_index], SelectAllTokens());
+      });
+}
+
 void SystemDictionary::LookupExact(absl::string_view key,
                                    const ConversionRequest &conversion_request,
                                    Callback *callback) const {
@@ -1002,6 +1482,10 @@ void SystemDictionary::LookupExact(absl::string_view key,
   for (TokenDecodeIterator iter(codec_, value_trie_, frequent_pos_, key,
                                 GetTokenArrayPtr(token_array_, key_id));
        !iter.Done(); iter.Next()) {
+    if (!callback->OnTokenWithoutValue(key, key,
+                                       *iter.GetWithoutValue().token)) {
+      continue;
+    }
     if (callback->OnToken(key, key, *iter.Get().token) !=
         Callback::TRAVERSE_CONTINUE) {
       break;
@@ -1042,7 +1526,7 @@ inline void AddKeyIdsOfAllPrefixes(const LoudsTrie &trie, absl::string_view key,
 }  // namespace
 
 void SystemDictionary::PopulateReverseLookupCache(absl::string_view str) const {
-  if (reverse_lookup_index_ != nullptr) {
+  if (reverse_lookup_offsets_ != nullptr || reverse_lookup_index_ != nullptr) {
     // We don't need to prepare cache for the current reverse conversion,
     // as we have already built the index for reverse lookup.
     return;
@@ -1122,7 +1606,10 @@ void SystemDictionary::RegisterReverseLookupTokensForValue(
 
   ReverseLookupCache *results = nullptr;
   ReverseLookupCache non_cached_results;
-  if (reverse_lookup_index_ != nullptr) {
+  if (reverse_lookup_offsets_ != nullptr) {
+    FillResultMapFromReverseLookupIndexSection(id_set, &non_cached_results);
+    results = &non_cached_results;
+  } else if (reverse_lookup_index_ != nullptr) {
     reverse_lookup_index_->FillResultMap(id_set, &non_cached_results.results);
     results = &non_cached_results;
   } else if (reverse_lookup_cache_ != nullptr &&
@@ -1152,6 +1639,29 @@ void SystemDictionary::ScanTokens(const std::set<int> &id_set,
   }
 }
 
+void SystemDictionary::FillResultMapFromReverseLookupIndexSection(
+    const std::set<int> &id_set, ReverseLookupCache *cache) const {
+  const uint8 *encoded_tokens_ptr = GetTokenArrayPtr(token_array_, 0);
+  for (std::set<int>::const_iterator itr = id_set.begin(); itr != id_set.end();
+       ++itr) {
+    const int value_id = *itr;
+    if (value_id < 0 ||
+        static_cast<uint32>(value_id) >= reverse_lookup_num_values_) {
+      continue;
+    }
+    const uint32 begin = reverse_lookup_offsets_[value_id];
+    const uint32 end = reverse_lookup_offsets_[value_id + 1];
+    for (uint32 i = begin; i < end; ++i) {
+      ReverseLookupResult lookup_result;
+      lookup_result.id_in_key_trie = reverse_lookup_key_ids_[i];
+      lookup_result.tokens_offset =
+          GetTokenArrayPtr(token_array_, lookup_result.id_in_key_trie) -
+          encoded_tokens_ptr;
+      cache->results.insert(std::make_pair(value_id, lookup_result));
+    }
+  }
+}
+
 void SystemDictionary::RegisterReverseLookupResults(
     const std::set<int> &id_set, const ReverseLookupCache &cache,
     Callback *callback) const {
@@ -1177,12 +1687,13 @@ void SystemDictionary::RegisterReverseLookupResults(
                codec_, value_trie_, frequent_pos_, tokens_key,
                encoded_tokens_ptr + reverse_result.tokens_offset);
            !iter.Done(); iter.Next()) {
-        const TokenInfo &token_info = iter.Get();
+        // Both are available without decoding the value.
+        const TokenInfo &token_info = iter.GetWithoutValue();
         if (token_info.token->attributes & Token::SPELLING_CORRECTION ||
             token_info.id_in_value_trie != value_id) {
           continue;
         }
-        callback->OnToken(tokens_key, tokens_key, *token_info.token);
+        callback->OnToken(tokens_key, tokens_key, *iter.Get().token);
       }
     }
   }
@@ -90,8 +90,10 @@
         'system_dictionary_builder.cc',
       ],
       'dependencies': [
+        '../../base/base.gyp:base',
         '../../base/base.gyp:base_core',
         '../../storage/louds/louds.gyp:bit_vector_based_array_builder',
+        '../../storage/louds/louds.gyp:louds_trie',
         '../../storage/louds/louds.gyp:louds_trie_builder',
         '../dictionary_base.gyp:pos_matcher',
         '../dictionary_base.gyp:text_dictionary_loader',
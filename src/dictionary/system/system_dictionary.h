@@ -112,10 +112,24 @@ class SystemDictionary : public DictionaryInterface {
                         const ConversionRequest &conversion_request,
                         Callback *callback) const override;
 
+  // Finds the matching prefixes in one depth-first traversal of the key trie,
+  // which computes the edit distance to |key| along the way; see .cc file.
+  void LookupPredictiveApproximate(absl::string_view key,
+                                   size_t exact_prefix_len, int max_edits,
+                                   const ConversionRequest &conversion_request,
+                                   Callback *callback) const override;
+
   void LookupPrefix(absl::string_view key,
                     const ConversionRequest &conversion_request,
                     Callback *callback) const override;
 
+  // Walks the key trie for all the keys at once; see
+  // LoudsTrie::PrefixSearchMulti().
+  void LookupPrefixBatch(const std::vector<absl::string_view> &keys,
+                         const ConversionRequest &conversion_request,
+                         const std::vector<Callback *> &callbacks)
+      const override;
+
   void LookupExact(absl::string_view key,
                    const ConversionRequest &conversion_request,
                    Callback *callback) const override;
@@ -146,6 +160,10 @@ class SystemDictionary : public DictionaryInterface {
                                     const ReverseLookupCache &cache,
                                     Callback *callback) const;
   void InitReverseLookupIndex();
+  bool OpenReverseLookupIndexSection();
+  bool OpenPredictiveCostIndexSection();
+  void FillResultMapFromReverseLookupIndexSection(
+      const std::set<int> &id_set, ReverseLookupCache *cache) const;
 
   Callback::ResultType LookupPrefixWithKeyExpansionImpl(
       const char *key, absl::string_view encoded_key,
@@ -158,10 +176,31 @@ class SystemDictionary : public DictionaryInterface {
       absl::string_view encoded_key, const KeyExpansionTable &table,
       size_t limit, std::vector<PredictiveLookupSearchState> *result) const;
 
+  // Same as CollectPredictiveNodesInBfsOrder() but collects the keys in the
+  // ascending order of their minimum token costs, using the predictive cost
+  // index to skip the subtrees that have no cheaper keys.
+  void CollectPredictiveNodesInCostOrder(
+      absl::string_view encoded_key, const KeyExpansionTable &table,
+      size_t limit, std::vector<PredictiveLookupSearchState> *result) const;
+
+  // Returns a lower bound of the token costs in the subtree of |node|.
+  int GetPredictiveCostBound(const storage::louds::LoudsTrie::Node &node) const;
+
   storage::louds::LoudsTrie key_trie_;
   storage::louds::LoudsTrie value_trie_;
   storage::louds::BitVectorBasedArray token_array_;
   const uint32 *frequent_pos_;
+  // Reverse lookup index embedded in the dictionary file, if any.  See
+  // SystemDictionaryBuilder::BuildReverseLookupIndex() for the layout.
+  const uint32 *reverse_lookup_offsets_;
+  const uint32 *reverse_lookup_key_ids_;
+  uint32 reverse_lookup_num_values_;
+  // Predictive cost index embedded in the dictionary file, if any.  See
+  // SystemDictionaryBuilder::BuildPredictiveCostIndex() for the layout.
+  const uint16 *predictive_key_costs_;
+  const uint8 *predictive_cost_bounds_;
+  int predictive_cost_bounds_size_;
+  int predictive_cost_bounds_shift_;
   const SystemDictionaryCodecInterface *codec_;
   KeyExpansionTable hiragana_expansion_table_;
   std::unique_ptr<DictionaryFile> dictionary_file_;
@@ -27,3 +27,301 @@
 // (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
 // OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
+// Measures the lookup methods of SystemDictionary on the OSS data set.
+// Each iteration is one lookup, so the reported time is ns per lookup, and
+// the "tokens" counter is the rate of the tokens passed to the callback.
+//
+// The keys are taken from typical input sentences:
+// - LookupPrefix: the rest of the input from every character position, as
+//   the converter does when it builds a lattice, truncated to the given
+//   number of characters.
+// - LookupPredictive: the first characters of the words of the sentences.
+// - LookupExact: the words of the sentences.
+// - LookupReverse: the surface forms of the words.
+// The second argument selects kana-modifier-insensitive key expansion,
+// e.g., "は" also matches "ば" and "ぱ".
+//
+// BM_LookupPredictiveOrder compares the orders in which LookupPredictive()
+// collects keys, BFS and cost order (--build_predictive_cost_index), on
+// dictionaries built from the first file of the OSS dictionary source.
+
+#include <memory>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "base/flags.h"
+#include "base/logging.h"
+#include "base/port.h"
+#include "base/util.h"
+#include "data_manager/oss/oss_data_manager.h"
+#include "dictionary/dictionary_interface.h"
+#include "dictionary/pos_matcher.h"
+#include "dictionary/system/system_dictionary.h"
+#include "dictionary/system/system_dictionary_builder.h"
+#include "dictionary/text_dictionary_loader.h"
+#include "protocol/commands.pb.h"
+#include "protocol/config.pb.h"
+#include "request/conversion_request.h"
+#include "testing/base/public/mozctest.h"
+#include "benchmark/benchmark.h"
+#include "absl/strings/string_view.h"
+
+DECLARE_bool(build_predictive_cost_index);
+
+namespace mozc {
+namespace dictionary {
+namespace {
+
+// Words of typical input sentences, separated by "|", and their surface forms
+// for reverse lookup.
+constexpr const char *kSentences[] = {
+    "わたしの|なまえは|なかのです",
+    "きょうは|いい|てんきですね",
+    "あした|かいぎしつで|うちあわせを|します",
+    "しりょうを|めーるで|おくって|ください",
+    "よろしく|おねがい|いたします",
+    "でんしゃが|おくれて|いるので|すこし|ちこくします",
+    "らいしゅうの|よていを|かくにんさせて|ください",
+    "にほんごの|にゅうりょくは|むずかしい",
+    "とうきょうから|おおさかまで|しんかんせんで|いきます",
+    "この|ぷろぐらむの|せいのうを|そくていする",
+    "がっこうの|ともだちと|ばすけっとぼーるを|した",
+    "ぱそこんが|こしょうして|しまった",
+};
+
+constexpr const char *kSurfaces[] = {
+    "私",   "名前", "中野", "今日", "天気", "明日", "会議室", "打ち合わせ",
+    "資料", "送って", "電車", "遅れて", "来週", "予定", "確認", "日本語",
+    "入力", "東京", "大阪", "新幹線", "性能", "測定", "学校", "友達",
+};
+
+enum KeyExpansion {
+  NO_EXPANSION = 0,
+  KANA_MODIFIER_INSENSITIVE = 1,
+};
+
+enum LookupOrder {
+  BFS_ORDER = 0,
+  COST_ORDER = 1,
+};
+
+// Counts the tokens found.
+class CountingCallback : public DictionaryInterface::Callback {
+ public:
+  CountingCallback() : num_tokens_(0) {}
+
+  ResultType OnToken(absl::string_view key, absl::string_view actual_key,
+                     const Token &token) override {
+    ++num_tokens_;
+    return TRAVERSE_CONTINUE;
+  }
+
+  int64 num_tokens() const { return num_tokens_; }
+
+ private:
+  int64 num_tokens_;
+};
+
+const oss::OssDataManager &GetDataManager() {
+  static const oss::OssDataManager *data_manager = new oss::OssDataManager();
+  return *data_manager;
+}
+
+std::unique_ptr<SystemDictionary> CreateSystemDictionary(
+    SystemDictionary::Options options) {
+  const char *data = nullptr;
+  int size = 0;
+  GetDataManager().GetSystemDictionaryData(&data, &size);
+  auto status_or_dictionary =
+      SystemDictionary::Builder(data, size).SetOptions(options).Build();
+  CHECK(status_or_dictionary.ok()) << status_or_dictionary.status();
+  return std::move(status_or_dictionary).value();
+}
+
+// Returns the image of the dictionary built from dictionary00.txt of the OSS
+// dictionary source for |order|.  The images are built once.
+const std::string &GetDictionaryImageFromSource(LookupOrder order) {
+  static const std::string *images = []() {
+    const POSMatcher pos_matcher(GetDataManager().GetPOSMatcherData());
+    TextDictionaryLoader loader(pos_matcher);
+    loader.Load(testing::GetSourceFileOrDie(
+                    {"data", "dictionary_oss", "dictionary00.txt"}),
+                "");
+    std::string *result = new std::string[2];
+    for (const LookupOrder build_order : {BFS_ORDER, COST_ORDER}) {
+      mozc::SetFlag(&FLAGS_build_predictive_cost_index,
+                    build_order == COST_ORDER);
+      SystemDictionaryBuilder builder;
+      builder.BuildFromTokens(loader.tokens());
+      std::ostringstream stream;
+      builder.WriteToStream("", &stream);
+      result[build_order] = stream.str();
+    }
+    mozc::SetFlag(&FLAGS_build_predictive_cost_index, false);
+    return result;
+  }();
+  return images[order];
+}
+
+std::vector<std::string> GetWords() {
+  std::vector<std::string> words;
+  for (const char *sentence : kSentences) {
+    std::vector<std::string> parts;
+    Util::SplitStringUsing(sentence, "|", &parts);
+    words.insert(words.end(), parts.begin(), parts.end());
+  }
+  return words;
+}
+
+// Returns the suffixes of the sentences starting at every character, each
+// truncated to |max_chars| characters.
+std::vector<std::string> GetPrefixLookupKeys(size_t max_chars) {
+  std::vector<std::string> keys;
+  for (const char *sentence : kSentences) {
+    std::string text;
+    Util::StringReplace(sentence, "|", "", true, &text);
+    const size_t len = Util::CharsLen(text);
+    for (size_t i = 0; i < len; ++i) {
+      keys.emplace_back(Util::Utf8SubString(text, i, max_chars));
+    }
+  }
+  return keys;
+}
+
+// Returns the first |num_chars| characters of the words.
+std::vector<std::string> GetPredictiveLookupKeys(size_t num_chars) {
+  std::vector<std::string> keys;
+  for (const std::string &word : GetWords()) {
+    keys.emplace_back(Util::Utf8SubString(word, 0, num_chars));
+  }
+  return keys;
+}
+
+// Holds the request and the config for |expansion|.
+class RequestHolder {
+ public:
+  explicit RequestHolder(KeyExpansion expansion) {
+    request_.set_kana_modifier_insensitive_conversion(
+        expansion == KANA_MODIFIER_INSENSITIVE);
+    config_.set_use_kana_modifier_insensitive_conversion(
+        expansion == KANA_MODIFIER_INSENSITIVE);
+    conversion_request_.set_request(&request_);
+    conversion_request_.set_config(&config_);
+  }
+
+  const ConversionRequest &conversion_request() const {
+    return conversion_request_;
+  }
+
+ private:
+  commands::Request request_;
+  config::Config config_;
+  ConversionRequest conversion_request_;
+
+  DISALLOW_COPY_AND_ASSIGN(RequestHolder);
+};
+
+// Sets the arguments {key length in characters, KeyExpansion}.
+void KeyLengthAndExpansionArgs(benchmark::internal::Benchmark *benchmark,
+                               const std::vector<int> &key_lengths) {
+  benchmark->ArgNames({"chars", "expansion"});
+  for (int key_length : key_lengths) {
+    benchmark->Args({key_length, NO_EXPANSION});
+    benchmark->Args({key_length, KANA_MODIFIER_INSENSITIVE});
+  }
+}
+
+using LookupMethod = void (SystemDictionary::*)(absl::string_view,
+                                                const ConversionRequest &,
+                                                DictionaryInterface::Callback *)
+    const;
+
+// Runs |method| for |keys| in turn, one key per iteration.
+void RunLookup(benchmark::State &state, const SystemDictionary &dictionary,
+               LookupMethod method, const std::vector<std::string> &keys,
+               KeyExpansion expansion) {
+  CHECK(!keys.empty());
+  const RequestHolder holder(expansion);
+  CountingCallback callback;
+  size_t index = 0;
+  for (auto _ : state) {
+    (dictionary.*method)(keys[index], holder.conversion_request(), &callback);
+    if (++index == keys.size()) {
+      index = 0;
+    }
+  }
+  state.SetItemsProcessed(state.iterations());
+  state.counters["tokens"] = benchmark::Counter(
+      static_cast<double>(callback.num_tokens()), benchmark::Counter::kIsRate);
+}
+
+void BM_LookupPrefix(benchmark::State &state) {
+  const std::unique_ptr<SystemDictionary> dictionary =
+      CreateSystemDictionary(SystemDictionary::NONE);
+  RunLookup(state, *dictionary, &SystemDictionary::LookupPrefix,
+            GetPrefixLookupKeys(state.range(0)),
+            static_cast<KeyExpansion>(state.range(1)));
+}
+BENCHMARK(BM_LookupPrefix)->Apply([](benchmark::internal::Benchmark *b) {
+  KeyLengthAndExpansionArgs(b, {4, 8, 16, 32});
+});
+
+void BM_LookupPredictive(benchmark::State &state) {
+  const std::unique_ptr<SystemDictionary> dictionary =
+      CreateSystemDictionary(SystemDictionary::NONE);
+  RunLookup(state, *dictionary, &SystemDictionary::LookupPredictive,
+            GetPredictiveLookupKeys(state.range(0)),
+            static_cast<KeyExpansion>(state.range(1)));
+}
+BENCHMARK(BM_LookupPredictive)->Apply([](benchmark::internal::Benchmark *b) {
+  KeyLengthAndExpansionArgs(b, {1, 2, 3, 5});
+});
+
+void BM_LookupPredictiveOrder(benchmark::State &state) {
+  const std::string &image =
+      GetDictionaryImageFromSource(static_cast<LookupOrder>(state.range(1)));
+  auto status_or_dictionary =
+      SystemDictionary::Builder(image.data(), image.size()).Build();
+  CHECK(status_or_dictionary.ok()) << status_or_dictionary.status();
+  RunLookup(state, *status_or_dictionary.value(),
+            &SystemDictionary::LookupPredictive,
+            GetPredictiveLookupKeys(state.range(0)), NO_EXPANSION);
+}
+BENCHMARK(BM_LookupPredictiveOrder)
+    ->ArgNames({"chars", "order"})
+    ->Args({1, BFS_ORDER})
+    ->Args({1, COST_ORDER})
+    ->Args({2, BFS_ORDER})
+    ->Args({2, COST_ORDER})
+    ->Args({3, BFS_ORDER})
+    ->Args({3, COST_ORDER});
+
+void BM_LookupExact(benchmark::State &state) {
+  const std::unique_ptr<SystemDictionary> dictionary =
+      CreateSystemDictionary(SystemDictionary::NONE);
+  RunLookup(state, *dictionary, &SystemDictionary::LookupExact, GetWords(),
+            static_cast<KeyExpansion>(state.range(0)));
+}
+BENCHMARK(BM_LookupExact)
+    ->ArgNames({"expansion"})
+    ->Arg(NO_EXPANSION)
+    ->Arg(KANA_MODIFIER_INSENSITIVE);
+
+void BM_LookupReverse(benchmark::State &state) {
+  const std::unique_ptr<SystemDictionary> dictionary = CreateSystemDictionary(
+      static_cast<SystemDictionary::Options>(state.range(0)));
+  const std::vector<std::string> keys(std::begin(kSurfaces),
+                                      std::end(kSurfaces));
+  RunLookup(state, *dictionary, &SystemDictionary::LookupReverse, keys,
+            NO_EXPANSION);
+}
+BENCHMARK(BM_LookupReverse)
+    ->ArgNames({"options"})
+    ->Arg(SystemDictionary::NONE)
+    ->Arg(SystemDictionary::ENABLE_REVERSE_LOOKUP_INDEX);
+
+}  // namespace
+}  // namespace dictionary
+}  // namespace mozc
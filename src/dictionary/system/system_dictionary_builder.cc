@@ -30,14 +30,19 @@
 #include "dictionary/system/system_dictionary_builder.h"
 
 #include <algorithm>
+#include <atomic>
 #include <climits>
 #include <cstring>
+#include <functional>
+#include <queue>
 #include <sstream>
+#include <utility>
 
 #include "base/file_stream.h"
 #include "base/flags.h"
 #include "base/logging.h"
 #include "base/mozc_hash_set.h"
+#include "base/thread_pool.h"
 #include "base/util.h"
 #include "dictionary/dictionary_token.h"
 #include "dictionary/file/codec_factory.h"
@@ -48,6 +53,7 @@
 #include "dictionary/system/words_info.h"
 #include "dictionary/text_dictionary_loader.h"
 #include "storage/louds/bit_vector_based_array_builder.h"
+#include "storage/louds/louds_trie.h"
 #include "storage/louds/louds_trie_builder.h"
 #include "absl/flags/flag.h"
 
@@ -55,11 +61,22 @@ DEFINE_bool(preserve_intermediate_dictionary, false,
             "preserve inetemediate dictionary file.");
 DEFINE_int32(min_key_length_to_use_small_cost_encoding, 6,
              "minimum key length to use 1 byte cost encoding.");
+DEFINE_bool(use_interleaved_key_trie_layout, false,
+            "build the key trie with the cache-line interleaved layout.");
+DEFINE_bool(build_reverse_lookup_index, false,
+            "embed the reverse lookup index into the dictionary file.");
+DEFINE_bool(build_predictive_cost_index, false,
+            "embed the minimum token cost of each key trie subtree into the "
+            "dictionary file for the cost-ordered predictive lookup.");
+DEFINE_int32(system_dictionary_builder_threads, 1,
+             "the number of threads to build the dictionary with.  The output "
+             "doesn't depend on it.");
 
 namespace mozc {
 namespace dictionary {
 
 using mozc::storage::louds::BitVectorBasedArrayBuilder;
+using mozc::storage::louds::LoudsTrie;
 using mozc::storage::louds::LoudsTrieBuilder;
 
 namespace {
@@ -79,17 +96,117 @@ struct TokenGreaterThan {
   }
 };
 
+LoudsTrieBuilder::Layout GetKeyTrieLayout() {
+  return mozc::GetFlag(FLAGS_use_interleaved_key_trie_layout)
+             ? LoudsTrieBuilder::INTERLEAVED_LAYOUT
+             : LoudsTrieBuilder::SEPARATE_LAYOUT;
+}
+
 void WriteSectionToFile(const DictionaryFileSection &section,
                         const std::string &filename) {
   OutputFileStream ofs(filename.c_str(), std::ios::binary | std::ios::out);
   ofs.write(section.ptr, section.len);
 }
 
+size_t GetNumThreads() {
+  return static_cast<size_t>(
+      std::max(mozc::GetFlag(FLAGS_system_dictionary_builder_threads), 1));
+}
+
+// Runs |tasks| on up to --system_dictionary_builder_threads threads, including
+// the calling thread, and returns when all of them are done.
+void RunTasks(const std::vector<std::function<void()>> &tasks) {
+  std::atomic<size_t> next_index(0);
+  auto run = [&]() {
+    for (size_t i = next_index++; i < tasks.size(); i = next_index++) {
+      tasks[i]();
+    }
+  };
+  const size_t num_threads = std::min(tasks.size(), GetNumThreads());
+  if (num_threads <= 1) {
+    run();
+    return;
+  }
+  ThreadPool::GetSharedPool()->RunInParallel(num_threads, run);
+}
+
+// Ranges smaller than this are not worth a task.
+const size_t kMinRangeSizeForTask = 4096;
+
+// Splits [begin, end) into disjoint ranges and calls |func| for each range in
+// parallel.  |func| must touch only the elements in the given range.
+template <typename Iterator, typename Func>
+void ForEachRange(Iterator begin, Iterator end, const Func &func) {
+  const size_t size = std::distance(begin, end);
+  // A few ranges per thread balance the load of uneven elements.
+  const size_t num_ranges = std::max<size_t>(
+      1, std::min(GetNumThreads() * 4, size / kMinRangeSizeForTask));
+  if (num_ranges == 1) {
+    func(begin, end);
+    return;
+  }
+  std::vector<std::function<void()>> tasks;
+  for (size_t i = 0; i < num_ranges; ++i) {
+    const Iterator range_begin = begin + size * i / num_ranges;
+    const Iterator range_end = begin + size * (i + 1) / num_ranges;
+    tasks.push_back([&func, range_begin, range_end]() {
+      func(range_begin, range_end);
+    });
+  }
+  RunTasks(tasks);
+}
+
+// Same as std::stable_sort() but sorts chunks in parallel and merges them.
+// The merge keeps the elements of the left chunk first on ties, so the result
+// is identical to std::stable_sort().
+template <typename Iterator, typename Compare>
+void ParallelStableSort(Iterator begin, Iterator end, Compare comp) {
+  const size_t size = std::distance(begin, end);
+  const size_t num_chunks =
+      std::min(GetNumThreads(), size / kMinRangeSizeForTask);
+  if (num_chunks <= 1) {
+    std::stable_sort(begin, end, comp);
+    return;
+  }
+  // Chunk i is [bounds[i], bounds[i + 1]).
+  std::vector<Iterator> bounds;
+  for (size_t i = 0; i <= num_chunks; ++i) {
+    bounds.push_back(begin + size * i / num_chunks);
+  }
+  std::vector<std::function<void()>> tasks;
+  for (size_t i = 0; i < num_chunks; ++i) {
+    tasks.push_back([&bounds, &comp, i]() {
+      std::stable_sort(bounds[i], bounds[i + 1], comp);
+    });
+  }
+  RunTasks(tasks);
+
+  // Merges adjacent chunks pairwise until one chunk is left.
+  while (bounds.size() > 2) {
+    std::vector<Iterator> merged_bounds;
+    tasks.clear();
+    size_t i = 0;
+    for (; i + 2 < bounds.size(); i += 2) {
+      tasks.push_back([&bounds, &comp, i]() {
+        std::inplace_merge(bounds[i], bounds[i + 1], bounds[i + 2], comp);
+      });
+      merged_bounds.push_back(bounds[i]);
+    }
+    if (i + 1 < bounds.size()) {
+      // The last chunk has no pair in this round.
+      merged_bounds.push_back(bounds[i]);
+    }
+    merged_bounds.push_back(bounds.back());
+    RunTasks(tasks);
+    bounds.swap(merged_bounds);
+  }
+}
+
 }  // namespace
 
 SystemDictionaryBuilder::SystemDictionaryBuilder()
     : value_trie_builder_(new LoudsTrieBuilder),
-      key_trie_builder_(new LoudsTrieBuilder),
+      key_trie_builder_(new LoudsTrieBuilder(GetKeyTrieLayout())),
       token_array_builder_(new BitVectorBasedArrayBuilder),
       codec_(SystemDictionaryCodecFactory::GetCodec()),
       file_codec_(DictionaryFileCodecFactory::GetCodec()) {}
@@ -99,7 +216,7 @@ SystemDictionaryBuilder::SystemDictionaryBuilder(
     const SystemDictionaryCodecInterface *codec,
     const DictionaryFileCodecInterface *file_codec)
     : value_trie_builder_(new LoudsTrieBuilder),
-      key_trie_builder_(new LoudsTrieBuilder),
+      key_trie_builder_(new LoudsTrieBuilder(GetKeyTrieLayout())),
       token_array_builder_(new BitVectorBasedArrayBuilder),
       codec_(codec),
       file_codec_(file_codec) {}
@@ -111,9 +228,12 @@ void SystemDictionaryBuilder::BuildFromTokens(
   KeyInfoList key_info_list;
   ReadTokens(tokens, &key_info_list);
 
-  BuildFrequentPos(key_info_list);
-  BuildValueTrie(key_info_list);
-  BuildKeyTrie(key_info_list);
+  // These read |key_info_list| and write to their own members only.
+  RunTasks({
+      [this, &key_info_list]() { BuildFrequentPos(key_info_list); },
+      [this, &key_info_list]() { BuildValueTrie(key_info_list); },
+      [this, &key_info_list]() { BuildKeyTrie(key_info_list); },
+  });
 
   SetIdForValue(&key_info_list);
   SetIdForKey(&key_info_list);
@@ -123,6 +243,12 @@ void SystemDictionaryBuilder::BuildFromTokens(
   SetValueType(&key_info_list);
 
   BuildTokenArray(key_info_list);
+  if (mozc::GetFlag(FLAGS_build_reverse_lookup_index)) {
+    BuildReverseLookupIndex(key_info_list);
+  }
+  if (mozc::GetFlag(FLAGS_build_predictive_cost_index)) {
+    BuildPredictiveCostIndex(key_info_list);
+  }
 }
 
 void SystemDictionaryBuilder::WriteToFile(
@@ -163,6 +289,24 @@ void SystemDictionaryBuilder::WriteToStream(
       file_codec_->GetSectionName(codec_->GetSectionNameForPos()));
   sections.push_back(frequent_pos_section);
 
+  if (!reverse_lookup_index_image_.empty()) {
+    DictionaryFileSection reverse_lookup_index_section(
+        reinterpret_cast<const char *>(reverse_lookup_index_image_.data()),
+        reverse_lookup_index_image_.size() * sizeof(uint32),
+        file_codec_->GetSectionName(
+            codec_->GetSectionNameForReverseLookupIndex()));
+    sections.push_back(reverse_lookup_index_section);
+  }
+
+  if (!predictive_cost_index_image_.empty()) {
+    DictionaryFileSection predictive_cost_index_section(
+        reinterpret_cast<const char *>(predictive_cost_index_image_.data()),
+        predictive_cost_index_image_.size(),
+        file_codec_->GetSectionName(
+            codec_->GetSectionNameForPredictiveCostIndex()));
+    sections.push_back(predictive_cost_index_section);
+  }
+
   if (mozc::GetFlag(FLAGS_preserve_intermediate_dictionary) &&
       !intermediate_output_file_base_path.empty()) {
     // Write out intermediate results to files.
@@ -239,8 +383,8 @@ void SystemDictionaryBuilder::ReadTokens(const std::vector<Token *> &tokens,
     CHECK(!token->value.empty()) << "empty value string in input";
     reduce_buffer.push_back(token);
   }
-  std::stable_sort(reduce_buffer.begin(), reduce_buffer.end(),
-                   TokenPtrLessThan());
+  ParallelStableSort(reduce_buffer.begin(), reduce_buffer.end(),
+                     TokenPtrLessThan());
 
   // Step 2.
   key_info_list->clear();
@@ -253,14 +397,23 @@ void SystemDictionaryBuilder::ReadTokens(const std::vector<Token *> &tokens,
        iter != reduce_buffer.end(); ++iter) {
     Token *token = *iter;
     if (last_key_info.key != token->key) {
-      key_info_list->push_back(last_key_info);
+      key_info_list->push_back(std::move(last_key_info));
       last_key_info = KeyInfo();
       last_key_info.key = token->key;
     }
     last_key_info.tokens.push_back(TokenInfo(token));
-    last_key_info.tokens.back().value_type = GetValueType(token);
   }
-  key_info_list->push_back(last_key_info);
+  key_info_list->push_back(std::move(last_key_info));
+
+  ForEachRange(key_info_list->begin(), key_info_list->end(),
+               [](KeyInfoList::iterator begin, KeyInfoList::iterator end) {
+                 for (KeyInfoList::iterator itr = begin; itr != end; ++itr) {
+                   for (size_t i = 0; i < itr->tokens.size(); ++i) {
+                     TokenInfo *token_info = &itr->tokens[i];
+                     token_info->value_type = GetValueType(token_info->token);
+                   }
+                 }
+               });
 }
 
 void SystemDictionaryBuilder::BuildFrequentPos(
@@ -334,85 +487,104 @@ void SystemDictionaryBuilder::BuildValueTrie(const KeyInfoList &key_info_list) {
   value_trie_builder_->Build();
 }
 
+// The following Set*() and Sort*() passes update each KeyInfo independently,
+// so they run over disjoint ranges of |key_info_list| in parallel.
+
 void SystemDictionaryBuilder::SetIdForValue(KeyInfoList *key_info_list) const {
-  for (KeyInfoList::iterator itr = key_info_list->begin();
-       itr != key_info_list->end(); ++itr) {
-    for (size_t i = 0; i < itr->tokens.size(); ++i) {
-      TokenInfo *token_info = &(itr->tokens[i]);
-      std::string value_str;
-      codec_->EncodeValue(token_info->token->value, &value_str);
-      token_info->id_in_value_trie = value_trie_builder_->GetId(value_str);
-    }
-  }
+  ForEachRange(
+      key_info_list->begin(), key_info_list->end(),
+      [this](KeyInfoList::iterator begin, KeyInfoList::iterator end) {
+        for (KeyInfoList::iterator itr = begin; itr != end; ++itr) {
+          for (size_t i = 0; i < itr->tokens.size(); ++i) {
+            TokenInfo *token_info = &(itr->tokens[i]);
+            std::string value_str;
+            codec_->EncodeValue(token_info->token->value, &value_str);
+            token_info->id_in_value_trie =
+                value_trie_builder_->GetId(value_str);
+          }
+        }
+      });
 }
 
 void SystemDictionaryBuilder::SortTokenInfo(KeyInfoList *key_info_list) const {
-  for (KeyInfoList::iterator itr = key_info_list->begin();
-       itr != key_info_list->end(); ++itr) {
-    KeyInfo *key_info = &(*itr);
-    std::sort(key_info->tokens.begin(), key_info->tokens.end(),
-              TokenGreaterThan());
-  }
+  ForEachRange(key_info_list->begin(), key_info_list->end(),
+               [](KeyInfoList::iterator begin, KeyInfoList::iterator end) {
+                 for (KeyInfoList::iterator itr = begin; itr != end; ++itr) {
+                   KeyInfo *key_info = &(*itr);
+                   std::sort(key_info->tokens.begin(), key_info->tokens.end(),
+                             TokenGreaterThan());
+                 }
+               });
 }
 
 void SystemDictionaryBuilder::SetCostType(KeyInfoList *key_info_list) const {
-  for (KeyInfoList::iterator itr = key_info_list->begin();
-       itr != key_info_list->end(); ++itr) {
-    KeyInfo *key_info = &(*itr);
-    if (HasHomonymsInSamePos(*key_info)) {
-      continue;
-    }
-    for (size_t i = 0; i < key_info->tokens.size(); ++i) {
-      TokenInfo *token_info = &key_info->tokens[i];
-      const int key_len = Util::CharsLen(token_info->token->key);
-      if (key_len >=
-          mozc::GetFlag(FLAGS_min_key_length_to_use_small_cost_encoding)) {
-        token_info->cost_type = TokenInfo::CAN_USE_SMALL_ENCODING;
-      }
-    }
-  }
+  const int min_key_length =
+      mozc::GetFlag(FLAGS_min_key_length_to_use_small_cost_encoding);
+  ForEachRange(
+      key_info_list->begin(), key_info_list->end(),
+      [min_key_length](KeyInfoList::iterator begin, KeyInfoList::iterator end) {
+        for (KeyInfoList::iterator itr = begin; itr != end; ++itr) {
+          KeyInfo *key_info = &(*itr);
+          if (HasHomonymsInSamePos(*key_info)) {
+            continue;
+          }
+          for (size_t i = 0; i < key_info->tokens.size(); ++i) {
+            TokenInfo *token_info = &key_info->tokens[i];
+            const int key_len = Util::CharsLen(token_info->token->key);
+            if (key_len >= min_key_length) {
+              token_info->cost_type = TokenInfo::CAN_USE_SMALL_ENCODING;
+            }
+          }
+        }
+      });
 }
 
 void SystemDictionaryBuilder::SetPosType(KeyInfoList *key_info_list) const {
-  for (KeyInfoList::iterator itr = key_info_list->begin();
-       itr != key_info_list->end(); ++itr) {
-    KeyInfo *key_info = &(*itr);
-    for (size_t i = 0; i < key_info->tokens.size(); ++i) {
-      TokenInfo *token_info = &(key_info->tokens[i]);
-      const uint32 pos =
-          GetCombinedPos(token_info->token->lid, token_info->token->rid);
-      std::map<uint32, int>::const_iterator itr = frequent_pos_.find(pos);
-      if (itr != frequent_pos_.end()) {
-        token_info->pos_type = TokenInfo::FREQUENT_POS;
-        token_info->id_in_frequent_pos_map = itr->second;
-      }
-      if (i >= 1) {
-        const TokenInfo &prev_token_info = key_info->tokens[i - 1];
-        const uint32 prev_pos = GetCombinedPos(prev_token_info.token->lid,
-                                               prev_token_info.token->rid);
-        if (prev_pos == pos) {
-          // we can overwrite FREQUENT_POS
-          token_info->pos_type = TokenInfo::SAME_AS_PREV_POS;
+  ForEachRange(
+      key_info_list->begin(), key_info_list->end(),
+      [this](KeyInfoList::iterator begin, KeyInfoList::iterator end) {
+        for (KeyInfoList::iterator itr = begin; itr != end; ++itr) {
+          KeyInfo *key_info = &(*itr);
+          for (size_t i = 0; i < key_info->tokens.size(); ++i) {
+            TokenInfo *token_info = &(key_info->tokens[i]);
+            const uint32 pos =
+                GetCombinedPos(token_info->token->lid, token_info->token->rid);
+            std::map<uint32, int>::const_iterator itr = frequent_pos_.find(pos);
+            if (itr != frequent_pos_.end()) {
+              token_info->pos_type = TokenInfo::FREQUENT_POS;
+              token_info->id_in_frequent_pos_map = itr->second;
+            }
+            if (i >= 1) {
+              const TokenInfo &prev_token_info = key_info->tokens[i - 1];
+              const uint32 prev_pos = GetCombinedPos(
+                  prev_token_info.token->lid, prev_token_info.token->rid);
+              if (prev_pos == pos) {
+                // we can overwrite FREQUENT_POS
+                token_info->pos_type = TokenInfo::SAME_AS_PREV_POS;
+              }
+            }
+          }
         }
-      }
-    }
-  }
+      });
 }
 
 void SystemDictionaryBuilder::SetValueType(KeyInfoList *key_info_list) const {
-  for (KeyInfoList::iterator itr = key_info_list->begin();
-       itr != key_info_list->end(); ++itr) {
-    KeyInfo *key_info = &(*itr);
-    for (size_t i = 1; i < key_info->tokens.size(); ++i) {
-      const TokenInfo *prev_token_info = &(key_info->tokens[i - 1]);
-      TokenInfo *token_info = &(key_info->tokens[i]);
-      if (token_info->value_type != TokenInfo::AS_IS_HIRAGANA &&
-          token_info->value_type != TokenInfo::AS_IS_KATAKANA &&
-          (token_info->token->value == prev_token_info->token->value)) {
-        token_info->value_type = TokenInfo::SAME_AS_PREV_VALUE;
-      }
-    }
-  }
+  ForEachRange(
+      key_info_list->begin(), key_info_list->end(),
+      [](KeyInfoList::iterator begin, KeyInfoList::iterator end) {
+        for (KeyInfoList::iterator itr = begin; itr != end; ++itr) {
+          KeyInfo *key_info = &(*itr);
+          for (size_t i = 1; i < key_info->tokens.size(); ++i) {
+            const TokenInfo *prev_token_info = &(key_info->tokens[i - 1]);
+            TokenInfo *token_info = &(key_info->tokens[i]);
+            if (token_info->value_type != TokenInfo::AS_IS_HIRAGANA &&
+                token_info->value_type != TokenInfo::AS_IS_KATAKANA &&
+                (token_info->token->value == prev_token_info->token->value)) {
+              token_info->value_type = TokenInfo::SAME_AS_PREV_VALUE;
+            }
+          }
+        }
+      });
 }
 
 void SystemDictionaryBuilder::BuildKeyTrie(const KeyInfoList &key_info_list) {
@@ -426,13 +598,15 @@ void SystemDictionaryBuilder::BuildKeyTrie(const KeyInfoList &key_info_list) {
 }
 
 void SystemDictionaryBuilder::SetIdForKey(KeyInfoList *key_info_list) const {
-  for (KeyInfoList::iterator itr = key_info_list->begin();
-       itr != key_info_list->end(); ++itr) {
-    KeyInfo *key_info = &(*itr);
-    std::string key_str;
-    codec_->EncodeKey(key_info->key, &key_str);
-    key_info->id_in_key_trie = key_trie_builder_->GetId(key_str);
-  }
+  ForEachRange(key_info_list->begin(), key_info_list->end(),
+               [this](KeyInfoList::iterator begin, KeyInfoList::iterator end) {
+                 for (KeyInfoList::iterator itr = begin; itr != end; ++itr) {
+                   KeyInfo *key_info = &(*itr);
+                   std::string key_str;
+                   codec_->EncodeKey(key_info->key, &key_str);
+                   key_info->id_in_key_trie = key_trie_builder_->GetId(key_str);
+                 }
+               });
 }
 
 void SystemDictionaryBuilder::BuildTokenArray(
@@ -450,11 +624,21 @@ void SystemDictionaryBuilder::BuildTokenArray(
       id_to_keyinfo_table[id] = &key_info;
     }
 
-    for (size_t i = 0; i < id_to_keyinfo_table.size(); ++i) {
-      const KeyInfo &key_info = *id_to_keyinfo_table[i];
-      std::string tokens_str;
-      codec_->EncodeTokens(key_info.tokens, &tokens_str);
-      token_array_builder_->Add(tokens_str);
+    // Encodes the tokens in parallel and adds them in the order of ids.
+    std::vector<std::string> encoded_tokens(id_to_keyinfo_table.size());
+    ForEachRange(encoded_tokens.begin(), encoded_tokens.end(),
+                 [this, &id_to_keyinfo_table, &encoded_tokens](
+                     std::vector<std::string>::iterator begin,
+                     std::vector<std::string>::iterator end) {
+                   for (auto itr = begin; itr != end; ++itr) {
+                     const size_t id = itr - encoded_tokens.begin();
+                     codec_->EncodeTokens(id_to_keyinfo_table[id]->tokens,
+                                          &*itr);
+                   }
+                 });
+    for (size_t i = 0; i < encoded_tokens.size(); ++i) {
+      token_array_builder_->Add(encoded_tokens[i]);
+      std::string().swap(encoded_tokens[i]);
     }
   }
 
@@ -462,5 +646,131 @@ void SystemDictionaryBuilder::BuildTokenArray(
   token_array_builder_->Build();
 }
 
+void SystemDictionaryBuilder::BuildReverseLookupIndex(
+    const KeyInfoList &key_info_list) {
+  // The index is an array of uint32 laid out as follows:
+  //   image[0]: N, the number of value ids.
+  //   image[1 .. N + 1]: offsets[0 .. N].
+  //   image[N + 2 ..]: key_ids[], where the key ids for value id v are stored
+  //                    in key_ids[offsets[v] .. offsets[v + 1] - 1].
+  // Key ids are sorted in ascending order for each value id.  A key id
+  // appears once per token that encodes the value id, so that the result is
+  // identical to scanning the token array at runtime, which ignores the
+  // tokens that reuse the value of the previous one.
+  std::vector<std::vector<uint32>> key_ids_per_value;
+  for (KeyInfoList::const_iterator itr = key_info_list.begin();
+       itr != key_info_list.end(); ++itr) {
+    for (size_t i = 0; i < itr->tokens.size(); ++i) {
+      const TokenInfo &token_info = itr->tokens[i];
+      if (token_info.value_type == TokenInfo::AS_IS_HIRAGANA ||
+          token_info.value_type == TokenInfo::AS_IS_KATAKANA ||
+          token_info.id_in_value_trie < 0) {
+        // These tokens have no id in value trie.
+        continue;
+      }
+      if (token_info.value_type == TokenInfo::SAME_AS_PREV_VALUE) {
+        // The key id has already been added for the previous token, and
+        // RegisterReverseLookupResults() emits all the tokens of the key
+        // having the value id.
+        continue;
+      }
+      const size_t value_id = token_info.id_in_value_trie;
+      if (value_id >= key_ids_per_value.size()) {
+        key_ids_per_value.resize(value_id + 1);
+      }
+      key_ids_per_value[value_id].push_back(itr->id_in_key_trie);
+    }
+  }
+
+  const size_t num_values = key_ids_per_value.size();
+  reverse_lookup_index_image_.clear();
+  reverse_lookup_index_image_.reserve(num_values + 2);
+  reverse_lookup_index_image_.push_back(num_values);
+  uint32 offset = 0;
+  for (size_t i = 0; i < num_values; ++i) {
+    reverse_lookup_index_image_.push_back(offset);
+    offset += key_ids_per_value[i].size();
+  }
+  reverse_lookup_index_image_.push_back(offset);
+  for (size_t i = 0; i < num_values; ++i) {
+    std::vector<uint32> *key_ids = &key_ids_per_value[i];
+    std::sort(key_ids->begin(), key_ids->end());
+    reverse_lookup_index_image_.insert(reverse_lookup_index_image_.end(),
+                                       key_ids->begin(), key_ids->end());
+  }
+}
+
+void SystemDictionaryBuilder::BuildPredictiveCostIndex(
+    const KeyInfoList &key_info_list) {
+  // The index is laid out as follows, where M is the number of keys:
+  //   uint16 key_costs[0]: S, the number of bits to shift the bounds by.
+  //   uint16 key_costs[1 .. M]: the minimum decoded cost of the tokens of the
+  //                             key whose key id is k, at key_costs[k + 1].
+  //   uint8 bounds[]: following key_costs[M], the minimum cost of the tokens
+  //                   in the subtree of the key trie node whose node id is i,
+  //                   shifted right by S, at bounds[i - 1].
+  // Costs are those decoded from the token array, whose small cost encoding
+  // drops the lower 8 bits of a cost (see codec.cc), so that LookupPredictive()
+  // doesn't need to decode tokens to order keys.  (bounds[i - 1] << S) is a
+  // lower bound of the costs.
+  const int kShift = 8;
+  LoudsTrie key_trie;
+  CHECK(key_trie.Open(
+      reinterpret_cast<const uint8 *>(key_trie_builder_->image().data())));
+
+  // Finds the parent of each node by BFS.  Since node ids are assigned in BFS
+  // order, a child has a larger id than its parent.
+  std::vector<int> parent_ids(1, 0);
+  std::queue<LoudsTrie::Node> queue;
+  queue.push(LoudsTrie::Node());
+  while (!queue.empty()) {
+    LoudsTrie::Node node = queue.front();
+    queue.pop();
+    const int node_id = node.node_id();
+    for (key_trie.MoveToFirstChild(&node); key_trie.IsValidNode(node);
+         key_trie.MoveToNextSibling(&node)) {
+      if (static_cast<size_t>(node.node_id()) > parent_ids.size()) {
+        parent_ids.resize(node.node_id(), 0);
+      }
+      parent_ids[node.node_id() - 1] = node_id;
+      queue.push(node);
+    }
+  }
+
+  std::vector<uint16> key_costs(key_info_list.size() + 1, 0);
+  key_costs[0] = kShift;
+  std::vector<int> min_costs(parent_ids.size(), INT_MAX);
+  for (KeyInfoList::const_iterator itr = key_info_list.begin();
+       itr != key_info_list.end(); ++itr) {
+    int key_cost = INT_MAX;
+    for (size_t i = 0; i < itr->tokens.size(); ++i) {
+      const TokenInfo &token_info = itr->tokens[i];
+      int cost = token_info.token->cost;
+      if (token_info.cost_type == TokenInfo::CAN_USE_SMALL_ENCODING) {
+        cost = (cost >> 8) << 8;
+      }
+      key_cost = std::min(key_cost, cost);
+    }
+    DCHECK_LT(itr->id_in_key_trie + 1, static_cast<int>(key_costs.size()));
+    key_costs[itr->id_in_key_trie + 1] = key_cost;
+    const int node_id =
+        key_trie.GetTerminalNodeFromKeyId(itr->id_in_key_trie).node_id();
+    min_costs[node_id - 1] = key_cost;
+  }
+  for (size_t i = min_costs.size(); i > 1; --i) {
+    int *parent_min_cost = &min_costs[parent_ids[i - 1] - 1];
+    *parent_min_cost = std::min(*parent_min_cost, min_costs[i - 1]);
+  }
+
+  const uint8 *key_costs_image =
+      reinterpret_cast<const uint8 *>(key_costs.data());
+  predictive_cost_index_image_.assign(
+      key_costs_image, key_costs_image + key_costs.size() * sizeof(uint16));
+  for (size_t i = 0; i < min_costs.size(); ++i) {
+    predictive_cost_index_image_.push_back(
+        std::min(min_costs[i] >> kShift, 255));
+  }
+}
+
 }  // namespace dictionary
 }  // namespace mozc
@@ -89,6 +89,10 @@ class SystemDictionaryBuilder {
 
   void BuildTokenArray(const KeyInfoList &key_info_list);
 
+  void BuildReverseLookupIndex(const KeyInfoList &key_info_list);
+
+  void BuildPredictiveCostIndex(const KeyInfoList &key_info_list);
+
   void SetIdForValue(KeyInfoList *key_info_list) const;
   void SetIdForKey(KeyInfoList *key_info_list) const;
   void SortTokenInfo(KeyInfoList *key_info_list) const;
@@ -105,6 +109,16 @@ class SystemDictionaryBuilder {
   // mapping from {left_id, right_id} to POS index (0--255)
   std::map<uint32, int> frequent_pos_;
 
+  // Image of the optional reverse lookup index section.  Empty unless
+  // --build_reverse_lookup_index is set.  See BuildReverseLookupIndex() for
+  // the layout.
+  std::vector<uint32> reverse_lookup_index_image_;
+
+  // Image of the optional predictive cost index section.  Empty unless
+  // --build_predictive_cost_index is set.  See BuildPredictiveCostIndex() for
+  // the layout.
+  std::vector<uint8> predictive_cost_index_image_;
+
   const SystemDictionaryCodecInterface *codec_;
   const DictionaryFileCodecInterface *file_codec_;
 
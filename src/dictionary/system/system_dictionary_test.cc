@@ -32,7 +32,10 @@
 #include <algorithm>
 #include <cstdlib>
 #include <limits>
+#include <map>
 #include <memory>
+#include <set>
+#include <sstream>
 #include <string>
 #include <utility>
 #include <vector>
@@ -64,6 +67,10 @@ DEFINE_int32(dictionary_test_size, 100000, "Dictionary size for this test.");
 DEFINE_int32(dictionary_reverse_lookup_test_size, 1000,
              "Number of tokens to run reverse lookup test.");
 DECLARE_int32(min_key_length_to_use_small_cost_encoding);
+DECLARE_bool(use_interleaved_key_trie_layout);
+DECLARE_bool(build_reverse_lookup_index);
+DECLARE_bool(build_predictive_cost_index);
+DECLARE_int32(system_dictionary_builder_threads);
 
 namespace mozc {
 namespace dictionary {
@@ -350,6 +357,32 @@ TEST_F(SystemDictionaryTest, LookupAllWords) {
   }
 }
 
+TEST_F(SystemDictionaryTest, LookupAllWordsWithInterleavedKeyTrie) {
+  const std::vector<Token *> &source_tokens = text_dict_->tokens();
+  mozc::SetFlag(&FLAGS_use_interleaved_key_trie_layout, true);
+  BuildSystemDictionary(source_tokens,
+                        mozc::GetFlag(FLAGS_dictionary_test_size));
+  mozc::SetFlag(&FLAGS_use_interleaved_key_trie_layout, false);
+
+  std::unique_ptr<SystemDictionary> system_dic =
+      SystemDictionary::Builder(dic_fn_).Build().value();
+  ASSERT_TRUE(system_dic) << "Failed to open dictionary source:" << dic_fn_;
+
+  // All the tokens should be looked up both by prefix and exact lookups.
+  for (size_t i = 0; i < source_tokens.size(); ++i) {
+    CheckTokenExistenceCallback prefix_callback(source_tokens[i]);
+    system_dic->LookupPrefix(source_tokens[i]->key, convreq_,
+                             &prefix_callback);
+    EXPECT_TRUE(prefix_callback.found())
+        << "Token was not found: " << PrintToken(*source_tokens[i]);
+
+    CheckTokenExistenceCallback exact_callback(source_tokens[i]);
+    system_dic->LookupExact(source_tokens[i]->key, convreq_, &exact_callback);
+    EXPECT_TRUE(exact_callback.found())
+        << "Token was not found: " << PrintToken(*source_tokens[i]);
+  }
+}
+
 TEST_F(SystemDictionaryTest, SimpleLookupPrefix) {
   const std::string k0 = "は";
   const std::string k1 = "はひふへほ";
@@ -518,6 +551,61 @@ TEST_F(SystemDictionaryTest, LookupPrefix) {
   }
 }
 
+TEST_F(SystemDictionaryTest, LookupPrefixBatch) {
+  struct {
+    const char *key;
+    const char *value;
+  } kKeyValues[] = {
+      {"あ", "亜"},     {"あい", "愛"},   {"あいう", "藍雨"}, {"い", "胃"},
+      {"いう", "言う"}, {"か", "可"},     {"かき", "牡蠣"},   {"かきく", "柿久"},
+      {"さ", "差"},     {"さし", "刺"},   {"た", "田"},       {"たち", "多値"},
+      {"き", "木"},     {"きく", "菊"},   {"く", "区"},
+  };
+  const size_t kKeyValuesSize = arraysize(kKeyValues);
+  std::unique_ptr<Token> tokens[kKeyValuesSize];
+  std::vector<Token *> source_tokens(kKeyValuesSize);
+  for (size_t i = 0; i < kKeyValuesSize; ++i) {
+    tokens[i].reset(CreateToken(kKeyValues[i].key, kKeyValues[i].value));
+    source_tokens[i] = tokens[i].get();
+  }
+  text_dict_->CollectTokens(&source_tokens);
+  BuildSystemDictionary(source_tokens, kKeyValuesSize);
+  std::unique_ptr<SystemDictionary> system_dic =
+      SystemDictionary::Builder(dic_fn_).Build().value();
+  ASSERT_TRUE(system_dic) << "Failed to open dictionary source:" << dic_fn_;
+
+  // Look up all the suffixes of the key at once, as the converter does.  The
+  // callback stops at "かき" and "た" and skips "さ", so these controls are
+  // also checked for each key.
+  const std::string kKey = "あいうかきくさしたち";
+  std::vector<absl::string_view> keys;
+  for (size_t pos = 0; pos < kKey.size(); pos += Util::OneCharLen(&kKey[pos])) {
+    keys.push_back(absl::string_view(kKey).substr(pos));
+  }
+
+  for (bool kana_modifier_insensitive : {false, true}) {
+    request_.set_kana_modifier_insensitive_conversion(
+        kana_modifier_insensitive);
+    config_.set_use_kana_modifier_insensitive_conversion(
+        kana_modifier_insensitive);
+
+    std::vector<LookupPrefixTestCallback> batch_callbacks(keys.size());
+    std::vector<DictionaryInterface::Callback *> callbacks;
+    for (LookupPrefixTestCallback &callback : batch_callbacks) {
+      callbacks.push_back(&callback);
+    }
+    system_dic->LookupPrefixBatch(keys, convreq_, callbacks);
+
+    for (size_t i = 0; i < keys.size(); ++i) {
+      LookupPrefixTestCallback expected;
+      system_dic->LookupPrefix(keys[i], convreq_, &expected);
+      EXPECT_EQ(expected.result(), batch_callbacks[i].result()) << keys[i];
+    }
+    // "あいう..." has "あ", "あい" and "あいう" as its prefixes.
+    EXPECT_EQ(3, batch_callbacks[0].result().size());
+  }
+}
+
 TEST_F(SystemDictionaryTest, LookupPredictive) {
   std::vector<Token *> tokens;
   ScopedElementsDeleter<std::vector<Token *>> deleter(&tokens);
@@ -596,6 +684,201 @@ TEST_F(SystemDictionaryTest, LookupPredictive_CutOffEmulatingBFS) {
   EXPECT_FALSE(callback.IsFound(tokens[1]));
 }
 
+namespace {
+
+// Records the keys in the order of lookup and the minimum token cost of each
+// key.
+class CollectKeyCostCallback : public DictionaryInterface::Callback {
+ public:
+  const std::vector<std::string> &keys() const { return keys_; }
+  const std::map<std::string, int> &costs() const { return costs_; }
+
+  ResultType OnKey(absl::string_view key) override {
+    keys_.push_back(std::string(key));
+    return TRAVERSE_CONTINUE;
+  }
+
+  ResultType OnToken(absl::string_view key, absl::string_view actual_key,
+                     const Token &token) override {
+    const auto result = costs_.emplace(std::string(key), token.cost);
+    if (!result.second) {
+      result.first->second = std::min(result.first->second, token.cost);
+    }
+    return TRAVERSE_CONTINUE;
+  }
+
+ private:
+  std::vector<std::string> keys_;
+  std::map<std::string, int> costs_;
+};
+
+}  // namespace
+
+TEST_F(SystemDictionaryTest, LookupPredictive_CutOffInCostOrder) {
+  std::vector<Token *> tokens;
+  ScopedElementsDeleter<std::vector<Token *>> deleter(&tokens);
+
+  tokens.push_back(CreateToken("あい", "ai"));
+  tokens.push_back(CreateToken("あいうえお", "aiueo"));
+  std::vector<Token *> source_tokens = tokens;
+  text_dict_->CollectTokens(&source_tokens);
+  source_tokens.resize(std::min<size_t>(source_tokens.size(), 10000));
+  mozc::SetFlag(&FLAGS_build_predictive_cost_index, true);
+  BuildSystemDictionary(source_tokens, source_tokens.size());
+  mozc::SetFlag(&FLAGS_build_predictive_cost_index, false);
+  std::unique_ptr<SystemDictionary> system_dic =
+      SystemDictionary::Builder(dic_fn_).Build().value();
+  ASSERT_TRUE(system_dic) << "Failed to open dictionary source: " << dic_fn_;
+
+  // With the predictive cost index, the cheapest keys are looked up
+  // regardless of their lengths.  Both tokens have cost 0.
+  CheckMultiTokensExistenceCallback callback(tokens);
+  system_dic->LookupPredictive("あ", convreq_, &callback);
+  EXPECT_TRUE(callback.IsFound(tokens[0]));
+  EXPECT_TRUE(callback.IsFound(tokens[1]));
+
+  CollectKeyCostCallback cost_callback;
+  system_dic->LookupPredictive("あ", convreq_, &cost_callback);
+  const std::vector<std::string> &keys = cost_callback.keys();
+  std::vector<int> costs;
+  for (const std::string &key : keys) {
+    const auto iter = cost_callback.costs().find(key);
+    ASSERT_NE(cost_callback.costs().end(), iter) << key;
+    costs.push_back(iter->second);
+  }
+  EXPECT_TRUE(std::is_sorted(costs.begin(), costs.end()));
+
+  // Brute force: the minimum cost of every key starting with "あ", as decoded
+  // from the dictionary.
+  std::map<std::string, int> all_key_costs;
+  for (const Token *token : source_tokens) {
+    if (!Util::StartsWith(token->key, "あ") ||
+        all_key_costs.count(token->key) > 0) {
+      continue;
+    }
+    CollectKeyCostCallback exact_callback;
+    system_dic->LookupExact(token->key, convreq_, &exact_callback);
+    const auto iter = exact_callback.costs().find(token->key);
+    ASSERT_NE(exact_callback.costs().end(), iter) << token->key;
+    all_key_costs[token->key] = iter->second;
+  }
+  // There are more keys than the lookup limit, so the lookup is truncated.
+  ASSERT_FALSE(keys.empty());
+  ASSERT_LT(keys.size(), all_key_costs.size());
+
+  // The truncated lookup returns exactly the cheapest keys, i.e., the costs
+  // are the smallest ones and every key cheaper than the last one is found.
+  std::vector<int> all_costs;
+  for (const auto &key_cost : all_key_costs) {
+    all_costs.push_back(key_cost.second);
+  }
+  std::sort(all_costs.begin(), all_costs.end());
+  all_costs.resize(keys.size());
+  EXPECT_EQ(all_costs, costs);
+  const std::set<std::string> found_keys(keys.begin(), keys.end());
+  EXPECT_EQ(keys.size(), found_keys.size());
+  for (const auto &key_cost : all_key_costs) {
+    if (key_cost.second < costs.back()) {
+      EXPECT_EQ(1, found_keys.count(key_cost.first)) << key_cost.first;
+    }
+  }
+}
+
+namespace {
+
+// Records the number of edits reported for each actual key.
+class CollectApproximateKeyCallback : public DictionaryInterface::Callback {
+ public:
+  const std::map<std::string, int> &num_edits() const { return num_edits_; }
+
+  ResultType OnApproximateKey(absl::string_view actual_key,
+                              int num_edits) override {
+    num_edits_[std::string(actual_key)] = num_edits;
+    return TRAVERSE_CONTINUE;
+  }
+
+ private:
+  std::map<std::string, int> num_edits_;
+};
+
+}  // namespace
+
+TEST_F(SystemDictionaryTest, LookupPredictiveApproximate) {
+  std::vector<Token *> tokens;
+  ScopedElementsDeleter<std::vector<Token *>> deleter(&tokens);
+
+  tokens.push_back(CreateToken("てすと", "テスト"));
+  tokens.push_back(CreateToken("てすとちゅう", "テスト中"));
+  tokens.push_back(CreateToken("てきすと", "テキスト"));
+  tokens.push_back(CreateToken("とうきょう", "東京"));
+
+  BuildSystemDictionary(tokens, 100);
+  std::unique_ptr<SystemDictionary> system_dic =
+      SystemDictionary::Builder(dic_fn_).Build().value();
+  ASSERT_TRUE(system_dic) << "Failed to open dictionary source: " << dic_fn_;
+
+  {
+    // Without edits, the lookup is the same as LookupPredictive().
+    CollectApproximateKeyCallback callback;
+    system_dic->LookupPredictiveApproximate("てす", 0, 0, convreq_, &callback);
+    const std::map<std::string, int> expected = {
+        {"てすと", 0},
+        {"てすとちゅう", 0},
+    };
+    EXPECT_EQ(expected, callback.num_edits());
+  }
+  {
+    // "ど" is a typo of "と".  "てきすと" needs two edits.
+    CollectApproximateKeyCallback callback;
+    system_dic->LookupPredictiveApproximate("てすど", 0, 1, convreq_, &callback);
+    const std::map<std::string, int> expected = {
+        {"てすと", 1},
+        {"てすとちゅう", 1},
+    };
+    EXPECT_EQ(expected, callback.num_edits());
+  }
+  {
+    // Tokens carry the actual key in the dictionary.
+    CollectTokenCallback callback;
+    system_dic->LookupPredictiveApproximate("てすとちゆう", 0, 1,
+                                            convreq_, &callback);
+    ASSERT_EQ(1, callback.tokens().size());
+    EXPECT_EQ("てすとちゅう", callback.tokens()[0].key);
+    EXPECT_EQ("テスト中", callback.tokens()[0].value);
+  }
+  {
+    // A query not longer than |max_edits| would match everything.
+    CollectTokenCallback callback;
+    system_dic->LookupPredictiveApproximate("て", 0, 1, convreq_, &callback);
+    EXPECT_TRUE(callback.tokens().empty());
+  }
+  {
+    // The exact prefix takes no edit, so the rest "ちゆ" is one edit away
+    // from "ちゅう".
+    CollectApproximateKeyCallback callback;
+    const std::string kPrefix = "てすと";
+    system_dic->LookupPredictiveApproximate(kPrefix + "ちゆ", kPrefix.size(), 1,
+                                            convreq_, &callback);
+    const std::map<std::string, int> expected = {
+        {"てすとちゅう", 1},
+    };
+    EXPECT_EQ(expected, callback.num_edits());
+  }
+  {
+    // "てきすと" is one edit away from "てすすと" but not found, as the edit
+    // would be in the exact prefix "てす".
+    CollectApproximateKeyCallback callback;
+    const std::string kPrefix = "てす";
+    system_dic->LookupPredictiveApproximate(kPrefix + "すと", kPrefix.size(), 1,
+                                            convreq_, &callback);
+    const std::map<std::string, int> expected = {
+        {"てすと", 1},
+        {"てすとちゅう", 1},
+    };
+    EXPECT_EQ(expected, callback.num_edits());
+  }
+}
+
 TEST_F(SystemDictionaryTest, LookupExact) {
   std::vector<Token *> source_tokens;
 
@@ -800,6 +1083,138 @@ TEST_F(SystemDictionaryTest, LookupReverseIndex) {
   }
 }
 
+TEST_F(SystemDictionaryTest, LookupReverseWithEmbeddedIndex) {
+  const std::vector<Token *> &source_tokens = text_dict_->tokens();
+  BuildSystemDictionary(source_tokens,
+                        mozc::GetFlag(FLAGS_dictionary_test_size));
+  std::unique_ptr<SystemDictionary> system_dic_without_index =
+      SystemDictionary::Builder(dic_fn_)
+          .SetOptions(SystemDictionary::NONE)
+          .Build()
+          .value();
+  ASSERT_TRUE(system_dic_without_index)
+      << "Failed to open dictionary source:" << dic_fn_;
+
+  const std::string embedded_dic_fn = dic_fn_ + ".embedded";
+  {
+    mozc::SetFlag(&FLAGS_build_reverse_lookup_index, true);
+    SystemDictionaryBuilder builder;
+    std::vector<Token *> tokens;
+    for (size_t i = 0; i < source_tokens.size() &&
+                       i < mozc::GetFlag(FLAGS_dictionary_test_size);
+         ++i) {
+      tokens.push_back(source_tokens[i]);
+    }
+    builder.BuildFromTokens(tokens);
+    builder.WriteToFile(embedded_dic_fn);
+    mozc::SetFlag(&FLAGS_build_reverse_lookup_index, false);
+  }
+  std::unique_ptr<SystemDictionary> system_dic_with_index =
+      SystemDictionary::Builder(embedded_dic_fn)
+          .SetOptions(SystemDictionary::NONE)
+          .Build()
+          .value();
+  ASSERT_TRUE(system_dic_with_index)
+      << "Failed to open dictionary source:" << embedded_dic_fn;
+
+  int size = mozc::GetFlag(FLAGS_dictionary_reverse_lookup_test_size);
+  for (std::vector<Token *>::const_iterator it = source_tokens.begin();
+       size > 0 && it != source_tokens.end(); ++it, --size) {
+    const Token &t = **it;
+    CollectTokenCallback callback1, callback2;
+    system_dic_without_index->LookupReverse(t.value, convreq_, &callback1);
+    system_dic_with_index->LookupReverse(t.value, convreq_, &callback2);
+
+    const std::vector<Token> &tokens1 = callback1.tokens();
+    const std::vector<Token> &tokens2 = callback2.tokens();
+    ASSERT_EQ(tokens1.size(), tokens2.size());
+    for (size_t i = 0; i < tokens1.size(); ++i) {
+      EXPECT_TOKEN_EQ(tokens1[i], tokens2[i]);
+    }
+  }
+  FileUtil::Unlink(embedded_dic_fn);
+}
+
+TEST_F(SystemDictionaryTest, LookupReverseWithEmbeddedIndexRepeatedValue) {
+  // The tokens of "ぎじゅつ" share the same value, so the second and the
+  // third ones are encoded with SAME_AS_PREV_VALUE.
+  std::vector<std::unique_ptr<Token>> owned_tokens;
+  owned_tokens.emplace_back(CreateToken("ぎじゅつ", "技術"));
+  owned_tokens.emplace_back(CreateToken("ぎじゅつ", "技術"));
+  owned_tokens.emplace_back(CreateToken("ぎじゅつ", "技術"));
+  owned_tokens.emplace_back(CreateToken("ぎじゅつてき", "技術的"));
+  owned_tokens[0]->lid = owned_tokens[0]->rid = 2;
+  owned_tokens[1]->cost = 100;
+  owned_tokens[2]->cost = 200;
+  std::vector<Token *> source_tokens;
+  for (const std::unique_ptr<Token> &token : owned_tokens) {
+    source_tokens.push_back(token.get());
+  }
+
+  BuildSystemDictionary(source_tokens, source_tokens.size());
+  std::unique_ptr<SystemDictionary> system_dic_without_index =
+      SystemDictionary::Builder(dic_fn_)
+          .SetOptions(SystemDictionary::NONE)
+          .Build()
+          .value();
+  ASSERT_TRUE(system_dic_without_index)
+      << "Failed to open dictionary source:" << dic_fn_;
+
+  const std::string embedded_dic_fn = dic_fn_ + ".embedded";
+  {
+    mozc::SetFlag(&FLAGS_build_reverse_lookup_index, true);
+    SystemDictionaryBuilder builder;
+    builder.BuildFromTokens(source_tokens);
+    builder.WriteToFile(embedded_dic_fn);
+    mozc::SetFlag(&FLAGS_build_reverse_lookup_index, false);
+  }
+  std::unique_ptr<SystemDictionary> system_dic_with_index =
+      SystemDictionary::Builder(embedded_dic_fn)
+          .SetOptions(SystemDictionary::NONE)
+          .Build()
+          .value();
+  ASSERT_TRUE(system_dic_with_index)
+      << "Failed to open dictionary source:" << embedded_dic_fn;
+
+  for (const char *value : {"技術", "技術的"}) {
+    CollectTokenCallback callback1, callback2;
+    system_dic_without_index->LookupReverse(value, convreq_, &callback1);
+    system_dic_with_index->LookupReverse(value, convreq_, &callback2);
+
+    const std::vector<Token> &tokens1 = callback1.tokens();
+    const std::vector<Token> &tokens2 = callback2.tokens();
+    ASSERT_EQ(tokens1.size(), tokens2.size()) << value;
+    for (size_t i = 0; i < tokens1.size(); ++i) {
+      EXPECT_TOKEN_EQ(tokens1[i], tokens2[i]);
+    }
+  }
+
+  // Each token of "ぎじゅつ" is looked up exactly once.
+  CollectTokenCallback callback;
+  system_dic_with_index->LookupReverse("技術", convreq_, &callback);
+  EXPECT_EQ(3, callback.tokens().size());
+  FileUtil::Unlink(embedded_dic_fn);
+}
+
+TEST_F(SystemDictionaryTest, BuildWithMultipleThreads) {
+  // Use small cost encoding for some tokens to cover SetCostType().
+  mozc::SetFlag(&FLAGS_min_key_length_to_use_small_cost_encoding, 3);
+  const std::vector<Token *> &tokens = text_dict_->tokens();
+  std::string images[2];
+  const int32 kNumThreads[] = {1, 4};
+  for (size_t i = 0; i < arraysize(kNumThreads); ++i) {
+    mozc::SetFlag(&FLAGS_system_dictionary_builder_threads, kNumThreads[i]);
+    SystemDictionaryBuilder builder;
+    builder.BuildFromTokens(tokens);
+    std::ostringstream stream;
+    builder.WriteToStream("", &stream);
+    images[i] = stream.str();
+  }
+  mozc::SetFlag(&FLAGS_system_dictionary_builder_threads, 1);
+  ASSERT_FALSE(images[0].empty());
+  EXPECT_TRUE(images[0] == images[1]);
+}
+
 TEST_F(SystemDictionaryTest, LookupReverseWithCache) {
   const std::string kDoraemon = "ドラえもん";
 
@@ -869,6 +1284,75 @@ TEST_F(SystemDictionaryTest, SpellingCorrectionTokens) {
   }
 }
 
+namespace {
+
+// Rejects the tokens with |rejected_lid| before their values are decoded.
+class RejectLidCallback : public CollectTokenCallback {
+ public:
+  explicit RejectLidCallback(int rejected_lid)
+      : rejected_lid_(rejected_lid), num_rejected_(0) {}
+
+  bool OnTokenWithoutValue(absl::string_view key, absl::string_view actual_key,
+                           const Token &token) override {
+    if (token.lid == rejected_lid_) {
+      ++num_rejected_;
+      return false;
+    }
+    return true;
+  }
+
+  int num_rejected() const { return num_rejected_; }
+
+ private:
+  const int rejected_lid_;
+  int num_rejected_;
+};
+
+}  // namespace
+
+TEST_F(SystemDictionaryTest, RejectTokensWithoutValue) {
+  // Tokens with lid 20 are rejected.  Since tokens are sorted by lid in
+  // descending order, (記者, lid 10) is encoded as having the same value as
+  // the rejected (記者, lid 20) just before it, so its value has to be
+  // decoded from scratch.
+  std::vector<Token> tokens(4);
+  tokens[0] = Token("きしゃ", "記者", 100, 10, 10, Token::NONE);
+  tokens[1] = Token("きしゃ", "記者", 200, 20, 20, Token::NONE);
+  tokens[2] = Token("きしゃ", "汽車", 300, 10, 10, Token::NONE);
+  tokens[3] = Token("きしゃ", "キシャ", 400, 20, 20, Token::NONE);
+  std::vector<Token *> source_tokens;
+  for (size_t i = 0; i < tokens.size(); ++i) {
+    source_tokens.push_back(&tokens[i]);
+  }
+  BuildSystemDictionary(source_tokens, source_tokens.size());
+
+  std::unique_ptr<SystemDictionary> system_dic =
+      SystemDictionary::Builder(dic_fn_).Build().value();
+  ASSERT_TRUE(system_dic) << "Failed to open dictionary source:" << dic_fn_;
+
+  for (int i = 0; i < 3; ++i) {
+    RejectLidCallback callback(20);
+    switch (i) {
+      case 0:
+        system_dic->LookupPrefix("きしゃ", convreq_, &callback);
+        break;
+      case 1:
+        system_dic->LookupExact("きしゃ", convreq_, &callback);
+        break;
+      default:
+        system_dic->LookupPredictive("きし", convreq_, &callback);
+        break;
+    }
+    EXPECT_EQ(2, callback.num_rejected());
+    std::vector<Token> actual = callback.tokens();
+    ASSERT_EQ(2, actual.size());
+    std::sort(actual.begin(), actual.end(),
+              [](const Token &a, const Token &b) { return a.cost < b.cost; });
+    EXPECT_TOKEN_EQ(tokens[0], actual[0]);
+    EXPECT_TOKEN_EQ(tokens[2], actual[1]);
+  }
+}
+
 TEST_F(SystemDictionaryTest, EnableNoModifierTargetWithLoudsTrie) {
   const std::string k0 = "かつ";
   const std::string k1 = "かっこ";
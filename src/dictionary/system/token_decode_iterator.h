@@ -44,6 +44,16 @@
 namespace mozc {
 namespace dictionary {
 
+// Decodes the tokens for a key one by one.  The value of each token is
+// decoded lazily, i.e., only when Get() is called, so that callers can reject
+// tokens by POS, cost and attributes without decoding their values:
+//
+//   for (TokenDecodeIterator iter(...); !iter.Done(); iter.Next()) {
+//     if (!IsWanted(*iter.GetWithoutValue().token)) {
+//       continue;  // The value is never decoded.
+//     }
+//     Use(*iter.Get().token);
+//   }
 class TokenDecodeIterator {
  public:
   TokenDecodeIterator(const SystemDictionaryCodecInterface *codec,
@@ -52,7 +62,18 @@ class TokenDecodeIterator {
                       const uint8 *ptr);
   ~TokenDecodeIterator() {}
 
-  const TokenInfo &Get() const { return token_info_; }
+  // Returns the current token with its value decoded.
+  const TokenInfo &Get() const {
+    if (!value_decoded_) {
+      DecodeValue();
+    }
+    return token_info_;
+  }
+
+  // Returns the current token without decoding its value.  Key, lid, rid,
+  // cost and attributes of the token are valid, while its value is not.
+  const TokenInfo &GetWithoutValue() const { return token_info_; }
+
   bool Done() const { return state_ == DONE; }
   void Next();
 
@@ -64,6 +85,7 @@ class TokenDecodeIterator {
   };
 
   void NextInternal();
+  void DecodeValue() const;
 
   void LookupValue(int id, std::string *value) const {
     char buffer[storage::louds::LoudsTrie::kMaxDepth + 1];
@@ -78,13 +100,19 @@ class TokenDecodeIterator {
 
   const absl::string_view key_;
   // Katakana key will be lazily initialized.
-  std::string key_katakana_;
+  mutable std::string key_katakana_;
 
   State state_;
   const uint8 *ptr_;
 
-  TokenInfo token_info_;
-  Token token_;
+  // The value of the current token is decoded into |token_.value| on demand.
+  // |value_id_in_token_| is the id in value trie of the value currently held
+  // by |token_.value|, or -1 if it doesn't hold a value from value trie, so
+  // that the value is reused for the successive tokens with the same value.
+  mutable TokenInfo token_info_;
+  mutable Token token_;
+  mutable bool value_decoded_;
+  mutable int value_id_in_token_;
 
   DISALLOW_COPY_AND_ASSIGN(TokenDecodeIterator);
 };
@@ -101,7 +129,9 @@ inline TokenDecodeIterator::TokenDecodeIterator(
       key_(key),
       state_(HAS_NEXT),
       ptr_(ptr),
-      token_info_(nullptr) {
+      token_info_(nullptr),
+      value_decoded_(false),
+      value_id_in_token_(-1) {
   token_.key.assign(key.data(), key.size());
   NextInternal();
 }
@@ -145,21 +175,34 @@ inline void TokenDecodeIterator::NextInternal() {
   }
   ptr_ += read_bytes;
 
-  // Fill remaining values.
+  if (token_info_.value_type == TokenInfo::SAME_AS_PREV_VALUE) {
+    DCHECK_NE(prev_id_in_value_trie, -1);
+    token_info_.id_in_value_trie = prev_id_in_value_trie;
+  }
+  value_decoded_ = false;
+
+  if (token_info_.pos_type == TokenInfo::FREQUENT_POS) {
+    const uint32 pos = frequent_pos_[token_info_.id_in_frequent_pos_map];
+    token_.lid = pos >> 16;
+    token_.rid = pos & 0xffff;
+  }
+}
+
+inline void TokenDecodeIterator::DecodeValue() const {
   switch (token_info_.value_type) {
-    case TokenInfo::DEFAULT_VALUE: {
-      token_.value.clear();
-      LookupValue(token_info_.id_in_value_trie, &token_.value);
-      break;
-    }
+    case TokenInfo::DEFAULT_VALUE:
     case TokenInfo::SAME_AS_PREV_VALUE: {
-      DCHECK_NE(prev_id_in_value_trie, -1);
-      token_info_.id_in_value_trie = prev_id_in_value_trie;
-      // We can keep the current value here.
+      // The value can be kept if it has been decoded for the previous token.
+      if (value_id_in_token_ != token_info_.id_in_value_trie) {
+        token_.value.clear();
+        LookupValue(token_info_.id_in_value_trie, &token_.value);
+        value_id_in_token_ = token_info_.id_in_value_trie;
+      }
       break;
     }
     case TokenInfo::AS_IS_HIRAGANA: {
       token_.value = token_.key;
+      value_id_in_token_ = -1;
       break;
     }
     case TokenInfo::AS_IS_KATAKANA: {
@@ -167,6 +210,7 @@ inline void TokenDecodeIterator::NextInternal() {
         Util::HiraganaToKatakana(key_, &key_katakana_);
       }
       token_.value = key_katakana_;
+      value_id_in_token_ = -1;
       break;
     }
     default: {
@@ -178,13 +222,10 @@ inline void TokenDecodeIterator::NextInternal() {
   if (token_info_.accent_encoding_type == TokenInfo::EMBEDDED_IN_TOKEN) {
     token_.value.append(1, '_').append(
         Util::StringPrintf("%d", token_info_.accent_type));
+    // The value is no longer the one in value trie.
+    value_id_in_token_ = -1;
   }
-
-  if (token_info_.pos_type == TokenInfo::FREQUENT_POS) {
-    const uint32 pos = frequent_pos_[token_info_.id_in_frequent_pos_map];
-    token_.lid = pos >> 16;
-    token_.rid = pos & 0xffff;
-  }
+  value_decoded_ = true;
 }
 
 }  // namespace dictionary
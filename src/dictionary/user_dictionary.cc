@@ -34,6 +34,7 @@
 #include <memory>
 #include <set>
 #include <string>
+#include <vector>
 
 #include "base/compiler_specific.h"
 #include "base/file_util.h"
@@ -119,6 +120,17 @@ void FillTokenFromUserPOSToken(const UserPOS::Token &user_pos_token,
   token->attributes = Token::USER_DICTIONARY;
 }
 
+void SplitIntoChars(absl::string_view str,
+                    std::vector<absl::string_view> *chars) {
+  chars->clear();
+  for (size_t pos = 0; pos < str.size();) {
+    const size_t len =
+        std::min<size_t>(Util::OneCharLen(str.data() + pos), str.size() - pos);
+    chars->push_back(str.substr(pos, len));
+    pos += len;
+  }
+}
+
 }  // namespace
 
 class UserDictionary::TokensIndex : public std::vector<UserPOS::Token *> {
@@ -285,6 +297,7 @@ UserDictionary::UserDictionary(std::unique_ptr<const UserPOSInterface> user_pos,
       pos_matcher_(pos_matcher),
       suppression_dictionary_(suppression_dictionary),
       tokens_(new TokensIndex(user_pos_.get(), suppression_dictionary)),
+      generation_(0),
       mutex_(new ReaderWriterMutex) {
   DCHECK(user_pos_.get());
   DCHECK(suppression_dictionary_);
@@ -354,6 +367,160 @@ void UserDictionary::LookupPredictive(
   }
 }
 
+void UserDictionary::LookupPredictiveApproximate(
+    absl::string_view key, size_t exact_prefix_len, int max_edits,
+    const ConversionRequest &conversion_request, Callback *callback) const {
+  scoped_reader_lock l(mutex_.get());
+
+  if (key.empty() || max_edits < 0 || exact_prefix_len > key.size()) {
+    return;
+  }
+  if (tokens_->empty()) {
+    return;
+  }
+  if (conversion_request.config().incognito_mode()) {
+    return;
+  }
+
+  const absl::string_view exact_prefix = key.substr(0, exact_prefix_len);
+  std::vector<absl::string_view> query_chars;
+  SplitIntoChars(key.substr(exact_prefix_len), &query_chars);
+  // An empty prefix of the keys would match, i.e., every key.
+  if (query_chars.size() <= static_cast<size_t>(max_edits)) {
+    return;
+  }
+
+  // A key and the length of its prefix that matched the query.
+  struct Match {
+    const UserPOS::Token *token;
+    size_t prefix_len;
+    int num_edits;
+  };
+  std::vector<Match> matches;
+
+  // rows[d * row_size ...] is the row of the Levenshtein distance matrix
+  // between the query and the first d characters of the key after
+  // |exact_prefix|.  The first |num_rows| rows are valid for |key_chars|, the
+  // characters of the last key, so that the next key in order reuses the rows
+  // for the characters it shares with the last one.  The minimum of a row
+  // doesn't decrease in the following rows, so no row follows the one whose
+  // minimum exceeds |max_edits|.
+  const size_t row_size = query_chars.size() + 1;
+  std::vector<int> rows(row_size);
+  for (size_t i = 0; i < row_size; ++i) {
+    rows[i] = i;
+  }
+  size_t num_rows = 1;
+  bool last_row_exceeds = false;
+  std::vector<absl::string_view> key_chars, next_key_chars;
+  const auto range = std::equal_range(tokens_->begin(), tokens_->end(),
+                                      exact_prefix, OrderByKeyPrefix());
+  for (auto it = range.first; it != range.second; ++it) {
+    const absl::string_view actual_key = (*it)->key;
+    SplitIntoChars(actual_key.substr(exact_prefix.size()), &next_key_chars);
+    size_t depth = 0;
+    while (depth + 1 < num_rows && depth < next_key_chars.size() &&
+           next_key_chars[depth] == key_chars[depth]) {
+      ++depth;
+    }
+    key_chars.swap(next_key_chars);
+    if (depth + 1 < num_rows) {
+      num_rows = depth + 1;
+      last_row_exceeds = false;
+    }
+
+    // Extends the rows until the distance can't be within |max_edits|.
+    for (; !last_row_exceeds && depth < key_chars.size(); ++depth) {
+      rows.resize((depth + 2) * row_size);
+      const int *row = &rows[depth * row_size];
+      int *next_row = &rows[(depth + 1) * row_size];
+      next_row[0] = row[0] + 1;
+      int min_distance = next_row[0];
+      for (size_t i = 1; i < row_size; ++i) {
+        const int substitution =
+            row[i - 1] + (query_chars[i - 1] == key_chars[depth] ? 0 : 1);
+        next_row[i] =
+            std::min(std::min(row[i], next_row[i - 1]) + 1, substitution);
+        min_distance = std::min(min_distance, next_row[i]);
+      }
+      ++num_rows;
+      last_row_exceeds = min_distance > max_edits;
+    }
+
+    // The shortest prefix with the fewest edits matches, as in
+    // SystemDictionary.
+    Match match = {*it, 0, max_edits + 1};
+    size_t prefix_len = exact_prefix.size();
+    for (size_t d = 0; d < num_rows; ++d) {
+      if (d > 0) {
+        prefix_len += key_chars[d - 1].size();
+      }
+      const int distance = rows[d * row_size + row_size - 1];
+      if (distance < match.num_edits) {
+        match.prefix_len = prefix_len;
+        match.num_edits = distance;
+      }
+    }
+    if (match.num_edits <= max_edits) {
+      matches.push_back(match);
+    }
+  }
+
+  // Visit closer matches first.
+  std::stable_sort(matches.begin(), matches.end(),
+                   [](const Match &lhs, const Match &rhs) {
+                     return lhs.num_edits < rhs.num_edits;
+                   });
+  std::string decoded_key;
+  Token token;
+  for (const Match &match : matches) {
+    const UserPOS::Token &user_pos_token = *match.token;
+    const absl::string_view actual_key = user_pos_token.key;
+    switch (callback->OnApproximateKey(actual_key, match.num_edits)) {
+      case Callback::TRAVERSE_DONE:
+        return;
+      case Callback::TRAVERSE_NEXT_KEY:
+      case Callback::TRAVERSE_CULL:
+        continue;
+      default:
+        break;
+    }
+    // decoded_key = key + the rest of the actual key after the prefix that
+    // matched |key|.
+    decoded_key.assign(key.data(), key.size());
+    decoded_key.append(actual_key.data() + match.prefix_len,
+                       actual_key.size() - match.prefix_len);
+    switch (callback->OnKey(decoded_key)) {
+      case Callback::TRAVERSE_DONE:
+        return;
+      case Callback::TRAVERSE_NEXT_KEY:
+      case Callback::TRAVERSE_CULL:
+        continue;
+      default:
+        break;
+    }
+    switch (callback->OnActualKey(decoded_key, actual_key,
+                                  match.num_edits > 0)) {
+      case Callback::TRAVERSE_DONE:
+        return;
+      case Callback::TRAVERSE_NEXT_KEY:
+      case Callback::TRAVERSE_CULL:
+        continue;
+      default:
+        break;
+    }
+    FillTokenFromUserPOSToken(user_pos_token, &token);
+    // Override POS IDs for suggest only words.
+    if (pos_matcher_.IsSuggestOnlyWord(user_pos_token.id)) {
+      token.lid = token.rid = pos_matcher_.GetUnknownId();
+    }
+    if (callback->OnToken(decoded_key, actual_key, token) ==
+        Callback::TRAVERSE_DONE) {
+      return;
+    }
+  }
+}
+
 // UserDictionary doesn't support kana modifier insensitive lookup.
 void UserDictionary::LookupPrefix(absl::string_view key,
                                   const ConversionRequest &conversion_request,
@@ -514,12 +681,18 @@ class FindValueCallback : public DictionaryInterface::Callback {
 
 void UserDictionary::WaitForReloader() { reloader_->Join(); }
 
+uint64 UserDictionary::GetGeneration() const {
+  scoped_reader_lock l(mutex_.get());
+  return generation_;
+}
+
 void UserDictionary::Swap(TokensIndex *new_tokens) {
   DCHECK(new_tokens);
   TokensIndex *old_tokens = tokens_;
   {
     scoped_writer_lock l(mutex_.get());
     tokens_ = new_tokens;
+    ++generation_;
   }
   delete old_tokens;
 }
@@ -63,6 +63,12 @@ class UserDictionary : public DictionaryInterface {
   void LookupPredictive(absl::string_view key,
                         const ConversionRequest &conversion_request,
                         Callback *callback) const override;
+  // Computes the edit distance for the keys in order, reusing the work for
+  // the prefix shared with the previous key.
+  void LookupPredictiveApproximate(absl::string_view key,
+                                   size_t exact_prefix_len, int max_edits,
+                                   const ConversionRequest &conversion_request,
+                                   Callback *callback) const override;
   void LookupPrefix(absl::string_view key,
                     const ConversionRequest &conversion_request,
                     Callback *callback) const override;
@@ -87,6 +93,10 @@ class UserDictionary : public DictionaryInterface {
   // Reloads dictionary asynchronously
   bool Reload() override;
 
+  // Returns the number of times the tokens have been swapped.  The
+  // suppression dictionary is updated right before the swap.
+  uint64 GetGeneration() const override;
+
   // Waits until reloader finishes
   void WaitForReloader();
 
@@ -105,6 +115,7 @@ class UserDictionary : public DictionaryInterface {
   const POSMatcher pos_matcher_;
   SuppressionDictionary *suppression_dictionary_;
   TokensIndex *tokens_;
+  uint64 generation_;  // Guarded by |mutex_|.
   mutable std::unique_ptr<ReaderWriterMutex> mutex_;
 
   friend class UserDictionaryTest;
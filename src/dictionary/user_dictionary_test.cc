@@ -33,6 +33,7 @@
 #include <cstring>
 #include <memory>
 #include <random>
+#include <set>
 #include <sstream>
 #include <string>
 #include <vector>
@@ -420,6 +421,82 @@ TEST_F(UserDictionaryTest, TestLookupPredictive) {
   TestLookupPredictiveHelper(nullptr, 0, "st", *dic);
 }
 
+TEST_F(UserDictionaryTest, TestLookupPredictiveApproximate) {
+  unique_ptr<UserDictionary> dic(CreateDictionaryWithMockPos());
+  // Wait for async reload called from the constructor.
+  dic->WaitForReloader();
+
+  {
+    UserDictionaryStorage storage("");
+    UserDictionaryTest::LoadFromString(kUserDictionary0, &storage);
+    dic->Load(storage.GetProto());
+  }
+
+  // Collects "actual_key:num_edits" for each token.
+  class ApproximateCollector : public DictionaryInterface::Callback {
+   public:
+    ResultType OnApproximateKey(absl::string_view actual_key,
+                                int num_edits) override {
+      num_edits_ = num_edits;
+      return TRAVERSE_CONTINUE;
+    }
+
+    ResultType OnToken(absl::string_view key, absl::string_view actual_key,
+                       const Token &token) override {
+      results_.insert(std::string(actual_key) + ":" +
+                      std::to_string(num_edits_));
+      return TRAVERSE_CONTINUE;
+    }
+
+    const std::set<std::string> &results() const { return results_; }
+
+   private:
+    int num_edits_ = -1;
+    std::set<std::string> results_;
+  };
+
+  {
+    // "smoh" is one substitution away from "smog".
+    ApproximateCollector collector;
+    dic->LookupPredictiveApproximate("smoh", 0, 1, convreq_, &collector);
+    EXPECT_EQ(std::set<std::string>({"smog:1"}), collector.results());
+  }
+  {
+    // No edit is allowed with |max_edits| = 0.
+    ApproximateCollector collector;
+    dic->LookupPredictiveApproximate("smoh", 0, 0, convreq_, &collector);
+    EXPECT_TRUE(collector.results().empty());
+  }
+  {
+    // The first character is substituted.
+    ApproximateCollector collector;
+    dic->LookupPredictiveApproximate("xtart", 0, 1, convreq_, &collector);
+    EXPECT_EQ(
+        std::set<std::string>({"start:1", "started:1", "starting:1"}),
+        collector.results());
+  }
+  {
+    // The exact prefix "x" takes no edit.
+    ApproximateCollector collector;
+    dic->LookupPredictiveApproximate("xtart", 1, 1, convreq_, &collector);
+    EXPECT_TRUE(collector.results().empty());
+  }
+  {
+    // The edit is after the exact prefix "st".
+    ApproximateCollector collector;
+    dic->LookupPredictiveApproximate("stxrt", 2, 1, convreq_, &collector);
+    EXPECT_EQ(
+        std::set<std::string>({"start:1", "started:1", "starting:1"}),
+        collector.results());
+  }
+  {
+    // Keys matching without edits are reported with zero edits.
+    ApproximateCollector collector;
+    dic->LookupPredictiveApproximate("smog", 0, 1, convreq_, &collector);
+    EXPECT_EQ(1, collector.results().count("smog:0"));
+  }
+}
+
 TEST_F(UserDictionaryTest, TestLookupPrefix) {
   unique_ptr<UserDictionary> dic(CreateDictionaryWithMockPos());
   // Wait for async reload called from the constructor.
@@ -681,9 +758,12 @@ TEST_F(UserDictionaryTest, TestSuppressionDictionary) {
       entry->set_pos(user_dictionary::UserDictionary::NOUN);
     }
 
+    const uint64 generation = user_dic->GetGeneration();
     suppression_dictionary_->Lock();
     user_dic->Load(storage.GetProto());
     EXPECT_FALSE(suppression_dictionary_->IsLocked());
+    // Callers caching look-ups detect the update by the generation.
+    EXPECT_NE(generation, user_dic->GetGeneration());
 
     for (size_t j = 0; j < 10; ++j) {
       EXPECT_FALSE(suppression_dictionary_->SuppressEntry(
@@ -33,17 +33,25 @@
 #include <cctype>
 #include <climits>  // INT_MAX
 #include <cmath>
+#include <iterator>
+#include <limits>
 #include <list>
 #include <map>
+#include <memory>
 #include <set>
 #include <string>
+#include <tuple>
 #include <utility>
 #include <vector>
 
 #include "base/flags.h"
 #include "base/logging.h"
 #include "base/mozc_hash_map.h"
+#include "base/mutex.h"
 #include "base/number_util.h"
+#include "base/port.h"
+#include "base/stopwatch.h"
+#include "base/thread_pool.h"
 #include "base/util.h"
 #include "composer/composer.h"
 #include "converter/connector.h"
@@ -61,8 +69,21 @@
 #include "protocol/config.pb.h"
 #include "request/conversion_request.h"
 #include "usage_stats/usage_stats.h"
+#include "absl/memory/memory.h"
 #include "absl/strings/string_view.h"
 
+DEFINE_bool(use_approximate_typing_correction_lookup, false,
+            "Look up typing corrections by one approximate traversal of the "
+            "dictionary instead of the type-corrected queries from composer.");
+DEFINE_bool(enable_parallel_prediction_aggregation, false,
+            "Run the dictionary prediction subroutines in parallel.");
+DEFINE_bool(record_prediction_aggregation_timing, false,
+            "Measure the elapsed time of each dictionary prediction "
+            "subroutine.  See DictionaryPredictor::GetAggregationTimings().");
+DEFINE_bool(enable_prediction_lookup_cache, false,
+            "Reuse the unigram dictionary look-up of the previous keystroke "
+            "for the extended key when it found all the matching entries.");
+
 namespace mozc {
 namespace {
 
@@ -85,6 +106,20 @@ const int kInfinity = (2 << 20);
 const size_t kSuggestionMaxResultsSize = 256;
 const size_t kPredictionMaxResultsSize = 100000;
 
+// Maximum number of edits and the cost penalty per edit for the approximate
+// typing correction look-up.  The penalty means that a corrected candidate is
+// evaluated 10 times smaller in frequency per edit (1151 = 500 * log(10)).
+const int kMaxTypingCorrectionEdits = 1;
+const int kTypingCorrectionPenaltyPerEdit = 1151;
+
+// Typing correction is skipped when the other subroutines produced more
+// results than this.
+const size_t kMaxPrevResultsSizeForTypingCorrection = 10000;
+
+// Maximum number of tokens kept by the predictive look-up cache.  Look-ups
+// finding more tokens than this are not cached.
+const size_t kMaxPredictiveLookupCacheSize = 4096;
+
 bool IsSimplifiedRankingEnabled(const ConversionRequest &request) {
   return request.request()
       .decoder_experiment_params()
@@ -218,17 +253,8 @@ class DictionaryPredictor::PredictiveLookupCallback
 
   ResultType OnToken(absl::string_view key, absl::string_view actual_key,
                      const Token &token) override {
-    // If the token is from user dictionary and its POS is unknown, it is
-    // suggest-only words.  Such words are looked up only when their keys
-    // exactly match |key|.  Otherwise, unigram suggestion can be annoying.  For
-    // example, suppose a user registers his/her email address as める.  Then,
-    // we don't want to show the email address from め but exactly from める.
-    if ((token.attributes & Token::USER_DICTIONARY) != 0 &&
-        token.lid == unknown_id_) {
-      const auto orig_key = absl::ClippedSubstr(key, 0, original_key_len_);
-      if (token.key != orig_key) {
-        return TRAVERSE_CONTINUE;
-      }
+    if (IsSuggestOnlyWordForOtherKey(key, token)) {
+      return TRAVERSE_CONTINUE;
     }
     results_->push_back(Result());
     results_->back().InitializeByTokenAndTypes(token, types_);
@@ -238,6 +264,20 @@ class DictionaryPredictor::PredictiveLookupCallback
   }
 
  protected:
+  // If the token is from user dictionary and its POS is unknown, it is
+  // suggest-only words.  Such words are looked up only when their keys
+  // exactly match |key|.  Otherwise, unigram suggestion can be annoying.  For
+  // example, suppose a user registers his/her email address as める.  Then,
+  // we don't want to show the email address from め but exactly from める.
+  bool IsSuggestOnlyWordForOtherKey(absl::string_view key,
+                                    const Token &token) const {
+    if ((token.attributes & Token::USER_DICTIONARY) == 0 ||
+        token.lid != unknown_id_) {
+      return false;
+    }
+    return token.key != absl::ClippedSubstr(key, 0, original_key_len_);
+  }
+
   int32 penalty_;
   const DictionaryPredictor::PredictionTypes types_;
   const size_t limit_;
@@ -284,6 +324,281 @@ class DictionaryPredictor::PredictiveBigramLookupCallback
   absl::string_view history_value_;
 };
 
+// Collects the candidates found by
+// DictionaryInterface::LookupPredictiveApproximate() whose keys need at least
+// one edit, as exact matches are found by the usual predictive look-up.
+class DictionaryPredictor::ApproximateLookupCallback
+    : public PredictiveLookupCallback {
+ public:
+  ApproximateLookupCallback(DictionaryPredictor::PredictionTypes types,
+                            size_t limit, size_t original_key_len,
+                            int unknown_id,
+                            std::vector<DictionaryPredictor::Result> *results)
+      : PredictiveLookupCallback(types, limit, original_key_len, nullptr,
+                                 Segment::Candidate::SOURCE_INFO_NONE,
+                                 unknown_id, results),
+        num_edits_(0) {}
+
+  ApproximateLookupCallback(const ApproximateLookupCallback &) = delete;
+  ApproximateLookupCallback &operator=(const ApproximateLookupCallback &) =
+      delete;
+
+  ResultType OnApproximateKey(absl::string_view actual_key,
+                              int num_edits) override {
+    num_edits_ = num_edits;
+    return num_edits > 0 ? TRAVERSE_CONTINUE : TRAVERSE_NEXT_KEY;
+  }
+
+  ResultType OnActualKey(absl::string_view key, absl::string_view actual_key,
+                         bool is_expanded) override {
+    penalty_ = num_edits_ * kTypingCorrectionPenaltyPerEdit;
+    return TRAVERSE_CONTINUE;
+  }
+
+ private:
+  int num_edits_;
+};
+
+// Caches the tokens found by DictionaryInterface::LookupPredictive() for the
+// last key so that the look-up for a longer key, which is the typical next
+// keystroke, is answered by filtering them instead of traversing the
+// dictionary again.  Since a dictionary visits the keys starting with the
+// longer key in the same order as it does for the shorter one, replaying the
+// cached tokens whose keys start with the longer key gives the same callbacks
+// as a fresh look-up.  This holds only when the cached look-up visited all the
+// matching keys, i.e., neither a dictionary (see OnLookupTruncated()) nor the
+// size limit of the cache stopped it, and under the same request conditions.
+class DictionaryPredictor::PredictiveLookupCache {
+ public:
+  PredictiveLookupCache() : complete_(false) {}
+
+  PredictiveLookupCache(const PredictiveLookupCache &) = delete;
+  PredictiveLookupCache &operator=(const PredictiveLookupCache &) = delete;
+
+  // Looks up |key| in |dictionary| through |cache|, or directly if |cache| is
+  // nullptr.
+  static void LookupPredictive(PredictiveLookupCache *cache,
+                               const DictionaryInterface &dictionary,
+                               absl::string_view key,
+                               const ConversionRequest &request,
+                               DictionaryInterface::Callback *callback) {
+    if (cache == nullptr) {
+      dictionary.LookupPredictive(key, request, callback);
+      return;
+    }
+    cache->Lookup(dictionary, key, request, callback);
+  }
+
+  void Clear() {
+    scoped_lock l(&mutex_);
+    key_.clear();
+    entries_.clear();
+    complete_ = false;
+  }
+
+ private:
+  // Dictionary, its generation and the config fields affecting the tokens
+  // passed to callbacks; see DictionaryImpl and UserDictionary.  The
+  // generation changes when the user dictionary, and hence the suppression
+  // dictionary, is reloaded, e.g., by Engine::Reload().
+  typedef std::tuple<const DictionaryInterface *, uint64, bool, bool, bool,
+                     bool>
+      Condition;
+
+  struct Entry {
+    std::string key;
+    std::string actual_key;
+    Token token;
+    // True for the first token passed after OnKey().
+    bool starts_key;
+  };
+
+  class RecordingCallback;
+
+  static Condition GetCondition(const DictionaryInterface &dictionary,
+                                const ConversionRequest &request) {
+    const config::Config &config = request.config();
+    return Condition(&dictionary, dictionary.GetGeneration(),
+                     config.incognito_mode(),
+                     config.use_spelling_correction(),
+                     config.use_zip_code_conversion(),
+                     config.use_t13n_conversion());
+  }
+
+  void Lookup(const DictionaryInterface &dictionary, absl::string_view key,
+              const ConversionRequest &request,
+              DictionaryInterface::Callback *callback);
+
+  // Passes the cached tokens whose keys start with |key| to |callback|.
+  void Replay(absl::string_view key,
+              DictionaryInterface::Callback *callback) const;
+
+  Mutex mutex_;
+  std::string key_;
+  Condition condition_;
+  std::vector<Entry> entries_;
+  bool complete_;
+};
+
+// Records the tokens passed from dictionaries to the cache while forwarding
+// them to the original callback.  The traversal continues after the original
+// callback finishes so that the cache gets all the tokens for |key_|.
+class DictionaryPredictor::PredictiveLookupCache::RecordingCallback
+    : public DictionaryInterface::Callback {
+ public:
+  RecordingCallback(PredictiveLookupCache *cache,
+                    DictionaryInterface::Callback *callback)
+      : cache_(cache),
+        callback_(callback),
+        callback_done_(false),
+        skip_key_(false),
+        starts_key_(false) {}
+
+  RecordingCallback(const RecordingCallback &) = delete;
+  RecordingCallback &operator=(const RecordingCallback &) = delete;
+
+  ResultType OnKey(absl::string_view key) override {
+    starts_key_ = true;
+    skip_key_ = false;
+    if (!callback_done_) {
+      Update(callback_->OnKey(key));
+    }
+    return Next();
+  }
+
+  ResultType OnActualKey(absl::string_view key, absl::string_view actual_key,
+                         bool is_expanded) override {
+    if (is_expanded) {
+      // Expanded keys can't be filtered by a longer key.
+      cache_->complete_ = false;
+    }
+    if (IsForwarding()) {
+      Update(callback_->OnActualKey(key, actual_key, is_expanded));
+    }
+    return Next();
+  }
+
+  bool OnTokenWithoutValue(absl::string_view key, absl::string_view actual_key,
+                           const Token &token) override {
+    if (cache_->complete_) {
+      return true;
+    }
+    return IsForwarding() &&
+           callback_->OnTokenWithoutValue(key, actual_key, token);
+  }
+
+  ResultType OnToken(absl::string_view key, absl::string_view actual_key,
+                     const Token &token) override {
+    if (cache_->complete_) {
+      if (cache_->entries_.size() < kMaxPredictiveLookupCacheSize) {
+        cache_->entries_.push_back(
+            {std::string(key), std::string(actual_key), token, starts_key_});
+        starts_key_ = false;
+      } else {
+        cache_->complete_ = false;
+      }
+    }
+    if (IsForwarding() &&
+        callback_->OnTokenWithoutValue(key, actual_key, token)) {
+      Update(callback_->OnToken(key, actual_key, token));
+    }
+    return Next();
+  }
+
+  void OnLookupTruncated() override {
+    cache_->complete_ = false;
+    callback_->OnLookupTruncated();
+  }
+
+ private:
+  bool IsForwarding() const { return !callback_done_ && !skip_key_; }
+
+  void Update(ResultType result) {
+    if (result == TRAVERSE_DONE) {
+      callback_done_ = true;
+    } else if (result != TRAVERSE_CONTINUE) {
+      skip_key_ = true;
+    }
+  }
+
+  // Keeps traversing while recording; otherwise follows the original
+  // callback.
+  ResultType Next() const {
+    if (cache_->complete_) {
+      return TRAVERSE_CONTINUE;
+    }
+    if (callback_done_) {
+      return TRAVERSE_DONE;
+    }
+    return skip_key_ ? TRAVERSE_NEXT_KEY : TRAVERSE_CONTINUE;
+  }
+
+  PredictiveLookupCache *cache_;
+  DictionaryInterface::Callback *callback_;
+  bool callback_done_;
+  bool skip_key_;
+  bool starts_key_;
+};
+
+void DictionaryPredictor::PredictiveLookupCache::Lookup(
+    const DictionaryInterface &dictionary, absl::string_view key,
+    const ConversionRequest &request,
+    DictionaryInterface::Callback *callback) {
+  // Kana modifier insensitive look-up finds keys not starting with |key|,
+  // which can't be filtered for a longer key.
+  if (key.empty() || request.IsKanaModifierInsensitiveConversion()) {
+    dictionary.LookupPredictive(key, request, callback);
+    return;
+  }
+  const Condition condition = GetCondition(dictionary, request);
+  scoped_lock l(&mutex_);
+  if (complete_ && condition == condition_ && Util::StartsWith(key, key_)) {
+    Replay(key, callback);
+    return;
+  }
+  key_.assign(key.data(), key.size());
+  condition_ = condition;
+  entries_.clear();
+  complete_ = true;
+  RecordingCallback recorder(this, callback);
+  dictionary.LookupPredictive(key, request, &recorder);
+  if (!complete_) {
+    entries_.clear();
+  }
+}
+
+void DictionaryPredictor::PredictiveLookupCache::Replay(
+    absl::string_view key, DictionaryInterface::Callback *callback) const {
+  bool skip_key = false;
+  for (const Entry &entry : entries_) {
+    // All the tokens of a key are filtered in or out together.
+    if (!Util::StartsWith(entry.key, key)) {
+      continue;
+    }
+    if (entry.starts_key) {
+      DictionaryInterface::Callback::ResultType result =
+          callback->OnKey(entry.key);
+      if (result == DictionaryInterface::Callback::TRAVERSE_CONTINUE) {
+        result = callback->OnActualKey(entry.key, entry.actual_key, false);
+      }
+      if (result == DictionaryInterface::Callback::TRAVERSE_DONE) {
+        return;
+      }
+      skip_key = result != DictionaryInterface::Callback::TRAVERSE_CONTINUE;
+    }
+    if (skip_key || !callback->OnTokenWithoutValue(entry.key, entry.actual_key,
+                                                   entry.token)) {
+      continue;
+    }
+    const DictionaryInterface::Callback::ResultType result =
+        callback->OnToken(entry.key, entry.actual_key, entry.token);
+    if (result == DictionaryInterface::Callback::TRAVERSE_DONE) {
+      return;
+    }
+    skip_key = result != DictionaryInterface::Callback::TRAVERSE_CONTINUE;
+  }
+}
+
 // Comparator for sorting prediction candidates.
 // If we have words A and AB, for example "六本木" and "六本木ヒルズ",
 // assume that cost(A) < cost(AB).
@@ -321,7 +636,8 @@ DictionaryPredictor::DictionaryPredictor(
       counter_suffix_word_id_(pos_matcher->GetCounterSuffixWordId()),
       general_symbol_id_(pos_matcher->GetGeneralSymbolId()),
       unknown_id_(pos_matcher->GetUnknownId()),
-      predictor_name_("DictionaryPredictor") {
+      predictor_name_("DictionaryPredictor"),
+      unigram_lookup_cache_(absl::make_unique<PredictiveLookupCache>()) {
   absl::string_view zero_query_token_array_data;
   absl::string_view zero_query_string_array_data;
   absl::string_view zero_query_number_token_array_data;
@@ -340,6 +656,10 @@ DictionaryPredictor::~DictionaryPredictor() {}
 
 void DictionaryPredictor::Finish(const ConversionRequest &request,
                                  Segments *segments) {
+  // The next composition rarely extends the committed key, so releases the
+  // cached tokens.
+  unigram_lookup_cache_->Clear();
+
   if (segments->request_type() == Segments::REVERSE_CONVERSION) {
     // Do nothing for REVERSE_CONVERSION.
     return;
@@ -512,50 +832,183 @@ DictionaryPredictor::PredictionTypes DictionaryPredictor::AggregatePrediction(
   }
 
   PredictionTypes selected_types = NO_PREDICTION;
-  if (ShouldAggregateRealTimeConversionResults(request, *segments)) {
-    AggregateRealtimeConversion(request, realtime_max_size, segments, results);
+  const bool use_realtime =
+      ShouldAggregateRealTimeConversionResults(request, *segments);
+  if (use_realtime) {
     selected_types |= REALTIME;
   }
+  const bool record_timing =
+      mozc::GetFlag(FLAGS_record_prediction_aggregation_timing);
+  // Realtime conversion modifies |segments| temporarily, so it runs on the
+  // calling thread.
+  double realtime_usec = 0;
+  auto aggregate_realtime = [&]() {
+    if (!record_timing) {
+      AggregateRealtimeConversion(request, realtime_max_size, segments,
+                                  results);
+      return;
+    }
+    Stopwatch stopwatch = Stopwatch::StartNew();
+    AggregateRealtimeConversion(request, realtime_max_size, segments, results);
+    stopwatch.Stop();
+    realtime_usec = stopwatch.GetElapsedMicroseconds();
+  };
+
   // In partial suggestion or prediction, only realtime candidates are used.
   if (segments->request_type() == Segments::PARTIAL_SUGGESTION ||
       segments->request_type() == Segments::PARTIAL_PREDICTION) {
+    if (use_realtime) {
+      aggregate_realtime();
+      if (record_timing) {
+        RecordAggregationTiming("Realtime", realtime_usec);
+      }
+    }
     return selected_types;
   }
 
+  std::vector<AggregationStage> stages;
+
   // Add unigram candidates.
   const size_t min_unigram_key_len = unigram_config.min_key_len;
   if (key_len >= min_unigram_key_len) {
-    const auto &unigram_fn = unigram_config.unigram_fn;
-    PredictionType type = (this->*unigram_fn)(request, *segments, results);
-    selected_types |= type;
+    const auto unigram_fn = unigram_config.unigram_fn;
+    stages.push_back({"Unigram",
+                      std::numeric_limits<size_t>::max(),
+                      [this, &request, unigram_fn](
+                          const Segments &segments,
+                          std::vector<Result> *results) -> PredictionTypes {
+                        return (this->*unigram_fn)(request, segments, results);
+                      }});
   }
 
   // Add bigram candidates.
   constexpr int kMinHistoryKeyLen = 3;
   if (HasHistoryKeyLongerThanOrEqualTo(*segments, kMinHistoryKeyLen)) {
-    AggregateBigramPrediction(request, *segments,
-                              Segment::Candidate::SOURCE_INFO_NONE, results);
-    selected_types |= BIGRAM;
+    stages.push_back({"Bigram",
+                      std::numeric_limits<size_t>::max(),
+                      [this, &request](const Segments &segments,
+                                       std::vector<Result> *results) {
+                        AggregateBigramPrediction(
+                            request, segments,
+                            Segment::Candidate::SOURCE_INFO_NONE, results);
+                        return static_cast<PredictionTypes>(BIGRAM);
+                      }});
   }
 
   // Add english candidates.
   if (IsLanguageAwareInputEnabled(request) && IsQwertyMobileTable(request) &&
       key_len >= min_unigram_key_len) {
-    AggregateEnglishPredictionUsingRawInput(request, *segments, results);
-    selected_types |= ENGLISH;
+    stages.push_back({"English",
+                      std::numeric_limits<size_t>::max(),
+                      [this, &request](const Segments &segments,
+                                       std::vector<Result> *results) {
+                        AggregateEnglishPredictionUsingRawInput(
+                            request, segments, results);
+                        return static_cast<PredictionTypes>(ENGLISH);
+                      }});
   }
 
   // Add typing correction candidates.
   constexpr int kMinTypingCorrectionKeyLen = 3;
   if (IsTypingCorrectionEnabled(request) &&
       key_len >= kMinTypingCorrectionKeyLen) {
-    AggregateTypeCorrectingPrediction(request, *segments, results);
-    selected_types |= TYPING_CORRECTION;
+    stages.push_back({"TypingCorrection",
+                      kMaxPrevResultsSizeForTypingCorrection,
+                      [this, &request](const Segments &segments,
+                                       std::vector<Result> *results) {
+                        AggregateTypeCorrectingPrediction(request, segments,
+                                                          results);
+                        return static_cast<PredictionTypes>(
+                            TYPING_CORRECTION);
+                      }});
+  }
+
+  std::vector<double> stage_usec(record_timing ? stages.size() : 0, 0);
+  auto run_stage = [&](size_t i, const Segments &stage_segments,
+                       std::vector<Result> *stage_results) {
+    if (!record_timing) {
+      return stages[i].aggregate(stage_segments, stage_results);
+    }
+    Stopwatch stopwatch = Stopwatch::StartNew();
+    const PredictionTypes types =
+        stages[i].aggregate(stage_segments, stage_results);
+    stopwatch.Stop();
+    stage_usec[i] = stopwatch.GetElapsedMicroseconds();
+    return types;
+  };
+
+  if (!mozc::GetFlag(FLAGS_enable_parallel_prediction_aggregation) ||
+      stages.empty()) {
+    if (use_realtime) {
+      aggregate_realtime();
+    }
+    for (size_t i = 0; i < stages.size(); ++i) {
+      selected_types |= run_stage(i, *segments, results);
+    }
+  } else {
+    // Each stage reads a snapshot of |segments| and writes to its own results,
+    // which are concatenated in the same order as the sequential mode.
+    Segments stage_segments;
+    stage_segments.CopyFrom(*segments);
+    std::vector<std::vector<Result>> stage_results(stages.size());
+    std::vector<PredictionTypes> stage_types(stages.size(), NO_PREDICTION);
+    {
+      // The stages run on the shared pool while the realtime conversion runs
+      // here.  Wait() runs the stages that no worker has taken yet.
+      ThreadPool::TaskGroup group(ThreadPool::GetSharedPool());
+      for (size_t i = 0; i < stages.size(); ++i) {
+        group.Schedule([&, i]() {
+          stage_types[i] = run_stage(i, stage_segments, &stage_results[i]);
+        });
+      }
+      if (use_realtime) {
+        aggregate_realtime();
+      }
+      group.Wait();
+    }
+
+    for (size_t i = 0; i < stages.size(); ++i) {
+      selected_types |= stage_types[i];
+      if (results->size() > stages[i].max_prev_results_size) {
+        continue;
+      }
+      results->insert(results->end(),
+                      std::make_move_iterator(stage_results[i].begin()),
+                      std::make_move_iterator(stage_results[i].end()));
+    }
   }
 
+  if (record_timing) {
+    if (use_realtime) {
+      RecordAggregationTiming("Realtime", realtime_usec);
+    }
+    for (size_t i = 0; i < stages.size(); ++i) {
+      RecordAggregationTiming(stages[i].timing_name, stage_usec[i]);
+    }
+  }
   return selected_types;
 }
 
+void DictionaryPredictor::RecordAggregationTiming(const char *name,
+                                                  double usec) const {
+  VLOG(2) << name << ": " << usec;
+  scoped_lock lock(&aggregation_timings_mutex_);
+  AggregationTiming *timing = &aggregation_timings_[name];
+  timing->total_usec += static_cast<uint64>(usec);
+  ++timing->num_calls;
+}
+
+std::map<std::string, DictionaryPredictor::AggregationTiming>
+DictionaryPredictor::GetAggregationTimings() const {
+  scoped_lock lock(&aggregation_timings_mutex_);
+  return aggregation_timings_;
+}
+
+void DictionaryPredictor::ClearAggregationTimings() {
+  scoped_lock lock(&aggregation_timings_mutex_);
+  aggregation_timings_.clear();
+}
+
 bool DictionaryPredictor::AddPredictionToCandidates(
     const ConversionRequest &request, bool include_exact_key,
     Segments *segments, std::vector<Result> *results) const {
@@ -1476,7 +1929,11 @@ DictionaryPredictor::AggregateUnigramCandidate(
   const size_t prev_results_size = results->size();
   GetPredictiveResults(*dictionary_, "", request, segments, UNIGRAM,
                        cutoff_threshold, Segment::Candidate::SOURCE_INFO_NONE,
-                       unknown_id_, results);
+                       unknown_id_,
+                       mozc::GetFlag(FLAGS_enable_prediction_lookup_cache)
+                           ? unigram_lookup_cache_.get()
+                           : nullptr,
+                       results);
   const size_t unigram_results_size = results->size() - prev_results_size;
 
   // If size reaches max_results_size (== cutoff_threshold).
@@ -1510,7 +1967,7 @@ void DictionaryPredictor::AggregateUnigramCandidateForMixedConversion(
   // No history key
   GetPredictiveResults(dictionary, "", request, segments, UNIGRAM,
                        cutoff_threshold, Segment::Candidate::SOURCE_INFO_NONE,
-                       unknown_id, &raw_result);
+                       unknown_id, nullptr, &raw_result);
 
   // Hereafter, we split "Needed Results" and "(maybe) Unneeded Results."
   // The algorithm is:
@@ -1714,14 +2171,15 @@ void DictionaryPredictor::GetPredictiveResults(
     const ConversionRequest &request, const Segments &segments,
     PredictionTypes types, size_t lookup_limit,
     Segment::Candidate::SourceInfo source_info, int unknown_id_,
-    std::vector<Result> *results) {
+    PredictiveLookupCache *cache, std::vector<Result> *results) {
   if (!request.has_composer()) {
     std::string input_key = history_key;
     input_key.append(segments.conversion_segment(0).key());
     PredictiveLookupCallback callback(types, lookup_limit, input_key.size(),
                                       nullptr, source_info, unknown_id_,
                                       results);
-    dictionary.LookupPredictive(input_key, request, &callback);
+    PredictiveLookupCache::LookupPredictive(cache, dictionary, input_key,
+                                            request, &callback);
     return;
   }
 
@@ -1739,7 +2197,8 @@ void DictionaryPredictor::GetPredictiveResults(
     PredictiveLookupCallback callback(types, lookup_limit, input_key.size(),
                                       nullptr, source_info, unknown_id_,
                                       results);
-    dictionary.LookupPredictive(input_key, request, &callback);
+    PredictiveLookupCache::LookupPredictive(cache, dictionary, input_key,
+                                            request, &callback);
     return;
   }
   // |expanded| is a very small set, so calling LookupPredictive multiple
@@ -1750,7 +2209,8 @@ void DictionaryPredictor::GetPredictiveResults(
     PredictiveLookupCallback callback(types, lookup_limit, input_key.size(),
                                       nullptr, source_info, unknown_id_,
                                       results);
-    dictionary.LookupPredictive(input_key, request, &callback);
+    PredictiveLookupCache::LookupPredictive(cache, dictionary, input_key,
+                                            request, &callback);
   }
 }
 
@@ -1843,6 +2303,22 @@ void DictionaryPredictor::GetPredictiveResultsUsingTypingCorrection(
     return;
   }
 
+  if (mozc::GetFlag(FLAGS_use_approximate_typing_correction_lookup)) {
+    if (segments.conversion_segments_size() == 0) {
+      return;
+    }
+    const std::string input_key =
+        history_key + segments.conversion_segment(0).key();
+    ApproximateLookupCallback callback(types, lookup_limit, input_key.size(),
+                                       unknown_id_, results);
+    // The history part was typed in the previous segments, so only the key
+    // being typed is corrected.
+    dictionary.LookupPredictiveApproximate(input_key, history_key.size(),
+                                           kMaxTypingCorrectionEdits, request,
+                                           &callback);
+    return;
+  }
+
   std::vector<composer::TypeCorrectedQuery> queries;
   request.composer().GetTypeCorrectedQueriesForPrediction(&queries);
   for (size_t query_index = 0; query_index < queries.size(); ++query_index) {
@@ -1991,7 +2467,7 @@ void DictionaryPredictor::AggregateSuffixPrediction(
   GetPredictiveResults(*suffix_dictionary_, kEmptyHistoryKey, request, segments,
                        SUFFIX, cutoff_threshold,
                        Segment::Candidate::SOURCE_INFO_NONE, unknown_id_,
-                       results);
+                       nullptr, results);
 }
 
 void DictionaryPredictor::AggregateZeroQuerySuffixPrediction(
@@ -2016,7 +2492,7 @@ void DictionaryPredictor::AggregateZeroQuerySuffixPrediction(
       *suffix_dictionary_, kEmptyHistoryKey, request, segments, SUFFIX,
       cutoff_threshold,
       Segment::Candidate::DICTIONARY_PREDICTOR_ZERO_QUERY_SUFFIX, unknown_id_,
-      results);
+      nullptr, results);
 }
 
 void DictionaryPredictor::AggregateEnglishPrediction(
@@ -2070,7 +2546,7 @@ void DictionaryPredictor::AggregateTypeCorrectingPrediction(
   DCHECK(dictionary_);
 
   const size_t prev_results_size = results->size();
-  if (prev_results_size > 10000) {
+  if (prev_results_size > kMaxPrevResultsSizeForTypingCorrection) {
     return;
   }
 
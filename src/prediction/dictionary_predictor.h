@@ -31,9 +31,13 @@
 #define MOZC_PREDICTION_DICTIONARY_PREDICTOR_H_
 
 #include <functional>
+#include <map>
+#include <memory>
 #include <string>
 #include <vector>
 
+#include "base/mutex.h"
+#include "base/port.h"
 #include "base/util.h"
 #include "converter/connector.h"
 #include "converter/converter_interface.h"
@@ -77,6 +81,18 @@ class DictionaryPredictor : public PredictorInterface {
     return predictor_name_;
   }
 
+  // The elapsed time of a prediction subroutine accumulated while
+  // --record_prediction_aggregation_timing is set.
+  struct AggregationTiming {
+    uint64 total_usec = 0;
+    uint64 num_calls = 0;
+  };
+
+  // Returns the timings keyed by the names of the subroutines, i.e.,
+  // "Realtime", "Unigram", "Bigram", "English" and "TypingCorrection".
+  std::map<std::string, AggregationTiming> GetAggregationTimings() const;
+  void ClearAggregationTimings();
+
  protected:
   // Protected members for unittesting
   // For use util method accessing private members, made them protected.
@@ -161,6 +177,19 @@ class DictionaryPredictor : public PredictorInterface {
     size_t min_key_len;
   };
 
+  // A prediction subroutine that only reads the segments and the
+  // dictionaries, so that it can run in parallel with the others.
+  struct AggregationStage {
+    // Name of the subroutine in GetAggregationTimings().
+    const char *timing_name;
+    // The results are dropped when the preceding subroutines produced more
+    // results than this.
+    size_t max_prev_results_size;
+    std::function<PredictionTypes(const Segments &segments,
+                                  std::vector<Result> *results)>
+        aggregate;
+  };
+
   // On MSVS2008/2010, Constructors of TestableDictionaryPredictor::Result
   // causes a compile error even if you change the access right of it to public.
   // You can use TestableDictionaryPredictor::MakeEmptyResult() instead.
@@ -168,6 +197,8 @@ class DictionaryPredictor : public PredictorInterface {
 
   class PredictiveLookupCallback;
   class PredictiveBigramLookupCallback;
+  class ApproximateLookupCallback;
+  class PredictiveLookupCache;
   class ResultWCostLess;
   class ResultCostLess;
 
@@ -236,6 +267,9 @@ class DictionaryPredictor : public PredictorInterface {
               GetRealtimeCandidateMaxSizeWithActualConverter);
   FRIEND_TEST(DictionaryPredictorTest, GetCandidateCutoffThreshold);
   FRIEND_TEST(DictionaryPredictorTest, AggregateUnigramCandidate);
+  FRIEND_TEST(DictionaryPredictorTest, CachedUnigramLookupIsSameAsUncached);
+  FRIEND_TEST(DictionaryPredictorTest, ParallelAggregationIsSameAsSequential);
+  FRIEND_TEST(DictionaryPredictorTest, AggregationTimings);
   FRIEND_TEST(DictionaryPredictorTest, AggregateBigramPrediction);
   FRIEND_TEST(DictionaryPredictorTest, AggregateZeroQueryBigramPrediction);
   FRIEND_TEST(DictionaryPredictorTest, AggregateSuffixPrediction);
@@ -292,6 +326,9 @@ class DictionaryPredictor : public PredictorInterface {
                                       Segments *segments,
                                       std::vector<Result> *results) const;
 
+  // Adds the elapsed time of a prediction subroutine to the timings.
+  void RecordAggregationTiming(const char *name, double usec) const;
+
   PredictionTypes AggregatePredictionForZeroQuery(
       const ConversionRequest &request, Segments *segments,
       std::vector<Result> *results) const;
@@ -319,12 +356,13 @@ class DictionaryPredictor : public PredictorInterface {
                          const ConversionRequest &request,
                          Result *result) const;
 
+  // Looks up |dictionary| through |cache| unless it's nullptr.
   static void GetPredictiveResults(
       const dictionary::DictionaryInterface &dictionary,
       const std::string &history_key, const ConversionRequest &request,
       const Segments &segments, PredictionTypes types, size_t lookup_limit,
       Segment::Candidate::SourceInfo source_info, int unknown_id,
-      std::vector<Result> *results);
+      PredictiveLookupCache *cache, std::vector<Result> *results);
 
   void GetPredictiveResultsForBigram(
       const dictionary::DictionaryInterface &dictionary,
@@ -343,7 +381,9 @@ class DictionaryPredictor : public PredictorInterface {
       std::vector<Result> *results) const;
 
   // Performs look-ups using type-corrected queries from composer. Usually
-  // involves multiple look-ups from dictionary.
+  // involves multiple look-ups from dictionary.  With
+  // --use_approximate_typing_correction_lookup, performs one approximate
+  // look-up of the conversion key instead.
   void GetPredictiveResultsUsingTypingCorrection(
       const dictionary::DictionaryInterface &dictionary,
       const std::string &history_key, const ConversionRequest &request,
@@ -486,6 +526,10 @@ class DictionaryPredictor : public PredictorInterface {
   const std::string predictor_name_;
   ZeroQueryDict zero_query_dict_;
   ZeroQueryDict zero_query_number_dict_;
+  // Caches the unigram look-up of |dictionary_| for the next keystroke.
+  std::unique_ptr<PredictiveLookupCache> unigram_lookup_cache_;
+  mutable Mutex aggregation_timings_mutex_;
+  mutable std::map<std::string, AggregationTiming> aggregation_timings_;
 
   DISALLOW_COPY_AND_ASSIGN(DictionaryPredictor);
 };
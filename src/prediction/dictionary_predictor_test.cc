@@ -30,6 +30,7 @@
 #include "prediction/dictionary_predictor.h"
 
 #include <algorithm>
+#include <map>
 #include <memory>
 #include <random>
 #include <set>
@@ -78,6 +79,11 @@
 #include "usage_stats/usage_stats_testing_util.h"
 #include "absl/strings/string_view.h"
 
+DECLARE_bool(enable_parallel_prediction_aggregation);
+DECLARE_bool(enable_prediction_lookup_cache);
+DECLARE_bool(record_prediction_aggregation_timing);
+DECLARE_bool(use_approximate_typing_correction_lookup);
+
 namespace mozc {
 namespace {
 
@@ -292,6 +298,71 @@ class CallCheckDictionary : public DictionaryInterface {
               (const, override));
 };
 
+// Dictionary looking up the keys starting with a given key in lexicographical
+// order, like SystemDictionary does.  Counts the calls of LookupPredictive()
+// to check the look-up cache of DictionaryPredictor.
+class PredictiveLookupCountingDictionary : public DictionaryInterface {
+ public:
+  PredictiveLookupCountingDictionary()
+      : num_predictive_lookups_(0), generation_(0) {}
+  ~PredictiveLookupCountingDictionary() override = default;
+
+  void AddToken(const std::string &key, const std::string &value, int cost) {
+    Token token;
+    token.key = key;
+    token.value = value;
+    token.cost = cost;
+    token.lid = 1;
+    token.rid = 1;
+    tokens_[key].push_back(token);
+  }
+
+  void set_generation(uint64 generation) { generation_ = generation; }
+  int num_predictive_lookups() const { return num_predictive_lookups_; }
+
+  bool HasKey(absl::string_view key) const override {
+    return tokens_.find(std::string(key)) != tokens_.end();
+  }
+  bool HasValue(absl::string_view value) const override { return false; }
+
+  void LookupPredictive(absl::string_view key,
+                        const ConversionRequest &convreq,
+                        Callback *callback) const override {
+    ++num_predictive_lookups_;
+    for (auto iter = tokens_.lower_bound(std::string(key));
+         iter != tokens_.end() && Util::StartsWith(iter->first, key);
+         ++iter) {
+      Callback::ResultType result = callback->OnKey(iter->first);
+      if (result == Callback::TRAVERSE_CONTINUE) {
+        result = callback->OnActualKey(iter->first, iter->first, false);
+      }
+      for (const Token &token : iter->second) {
+        if (result != Callback::TRAVERSE_CONTINUE) {
+          break;
+        }
+        result = callback->OnToken(iter->first, iter->first, token);
+      }
+      if (result == Callback::TRAVERSE_DONE) {
+        return;
+      }
+    }
+  }
+
+  void LookupPrefix(absl::string_view key, const ConversionRequest &convreq,
+                    Callback *callback) const override {}
+  void LookupExact(absl::string_view key, const ConversionRequest &convreq,
+                   Callback *callback) const override {}
+  void LookupReverse(absl::string_view str, const ConversionRequest &convreq,
+                     Callback *callback) const override {}
+
+  uint64 GetGeneration() const override { return generation_; }
+
+ private:
+  std::map<std::string, std::vector<Token>> tokens_;
+  mutable int num_predictive_lookups_;
+  uint64 generation_;
+};
+
 // Action to call the third argument of LookupPrefix with the token
 // <key, value>.
 ACTION_P4(LookupPrefixOneToken, key, value, lid, rid) {
@@ -1368,6 +1439,70 @@ TEST_F(DictionaryPredictorTest, AggregateUnigramCandidate) {
   EXPECT_EQ(1, segments.conversion_segments_size());
 }
 
+TEST_F(DictionaryPredictorTest, CachedUnigramLookupIsSameAsUncached) {
+  // Owned by |data_and_predictor|.
+  PredictiveLookupCountingDictionary *dictionary =
+      new PredictiveLookupCountingDictionary;
+  dictionary->AddToken("ぐーぐる", "グーグル", 100);
+  dictionary->AddToken("ぐーぐる", "ぐーぐる", 500);
+  dictionary->AddToken("ぐーぐるあどせんす", "グーグルアドセンス", 200);
+  dictionary->AddToken("ぐーぐるあどわーず", "グーグルアドワーズ", 300);
+  dictionary->AddToken("ぐらす", "グラス", 100);
+  dictionary->AddToken("てすと", "テスト", 100);
+  dictionary->AddToken("てすら", "テスラ", 100);
+  MockDataAndPredictor data_and_predictor;
+  data_and_predictor.Init(dictionary);
+  const DictionaryPredictor *predictor =
+      data_and_predictor.dictionary_predictor();
+
+  const auto check_lookup = [&](const char *key,
+                                 bool expect_cache_hit) -> size_t {
+    SCOPED_TRACE(key);
+    Segments segments;
+    SetUpInputForSuggestion(key, composer_.get(), &segments);
+
+    std::vector<DictionaryPredictor::Result> results[2];
+    mozc::SetFlag(&FLAGS_enable_prediction_lookup_cache, false);
+    predictor->AggregateUnigramCandidate(*convreq_, segments, &results[0]);
+    const int num_lookups = dictionary->num_predictive_lookups();
+    mozc::SetFlag(&FLAGS_enable_prediction_lookup_cache, true);
+    predictor->AggregateUnigramCandidate(*convreq_, segments, &results[1]);
+    mozc::SetFlag(&FLAGS_enable_prediction_lookup_cache, false);
+    EXPECT_EQ(expect_cache_hit ? 0 : 1,
+              dictionary->num_predictive_lookups() - num_lookups);
+
+    EXPECT_EQ(results[0].size(), results[1].size());
+    for (size_t i = 0; i < std::min(results[0].size(), results[1].size());
+         ++i) {
+      EXPECT_EQ(results[0][i].key, results[1][i].key);
+      EXPECT_EQ(results[0][i].value, results[1][i].value);
+      EXPECT_EQ(results[0][i].wcost, results[1][i].wcost);
+      EXPECT_EQ(results[0][i].lid, results[1][i].lid);
+      EXPECT_EQ(results[0][i].rid, results[1][i].rid);
+    }
+    return results[1].size();
+  };
+
+  // Each key is looked up with the cache filled by the previous one.
+  EXPECT_EQ(5, check_lookup("ぐ", false));
+  EXPECT_EQ(4, check_lookup("ぐー", true));
+  EXPECT_EQ(4, check_lookup("ぐーぐ", true));
+  EXPECT_EQ(4, check_lookup("ぐーぐる", true));
+  EXPECT_EQ(2, check_lookup("ぐーぐるあ", true));
+  // The cache still holds the tokens for "ぐ", so going back to a shorter key
+  // hits as well.
+  EXPECT_EQ(4, check_lookup("ぐー", true));
+  EXPECT_EQ(2, check_lookup("てす", false));
+  EXPECT_EQ(1, check_lookup("てすと", true));
+  EXPECT_EQ(5, check_lookup("ぐ", false));
+
+  // Reloading the dictionary invalidates the cache.
+  dictionary->AddToken("てすとあ", "テスト亜", 100);
+  dictionary->set_generation(1);
+  EXPECT_EQ(2, check_lookup("てすと", false));
+  EXPECT_EQ(2, check_lookup("てすと", true));
+}
+
 TEST_F(DictionaryPredictorTest, AggregateUnigramCandidateForMixedConversion) {
   const char kHiraganaA[] = "あ";
   const char kHiraganaAA[] = "ああ";
@@ -2084,6 +2219,151 @@ TEST_F(DictionaryPredictorTest, AggregateTypeCorrectingPrediction) {
                                     arraysize(kExpectedValues));
 }
 
+TEST_F(DictionaryPredictorTest, ApproximateTypeCorrectingPrediction) {
+  testing::MockDataManager data_manager;
+  unique_ptr<MockDataAndPredictor> data_and_predictor(
+      new MockDataAndPredictor());
+  data_and_predictor->Init(
+      CreateSystemDictionaryFromDataManager(data_manager).value().release(),
+      CreateSuffixDictionaryFromDataManager(data_manager));
+  const TestableDictionaryPredictor *predictor =
+      data_and_predictor->dictionary_predictor();
+  config_->set_use_typing_correction(true);
+
+  // The cost of the word for the correct key.
+  Segments segments;
+  SetUpInputForSuggestion("あぼかど", composer_.get(), &segments);
+  std::vector<TestableDictionaryPredictor::Result> results;
+  predictor->AggregateUnigramCandidate(*convreq_, segments, &results);
+  auto it = std::find_if(results.begin(), results.end(),
+                         [](const TestableDictionaryPredictor::Result &r) {
+                           return r.value == "アボカド";
+                         });
+  ASSERT_NE(results.end(), it);
+  const int exact_wcost = it->wcost;
+
+  // "あぼかと" is one substitution away from "あぼかど".
+  SetUpInputForSuggestion("あぼかと", composer_.get(), &segments);
+  results.clear();
+  mozc::SetFlag(&FLAGS_use_approximate_typing_correction_lookup, true);
+  predictor->AggregateTypeCorrectingPrediction(*convreq_, segments, &results);
+  mozc::SetFlag(&FLAGS_use_approximate_typing_correction_lookup, false);
+
+  it = std::find_if(results.begin(), results.end(),
+                    [](const TestableDictionaryPredictor::Result &r) {
+                      return r.value == "アボカド";
+                    });
+  ASSERT_NE(results.end(), it);
+  EXPECT_EQ("あぼかど", it->key);
+  EXPECT_EQ(TestableDictionaryPredictor::TYPING_CORRECTION, it->types);
+  // The penalty for one edit.
+  EXPECT_EQ(exact_wcost + 1151, it->wcost);
+  for (const auto &result : results) {
+    EXPECT_EQ(TestableDictionaryPredictor::TYPING_CORRECTION, result.types);
+    EXPECT_FALSE(Util::StartsWith(result.key, "あぼかと")) << result.key;
+  }
+}
+
+TEST_F(DictionaryPredictorTest, ParallelAggregationIsSameAsSequential) {
+  unique_ptr<MockDataAndPredictor> data_and_predictor(
+      CreateDictionaryPredictorWithMockData());
+  const DictionaryPredictor *predictor =
+      data_and_predictor->dictionary_predictor();
+
+  config_->set_use_dictionary_suggest(true);
+  config_->set_use_realtime_conversion(true);
+  data_and_predictor->mutable_dictionary()->AddLookupPredictive(
+      "あ", "あどせんす", "アドセンス", Token::NONE);
+
+  // Unigram, bigram and realtime conversion are triggered.
+  Segments segments;
+  SetUpInputForSuggestionWithHistory("あ", "ぐーぐる", "グーグル",
+                                     composer_.get(), &segments);
+  segments.set_request_type(Segments::PREDICTION);
+
+  DictionaryPredictor::PredictionTypes types[2];
+  std::vector<DictionaryPredictor::Result> results[2];
+  for (const bool parallel : {false, true}) {
+    mozc::SetFlag(&FLAGS_enable_parallel_prediction_aggregation, parallel);
+    types[parallel] = predictor->AggregatePredictionForRequest(
+        *convreq_, &segments, &results[parallel]);
+  }
+  mozc::SetFlag(&FLAGS_enable_parallel_prediction_aggregation, false);
+
+  EXPECT_EQ(types[0], types[1]);
+  EXPECT_TRUE(types[1] & DictionaryPredictor::UNIGRAM);
+  EXPECT_TRUE(types[1] & DictionaryPredictor::BIGRAM);
+  EXPECT_TRUE(types[1] & DictionaryPredictor::REALTIME);
+  ASSERT_EQ(results[0].size(), results[1].size());
+  EXPECT_FALSE(results[1].empty());
+  for (size_t i = 0; i < results[0].size(); ++i) {
+    EXPECT_EQ(results[0][i].key, results[1][i].key);
+    EXPECT_EQ(results[0][i].value, results[1][i].value);
+    EXPECT_EQ(results[0][i].types, results[1][i].types);
+    EXPECT_EQ(results[0][i].wcost, results[1][i].wcost);
+  }
+  EXPECT_EQ(0, segments.conversion_segment(0).candidates_size());
+
+  // Every subroutine produced results, and they are merged in the sequential
+  // order: realtime conversion, unigram and then bigram.
+  std::vector<int> order;
+  for (const auto &result : results[1]) {
+    if (result.types & DictionaryPredictor::REALTIME) {
+      order.push_back(0);
+    } else if (result.types & DictionaryPredictor::UNIGRAM) {
+      order.push_back(1);
+    } else if (result.types & DictionaryPredictor::BIGRAM) {
+      order.push_back(2);
+    } else {
+      order.push_back(3);
+    }
+  }
+  EXPECT_TRUE(std::is_sorted(order.begin(), order.end()));
+  for (int i = 0; i < 3; ++i) {
+    EXPECT_NE(order.end(), std::find(order.begin(), order.end(), i)) << i;
+  }
+}
+
+TEST_F(DictionaryPredictorTest, AggregationTimings) {
+  unique_ptr<MockDataAndPredictor> data_and_predictor(
+      CreateDictionaryPredictorWithMockData());
+  TestableDictionaryPredictor *predictor =
+      data_and_predictor->mutable_dictionary_predictor();
+
+  config_->set_use_dictionary_suggest(true);
+  config_->set_use_realtime_conversion(true);
+
+  Segments segments;
+  SetUpInputForSuggestionWithHistory("ぐーぐるあ", "てすとだよ", "テストだよ",
+                                     composer_.get(), &segments);
+  segments.set_request_type(Segments::PREDICTION);
+
+  // Nothing is measured by default.
+  std::vector<DictionaryPredictor::Result> results;
+  predictor->AggregatePredictionForRequest(*convreq_, &segments, &results);
+  EXPECT_TRUE(predictor->GetAggregationTimings().empty());
+
+  mozc::SetFlag(&FLAGS_record_prediction_aggregation_timing, true);
+  for (const bool parallel : {false, true}) {
+    mozc::SetFlag(&FLAGS_enable_parallel_prediction_aggregation, parallel);
+    results.clear();
+    predictor->AggregatePredictionForRequest(*convreq_, &segments, &results);
+  }
+  mozc::SetFlag(&FLAGS_enable_parallel_prediction_aggregation, false);
+  mozc::SetFlag(&FLAGS_record_prediction_aggregation_timing, false);
+
+  const auto timings = predictor->GetAggregationTimings();
+  for (const char *name : {"Realtime", "Unigram", "Bigram"}) {
+    const auto it = timings.find(name);
+    ASSERT_NE(timings.end(), it) << name;
+    EXPECT_EQ(2, it->second.num_calls) << name;
+  }
+  EXPECT_EQ(timings.end(), timings.find("English"));
+
+  predictor->ClearAggregationTimings();
+  EXPECT_TRUE(predictor->GetAggregationTimings().empty());
+}
+
 TEST_F(DictionaryPredictorTest, ZeroQuerySuggestionAfterNumbers) {
   unique_ptr<MockDataAndPredictor> data_and_predictor(
       CreateDictionaryPredictorWithMockData());
@@ -30,17 +30,24 @@
 #include "prediction/predictor.h"
 
 #include <algorithm>
+#include <functional>
 #include <string>
 #include <utility>
 #include <vector>
 
 #include "base/flags.h"
 #include "base/logging.h"
+#include "base/port.h"
+#include "base/thread_pool.h"
 #include "converter/segments.h"
 #include "protocol/commands.pb.h"
 #include "protocol/config.pb.h"
 #include "absl/memory/memory.h"
 
+DEFINE_bool(enable_concurrent_prediction, false,
+            "Run the dictionary predictor concurrently with the user history "
+            "predictor in DefaultPredictor.");
+
 namespace mozc {
 namespace {
 
@@ -156,6 +163,10 @@ bool DefaultPredictor::PredictForRequest(const ConversionRequest &request,
         9, std::max(1, static_cast<int>(request.config().suggestions_size())));
   }
 
+  if (mozc::GetFlag(FLAGS_enable_concurrent_prediction)) {
+    return PredictConcurrently(request, size, segments);
+  }
+
   bool result = false;
   int remained_size = size;
   segments->set_max_prediction_candidates_size(static_cast<size_t>(size));
@@ -173,6 +184,64 @@ bool DefaultPredictor::PredictForRequest(const ConversionRequest &request,
   return result;
 }
 
+bool DefaultPredictor::PredictConcurrently(const ConversionRequest &request,
+                                           int size,
+                                           Segments *segments) const {
+  // Speculates that the user history predictor adds no candidate, and runs
+  // the dictionary predictor on a copy of |segments| with the size it would
+  // get in that case.  The copy borrows the cached lattice of |segments|,
+  // which the user history predictor doesn't use.
+  const size_t prev_candidates_size = GetCandidatesSize(*segments);
+  const int speculative_size = size - static_cast<int>(prev_candidates_size);
+  Segments dictionary_segments;
+  dictionary_segments.CopyFrom(*segments);
+  dictionary_segments.set_max_prediction_candidates_size(
+      std::max(speculative_size, 0));
+  dictionary_segments.SwapCachedLattice(segments);
+  bool dictionary_result = false;
+  ThreadPool::TaskGroup group(ThreadPool::GetSharedPool());
+  if (speculative_size > 0) {
+    group.Schedule([&]() {
+      dictionary_result = dictionary_predictor_->PredictForRequest(
+          request, &dictionary_segments);
+    });
+  }
+
+  bool result = false;
+  segments->set_max_prediction_candidates_size(static_cast<size_t>(size));
+  result |= user_history_predictor_->PredictForRequest(request, segments);
+  group.Wait();
+  segments->SwapCachedLattice(&dictionary_segments);
+
+  const size_t candidates_size = GetCandidatesSize(*segments);
+  const int remained_size = size - static_cast<int>(candidates_size);
+  if (remained_size <= 0) {
+    return result;
+  }
+  segments->set_max_prediction_candidates_size(remained_size);
+  if (candidates_size != prev_candidates_size) {
+    // The speculation failed.  Predicts again as in the sequential mode, as the
+    // dictionary predictor depends on the candidates in |segments|, e.g., the
+    // number of realtime conversion candidates.
+    result |= dictionary_predictor_->PredictForRequest(request, segments);
+    return result;
+  }
+
+  // The dictionary predictor saw the same |segments| as in the sequential
+  // mode, so its candidates are merged after the user history ones.
+  if (segments->conversion_segments_size() == 0) {
+    return result | dictionary_result;
+  }
+  const Segment &dictionary_segment = dictionary_segments.conversion_segment(0);
+  Segment *segment = segments->mutable_conversion_segment(0);
+  for (size_t i = prev_candidates_size;
+       i < dictionary_segment.candidates_size(); ++i) {
+    segment->push_back_candidate()->CopyFrom(dictionary_segment.candidate(i));
+  }
+  result |= dictionary_result;
+  return result;
+}
+
 // static
 std::unique_ptr<PredictorInterface> MobilePredictor::CreateMobilePredictor(
     std::unique_ptr<PredictorInterface> dictionary_predictor,
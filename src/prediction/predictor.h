@@ -99,6 +99,11 @@ class DefaultPredictor : public BasePredictor {
   }
 
  private:
+  // Runs the user history predictor and the dictionary predictor concurrently
+  // with the same results as PredictForRequest() in the sequential mode.
+  bool PredictConcurrently(const ConversionRequest &request, int size,
+                           Segments *segments) const;
+
   const ConversionRequest empty_request_;
   const std::string predictor_name_;
 };
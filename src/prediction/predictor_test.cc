@@ -32,7 +32,9 @@
 #include <cstddef>
 #include <memory>
 #include <string>
+#include <vector>
 
+#include "base/flags.h"
 #include "base/logging.h"
 #include "base/singleton.h"
 #include "base/system_util.h"
@@ -54,6 +56,8 @@
 #include "testing/base/public/gunit.h"
 #include "absl/memory/memory.h"
 
+DECLARE_bool(enable_concurrent_prediction);
+
 namespace mozc {
 namespace {
 
@@ -111,6 +115,69 @@ class NullPredictor : public PredictorInterface {
   const std::string predictor_name_;
 };
 
+// Adds up to |num_candidates| candidates.  Their values depend on the number
+// of candidates already in the segment and the max prediction candidates size
+// so that the tests can check what the predictor saw.
+class AddCandidatesPredictor : public PredictorInterface {
+ public:
+  AddCandidatesPredictor(const std::string &name, size_t num_candidates)
+      : num_candidates_(num_candidates), predictor_name_(name) {}
+
+  bool PredictForRequest(const ConversionRequest &request,
+                         Segments *segments) const override {
+    if (segments->conversion_segments_size() == 0) {
+      return false;
+    }
+    Segment *segment = segments->mutable_conversion_segment(0);
+    const size_t prev_size = segment->candidates_size();
+    const size_t max_size = segments->max_prediction_candidates_size();
+    for (size_t i = 0; i < num_candidates_ && i < max_size; ++i) {
+      Segment::Candidate *candidate = segment->push_back_candidate();
+      candidate->Init();
+      candidate->value = predictor_name_ + std::to_string(i) + "/" +
+                         std::to_string(prev_size) + "/" +
+                         std::to_string(max_size);
+    }
+    return num_candidates_ > 0;
+  }
+
+  const std::string &GetPredictorName() const override {
+    return predictor_name_;
+  }
+
+ private:
+  const size_t num_candidates_;
+  const std::string predictor_name_;
+};
+
+// Checks the key of the cached lattice and updates it, as the immutable
+// converter does in the realtime conversion.
+class UpdateLatticePredictor : public PredictorInterface {
+ public:
+  UpdateLatticePredictor(const std::string &expected_key,
+                         const std::string &new_key)
+      : expected_key_(expected_key),
+        new_key_(new_key),
+        predictor_name_("UpdateLatticePredictor") {}
+
+  bool PredictForRequest(const ConversionRequest &request,
+                         Segments *segments) const override {
+    Lattice *lattice = segments->mutable_cached_lattice();
+    EXPECT_EQ(expected_key_, lattice->key());
+    lattice->SetKey(new_key_);
+    return true;
+  }
+
+  const std::string &GetPredictorName() const override {
+    return predictor_name_;
+  }
+
+ private:
+  const std::string expected_key_;
+  const std::string new_key_;
+  const std::string predictor_name_;
+};
+
 class MockPredictor : public PredictorInterface {
  public:
   MockPredictor() = default;
@@ -356,4 +423,52 @@ TEST_F(PredictorTest, DisableAllSuggestion) {
   EXPECT_TRUE(pred2->predict_called());
 }
 
+TEST_F(PredictorTest, ConcurrentPredictionIsSameAsSequential) {
+  const Segments::RequestType kRequestTypes[] = {
+      Segments::SUGGESTION, Segments::PREDICTION,
+      Segments::PARTIAL_SUGGESTION, Segments::PARTIAL_PREDICTION};
+  // The user history predictor adds no candidate, some candidates, or fills
+  // up the candidates.
+  const int kHistorySizes[] = {0, 2, 200};
+  for (const Segments::RequestType request_type : kRequestTypes) {
+    for (const int history_size : kHistorySizes) {
+      auto predictor = absl::make_unique<DefaultPredictor>(
+          absl::make_unique<AddCandidatesPredictor>("dictionary", 150),
+          absl::make_unique<AddCandidatesPredictor>("history", history_size));
+      bool results[2];
+      std::vector<std::string> values[2];
+      for (const bool concurrent : {false, true}) {
+        mozc::SetFlag(&FLAGS_enable_concurrent_prediction, concurrent);
+        Segments segments;
+        segments.set_request_type(request_type);
+        segments.add_segment();
+        results[concurrent] = predictor->PredictForRequest(*convreq_, &segments);
+        const Segment &segment = segments.conversion_segment(0);
+        for (size_t i = 0; i < segment.candidates_size(); ++i) {
+          values[concurrent].push_back(segment.candidate(i).value);
+        }
+      }
+      EXPECT_EQ(results[0], results[1]);
+      EXPECT_EQ(values[0], values[1]);
+      EXPECT_FALSE(values[1].empty());
+    }
+  }
+  mozc::SetFlag(&FLAGS_enable_concurrent_prediction, false);
+}
+
+TEST_F(PredictorTest, ConcurrentPredictionUsesCachedLattice) {
+  mozc::SetFlag(&FLAGS_enable_concurrent_prediction, true);
+  auto predictor = absl::make_unique<DefaultPredictor>(
+      absl::make_unique<UpdateLatticePredictor>("あい", "あいう"),
+      absl::make_unique<AddCandidatesPredictor>("history", 0));
+  Segments segments;
+  segments.set_request_type(Segments::PREDICTION);
+  segments.add_segment();
+  // The speculative prediction runs on a copy of |segments|.
+  segments.mutable_cached_lattice()->SetKey("あい");
+  EXPECT_TRUE(predictor->PredictForRequest(*convreq_, &segments));
+  EXPECT_EQ("あいう", segments.mutable_cached_lattice()->key());
+  mozc::SetFlag(&FLAGS_enable_concurrent_prediction, false);
+}
+
 }  // namespace mozc
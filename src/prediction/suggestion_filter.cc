@@ -43,11 +43,11 @@ SuggestionFilter::SuggestionFilter(const char *data, size_t size) {
 
 SuggestionFilter::~SuggestionFilter() {}
 
-bool SuggestionFilter::IsBadSuggestion(const std::string &text) const {
+bool SuggestionFilter::IsBadSuggestion(absl::string_view text) const {
   if (filter_.get() == nullptr) {
     return false;
   }
-  std::string lower_text = text;
+  std::string lower_text(text);
   Util::LowerString(&lower_text);
   return filter_->Exists(Hash::Fingerprint(lower_text));
 }
@@ -34,6 +34,7 @@
 #include <string>
 
 #include "base/port.h"
+#include "absl/strings/string_view.h"
 
 namespace mozc {
 namespace storage {
@@ -46,7 +47,7 @@ class SuggestionFilter {
   SuggestionFilter(const char *data, size_t size);
   ~SuggestionFilter();
 
-  bool IsBadSuggestion(const std::string &text) const;
+  bool IsBadSuggestion(absl::string_view text) const;
 
  private:
   std::unique_ptr<mozc::storage::ExistenceFilter> filter_;
@@ -34,7 +34,10 @@
 #include <climits>
 #include <limits>
 #include <memory>
+#include <set>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include "base/clock.h"
 #include "base/config_file_stream.h"
@@ -71,8 +74,9 @@ using dictionary::POSMatcher;
 using dictionary::SuppressionDictionary;
 using usage_stats::UsageStats;
 
-// Finds suggestion candidates from the most recent 3000 history in LRU.
-// We don't check all history, since suggestion is called every key event
+// Finds fuzzy suggestion candidates from the most recent 3000 history in LRU.
+// We don't check all history, since suggestion is called every key event.
+// Other candidates are looked up by the key index.
 const size_t kMaxSuggestionTrial = 3000;
 
 // Finds suffix matches of history_segments from the most recent 500 histories
@@ -471,6 +475,7 @@ bool UserHistoryPredictor::Load(const UserHistoryStorage &history) {
     dic_->Insert(EntryFingerprint(history.GetProto().entries(i)),
                  history.GetProto().entries(i));
   }
+  RebuildKeyIndex();
 
   VLOG(1) << "Loaded user histroy, size=" << history.GetProto().entries_size();
 
@@ -520,6 +525,7 @@ bool UserHistoryPredictor::ClearAllHistory() {
   // Renews DicCache as LRUCache tries to reuse the internal value by
   // using FreeList
   dic_.reset(new DicCache(UserHistoryPredictor::cache_size()));
+  key_index_.clear();
 
   // insert a dummy event entry.
   InsertEvent(Entry::CLEAN_ALL_EVENT);
@@ -1294,29 +1300,42 @@ void UserHistoryPredictor::GetResultsFromHistoryDictionary(
   unique_ptr<Trie<std::string>> expanded;
   GetInputKeyFromSegments(request, segments, &input_key, &base_key, &expanded);
 
+  // Fuzzy matching of the romanized key needs to check every entry.
+  // Otherwise, only the entries found by the key index can match.
+  const bool use_key_index = roman_input_key.empty();
+  std::vector<const Entry *> entries;
+  if (use_key_index) {
+    LookupKeyIndex(base_key, expanded.get(), prev_entry, &entries);
+  } else {
+    for (const DicElement *elm = dic_->Head(); elm != nullptr;
+         elm = elm->next) {
+      entries.push_back(&elm->value);
+    }
+  }
+
   const uint64 now = Clock::GetTime();
   int trial = 0;
-  for (const DicElement *elm = dic_->Head(); elm != nullptr; elm = elm->next) {
+  for (const Entry *entry : entries) {
     if (!IsValidEntryIgnoringRemovedField(
-            elm->value, request.request().available_emoji_carrier())) {
+            *entry, request.request().available_emoji_carrier())) {
       continue;
     }
-    if (elm->value.last_access_time() + k62DaysInSec < now) {
+    if (entry->last_access_time() + k62DaysInSec < now) {
       updated_ = true;  // We found an entry to be deleted at next save.
       continue;
     }
-    if (segments.request_type() == Segments::SUGGESTION &&
+    if (!use_key_index && segments.request_type() == Segments::SUGGESTION &&
         trial++ >= kMaxSuggestionTrial) {
       VLOG(2) << "too many trials";
       break;
     }
 
-    // Lookup key from elm_value and prev_entry.
+    // Lookup key from entry and prev_entry.
     // If a new entry is found, the entry is pushed to the results.
     // TODO(team): make KanaFuzzyLookupEntry().
-    if (!LookupEntry(request_type, input_key, base_key, expanded.get(),
-                     &(elm->value), prev_entry, results) &&
-        !RomanFuzzyLookupEntry(roman_input_key, &(elm->value), results)) {
+    if (!LookupEntry(request_type, input_key, base_key, expanded.get(), entry,
+                     prev_entry, results) &&
+        !RomanFuzzyLookupEntry(roman_input_key, entry, results)) {
       continue;
     }
 
@@ -1327,6 +1346,81 @@ void UserHistoryPredictor::GetResultsFromHistoryDictionary(
   }
 }
 
+void UserHistoryPredictor::InsertToKeyIndex(const std::string &key,
+                                            uint32 dic_key) {
+  key_index_.emplace(key, dic_key);
+  // Drops the pairs of evicted and erased entries when they dominate.
+  if (key_index_.size() > 2 * UserHistoryPredictor::cache_size()) {
+    RebuildKeyIndex();
+  }
+}
+
+void UserHistoryPredictor::RebuildKeyIndex() {
+  key_index_.clear();
+  for (const DicElement *elm = dic_->Head(); elm != nullptr; elm = elm->next) {
+    if (!elm->value.key().empty()) {
+      key_index_.emplace(elm->value.key(), elm->key);
+    }
+  }
+}
+
+void UserHistoryPredictor::LookupKeyIndex(
+    const std::string &key_base, const Trie<std::string> *key_expanded,
+    const Entry *prev_entry, std::vector<const Entry *> *entries) const {
+  DCHECK(entries);
+  std::vector<uint32> dic_keys;
+
+  // Adds the entries whose key equals to |key|, or starts with |key| when
+  // |is_prefix| is true.
+  auto add_entries = [this, &dic_keys](const std::string &key,
+                                       bool is_prefix) {
+    for (auto it = key_index_.lower_bound(std::make_pair(key, 0u));
+         it != key_index_.end(); ++it) {
+      if (is_prefix ? !Util::StartsWith(it->first, key) : it->first != key) {
+        break;
+      }
+      dic_keys.push_back(it->second);
+    }
+  };
+
+  if (key_base.empty() && key_expanded == nullptr) {
+    if (prev_entry != nullptr) {
+      for (const auto &next_entry : prev_entry->next_entries()) {
+        dic_keys.push_back(next_entry.entry_fp());
+      }
+    }
+  } else {
+    // RIGHT_PREFIX_MATCH and EXACT_MATCH.
+    for (size_t len = 1; len <= key_base.size(); ++len) {
+      add_entries(key_base.substr(0, len), false);
+    }
+    // LEFT_PREFIX_MATCH.
+    if (key_expanded == nullptr) {
+      add_entries(key_base, true);
+    } else {
+      std::vector<std::string> expanded;
+      key_expanded->LookUpPredictiveAll("", &expanded);
+      for (const std::string &suffix : expanded) {
+        add_entries(key_base + suffix, true);
+      }
+    }
+  }
+
+  std::sort(dic_keys.begin(), dic_keys.end());
+  dic_keys.erase(std::unique(dic_keys.begin(), dic_keys.end()),
+                 dic_keys.end());
+  for (const uint32 dic_key : dic_keys) {
+    const Entry *entry = dic_->LookupWithoutInsert(dic_key);
+    if (entry != nullptr) {
+      entries->push_back(entry);
+    }
+  }
+  std::stable_sort(entries->begin(), entries->end(),
+                   [](const Entry *lhs, const Entry *rhs) {
+                     return lhs->last_access_time() > rhs->last_access_time();
+                   });
+}
+
 // static
 void UserHistoryPredictor::GetInputKeyFromSegments(
     const ConversionRequest &request, const Segments &segments,
@@ -1606,6 +1700,7 @@ void UserHistoryPredictor::Insert(const std::string &key,
   entry->set_key(key);
   entry->set_value(value);
   entry->set_removed(false);
+  InsertToKeyIndex(key, dic_key);
 
   if (description.empty()) {
     entry->clear_description();
@@ -408,6 +408,20 @@ class UserHistoryPredictor : public PredictorInterface {
                                        const Entry *prev_entry,
                                        EntryPriorityQueue *results) const;
 
+  // Adds the entry |dic_key| in |dic_| whose key is |key| to |key_index_|.
+  void InsertToKeyIndex(const std::string &key, uint32 dic_key);
+
+  // Rebuilds |key_index_| from the entries in |dic_|.
+  void RebuildKeyIndex();
+
+  // Collects the entries that may match |key_base| and |key_expanded| in
+  // LookupEntry(), most recently accessed first.  When both are empty, i.e.,
+  // for zero query suggestion, collects the entries following |prev_entry|.
+  void LookupKeyIndex(const std::string &key_base,
+                      const Trie<std::string> *key_expanded,
+                      const Entry *prev_entry,
+                      std::vector<const Entry *> *entries) const;
+
   // Gets input data from segments.
   // These input data include ambiguities.
   static void GetInputKeyFromSegments(
@@ -500,6 +514,10 @@ class UserHistoryPredictor : public PredictorInterface {
   bool content_word_learning_enabled_;
   mutable std::atomic<bool> updated_;
   std::unique_ptr<DicCache> dic_;
+  // Pairs of the key and the fingerprint of the entries in |dic_|, sorted by
+  // key.  The pairs of evicted or erased entries are skipped on lookup and
+  // dropped on the next rebuild.
+  std::set<std::pair<std::string, uint32>> key_index_;
   mutable std::unique_ptr<UserHistoryPredictorSyncer> syncer_;
 };
 
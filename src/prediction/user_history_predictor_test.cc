@@ -280,6 +280,7 @@ class UserHistoryPredictorTest : public ::testing::Test {
     e->set_key(key);
     e->set_value(value);
     e->set_removed(false);
+    predictor->InsertToKeyIndex(key, predictor->Fingerprint(key, value));
     return e;
   }
 
@@ -3103,6 +3104,25 @@ TEST_F(UserHistoryPredictorTest, ClearHistoryEntry_Unigram) {
   }
 }
 
+TEST_F(UserHistoryPredictorTest, SuggestOldEntryBehindManyRecentEntries) {
+  ScopedClockMock clock(1, 0);
+
+  UserHistoryPredictor *predictor = GetUserHistoryPredictorWithClearedHistory();
+
+  // Add a unigram history ("japanese", "Japanese") followed by more recent
+  // entries than the suggestion used to scan in LRU.
+  InsertEntry(predictor, "japanese", "Japanese")->set_last_access_time(1);
+  for (int i = 0; i < 3500; ++i) {
+    InsertEntry(predictor, Util::StringPrintf("input%d", i),
+                Util::StringPrintf("Input%d", i))
+        ->set_last_access_time(2);
+  }
+
+  // "Japanese" is found through the key index.
+  EXPECT_TRUE(IsSuggestedAndPredicted(predictor, "japan", "Japanese"));
+  EXPECT_TRUE(IsSuggestedAndPredicted(predictor, "input3499", "Input3499"));
+}
+
 TEST_F(UserHistoryPredictorTest, ClearHistoryEntry_Bigram_DeleteWhole) {
   ScopedClockMock clock(1, 0);
 
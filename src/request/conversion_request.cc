@@ -42,7 +42,8 @@ ConversionRequest::ConversionRequest()
       use_actual_converter_for_realtime_conversion_(false),
       composer_key_selection_(CONVERSION_KEY),
       skip_slow_rewriters_(false),
-      create_partial_candidates_(false) {}
+      create_partial_candidates_(false),
+      viterbi_beam_width_(0) {}
 
 ConversionRequest::ConversionRequest(const composer::Composer *c,
                                      const commands::Request *request,
@@ -53,7 +54,8 @@ ConversionRequest::ConversionRequest(const composer::Composer *c,
       use_actual_converter_for_realtime_conversion_(false),
       composer_key_selection_(CONVERSION_KEY),
       skip_slow_rewriters_(false),
-      create_partial_candidates_(false) {}
+      create_partial_candidates_(false),
+      viterbi_beam_width_(0) {}
 
 ConversionRequest::~ConversionRequest() {}
 
@@ -121,6 +123,14 @@ void ConversionRequest::set_create_partial_candidates(bool value) {
   create_partial_candidates_ = value;
 }
 
+size_t ConversionRequest::viterbi_beam_width() const {
+  return viterbi_beam_width_;
+}
+
+void ConversionRequest::set_viterbi_beam_width(size_t width) {
+  viterbi_beam_width_ = width;
+}
+
 bool ConversionRequest::IsKanaModifierInsensitiveConversion() const {
   return request_->kana_modifier_insensitive_conversion() &&
          config_->use_kana_modifier_insensitive_conversion();
@@ -135,6 +145,7 @@ void ConversionRequest::CopyFrom(const ConversionRequest &request) {
   composer_key_selection_ = request.composer_key_selection_;
   skip_slow_rewriters_ = request.skip_slow_rewriters_;
   create_partial_candidates_ = request.create_partial_candidates_;
+  viterbi_beam_width_ = request.viterbi_beam_width_;
 }
 
 }  // namespace mozc
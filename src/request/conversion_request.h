@@ -89,6 +89,11 @@ class ConversionRequest {
   bool create_partial_candidates() const;
   void set_create_partial_candidates(bool value);
 
+  // The number of the nodes kept at each end position by Viterbi search for
+  // conversion.  0 means no limit, i.e., exhaustive search.
+  size_t viterbi_beam_width() const;
+  void set_viterbi_beam_width(size_t width);
+
   ComposerKeySelection composer_key_selection() const;
   void set_composer_key_selection(ComposerKeySelection selection);
 
@@ -137,6 +142,11 @@ class ConversionRequest {
   // For example, "私の" is created from composition "わたしのなまえ".
   bool create_partial_candidates_;
 
+  // If positive, Viterbi search for conversion considers only this number of
+  // the best nodes ending at each position.  It trades the accuracy for the
+  // latency on long inputs.
+  size_t viterbi_beam_width_;
+
   // TODO(noriyukit): Moves all the members of Segments that are irrelevant to
   // this structure, e.g., Segments::user_history_enabled_ and
   // Segments::request_type_. Also, a key for conversion is eligible to live in
@@ -66,6 +66,7 @@
       'dependencies': [
         '../../base/base.gyp:base',
         'bit_stream',
+        'louds_trie',
       ],
     },
     # Implementation of an array of string based on bit vector.
@@ -165,6 +165,12 @@ class Louds {
     return index_.Get(node.edge_index_) != 0;
   }
 
+  // Hints the processor to fetch the bits read by IsValidNode() for |node| and
+  // its next siblings.
+  void PrefetchNode(const Node &node) const {
+    index_.Prefetch(node.edge_index_);
+  }
+
  private:
   SimpleSuccinctBitVectorIndex index_;
   size_t select0_cache_size_;
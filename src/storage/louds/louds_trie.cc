@@ -29,6 +29,8 @@
 
 #include "storage/louds/louds_trie.h"
 
+#include <algorithm>
+
 #include "base/logging.h"
 #include "base/port.h"
 #include "storage/louds/louds.h"
@@ -40,10 +42,25 @@ namespace storage {
 namespace louds {
 
 namespace {
+
 inline int32 ReadInt32(const uint8 *data) {
   // TODO(noriyukit): static assertion for the endian.
   return *reinterpret_cast<const int32 *>(data);
 }
+
+#ifdef __GNUC__
+inline int BitCount1(uint32 x) { return __builtin_popcount(x); }
+#else
+int BitCount1(uint32 x) {
+  x = ((x & 0xaaaaaaaa) >> 1) + (x & 0x55555555);
+  x = ((x & 0xcccccccc) >> 2) + (x & 0x33333333);
+  x = ((x >> 4) + x) & 0x0f0f0f0f;
+  x = (x >> 8) + x;
+  x = ((x >> 16) + x) & 0x3f;
+  return x;
+}
+#endif
+
 }  // namespace
 
 bool LoudsTrie::Open(const uint8 *image, size_t louds_lb0_cache_size,
@@ -73,11 +90,27 @@ bool LoudsTrie::Open(const uint8 *image, size_t louds_lb0_cache_size,
   //   [3]
   // In this case, [0] and [1] are not terminal (as the original words contains
   // neither "" nor "a"), and [2] and [3] are terminal.
+  //
+  // The image may instead have the interleaved layout, which is indicated by
+  // kInterleavedLayoutFlag in the "num bits" field.  In this layout, the edge
+  // character image is replaced by an array of NodeBlock (see louds_trie.h),
+  // which holds the edge characters, terminal bits and terminal rank samples
+  // of every kNodesPerBlock nodes.  The terminal image is replaced by padding
+  // bytes which align the node block image at a multiple of sizeof(NodeBlock)
+  // from the beginning of the image, so that each block occupies one cache
+  // line if the image is aligned at the cache line boundary:
+  // [trie size: little endian 4byte int]
+  // [padding size: little endian 4byte int less than sizeof(NodeBlock)]
+  // [kInterleavedLayoutFlag | num bits for each character]
+  // [node block image size: little endian 4 byte int]
+  // [trie image: "trie size" bytes]
+  // [padding: "padding size" bytes]
+  // [node block image: "node block image size" bytes]
   const int louds_size = ReadInt32(image);
   const int terminal_size = ReadInt32(image + 4);
-  const int num_character_bits = ReadInt32(image + 8);
+  const int layout_and_num_character_bits = ReadInt32(image + 8);
   const int edge_character_size = ReadInt32(image + 12);
-  CHECK_EQ(num_character_bits, 8);
+  CHECK_EQ(layout_and_num_character_bits & ~kInterleavedLayoutFlag, 8);
   CHECK_GT(edge_character_size, 0);
 
   const uint8 *louds_image = image + 16;
@@ -87,6 +120,13 @@ bool LoudsTrie::Open(const uint8 *image, size_t louds_lb0_cache_size,
   louds_.Init(louds_image, louds_size, louds_lb0_cache_size,
               louds_lb1_cache_size, louds_select0_cache_size,
               louds_select1_cache_size);
+  if (layout_and_num_character_bits & kInterleavedLayoutFlag) {
+    CHECK_LT(terminal_size, sizeof(NodeBlock));
+    CHECK_EQ(edge_character_size % sizeof(NodeBlock), 0);
+    node_blocks_ = reinterpret_cast<const NodeBlock *>(edge_character);
+    num_node_blocks_ = edge_character_size / sizeof(NodeBlock);
+    return true;
+  }
   terminal_bit_vector_.Init(terminal_image, terminal_size,
                             0,  // Select0 is not carried out.
                             termvec_lb1_cache_size);
@@ -99,10 +139,80 @@ void LoudsTrie::Close() {
   louds_.Reset();
   terminal_bit_vector_.Reset();
   edge_character_ = nullptr;
+  node_blocks_ = nullptr;
+  num_node_blocks_ = 0;
 }
 
-bool LoudsTrie::MoveToChildByLabel(char label, Node *node) const {
-  MoveToFirstChild(node);
+int LoudsTrie::GetNumKeys() const {
+  if (node_blocks_ == nullptr) {
+    return terminal_bit_vector_.GetNum1Bits();
+  }
+  if (num_node_blocks_ == 0) {
+    return 0;
+  }
+  const NodeBlock &last_block = node_blocks_[num_node_blocks_ - 1];
+  return last_block.terminal_rank + BitCount1(last_block.terminal_bits[0]) +
+         BitCount1(last_block.terminal_bits[1]);
+}
+
+int LoudsTrie::GetKeyIdOfTerminalNodeInBlocks(int index) const {
+  const NodeBlock &block = node_blocks_[index / kNodesPerBlock];
+  const int offset = index % kNodesPerBlock;
+  int result = block.terminal_rank;
+  if (offset >= 32) {
+    result += BitCount1(block.terminal_bits[0]);
+  }
+  if (offset % 32 > 0) {
+    result += BitCount1(block.terminal_bits[offset / 32] << (32 - offset % 32));
+  }
+  return result;
+}
+
+int LoudsTrie::SelectTerminalNodeInBlocks(int key_id) const {
+  // Find the last block having at most |key_id| terminal nodes before it.
+  const NodeBlock *block =
+      std::upper_bound(node_blocks_, node_blocks_ + num_node_blocks_, key_id,
+                       [](int key_id, const NodeBlock &block) {
+                         return key_id < static_cast<int>(block.terminal_rank);
+                       }) -
+      1;
+  DCHECK_GE(block, node_blocks_);
+  int rank = key_id - block->terminal_rank;
+  int offset = 0;
+  uint32 bits = block->terminal_bits[0];
+  if (rank >= BitCount1(bits)) {
+    rank -= BitCount1(bits);
+    offset = 32;
+    bits = block->terminal_bits[1];
+  }
+  for (; rank > 0; --rank) {
+    bits &= bits - 1;  // Clear the lowest 1-bit.
+  }
+  for (; (bits & 1) == 0; bits >>= 1) {
+    ++offset;
+  }
+  return (block - node_blocks_) * kNodesPerBlock + offset;
+}
+
+bool LoudsTrie::MoveToSiblingByLabel(char label, Node *node) const {
+  if (node_blocks_ != nullptr) {
+    // Siblings are consecutive in the blocks, so walk them without computing
+    // the block for each node.
+    const int index = node->node_id() - 1;
+    const NodeBlock *block = node_blocks_ + index / kNodesPerBlock;
+    int offset = index % kNodesPerBlock;
+    while (IsValidNode(*node)) {
+      if (block->labels[offset] == label) {
+        return true;
+      }
+      MoveToNextSibling(node);
+      if (++offset == kNodesPerBlock) {
+        offset = 0;
+        ++block;
+      }
+    }
+    return false;
+  }
   while (IsValidNode(*node)) {
     if (GetEdgeLabelToParentNode(*node) == label) {
       return true;
@@ -112,6 +222,21 @@ bool LoudsTrie::MoveToChildByLabel(char label, Node *node) const {
   return false;
 }
 
+void LoudsTrie::PrefetchSiblings(const Node &node) const {
+  louds_.PrefetchNode(node);
+  const int index = node.node_id() - 1;
+  if (node_blocks_ != nullptr) {
+#ifdef __GNUC__
+    __builtin_prefetch(node_blocks_ + index / kNodesPerBlock);
+#endif  // __GNUC__
+    return;
+  }
+#ifdef __GNUC__
+  __builtin_prefetch(edge_character_ + index);
+#endif  // __GNUC__
+  terminal_bit_vector_.Prefetch(index);
+}
+
 bool LoudsTrie::Traverse(absl::string_view key, Node *node) const {
   for (auto iter = key.begin(); iter != key.end(); ++iter) {
     if (!MoveToChildByLabel(*iter, node)) {
@@ -31,6 +31,7 @@
 #define MOZC_STORAGE_LOUDS_LOUDS_TRIE_H_
 
 #include <memory>
+#include <vector>
 
 #include "base/port.h"
 #include "storage/louds/louds.h"
@@ -49,7 +50,34 @@ class LoudsTrie {
   // This class stores a traversal state.
   typedef Louds::Node Node;
 
-  LoudsTrie() : edge_character_(nullptr) {}
+  // Set in the "num bits for each character" field of the image header if the
+  // image has the interleaved layout; see .cc file.
+  static constexpr int32 kInterleavedLayoutFlag = 1 << 16;
+
+  // The number of nodes whose data are stored in a NodeBlock.
+  static constexpr int kNodesPerBlock = 48;
+
+  // Per-node data of the interleaved layout (see .cc file).  A block holds the
+  // edge labels and terminal bits of kNodesPerBlock consecutive nodes together
+  // with the rank sample of the terminal bits, so that scanning siblings and
+  // computing key IDs touch only one block of 64 bytes.  The blocks are
+  // aligned at 64 bytes relative to the beginning of the image; an image in
+  // the system dictionary is aligned at cache lines through the dictionary
+  // file sections and the data set.
+  struct NodeBlock {
+    // The number of terminal nodes before this block.
+    uint32 terminal_rank;
+    // The terminal bits of the nodes; the i-th node's bit is the (i % 32)-th
+    // bit of terminal_bits[i / 32].
+    uint32 terminal_bits[2];
+    uint32 reserved;
+    // The labels of the edges from the parents to the nodes.
+    char labels[kNodesPerBlock];
+  };
+  static_assert(sizeof(NodeBlock) == 64, "NodeBlock must fit in a cache line");
+
+  LoudsTrie()
+      : edge_character_(nullptr), node_blocks_(nullptr), num_node_blocks_(0) {}
   ~LoudsTrie() {}
 
   // Opens the binary image and constructs the data structure.  The first four
@@ -77,24 +105,38 @@ class LoudsTrie {
 
   // Returns true if |node| is a terminal node.
   bool IsTerminalNode(const Node &node) const {
-    return terminal_bit_vector_.Get(node.node_id() - 1) != 0;
+    const int index = node.node_id() - 1;
+    if (node_blocks_ != nullptr) {
+      const NodeBlock &block = node_blocks_[index / kNodesPerBlock];
+      const int offset = index % kNodesPerBlock;
+      return (block.terminal_bits[offset / 32] >> (offset % 32)) & 1;
+    }
+    return terminal_bit_vector_.Get(index) != 0;
   }
 
   // Returns the label of the edge from |node|'s parent (predecessor) to |node|.
   char GetEdgeLabelToParentNode(const Node &node) const {
-    return edge_character_[node.node_id() - 1];
+    const int index = node.node_id() - 1;
+    if (node_blocks_ != nullptr) {
+      return node_blocks_[index / kNodesPerBlock].labels[index % kNodesPerBlock];
+    }
+    return edge_character_[index];
   }
 
   // Computes the ID of key that reaches to |node|.
   // REQUIRES: |node| is a terminal node.
   int GetKeyIdOfTerminalNode(const Node &node) const {
-    return terminal_bit_vector_.Rank1(node.node_id() - 1);
+    return node_blocks_ != nullptr
+               ? GetKeyIdOfTerminalNodeInBlocks(node.node_id() - 1)
+               : terminal_bit_vector_.Rank1(node.node_id() - 1);
   }
 
   // Initializes a node corresponding to |key_id|.
   // REQUIRES: |key_id| is a valid ID.
   void GetTerminalNodeFromKeyId(int key_id, Node *node) const {
-    const int node_id = terminal_bit_vector_.Select1(key_id + 1) + 1;
+    const int node_id = node_blocks_ != nullptr
+                            ? SelectTerminalNodeInBlocks(key_id) + 1
+                            : terminal_bit_vector_.Select1(key_id + 1) + 1;
     louds_.InitNodeFromNodeId(node_id, node);
   }
 
@@ -104,6 +146,10 @@ class LoudsTrie {
     return node;
   }
 
+  // Returns the number of keys in this trie.  Valid key IDs are in
+  // [0, GetNumKeys()).
+  int GetNumKeys() const;
+
   // Restores the key string that reaches to |node|.  The caller is
   // responsible for allocating a buffer for the result string view, which needs
   // to be passed in |buf|.  The returned string view points to a piece of
@@ -136,13 +182,28 @@ class LoudsTrie {
 
   // Moves |node| to its child connected by the edge with |label|.  If there's
   // no edge having |label|, |node| becomes invalid and false is returned.
-  bool MoveToChildByLabel(char label, Node *node) const;
+  bool MoveToChildByLabel(char label, Node *node) const {
+    MoveToFirstChild(node);
+    return MoveToSiblingByLabel(label, node);
+  }
+
+  // Moves |node| to the first of itself and its next siblings whose edge has
+  // |label|.  If there's no such node, |node| becomes invalid and false is
+  // returned.
+  bool MoveToSiblingByLabel(char label, Node *node) const;
+
+  // Hints the processor to fetch the data read by MoveToSiblingByLabel() for
+  // |node|, i.e., its LOUDS bits, edge labels and terminal bits.
+  void PrefetchSiblings(const Node &node) const;
 
   // Traverses a trie for |key|, starting from |node|, and modifies |node| to
   // the destination terminal node.  Here, |node| is not necessarily the root.
   // Returns false if there's no node reachable by |key|.
   bool Traverse(absl::string_view key, Node *node) const;
 
+  // Returns true if the image was built with the interleaved layout.
+  bool HasInterleavedLayout() const { return node_blocks_ != nullptr; }
+
   // Higher level APIs.
 
   // Returns true if |key| is in this trie.
@@ -184,7 +245,74 @@ class LoudsTrie {
     }
   }
 
+  // Runs prefix search for each of |keys| at once.  The traversals for the
+  // keys proceed in turn one edge at a time, and the data needed by the next
+  // step of each traversal is prefetched before moving on to the other keys,
+  // so that the cache misses of the traversals overlap.  The prefixes of each
+  // key are reported in the ascending order of length, while those of
+  // different keys are interleaved.  |callback| needs to have the following
+  // signature:
+  //
+  // bool(size_t key_index, StringPiece key, StringPiece::size_type prefix_len,
+  //      const LoudsTrie &trie, LoudsTrie::Node node)
+  //
+  // where
+  //   key_index: The index of |key| in |keys|.
+  //   key, prefix_len, trie, node: The same as PrefixSearch().
+  // The search for |key| stops if |callback| returns false.
+  template <typename Func>
+  void PrefixSearchMulti(const std::vector<absl::string_view> &keys,
+                         Func callback) const {
+    // |node| of each cursor is the first child of the node reached by
+    // keys[key_index].substr(0, pos).
+    struct Cursor {
+      size_t key_index;
+      absl::string_view::size_type pos;
+      Node node;
+    };
+    std::vector<Cursor> cursors;
+    cursors.reserve(keys.size());
+    for (size_t i = 0; i < keys.size(); ++i) {
+      if (keys[i].empty()) {
+        continue;
+      }
+      Cursor cursor = {i, 0, Node()};
+      MoveToFirstChild(&cursor.node);
+      cursors.push_back(cursor);
+    }
+    while (!cursors.empty()) {
+      size_t num_active = 0;
+      for (size_t i = 0; i < cursors.size(); ++i) {
+        Cursor cursor = cursors[i];
+        const absl::string_view key = keys[cursor.key_index];
+        if (!MoveToSiblingByLabel(key[cursor.pos], &cursor.node)) {
+          continue;
+        }
+        ++cursor.pos;
+        if (IsTerminalNode(cursor.node) &&
+            !callback(cursor.key_index, key, cursor.pos, *this, cursor.node)) {
+          continue;
+        }
+        if (cursor.pos == key.size()) {
+          continue;
+        }
+        MoveToFirstChild(&cursor.node);
+        PrefetchSiblings(cursor.node);
+        cursors[num_active++] = cursor;
+      }
+      cursors.resize(num_active);
+    }
+  }
+
  private:
+  // Returns the number of terminal nodes before the |index|-th node in
+  // |node_blocks_|.
+  int GetKeyIdOfTerminalNodeInBlocks(int index) const;
+
+  // Returns the index of the (|key_id| + 1)-th terminal node in
+  // |node_blocks_|.
+  int SelectTerminalNodeInBlocks(int key_id) const;
+
   Louds louds_;  // Tree structure representation by LOUDS.
 
   // Bit-vector to represent whether each node in LOUDS tree is terminal.
@@ -200,6 +328,12 @@ class LoudsTrie {
   // In other words, id=2 in louds_ corresponds to edge_character_[1].
   const char *edge_character_;
 
+  // Interleaved per-node data, which replaces |terminal_bit_vector_| and
+  // |edge_character_| if the image has the interleaved layout.  Otherwise,
+  // nullptr.
+  const NodeBlock *node_blocks_;
+  int num_node_blocks_;
+
   DISALLOW_COPY_AND_ASSIGN(LoudsTrie);
 };
 
@@ -35,12 +35,17 @@
 #include "base/logging.h"
 #include "base/port.h"
 #include "storage/louds/bit_stream.h"
+#include "storage/louds/louds_trie.h"
 
 namespace mozc {
 namespace storage {
 namespace louds {
 
-LoudsTrieBuilder::LoudsTrieBuilder() : built_(false) {}
+LoudsTrieBuilder::LoudsTrieBuilder()
+    : built_(false), layout_(SEPARATE_LAYOUT) {}
+
+LoudsTrieBuilder::LoudsTrieBuilder(Layout layout)
+    : built_(false), layout_(layout) {}
 
 void LoudsTrieBuilder::Add(const std::string &word) {
   CHECK(!built_);
@@ -86,6 +91,36 @@ void PushInt(size_t value, std::string *image) {
   image->push_back(static_cast<char>((value >> 16) & 0xFF));
   image->push_back(static_cast<char>((value >> 24) & 0xFF));
 }
+
+// Builds the array of LoudsTrie::NodeBlock from the terminal bits and the edge
+// characters of the nodes.
+void PushNodeBlocks(const BitStream &terminal_stream,
+                    const std::string &edge_character, std::string *image) {
+  constexpr int kNodesPerBlock = LoudsTrie::kNodesPerBlock;
+  const std::string &terminal_image = terminal_stream.image();
+  const size_t num_nodes = edge_character.size();
+  size_t num_terminals = 0;
+  for (size_t begin = 0; begin < num_nodes; begin += kNodesPerBlock) {
+    uint32 terminal_bits[2] = {0, 0};
+    std::string labels(kNodesPerBlock, '\0');
+    const size_t num_terminals_before = num_terminals;
+    for (size_t i = begin; i < std::min(begin + kNodesPerBlock, num_nodes);
+         ++i) {
+      const int offset = i - begin;
+      if ((terminal_image[i / 8] >> (i % 8)) & 1) {
+        terminal_bits[offset / 32] |= uint32{1} << (offset % 32);
+        ++num_terminals;
+      }
+      labels[offset] = edge_character[i];
+    }
+    PushInt(num_terminals_before, image);
+    PushInt(terminal_bits[0], image);
+    PushInt(terminal_bits[1], image);
+    PushInt(0, image);  // Reserved.
+    image->append(labels);
+  }
+}
+
 }  // namespace
 
 void LoudsTrieBuilder::Build() {
@@ -197,6 +232,32 @@ void LoudsTrieBuilder::Build() {
   terminal_stream.FillPadding32();
 
   // Output
+  if (layout_ == INTERLEAVED_LAYOUT) {
+    std::string node_blocks;
+    PushNodeBlocks(terminal_stream, edge_character, &node_blocks);
+    // The terminal bits are in the node blocks, so the terminal image is used
+    // as the padding to align the node blocks at the cache line boundary
+    // relative to the beginning of the image.
+    constexpr int kHeaderSize = 16;
+    constexpr int kBlockSize = sizeof(LoudsTrie::NodeBlock);
+    const int padding_size =
+        (kBlockSize - (kHeaderSize + trie_stream.ByteSize()) % kBlockSize) %
+        kBlockSize;
+    PushInt(trie_stream.ByteSize(), &image_);
+    PushInt(padding_size, &image_);
+    // The num bits of each character with the flag of the interleaved layout.
+    PushInt(LoudsTrie::kInterleavedLayoutFlag | 8, &image_);
+    PushInt(node_blocks.size(), &image_);
+
+    image_.append(trie_stream.image());
+    image_.append(padding_size, '\0');
+    DCHECK_EQ(0, image_.size() % kBlockSize);
+    image_.append(node_blocks);
+
+    built_ = true;
+    return;
+  }
+
   PushInt(trie_stream.ByteSize(), &image_);
   PushInt(terminal_stream.ByteSize(), &image_);
   // The num bits of each character annoated to each edge.
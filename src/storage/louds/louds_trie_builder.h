@@ -41,7 +41,18 @@ namespace louds {
 
 class LoudsTrieBuilder {
  public:
+  // Layout of the per-node data in the image; see louds_trie.cc.
+  enum Layout {
+    // The terminal bit vector and the edge characters are stored in separate
+    // arrays.
+    SEPARATE_LAYOUT,
+    // The edge characters and terminal bits are interleaved in blocks of the
+    // size of a cache line, which makes trie descent touch fewer cache lines.
+    INTERLEAVED_LAYOUT,
+  };
+
   LoudsTrieBuilder();
+  explicit LoudsTrieBuilder(Layout layout);
 
   // Adds the word to the builder. It is necessary to call this method,
   // before Build invocation.
@@ -60,6 +71,7 @@ class LoudsTrieBuilder {
 
  private:
   bool built_;
+  Layout layout_;
 
   std::vector<std::string> word_list_;
   std::vector<int> id_list_;
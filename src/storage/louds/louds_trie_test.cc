@@ -29,6 +29,9 @@
 
 #include "storage/louds/louds_trie.h"
 
+#include <random>
+#include <set>
+#include <string>
 #include <vector>
 
 #include "base/port.h"
@@ -491,6 +494,82 @@ TEST_P(LoudsTrieTest, PrefixSearch) {
 }
 INSTANTIATE_TEST_CASE(GenPrefixSearchTest);
 
+TEST_P(LoudsTrieTest, PrefixSearchMulti) {
+  LoudsTrieBuilder builder;
+  builder.Add("aa");
+  builder.Add("ab");
+  builder.Add("abc");
+  builder.Add("abcd");
+  builder.Add("abd");
+  builder.Add("bc");
+  builder.Add("bcd");
+  builder.Add("c");
+  builder.Add("d");
+  builder.Add("ebd");
+  builder.Build();
+
+  const CacheSizeParam &param = GetParam();
+  LoudsTrie trie;
+  trie.Open(reinterpret_cast<const uint8 *>(builder.image().data()),
+            param.louds_lb0_cache_size, param.louds_lb1_cache_size,
+            param.louds_select0_cache_size, param.louds_select1_cache_size,
+            param.termvec_lb1_cache_size);
+
+  // All the suffixes of a key, as the converter looks them up.
+  const absl::string_view kKey = "abcde";
+  std::vector<absl::string_view> keys;
+  for (size_t i = 0; i <= kKey.size(); ++i) {
+    keys.push_back(kKey.substr(i));
+  }
+
+  {
+    std::vector<std::vector<RecordCallbackArgs::CallbackArgs>> actual(
+        keys.size());
+    trie.PrefixSearchMulti(
+        keys, [&actual](size_t key_index, absl::string_view key,
+                        size_t prefix_len, const LoudsTrie &trie,
+                        LoudsTrie::Node node) {
+          RecordCallbackArgs record(&actual[key_index]);
+          record(key, prefix_len, trie, node);
+          return true;
+        });
+    for (size_t i = 0; i < keys.size(); ++i) {
+      std::vector<RecordCallbackArgs::CallbackArgs> expected;
+      trie.PrefixSearch(keys[i], RecordCallbackArgs(&expected));
+      ASSERT_EQ(expected.size(), actual[i].size()) << keys[i];
+      for (size_t j = 0; j < expected.size(); ++j) {
+        EXPECT_EQ(keys[i], actual[i][j].key);
+        EXPECT_EQ(expected[j].prefix_len, actual[i][j].prefix_len);
+        EXPECT_EQ(expected[j].node, actual[i][j].node);
+      }
+    }
+    // "abcde" has the prefixes "ab", "abc" and "abcd".
+    ASSERT_EQ(3, actual[0].size());
+    EXPECT_EQ(2, actual[0][0].prefix_len);
+    EXPECT_EQ(4, actual[0][2].prefix_len);
+  }
+  {
+    // Stop the search for each key at the first prefix.
+    std::vector<std::vector<RecordCallbackArgs::CallbackArgs>> actual(
+        keys.size());
+    trie.PrefixSearchMulti(
+        keys, [&actual](size_t key_index, absl::string_view key,
+                        size_t prefix_len, const LoudsTrie &trie,
+                        LoudsTrie::Node node) {
+          RecordCallbackArgs record(&actual[key_index]);
+          record(key, prefix_len, trie, node);
+          return false;
+        });
+    EXPECT_EQ(1, actual[0].size());  // "ab"
+    EXPECT_EQ(1, actual[1].size());  // "bc"
+    EXPECT_EQ(1, actual[2].size());  // "c"
+    EXPECT_EQ(1, actual[3].size());  // "d"
+    EXPECT_EQ(0, actual[4].size());
+    EXPECT_EQ(0, actual[5].size());
+  }
+}
+INSTANTIATE_TEST_CASE(GenPrefixSearchMultiTest);
+
 TEST_P(LoudsTrieTest, RestoreKeyString) {
   LoudsTrieBuilder builder;
   builder.Add("aa");
@@ -528,6 +607,78 @@ TEST_P(LoudsTrieTest, RestoreKeyString) {
 }
 INSTANTIATE_TEST_CASE(GenRestoreKeyStringTest);
 
+TEST_P(LoudsTrieTest, InterleavedLayout) {
+  // Builds the same trie in both layouts with enough nodes to span multiple
+  // node blocks, and checks that they behave identically.
+  std::mt19937 random(0x10ad5);
+  std::vector<std::string> words;
+  for (int i = 0; i < 500; ++i) {
+    std::string word(1 + random() % 6, '\0');
+    for (char &c : word) {
+      c = "abcdefg\x80\xFF"[random() % 9];
+    }
+    words.push_back(word);
+  }
+
+  LoudsTrieBuilder separate_builder;
+  LoudsTrieBuilder interleaved_builder(LoudsTrieBuilder::INTERLEAVED_LAYOUT);
+  for (const std::string &word : words) {
+    separate_builder.Add(word);
+    interleaved_builder.Add(word);
+  }
+  separate_builder.Build();
+  interleaved_builder.Build();
+  // The node blocks are at the end of the image and aligned at the block size
+  // relative to the beginning of the image.
+  EXPECT_EQ(0,
+            interleaved_builder.image().size() % sizeof(LoudsTrie::NodeBlock));
+
+  const CacheSizeParam &param = GetParam();
+  LoudsTrie separate_trie, interleaved_trie;
+  separate_trie.Open(
+      reinterpret_cast<const uint8 *>(separate_builder.image().data()),
+      param.louds_lb0_cache_size, param.louds_lb1_cache_size,
+      param.louds_select0_cache_size, param.louds_select1_cache_size,
+      param.termvec_lb1_cache_size);
+  interleaved_trie.Open(
+      reinterpret_cast<const uint8 *>(interleaved_builder.image().data()),
+      param.louds_lb0_cache_size, param.louds_lb1_cache_size,
+      param.louds_select0_cache_size, param.louds_select1_cache_size,
+      param.termvec_lb1_cache_size);
+  EXPECT_FALSE(separate_trie.HasInterleavedLayout());
+  EXPECT_TRUE(interleaved_trie.HasInterleavedLayout());
+
+  const int num_keys =
+      std::set<std::string>(words.begin(), words.end()).size();
+  EXPECT_EQ(num_keys, separate_trie.GetNumKeys());
+  EXPECT_EQ(num_keys, interleaved_trie.GetNumKeys());
+
+  char buffer[LoudsTrie::kMaxDepth + 1];
+  for (const std::string &word : words) {
+    const int id = separate_builder.GetId(word);
+    EXPECT_EQ(id, interleaved_builder.GetId(word));
+    EXPECT_EQ(id, separate_trie.ExactSearch(word));
+    EXPECT_EQ(id, interleaved_trie.ExactSearch(word));
+    EXPECT_EQ(word, interleaved_trie.RestoreKeyString(id, buffer));
+
+    // Prefix search with a longer key also visits non-terminal nodes.
+    const std::string key = word + "ab";
+    std::vector<RecordCallbackArgs::CallbackArgs> expected, actual;
+    separate_trie.PrefixSearch(key, RecordCallbackArgs(&expected));
+    interleaved_trie.PrefixSearch(key, RecordCallbackArgs(&actual));
+    ASSERT_EQ(expected.size(), actual.size()) << key;
+    for (size_t i = 0; i < expected.size(); ++i) {
+      EXPECT_EQ(expected[i].prefix_len, actual[i].prefix_len);
+      EXPECT_EQ(expected[i].node, actual[i].node);
+      EXPECT_EQ(separate_trie.GetKeyIdOfTerminalNode(expected[i].node),
+                interleaved_trie.GetKeyIdOfTerminalNode(actual[i].node));
+    }
+  }
+  EXPECT_EQ(-1, interleaved_trie.ExactSearch("h"));
+  EXPECT_FALSE(interleaved_trie.HasKey("abcdefgh"));
+}
+INSTANTIATE_TEST_CASE(GenInterleavedLayoutTest);
+
 }  // namespace
 }  // namespace louds
 }  // namespace storage
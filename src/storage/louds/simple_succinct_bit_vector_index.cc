@@ -30,146 +30,161 @@
 #include "storage/louds/simple_succinct_bit_vector_index.h"
 
 #include <algorithm>
-#include <iterator>
+#include <cstring>
 #include <vector>
 
-#include "base/iterator_adapter.h"
 #include "base/logging.h"
 #include "base/port.h"
 
+#if defined(__GNUC__) && defined(__x86_64__)
+#define MOZC_BIT_VECTOR_INDEX_X86_64
+#include <immintrin.h>
+#endif  // __GNUC__ && __x86_64__
+
 namespace mozc {
 namespace storage {
 namespace louds {
 namespace {
 
-// Simple adapter to convert from 1-bit index to 0-bit index.
-class ZeroBitAdapter : public AdapterBase<int> {
- public:
-  // Needs to be default constructive to create invalid iterator.
-  ZeroBitAdapter() : index_(nullptr), chunk_size_(0) {}
-
-  ZeroBitAdapter(const std::vector<int> *index, int chunk_size)
-      : index_(index), chunk_size_(chunk_size) {}
-
-  value_type operator()(const int *ptr) const {
-    // The number of 0-bits
-    //   = (total num bits) - (1-bits)
-    //   = (chunk_size [bytes] * 8 [bits/byte] * (ptr's offset) - (1-bits)
-    return chunk_size_ * 8 * (ptr - index_->data()) - *ptr;
-  }
-
- private:
-  const std::vector<int> *index_;
-  int chunk_size_;
-};
-
-#ifdef __GNUC__
-// TODO(hidehiko): Support XMM and 64-bits popcount for 64bits architectures.
-inline int BitCount1(uint32 x) { return __builtin_popcount(x); }
-#else
-int BitCount1(uint32 x) {
-  x = ((x & 0xaaaaaaaa) >> 1) + (x & 0x55555555);
-  x = ((x & 0xcccccccc) >> 2) + (x & 0x33333333);
-  x = ((x >> 4) + x) & 0x0f0f0f0f;
-  x = (x >> 8) + x;
-  x = ((x >> 16) + x) & 0x3f;
-  return x;
+constexpr int kWordBits = 64;
+constexpr int kWordsPerBlock = 8;
+constexpr int kBlockBits = kWordBits * kWordsPerBlock;
+
+constexpr uint64 kOnesStep8 = 0x0101010101010101ULL;
+constexpr uint64 kMsbsStep8 = 0x8080808080808080ULL;
+
+// Without -mpopcnt, __builtin_popcountll() is compiled into a call to the
+// library, which is slower than the broadword counting inlined here.
+#if defined(__GNUC__) && defined(__POPCNT__)
+inline int BitCount1(uint64 x) { return __builtin_popcountll(x); }
+#else   // __GNUC__ && __POPCNT__
+inline int BitCount1(uint64 x) {
+  x = x - ((x >> 1) & 0x5555555555555555ULL);
+  x = (x & 0x3333333333333333ULL) + ((x >> 2) & 0x3333333333333333ULL);
+  x = (x + (x >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+  return static_cast<int>((x * kOnesStep8) >> 56);
 }
-#endif
+#endif  // __GNUC__ && __POPCNT__
 
-inline int BitCount0(uint32 x) {
-  // Flip all bits, and count 1-bits.
-  return BitCount1(~x);
-}
-
-inline bool IsPowerOfTwo(int value) {
-  // value & -value is the well-known idiom to take the lowest 1-bit in
-  // value, so value & ~(value & -value) clears the lowest 1-bit in value.
-  // If the result is 0, value has only one 1-bit i.e. it is power of two.
-  return value != 0 && (value & ~(value & -value)) == 0;
+#ifdef __GNUC__
+inline int CountTrailingZeros(uint64 x) { return __builtin_ctzll(x); }
+#else   // __GNUC__
+inline int CountTrailingZeros(uint64 x) {
+  // Isolate the lowest 1-bit and count the bits below it.
+  return BitCount1((x & (~x + 1)) - 1);
 }
-
-// Returns 1-bits in the data[0] ... data[length - 1].
-int Count1Bits(const uint32 *data, int length) {
-  int num_bits = 0;
-  for (; length > 0; ++data, --length) {
-    num_bits += BitCount1(*data);
+#endif  // __GNUC__
+
+using SelectInWordFunc = int (*)(uint64 x, int k);
+
+// Returns the position of the (k + 1)-th 1-bit in |x|.  |k| needs to be less
+// than the number of 1-bits in |x|.
+int SelectInWordBroadword(uint64 x, int k) {
+  // Broadword selection; see S. Vigna, "Broadword Implementation of
+  // Rank/Select Queries", 2008.  First, the i-th byte of |byte_sums| is set
+  // to the number of 1-bits in the 0-th to i-th bytes of |x|.
+  uint64 byte_sums = x - ((x >> 1) & 0x5555555555555555ULL);
+  byte_sums = (byte_sums & 0x3333333333333333ULL) +
+              ((byte_sums >> 2) & 0x3333333333333333ULL);
+  byte_sums = (byte_sums + (byte_sums >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+  byte_sums *= kOnesStep8;
+
+  // The MSB of each byte is set iff k >= the cumulative count, so the number
+  // of such bytes is the index of the byte containing the target bit.
+  const uint64 k_step8 = static_cast<uint64>(k) * kOnesStep8;
+  const uint64 geq_k_step8 = ((k_step8 | kMsbsStep8) - byte_sums) & kMsbsStep8;
+  const int place = BitCount1(geq_k_step8) * 8;
+  const int byte_rank =
+      k - static_cast<int>(((byte_sums << 8) >> place) & 0xFF);
+
+  // Finally, drop |byte_rank| lowest 1-bits in the byte.
+  uint32 byte = static_cast<uint32>((x >> place) & 0xFF);
+  for (int i = 0; i < byte_rank; ++i) {
+    byte &= byte - 1;
   }
-  return num_bits;
+  return place + CountTrailingZeros(byte);
 }
 
-// Stores index (the camulative number of the 1-bits from begin of each chunk).
-void InitIndex(const uint8 *data, int length, int chunk_size,
-               std::vector<int> *index) {
-  DCHECK_GE(chunk_size, 4);
-  DCHECK(IsPowerOfTwo(chunk_size)) << chunk_size;
-  DCHECK_EQ(length % 4, 0);
-
-  index->clear();
+#ifdef MOZC_BIT_VECTOR_INDEX_X86_64
 
-  // Count the number of chunks with ceiling.
-  const int chunk_length = (length + chunk_size - 1) / chunk_size;
+// Deposits a 1-bit at the k-th 1-bit of |x|.
+__attribute__((target("bmi2"))) int SelectInWordBMI2(uint64 x, int k) {
+  return __builtin_ctzll(_pdep_u64(uint64{1} << k, x));
+}
 
-  // Reserve the memory including a sentinel.
-  index->reserve(chunk_length + 1);
+#endif  // MOZC_BIT_VECTOR_INDEX_X86_64
 
-  int num_bits = 0;
-  for (int remaining_num_words = length / 4; remaining_num_words > 0;
-       data += chunk_size, remaining_num_words -= chunk_size / 4) {
-    index->push_back(num_bits);
-    num_bits += Count1Bits(reinterpret_cast<const uint32 *>(data),
-                           std::min(chunk_size / 4, remaining_num_words));
+SelectInWordFunc GetSelectInWordFunc() {
+#ifdef MOZC_BIT_VECTOR_INDEX_X86_64
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("bmi2")) {
+    return &SelectInWordBMI2;
   }
-  index->push_back(num_bits);
+#endif  // MOZC_BIT_VECTOR_INDEX_X86_64
+  return &SelectInWordBroadword;
+}
 
-  CHECK_EQ(chunk_length + 1, index->size());
+inline int SelectInWord(uint64 x, int k) {
+  static const SelectInWordFunc kFunc = GetSelectInWordFunc();
+  return (*kFunc)(x, k);
 }
 
-void InitLowerBound0Cache(const std::vector<int> &index, int chunk_size,
-                          size_t increment, size_t size,
-                          std::vector<const int *> *cache) {
-  DCHECK_GT(increment, 0);
-  cache->clear();
-  cache->reserve(size + 2);
-  cache->push_back(index.data());
-  ZeroBitAdapter adapter(&index, chunk_size);
-  for (size_t i = 1; i <= size; ++i) {
-    const int target_index = increment * i;
-    const int *ptr =
-        std::lower_bound(
-            MakeIteratorAdapter(index.data(), adapter),
-            MakeIteratorAdapter(index.data() + index.size(), adapter),
-            target_index)
-            .base();
-    cache->push_back(ptr);
-  }
-  cache->push_back(index.data() + index.size());
+// Returns the number of 1-bits before the |index|-th word in the block.
+inline int SubRank(uint64 sub_ranks, int index) {
+  return index == 0 ? 0 : (sub_ranks >> (9 * (index - 1))) & 0x1FF;
 }
 
-void InitLowerBound1Cache(const std::vector<int> &index, int chunk_size,
-                          size_t increment, size_t size,
-                          std::vector<const int *> *cache) {
-  DCHECK_GT(increment, 0);
-  cache->clear();
-  cache->reserve(size + 2);
-  cache->push_back(index.data());
-  for (size_t i = 1; i <= size; ++i) {
-    const int target_index = increment * i;
-    const int *ptr = std::lower_bound(index.data(), index.data() + index.size(),
-                                      target_index);
-    cache->push_back(ptr);
-  }
-  cache->push_back(index.data() + index.size());
+// Returns the number of 0-bits before the |index|-th word in the block.
+inline int SubRank0(uint64 sub_ranks, int index) {
+  return kWordBits * index - SubRank(sub_ranks, index);
 }
 
 }  // namespace
 
+uint64 SimpleSuccinctBitVectorIndex::GetWord(int index) const {
+  // The data is not necessarily aligned to 64 bits, and its length is only
+  // guaranteed to be a multiple of 4 bytes.  Note that, as the bit order in
+  // Get(), the data is interpreted as little endian.
+  const int offset = index * 8;
+  if (offset + 8 <= length_) {
+    uint64 word;
+    memcpy(&word, data_ + offset, sizeof(word));
+    return word;
+  }
+  uint32 half_word;
+  memcpy(&half_word, data_ + offset, sizeof(half_word));
+  return half_word;
+}
+
 void SimpleSuccinctBitVectorIndex::Init(const uint8 *data, int length,
                                         size_t lb0_cache_size,
                                         size_t lb1_cache_size) {
+  DCHECK_EQ(length % 4, 0);
   data_ = data;
   length_ = length;
-  InitIndex(data, length, chunk_size_, &index_);
+
+  // Build the index of the blocks, including a sentinel.
+  const int num_words = (length + 7) / 8;
+  const int num_blocks = (num_words + kWordsPerBlock - 1) / kWordsPerBlock;
+  blocks_.clear();
+  blocks_.reserve(num_blocks + 1);
+  uint64 num_bits = 0;
+  for (int i = 0; i < num_blocks; ++i) {
+    RankBlock block = {num_bits, 0};
+    uint64 sub_rank = 0;
+    for (int j = 0; j < kWordsPerBlock; ++j) {
+      const int word_index = i * kWordsPerBlock + j;
+      if (j > 0) {
+        block.sub_ranks |= sub_rank << (9 * (j - 1));
+      }
+      if (word_index < num_words) {
+        sub_rank += BitCount1(GetWord(word_index));
+      }
+    }
+    blocks_.push_back(block);
+    num_bits += sub_rank;
+  }
+  blocks_.push_back({num_bits, 0});
 
   // TODO(noriyukit): Currently, we simply use uniform increment width for lower
   // bound cache.  Nonuniform increment width may improve performance.
@@ -178,22 +193,44 @@ void SimpleSuccinctBitVectorIndex::Init(const uint8 *data, int length,
   if (lb0_cache_increment_ == 0) {
     lb0_cache_increment_ = 1;
   }
-  InitLowerBound0Cache(index_, chunk_size_, lb0_cache_increment_,
-                       lb0_cache_size, &lb0_cache_);
+  lb0_cache_.clear();
+  lb0_cache_.reserve(lb0_cache_size + 2);
+  lb0_cache_.push_back(0);
+  int block_index = 0;
+  for (size_t i = 1; i <= lb0_cache_size; ++i) {
+    const int target = lb0_cache_increment_ * i;
+    while (block_index < blocks_.size() &&
+           kBlockBits * block_index - blocks_[block_index].rank < target) {
+      ++block_index;
+    }
+    lb0_cache_.push_back(block_index);
+  }
+  lb0_cache_.push_back(blocks_.size());
 
   lb1_cache_increment_ =
       lb1_cache_size == 0 ? GetNum1Bits() : GetNum1Bits() / lb1_cache_size;
   if (lb1_cache_increment_ == 0) {
     lb1_cache_increment_ = 1;
   }
-  InitLowerBound1Cache(index_, chunk_size_, lb1_cache_increment_,
-                       lb1_cache_size, &lb1_cache_);
+  lb1_cache_.clear();
+  lb1_cache_.reserve(lb1_cache_size + 2);
+  lb1_cache_.push_back(0);
+  block_index = 0;
+  for (size_t i = 1; i <= lb1_cache_size; ++i) {
+    const int target = lb1_cache_increment_ * i;
+    while (block_index < blocks_.size() &&
+           blocks_[block_index].rank < target) {
+      ++block_index;
+    }
+    lb1_cache_.push_back(block_index);
+  }
+  lb1_cache_.push_back(blocks_.size());
 }
 
 void SimpleSuccinctBitVectorIndex::Reset() {
   data_ = nullptr;
   length_ = 0;
-  index_.clear();
+  blocks_.clear();
   lb0_cache_increment_ = 1;
   lb0_cache_.clear();
   lb1_cache_increment_ = 1;
@@ -201,106 +238,88 @@ void SimpleSuccinctBitVectorIndex::Reset() {
 }
 
 int SimpleSuccinctBitVectorIndex::Rank1(int n) const {
-  // Look up pre-computed 1-bits for the preceding chunks.
-  const int num_chunks = n / (chunk_size_ * 8);
-  int result = index_[n / (chunk_size_ * 8)];
-
-  // Count 1-bits for remaining "words".
-  result += Count1Bits(
-      reinterpret_cast<const uint32 *>(data_ + num_chunks * chunk_size_),
-      (n / 8 - num_chunks * chunk_size_) / 4);
+  // Look up pre-computed 1-bits for the preceding blocks and words.
+  const RankBlock &block = blocks_[n / kBlockBits];
+  const int word_index = n / kWordBits;
+  int result = static_cast<int>(block.rank) +
+               SubRank(block.sub_ranks, word_index % kWordsPerBlock);
 
   // Count 1-bits for remaining "bits".
-  if (n % 32 > 0) {
-    const int index = n / 32;
-    const int shift = 32 - n % 32;
-    result +=
-        BitCount1(reinterpret_cast<const uint32 *>(data_)[index] << shift);
+  if (n % kWordBits > 0) {
+    result += BitCount1(GetWord(word_index) << (kWordBits - n % kWordBits));
   }
-
   return result;
 }
 
 int SimpleSuccinctBitVectorIndex::Select0(int n) const {
   DCHECK_GT(n, 0);
 
-  // Narrow down the range of |index_| on which lower bound is performed.
+  // Narrow down the range of |blocks_| on which lower bound is performed.
   int lb0_cache_index = n / lb0_cache_increment_;
   if (lb0_cache_index > lb0_cache_.size() - 2) {
     lb0_cache_index = lb0_cache_.size() - 2;
   }
   DCHECK_GE(lb0_cache_index, 0);
 
-  // Binary search on chunks.
-  ZeroBitAdapter adapter(&index_, chunk_size_);
-  const int *chunk_ptr =
-      std::lower_bound(
-          MakeIteratorAdapter(lb0_cache_[lb0_cache_index], adapter),
-          MakeIteratorAdapter(lb0_cache_[lb0_cache_index + 1], adapter), n)
-          .base();
-  const int chunk_index = (chunk_ptr - index_.data()) - 1;
-  DCHECK_GE(chunk_index, 0);
-  n -= chunk_size_ * 8 * chunk_index - index_[chunk_index];
-
-  // Linear search on remaining "words"
-  const uint32 *ptr =
-      reinterpret_cast<const uint32 *>(data_) + chunk_index * chunk_size_ / 4;
-  while (true) {
-    const int bit_count = BitCount0(*ptr);
-    if (bit_count >= n) {
-      break;
-    }
-    n -= bit_count;
-    ++ptr;
+  // Binary search on blocks.
+  const RankBlock *begin = blocks_.data();
+  const RankBlock *block_ptr = std::lower_bound(
+      begin + lb0_cache_[lb0_cache_index],
+      begin + lb0_cache_[lb0_cache_index + 1], n,
+      [begin](const RankBlock &block, int n) {
+        return kBlockBits * (&block - begin) - static_cast<int>(block.rank) <
+               n;
+      });
+  const int block_index = (block_ptr - begin) - 1;
+  DCHECK_GE(block_index, 0);
+  const RankBlock &block = blocks_[block_index];
+  n -= kBlockBits * block_index - static_cast<int>(block.rank);
+
+  // Linear search on the words in the block.
+  int word_offset = 0;
+  while (word_offset + 1 < kWordsPerBlock &&
+         SubRank0(block.sub_ranks, word_offset + 1) < n) {
+    ++word_offset;
   }
+  n -= SubRank0(block.sub_ranks, word_offset);
 
-  int index = (ptr - reinterpret_cast<const uint32 *>(data_)) * 32;
-  for (uint32 word = ~(*ptr); n > 0; word >>= 1, ++index) {
-    n -= (word & 1);
-  }
-
-  // Index points to the "next bit" of the target one.
-  // Thus, subtract one to adjust.
-  return index - 1;
+  const int word_index = block_index * kWordsPerBlock + word_offset;
+  return word_index * kWordBits + SelectInWord(~GetWord(word_index), n - 1);
 }
 
 int SimpleSuccinctBitVectorIndex::Select1(int n) const {
   DCHECK_GT(n, 0);
 
-  // Narrow down the range of |index_| on which lower bound is performed.
+  // Narrow down the range of |blocks_| on which lower bound is performed.
   int lb1_cache_index = n / lb1_cache_increment_;
   if (lb1_cache_index > lb1_cache_.size() - 2) {
     lb1_cache_index = lb1_cache_.size() - 2;
   }
   DCHECK_GE(lb1_cache_index, 0);
 
-  // Binary search on chunks.
-  const int *chunk_ptr = std::lower_bound(lb1_cache_[lb1_cache_index],
-                                          lb1_cache_[lb1_cache_index + 1], n);
-  const int chunk_index = (chunk_ptr - index_.data()) - 1;
-  DCHECK_GE(chunk_index, 0);
-  n -= index_[chunk_index];
-
-  // Linear search on remaining "words"
-  const uint32 *ptr =
-      reinterpret_cast<const uint32 *>(data_) + chunk_index * chunk_size_ / 4;
-  while (true) {
-    const int bit_count = BitCount1(*ptr);
-    if (bit_count >= n) {
-      break;
-    }
-    n -= bit_count;
-    ++ptr;
-  }
-
-  int index = (ptr - reinterpret_cast<const uint32 *>(data_)) * 32;
-  for (uint32 word = *ptr; n > 0; word >>= 1, ++index) {
-    n -= (word & 1);
+  // Binary search on blocks.
+  const RankBlock *begin = blocks_.data();
+  const RankBlock *block_ptr = std::lower_bound(
+      begin + lb1_cache_[lb1_cache_index],
+      begin + lb1_cache_[lb1_cache_index + 1], n,
+      [](const RankBlock &block, int n) {
+        return static_cast<int>(block.rank) < n;
+      });
+  const int block_index = (block_ptr - begin) - 1;
+  DCHECK_GE(block_index, 0);
+  const RankBlock &block = blocks_[block_index];
+  n -= static_cast<int>(block.rank);
+
+  // Linear search on the words in the block.
+  int word_offset = 0;
+  while (word_offset + 1 < kWordsPerBlock &&
+         SubRank(block.sub_ranks, word_offset + 1) < n) {
+    ++word_offset;
   }
+  n -= SubRank(block.sub_ranks, word_offset);
 
-  // Index points to the "next bit" of the target one.
-  // Thus, subtract one to adjust.
-  return index - 1;
+  const int word_index = block_index * kWordsPerBlock + word_offset;
+  return word_index * kWordBits + SelectInWord(GetWord(word_index), n - 1);
 }
 
 }  // namespace louds
@@ -31,36 +31,33 @@
 #define MOZC_STORAGE_LOUDS_SIMPLE_SUCCINCT_BIT_VECTOR_INDEX_H_
 
 #include <vector>
+
 #include "base/port.h"
 
 namespace mozc {
 namespace storage {
 namespace louds {
 
-// This is simple(naive) C++ implementation of succinct bit vector.
+// Succinct bit vector index in the style of rank9 (S. Vigna, "Broadword
+// Implementation of Rank/Select Queries", 2008).
+// The bit vector is split into blocks of 512 bits, i.e., 8 64-bit words.  For
+// each block, the index holds the number of 1-bits before the block and, next
+// to it, the numbers of 1-bits before each word in the block, so that Rank1()
+// reads one 16-byte entry of the index and one word of the data.
+// Select0/1() find the block by binary search on the index, narrowed down by
+// the lower bound caches, then the word by the counts in the entry, and then
+// the bit by broadword select (or PDEP if BMI2 is available) in the word.
 class SimpleSuccinctBitVectorIndex {
  public:
-  // The default chunk_size is 32.
   SimpleSuccinctBitVectorIndex()
       : data_(nullptr),
         length_(0),
-        chunk_size_(32),
-        lb0_cache_increment_(1),
-        lb1_cache_increment_(1) {}
-
-  // chunk_size is in bytes, and must be greater than or equal to 4
-  // and power of 2, at the moment, although we may relax the restriction
-  // in future if necessary.
-  explicit SimpleSuccinctBitVectorIndex(int chunk_size)
-      : data_(nullptr),
-        length_(0),
-        chunk_size_(chunk_size),
         lb0_cache_increment_(1),
         lb1_cache_increment_(1) {}
 
   // Initializes the index. This class doesn't have the ownership of the memory
   // pointed by data, so it is caller's responsibility to manage its life time.
-  // The 'data' needs to be aligned to 32-bits.
+  // The 'length' needs to be a multiple of 4.
   void Init(const uint8 *data, int length, size_t lb0_cache_size,
             size_t lb1_cache_size);
 
@@ -89,19 +86,43 @@ class SimpleSuccinctBitVectorIndex {
   // Returned index is 0-origin.
   int Select1(int n) const;
 
-  int GetNum1Bits() const { return index_.back(); }
-  int GetNum0Bits() const { return 8 * length_ - index_.back(); }
+  // Hints the processor to fetch the cache line holding the |index|-th bit.
+  void Prefetch(int index) const {
+#ifdef __GNUC__
+    __builtin_prefetch(data_ + index / 8);
+#endif  // __GNUC__
+  }
+
+  int GetNum1Bits() const { return static_cast<int>(blocks_.back().rank); }
+  int GetNum0Bits() const { return 8 * length_ - GetNum1Bits(); }
 
  private:
+  // Index entry of a block of 512 bits.
+  struct RankBlock {
+    // The number of 1-bits before the block.
+    uint64 rank;
+    // The number of 1-bits in the block before the i-th word (1 <= i <= 7) is
+    // stored in the 9 bits from the (9 * (i - 1))-th bit.
+    uint64 sub_ranks;
+  };
+
+  // Returns the |index|-th 64-bit word of the data.  The last word is padded
+  // with 0-bits if the length is not a multiple of 8.
+  uint64 GetWord(int index) const;
+
   const uint8 *data_;
   int length_;
-  int chunk_size_;
 
-  std::vector<int> index_;
+  // The entries of the blocks followed by a sentinel holding the total number
+  // of 1-bits.
+  std::vector<RankBlock> blocks_;
+
+  // |lbX_cache_|[i] is the first block in |blocks_| such that the number of
+  // X-bits before it is at least |lbX_cache_increment_| * i.
   int lb0_cache_increment_;
-  std::vector<const int *> lb0_cache_;
+  std::vector<int> lb0_cache_;
   int lb1_cache_increment_;
-  std::vector<const int *> lb1_cache_;
+  std::vector<int> lb1_cache_;
 
   DISALLOW_COPY_AND_ASSIGN(SimpleSuccinctBitVectorIndex);
 };
@@ -29,6 +29,10 @@
 
 #include "storage/louds/simple_succinct_bit_vector_index.h"
 
+#include <random>
+#include <string>
+#include <vector>
+
 #include "testing/base/public/gunit.h"
 
 namespace {
@@ -187,4 +191,48 @@ TEST_P(SimpleSuccinctBitVectorIndexTest, Pattern2) {
 }
 INSTANTIATE_TEST_CASE(GenPattern2Test);
 
+TEST_P(SimpleSuccinctBitVectorIndexTest, Random) {
+  const CacheSizeParam &param = GetParam();
+  std::mt19937 random(0x5eed);
+
+  // Covers lengths which are not a multiple of 8 bytes (a 64-bit word) or 64
+  // bytes (a block), and several densities of 1-bits.
+  const int kLengths[] = {4, 8, 12, 60, 64, 68, 124, 128, 1028, 4096};
+  const int kDensities[] = {1, 50, 99};  // in percent
+  for (int length : kLengths) {
+    for (int density : kDensities) {
+      std::string data(length, '\0');
+      std::vector<int> rank1(8 * length + 1, 0);
+      std::vector<int> select0, select1;
+      for (int i = 0; i < 8 * length; ++i) {
+        const bool bit = random() % 100 < density;
+        if (bit) {
+          data[i / 8] |= 1 << (i % 8);
+          select1.push_back(i);
+        } else {
+          select0.push_back(i);
+        }
+        rank1[i + 1] = rank1[i] + bit;
+      }
+
+      SimpleSuccinctBitVectorIndex bit_vector;
+      bit_vector.Init(reinterpret_cast<const uint8 *>(data.data()), length,
+                      param.first, param.second);
+      EXPECT_EQ(select0.size(), bit_vector.GetNum0Bits());
+      EXPECT_EQ(select1.size(), bit_vector.GetNum1Bits());
+      for (int i = 0; i <= 8 * length; ++i) {
+        EXPECT_EQ(rank1[i], bit_vector.Rank1(i)) << length << ", " << i;
+        EXPECT_EQ(i - rank1[i], bit_vector.Rank0(i)) << length << ", " << i;
+      }
+      for (int i = 0; i < select0.size(); ++i) {
+        EXPECT_EQ(select0[i], bit_vector.Select0(i + 1)) << length << ", " << i;
+      }
+      for (int i = 0; i < select1.size(); ++i) {
+        EXPECT_EQ(select1[i], bit_vector.Select1(i + 1)) << length << ", " << i;
+      }
+    }
+  }
+}
+INSTANTIATE_TEST_CASE(GenRandomTest);
+
 }  // namespace